@@ -0,0 +1,406 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file jmatrix_bench.cpp
+ *
+ * Micro-benchmarks of the jmatrix library.\n
+ * Usage: jmatrix_bench [-s size] [-r repetitions] [-f filter] [-t tmpdir] [-o results.json]\n
+ *  - size:        number of rows (and columns) of the matrices (default: 512)
+ *  - repetitions: times each benchmark is run after one warm-up run (default: 5)
+ *  - filter:      only benchmarks whose name contains this string are run
+ *  - tmpdir:      directory for the temporary binary and csv files (default: current directory)
+ *  - results:     file to write the results in JSON format (default: standard output)
+ *
+ * Each result reports the number of operations of one run and the minimum, median and mean time per operation in nanoseconds.
+ */
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <cstdio>
+#include "../headers/fullmatrix.h"
+#include "../headers/sparsematrix.h"
+#include "../headers/symmetricmatrix.h"
+#include "../headers/bitmatrix.h"
+#include "../headers/matgetrows.h"
+#include "../headers/matgetcols.h"
+#include "../headers/jmatrixreader.h"
+
+#define BENCH_STR2(x) #x
+#define BENCH_STR(x) BENCH_STR2(x)
+
+using namespace std;
+
+struct BenchResult
+{
+ string name;
+ unsigned long long ops;
+ double min_ns,median_ns,mean_ns;
+};
+
+static indextype bsize=512;
+static unsigned int nreps=5;
+static string filter="";
+static string tmpdir=".";
+static vector<BenchResult> results;
+
+// The result of the measured operations is accumulated here so that the compiler cannot optimize them away
+static volatile double sink=0.0;
+
+// Runs setup (not measured) and then op (measured) once as warm-up and nreps times more, and keeps the time per operation
+void Bench(string name,unsigned long long ops,function<void()> setup,function<void()> op)
+{
+ if ((filter!="") && (name.find(filter)==string::npos))
+  return;
+
+ vector<double> ns;
+ for (unsigned int rep=0; rep<=nreps; rep++)
+ {
+  setup();
+  auto t0=chrono::steady_clock::now();
+  op();
+  auto t1=chrono::steady_clock::now();
+  if (rep>0)
+   ns.push_back(double(chrono::duration_cast<chrono::nanoseconds>(t1-t0).count())/double(ops));
+ }
+ sort(ns.begin(),ns.end());
+ BenchResult b;
+ b.name=name;
+ b.ops=ops;
+ b.min_ns=ns[0];
+ b.median_ns=ns[ns.size()/2];
+ double s=0.0;
+ for (size_t i=0; i<ns.size(); i++)
+  s+=ns[i];
+ b.mean_ns=s/double(ns.size());
+ results.push_back(b);
+ cerr << name << ": " << b.median_ns << " ns/op\n";
+}
+
+void NoSetup() {}
+
+string TmpName(string base)
+{
+ return tmpdir+"/jmatrix_bench_"+base;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Get and Set of all the elements of full and symmetric matrices, and of a 10% of the elements of sparse matrices
+template <typename T>
+void BenchAccess(string tname)
+{
+ indextype n=bsize;
+ unsigned long long nn=(unsigned long long)n*n;
+
+ {
+  FullMatrix<T> M(n,n);
+  Bench("set/full/"+tname,nn,NoSetup,[&]() { for (indextype r=0;r<n;r++) for (indextype c=0;c<n;c++) M.Set(r,c,T(r+c)); });
+  Bench("get/full/"+tname,nn,NoSetup,[&]() { double s=0; for (indextype r=0;r<n;r++) for (indextype c=0;c<n;c++) s+=double(M.Get(r,c)); sink=sink+s; });
+ }
+ {
+  SymmetricMatrix<T> M(n);
+  Bench("set/symmetric/"+tname,nn,NoSetup,[&]() { for (indextype r=0;r<n;r++) for (indextype c=0;c<n;c++) M.Set(r,c,T(r+c)); });
+  Bench("get/symmetric/"+tname,nn,NoSetup,[&]() { double s=0; for (indextype r=0;r<n;r++) for (indextype c=0;c<n;c++) s+=double(M.Get(r,c)); sink=sink+s; });
+ }
+ {
+  // Sparse matrices are rebuilt for each run of Set, since setting an existing element is not the same as inserting it
+  SparseMatrix<T> *M=nullptr;
+  unsigned long long nset=0;
+  for (indextype r=0;r<n;r++) for (indextype c=r%10;c<n;c+=10) nset++;
+  Bench("set/sparse/"+tname,nset,[&]() { delete M; M=new SparseMatrix<T>(n,n); },[&]() { for (indextype r=0;r<n;r++) for (indextype c=r%10;c<n;c+=10) M->Set(r,c,T(r+c+1)); });
+  Bench("get/sparse/"+tname,nn,NoSetup,[&]() { double s=0; for (indextype r=0;r<n;r++) for (indextype c=0;c<n;c++) s+=double(M->Get(r,c)); sink=sink+s; });
+  delete M;
+ }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writing and reading of binary files, and writing and reading of csv files (which includes ProcessDataLineCsv)
+template <typename T>
+void BenchFiles(string tname,unsigned char ctype)
+{
+ indextype n=bsize;
+ unsigned long long nn=(unsigned long long)n*n;
+
+ FullMatrix<T> F(n,n);
+ SymmetricMatrix<T> Y(n);
+ SparseMatrix<T> S(n,n);
+ for (indextype r=0;r<n;r++)
+  for (indextype c=0;c<n;c++)
+  {
+   F.Set(r,c,T((r*7+c)%100));
+   Y.Set(r,c,T((r+c)%100));
+   if ((c%10)==(r%10))
+    S.Set(r,c,T((r+c)%100+1));
+  }
+
+ string ff=TmpName("full.bin"), fy=TmpName("symmetric.bin"), fs=TmpName("sparse.bin");
+ Bench("writebin/full/"+tname,nn,NoSetup,[&]() { F.WriteBin(ff); });
+ Bench("writebin/symmetric/"+tname,nn,NoSetup,[&]() { Y.WriteBin(fy); });
+ Bench("writebin/sparse/"+tname,nn,NoSetup,[&]() { S.WriteBin(fs); });
+ Bench("readbin/full/"+tname,nn,NoSetup,[&]() { FullMatrix<T> M(ff); sink=sink+double(M.Get(0,0)); });
+ Bench("readbin/symmetric/"+tname,nn,NoSetup,[&]() { SymmetricMatrix<T> M(fy); sink=sink+double(M.Get(0,0)); });
+ Bench("readbin/sparse/"+tname,nn,NoSetup,[&]() { SparseMatrix<T> M(fs); sink=sink+double(M.Get(0,0)); });
+
+ string cf=TmpName("full.csv"), cs=TmpName("sparse.csv");
+ Bench("writecsv/full/"+tname,nn,NoSetup,[&]() { F.WriteCsv(cf); });
+ Bench("writecsv/sparse/"+tname,nn,NoSetup,[&]() { S.WriteCsv(cs); });
+ Bench("readcsv/full/"+tname,nn,NoSetup,[&]() { FullMatrix<T> M(cf,ctype,','); sink=sink+double(M.Get(0,0)); });
+ Bench("readcsv/sparse/"+tname,nn,NoSetup,[&]() { SparseMatrix<T> M(cs,ctype,','); sink=sink+double(M.Get(0,0)); });
+
+ remove(cf.c_str());
+ remove(cs.c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Extraction of rows and columns from the binary files written by BenchFiles, without loading the matrices
+template <typename T>
+void BenchExtraction(string tname)
+{
+ indextype n=bsize;
+ string ff=TmpName("full.bin"), fy=TmpName("symmetric.bin"), fs=TmpName("sparse.bin");
+
+ // Always the same random rows/columns, so that runs of different versions are comparable
+ mt19937 gen(12345);
+ uniform_int_distribution<indextype> dist(0,n-1);
+ vector<indextype> which;
+ indextype k=(n>=10) ? n/10 : 1;
+ for (indextype i=0; i<k; i++)
+  which.push_back(dist(gen));
+ indextype one=which[0];
+
+ vector<T> v;
+ vector<vector<T>> m;
+ Bench("getrow/full/"+tname,1,NoSetup,[&]() { GetJustOneRowFromFull(ff,one,n,v); sink=sink+double(v[0]); });
+ Bench("getrow/sparse/"+tname,1,NoSetup,[&]() { GetJustOneRowFromSparse(fs,one,n,v); sink=sink+double(v[0]); });
+ Bench("getrow/symmetric/"+tname,1,NoSetup,[&]() { GetJustOneRowFromSymmetric(fy,one,n,v); sink=sink+double(v[0]); });
+ Bench("getrows/full/"+tname,k,NoSetup,[&]() { GetManyRowsFromFull(ff,which,n,m); sink=sink+double(m[0][0]); });
+ Bench("getrows/sparse/"+tname,k,NoSetup,[&]() { GetManyRowsFromSparse(fs,which,n,n,m); sink=sink+double(m[0][0]); });
+ Bench("getrows/symmetric/"+tname,k,NoSetup,[&]() { GetManyRowsFromSymmetric(fy,which,n,m); sink=sink+double(m[0][0]); });
+ Bench("getcol/full/"+tname,1,NoSetup,[&]() { GetJustOneColumnFromFull(ff,one,n,n,v); sink=sink+double(v[0]); });
+ Bench("getcol/sparse/"+tname,1,NoSetup,[&]() { GetJustOneColumnFromSparse(fs,one,n,n,v); sink=sink+double(v[0]); });
+ Bench("getcol/symmetric/"+tname,1,NoSetup,[&]() { GetJustOneColumnFromSymmetric(fy,one,n,v); sink=sink+double(v[0]); });
+ Bench("getcols/full/"+tname,k,NoSetup,[&]() { GetManyColumnsFromFull(ff,which,n,n,m); sink=sink+double(m[0][0]); });
+ Bench("getcols/sparse/"+tname,k,NoSetup,[&]() { GetManyColumnsFromSparse(fs,which,n,n,m); sink=sink+double(m[0][0]); });
+ Bench("getcols/symmetric/"+tname,k,NoSetup,[&]() { GetManyColumnsFromSymmetric(fy,which,n,m); sink=sink+double(m[0][0]); });
+
+ remove(ff.c_str());
+ remove(fy.c_str());
+ remove(fs.c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Hamming and Jaccard distances between all pairs of rows of a random binary matrix, stored with a byte per cell and packed in a BitMatrix
+void BenchBinaryDistances()
+{
+ indextype n=bsize;
+ unsigned long long nn=(unsigned long long)n*n;
+ mt19937 gen(12345);
+ FullMatrix<unsigned char> F(n,n);
+ for (indextype r=0;r<n;r++)
+  for (indextype c=0;c<n;c++)
+   F.Set(r,c,(unsigned char)(gen() & 1));
+ BitMatrix B(F);
+
+ vector<vector<unsigned char>> rows(n,vector<unsigned char>(n));
+ for (indextype r=0;r<n;r++)
+  F.GetRow(r,rows[r].data());
+ Bench("hamming/bytes",nn,NoSetup,[&]()
+ {
+  unsigned long long s=0;
+  for (indextype r1=0;r1<n;r1++)
+   for (indextype r2=0;r2<n;r2++)
+   {
+    const unsigned char *a=rows[r1].data(),*b=rows[r2].data();
+    indextype h=0;
+    for (indextype c=0;c<n;c++)
+     h+=(a[c]!=b[c]);
+    s+=h;
+   }
+  sink=sink+double(s);
+ });
+ Bench("hamming/bit",nn,NoSetup,[&]() { unsigned long long s=0; for (indextype r1=0;r1<n;r1++) for (indextype r2=0;r2<n;r2++) s+=B.HammingDistance(r1,B,r2); sink=sink+double(s); });
+ Bench("jaccard/bit",nn,NoSetup,[&]() { double s=0; for (indextype r1=0;r1<n;r1++) for (indextype r2=0;r2<n;r2++) s+=B.JaccardDistance(r1,B,r2); sink=sink+s; });
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writing, loading and streaming a float full matrix whose values are stored with each encoding, and decoding its values from memory
+void BenchValueEncodings()
+{
+ indextype n=bsize;
+ unsigned long long nn=(unsigned long long)n*n;
+ mt19937 gen(12345);
+ uniform_real_distribution<float> u(0.0,1.0);
+ FullMatrix<float> F(n,n);
+ for (indextype r=0;r<n;r++)
+  for (indextype c=0;c<n;c++)
+   F.Set(r,c,u(gen));
+
+ string ff=TmpName("encoded.bin");
+ vector<float> row(n);
+ vector<unsigned char> enc;
+ const char *enames[]={"native","half","bfloat16","q8","q16"};
+ for (const char *ename : enames)
+ {
+  JMatrixSetValueEncoding(ValueEncodingFromName(ename),0.0,1.0);
+  Bench(string("writebin/full/float/")+ename,nn,NoSetup,[&]() { F.WriteBin(ff); });
+  Bench(string("readbin/full/float/")+ename,nn,NoSetup,[&]() { FullMatrix<float> M(ff); sink=sink+double(M.Get(0,0)); });
+  Bench(string("stream/full/float/")+ename,nn,NoSetup,[&]() { JMatrixReader<float> rd(ff); double s=0; while (rd.NextRow()) { rd.GetRow(row.data()); s+=row[0]; } sink=sink+s; });
+
+  ValueCodec vc=ValueWriteCodec(FTYPE,0.0,1.0);
+  enc.resize(nn*ValueSize(vc,sizeof(float)));
+  for (indextype r=0;r<n;r++)
+  {
+   F.GetRow(r,row.data());
+   EncodeValues(vc,row.data(),n,enc.data()+(size_t)r*n*ValueSize(vc,sizeof(float)));
+  }
+  Bench(string("decode/float/")+ename,nn,NoSetup,[&]()
+  {
+   double s=0;
+   for (indextype r=0;r<n;r++)
+   {
+    DecodeValues(vc,enc.data()+(size_t)r*n*ValueSize(vc,sizeof(float)),n,row.data());
+    s+=row[r];
+   }
+   sink=sink+s;
+  });
+ }
+ JMatrixSetValueEncoding(VALUE_NATIVE);
+ remove(ff.c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Loading and streaming a double full matrix as double and, converting it on the fly, as float
+void BenchCrossType()
+{
+ indextype n=bsize;
+ unsigned long long nn=(unsigned long long)n*n;
+ FullMatrix<double> F(n,n);
+ for (indextype r=0;r<n;r++)
+  for (indextype c=0;c<n;c++)
+   F.Set(r,c,double((r*7+c)%100)/7.0);
+ string ff=TmpName("double.bin");
+ F.WriteBin(ff);
+
+ vector<double> rowd(n);
+ vector<float> rowf(n);
+ Bench("readbin/full/double/as_double",nn,NoSetup,[&]() { FullMatrix<double> M(ff); sink=sink+M.Get(0,0); });
+ Bench("readbin/full/double/as_float",nn,NoSetup,[&]() { FullMatrix<float> M(ff); sink=sink+double(M.Get(0,0)); });
+ Bench("stream/full/double/as_double",nn,NoSetup,[&]() { JMatrixReader<double> rd(ff); double s=0; while (rd.NextRow()) { rd.GetRow(rowd.data()); s+=rowd[0]; } sink=sink+s; });
+ Bench("stream/full/double/as_float",nn,NoSetup,[&]() { JMatrixReader<float> rd(ff); double s=0; while (rd.NextRow()) { rd.GetRow(rowf.data()); s+=rowf[0]; } sink=sink+s; });
+ remove(ff.c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+void WriteJson(ostream &os)
+{
+ os << "{\n";
+ os << "  \"library\": \"jmatrix\",\n";
+#ifdef GIT_BRANCH
+ os << "  \"git_commit\": \"" << BENCH_STR(GIT_BRANCH) << "\",\n";
+#endif
+ os << "  \"size\": " << bsize << ",\n";
+ os << "  \"repetitions\": " << nreps << ",\n";
+ os << "  \"benchmarks\": [\n";
+ for (size_t i=0; i<results.size(); i++)
+ {
+  os << "    { \"name\": \"" << results[i].name << "\", \"ops\": " << results[i].ops;
+  os << ", \"min_ns_per_op\": " << results[i].min_ns << ", \"median_ns_per_op\": " << results[i].median_ns << ", \"mean_ns_per_op\": " << results[i].mean_ns << " }";
+  os << ((i+1<results.size()) ? ",\n" : "\n");
+ }
+ os << "  ]\n";
+ os << "}\n";
+}
+
+void Usage(const char *pname)
+{
+ cerr << "Usage: " << pname << " [-s size] [-r repetitions] [-f filter] [-t tmpdir] [-o results.json]\n";
+ exit(1);
+}
+
+int main(int argc,char *argv[])
+{
+ string ofname="";
+
+ for (int i=1; i<argc; i++)
+ {
+  string a(argv[i]);
+  if (i+1>=argc)
+   Usage(argv[0]);
+  if (a=="-s")
+   bsize=indextype(atol(argv[++i]));
+  else if (a=="-r")
+   nreps=(unsigned int)atoi(argv[++i]);
+  else if (a=="-f")
+   filter=argv[++i];
+  else if (a=="-t")
+   tmpdir=argv[++i];
+  else if (a=="-o")
+   ofname=argv[++i];
+  else
+   Usage(argv[0]);
+ }
+ if ((bsize==0) || (nreps==0))
+  Usage(argv[0]);
+
+ BenchAccess<unsigned char>("uchar");
+ BenchAccess<char>("char");
+ BenchAccess<unsigned short>("ushort");
+ BenchAccess<short>("short");
+ BenchAccess<unsigned int>("uint");
+ BenchAccess<int>("int");
+ BenchAccess<unsigned long>("ulong");
+ BenchAccess<long>("long");
+ BenchAccess<unsigned long long>("ulonglong");
+ BenchAccess<long long>("longlong");
+ BenchAccess<float>("float");
+ BenchAccess<double>("double");
+ BenchAccess<long double>("longdouble");
+
+ BenchFiles<int>("int",SITYPE);
+ BenchExtraction<int>("int");
+ BenchFiles<float>("float",FTYPE);
+ BenchExtraction<float>("float");
+ BenchFiles<double>("double",DTYPE);
+ BenchExtraction<double>("double");
+
+ BenchBinaryDistances();
+ BenchValueEncodings();
+ BenchCrossType();
+
+ if (ofname=="")
+  WriteJson(cout);
+ else
+ {
+  ofstream of(ofname.c_str());
+  if (!of.is_open())
+  {
+   cerr << "Cannot open file " << ofname << " to write the results.\n";
+   exit(1);
+  }
+  WriteJson(of);
+  of.close();
+ }
+ return 0;
+}
@@ -37,6 +37,8 @@
 #include "../headers/debugpar.h"
 #include "../headers/jmatrix.h"
 #include "../headers/apitocommands.h"
+#include "../headers/matconvert.h"
+#include "../headers/matsample.h"
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 #include <iostream>
@@ -66,10 +68,21 @@ const unsigned char GETCNAMES=14;
 const unsigned char CSVDUMP=15;
 const unsigned char CSVREAD=16;
 const unsigned char SETCOM=17;
-const unsigned int NUM_COMMANDS=18;
+const unsigned char GEN=18;
+const unsigned char CONVERT=19;
+const unsigned char SUBMATRIX=20;
+const unsigned char SUBMATRIXN=21;
+const unsigned char STATS=22;
+const unsigned char FILTER=23;
+const unsigned char RBIND=24;
+const unsigned char CBIND=25;
+const unsigned char APPEND=26;
+const unsigned char PERMUTE=27;
+const unsigned char SAMPLE=28;
+const unsigned int NUM_COMMANDS=29;
 
 // Strings associated to each command
-const string command_names[NUM_COMMANDS]={"info","rownum","rownums","rowname","rownames","colnum","colnums","colname","colnames","subdiag","setrnames","setcnames","setrcnames","getrnames","getcnames","csvdump","csvread","setcom"};
+const string command_names[NUM_COMMANDS]={"info","rownum","rownums","rowname","rownames","colnum","colnums","colname","colnames","subdiag","setrnames","setcnames","setrcnames","getrnames","getcnames","csvdump","csvread","setcom","gen","convert","submatrix","submatrixn","stats","filter","rbind","cbind","append","permute","sample"};
 
 unsigned short ComFromName(string com)
 {
@@ -84,7 +97,7 @@ void Usage(char *pname,unsigned char specific)
  if (specific>=NUM_COMMANDS)
  {
   cerr << "Usage:\n\n";
-  cerr << "   " << pname << " command matrix_file [other_options] -o out_matrix file\n\n";
+  cerr << "   " << pname << " [--stats] [--varint] [--encode half|bfloat16|q8|q16] command matrix_file [other_options] -o out_matrix file\n\n";
   cerr << "where command is one of\n\n ";
   for (unsigned int c=0;c<NUM_COMMANDS;c++)
   {
@@ -95,6 +108,11 @@ void Usage(char *pname,unsigned char specific)
   cerr << "\n\nother_options are options dependent on the command (call '" << pname << " any_command' for specific information)\n\n";
   cerr << "Option -o out_matrix_file will name the file to contain either the binary matrix (or, for the info command,\n";
   cerr << "the ASCII/CSV) output file that results from the command.\n";
+  cerr << "With --stats, the bytes read and written, seeks, rows and time spent by each operation of the library are printed to the console at the end.\n";
+  cerr << "With --varint, sparse matrices written by the command store their column indices as varint-encoded gaps, which makes their files smaller.\n";
+  cerr << "With --encode, the values of float or double full and symmetric matrices written by the command are stored as 16-bit floats (half, bfloat16)\n";
+  cerr << "or as 8 or 16-bit integers scaled to the range of the values (q8, q16), which makes their files 2 to 8 times smaller at the cost of precision.\n";
+  cerr << "If the environment variable JMATRIX_TRACE is set to a file name, a trace of the phases of each operation (in Chrome trace format) is written to it.\n";
   cerr << "Also, remember that if this program is called as jmatd (symbolic link to jmat) you will get debugging messages in the console.\n\n";
  }
  else
@@ -156,7 +174,8 @@ void Usage(char *pname,unsigned char specific)
     case CSVREAD:
         cerr << "\n  " << pname << " csvread input_file.csv sepchar mtype valtype -o res_file\n\nReads the input file, which must be a csv file, and creates a binary jmatrix file with its content.\n";
         cerr << "  sepchar must be c or t to indicate that the expected field separator will be a comma or a tab, respectively.\n";
-        cerr << "  mtype must be one of the strings 'full', 'sparse' or 'symmetric'\n";
+        cerr << "  mtype must be one of the strings 'full', 'sparse', 'symmetric' or 'bit'\n";
+        cerr << "  A bit matrix stores each value in a single bit: non-zero values are read as 1. valtype is used to read them, but the file is always of type u8.\n";
         cerr << "  WARNING: if you read a symmetric matrix from a .csv file, the file must be a square table but ONLY the lower-diagonal matrix\n";
         cerr << "           and the main diagonal will be stored. The upper-diagonal matrix is read BUT THEIR VALUES ARE IGNORED.\n";
         cerr << "  valtype must be one of the strings 'u8','s8','u16','s16','u32','s32','u64','s64','f','d' or 'ld'.\n";
@@ -166,6 +185,67 @@ void Usage(char *pname,unsigned char specific)
         cerr << "\n" << pname << " setcom matrix_file 'new comment' -o res_file\n\nCopy the input matrix with the given comment.\n";
         cerr << "  The comment is set to the new one. Previous comment, if any, is discarded.\n";
         cerr << "  Setting the new comment to the empty string, '', gets rid of the old comment.\n";
+        break;
+    case GEN:
+        cerr << "\n  " << pname << " gen mtype valtype nrows ncols [density=d] [skew=s] [seed=n] [threads=n] [names] -o res_file\n\nCreates a jmatrix file with a synthetic matrix of random values.\n";
+        cerr << "  mtype and valtype are as in the csvread command. For symmetric matrices, ncols must be equal to nrows.\n";
+        cerr << "  density is the expected fraction of non-zero entries (default 1) and skew the spread of the number of non-zero entries of the rows (default 0, all rows alike).\n";
+        cerr << "  The same seed (default 1) always produces the same file, whatever the number of generating threads (default, as many as hardware threads).\n";
+        cerr << "  If names is given, rows are named R1,R2... and columns C1,C2...\n";
+        break;
+    case CONVERT:
+        cerr << "\n  " << pname << " convert matrix_file mtype valtype [round] [wrap] [threads=n] -o res_file\n\nCreates a jmatrix file with the matrix in the input file converted to another matrix type and/or data type.\n";
+        cerr << "  mtype and valtype are as in the csvread command. Converting to a symmetric matrix keeps the lower triangle and main diagonal of a square matrix.\n";
+        cerr << "  Converting to a sparse matrix drops the values that are 0 once converted.\n";
+        cerr << "  Values out of the range of valtype become its lowest or highest value, unless wrap is given (then integers wrap around as in C++).\n";
+        cerr << "  With round, floating point values converted to integers are rounded to the nearest one instead of truncated.\n";
+        cerr << "  Rows are converted by as many threads as hardware threads, unless threads=n is given.\n";
+        break;
+    case SUBMATRIX:
+        cerr << "\n  " << pname << " submatrix matrix_file n1,n2,... m1,m2,... -o res_file\n\nCreates a jmatrix file with the submatrix formed by the rows n1,n2,... and the columns m1,m2,... (indices from 0) of the jmatrix in file matrix_file.\n";
+        cerr << "  Only the requested rows, and the requested columns of full matrices, are read. The submatrix of a symmetric matrix is full, unless rows and columns are the same.\n";
+        break;
+    case SUBMATRIXN:
+        cerr << "\n  " << pname << " submatrixn matrix_file rn1,rn2,... cn1,cn2,... -o res_file\n\nCreates a jmatrix file with the submatrix formed by the rows named rn1,rn2,... and the columns named cn1,cn2,... of the jmatrix in file matrix_file.\n";
+        break;
+    case STATS:
+        cerr << "\n  " << pname << " stats matrix_file [csv] [threads=n] -o res_file\n\nWrites the sum, mean, variance, number of non-zeros, minimum and maximum of each row and each column of the jmatrix in file matrix_file.\n";
+        cerr << "  Row statistics go to res_file.rows and column statistics to res_file.cols, as full jmatrix files of doubles, or to res_file.rows.csv and res_file.cols.csv if csv is given.\n";
+        cerr << "  The file is read once, and rows are processed by as many threads as hardware threads, unless threads=n is given.\n";
+        break;
+    case FILTER:
+        cerr << "\n  " << pname << " filter matrix_file [minnnz=n] [minsum=x] [maxsum=x] [regex=re] [names=file] [cminnnz=n] [cminsum=x] [cmaxsum=x] [cregex=re] [cnames=file] -o res_file\n\n";
+        cerr << "Creates a jmatrix file with the rows of the jmatrix in file matrix_file that have at least minnnz non-zeros, a sum between minsum and maxsum,\n";
+        cerr << "  a name matched by the regular expression re and a name in file (one name per line). All conditions are optional.\n";
+        cerr << "  Conditions starting with c are those on the columns, whose number of non-zeros and sum are computed on the rows kept, which takes another pass.\n";
+        cerr << "  Rows and columns of symmetric matrices are kept only if they fulfil both the conditions on rows and those on columns, and the result is symmetric.\n";
+        break;
+    case RBIND:
+        cerr << "\n  " << pname << " rbind matrix_file1 matrix_file2 ... -o res_file\n\nCreates a jmatrix file with the rows of the jmatrices in all the files, one after the other. They must have the same number of columns.\n";
+        cerr << "  The result is sparse if all of them are sparse, bit if all are bit matrices, and full otherwise. Symmetric matrices cannot be bound.\n";
+        cerr << "  Its data type is wide enough for those of all of them. Rows of files stored as those of the result are copied as they are.\n";
+        break;
+    case CBIND:
+        cerr << "\n  " << pname << " cbind matrix_file1 matrix_file2 ... -o res_file\n\nCreates a jmatrix file with the columns of the jmatrices in all the files, one after the other. They must have the same number of rows.\n";
+        cerr << "  Matrix type and data type of the result are as in the rbind command. All files are read at once, row by row.\n";
+        break;
+    case APPEND:
+        cerr << "\n  " << pname << " append rows_file -o matrix_file\n\nAppends the rows of the jmatrix in file rows_file to the jmatrix in file matrix_file, in place, writing only the new rows and the metadata.\n";
+        cerr << "  Both must have the same number of columns, unless matrix_file is symmetric, of dimension n: then the m rows of rows_file must have\n";
+        cerr << "  at least n+m columns, and the first n+i+1 values of its row i become the lower-triangular part of the new row.\n";
+        cerr << "  Values are converted to the data type of matrix_file, if needed.\n";
+        break;
+    case PERMUTE:
+        cerr << "\n  " << pname << " permute matrix_file order_file -o res_file\n\nCreates a jmatrix file with the rows of the jmatrix in file matrix_file in the order given in order_file,\n";
+        cerr << "  one per line, as row names or as row numbers (from 0). Each row must appear exactly once. Rows and columns of symmetric matrices are permuted at once.\n";
+        cerr << "  Rows are moved as they are stored, with their names, using a bounded amount of memory whatever the size of the file.\n";
+        break;
+    case SAMPLE:
+        cerr << "\n  " << pname << " sample matrix_file n [uniform|reservoir|stratified] [seed=n] [sep=c] -o res_file\n\nCreates a jmatrix file with n rows of the jmatrix in file matrix_file chosen at random,\n";
+        cerr << "  in the order they have in it and with their names. uniform (the default) reads only the chosen rows, in the order they are stored;\n";
+        cerr << "  reservoir reads the file once, sequentially; stratified samples each group of rows whose names share the part before the character c\n";
+        cerr << "  (default '_') in proportion to its size. The same seed (default 1) always gives the same sample. Symmetric matrices keep the same rows and columns.\n";
+        break;
     default: break;
   }
  }
@@ -259,35 +339,31 @@ bool CorrectSeparator(string s,char &sep,bool &q)
  return true;
 }
 
-bool CorrectWriteSpecs(vector<string> spec,char &sep,unsigned char &mtype,unsigned char &valtype)
+bool CorrectTypeSpecs(string mspec,string vspec,string com,unsigned char &mtype,unsigned char &valtype)
 {
- if ( (spec[0][0]!='c') && (spec[0][0]!='t') )
- {
-   JMatrixStop("Incorrect format specifier for separator character in csvread subcommand.\n");
-   return false;
- }
- sep=(spec[0][0]=='c') ? ',' : '\t';
-
- if (spec[1]=="full")
+ if (mspec=="full")
   mtype=MTYPEFULL;
  else
-  if (spec[1]=="sparse")
+  if (mspec=="sparse")
    mtype=MTYPESPARSE;
   else
-   if (spec[1]=="symmetric")
+   if (mspec=="symmetric")
     mtype=MTYPESYMMETRIC;
    else
-   {
-    JMatrixStop("Incorrect format specifier for matrix type in csvread subcommand.\n");
-    return false;
-   }
+    if (mspec=="bit")
+     mtype=MTYPEBIT;
+    else
+    {
+     JMatrixStop("Incorrect format specifier for matrix type in "+com+" subcommand.\n");
+     return false;
+    }
 
- if (spec[2]=="u8") { valtype=UCTYPE; return true; }
- if (spec[2]=="s8") { valtype=SCTYPE; return true; }
- if (spec[2]=="u16") { valtype=USTYPE; return true; }
- if (spec[2]=="s16") { valtype=SSTYPE; return true; }
+ if (vspec=="u8") { valtype=UCTYPE; return true; }
+ if (vspec=="s8") { valtype=SCTYPE; return true; }
+ if (vspec=="u16") { valtype=USTYPE; return true; }
+ if (vspec=="s16") { valtype=SSTYPE; return true; }
 
- if (spec[2]=="u32")
+ if (vspec=="u32")
  {
    // Depending on the machine, there is still discrepancy on the size of int/long. long is always 32 bits, as far as I know.
    // int is usally 32 bits to nowadays, but one never knows....
@@ -297,7 +373,7 @@ bool CorrectWriteSpecs(vector<string> spec,char &sep,unsigned char &mtype,unsign
      valtype=ULTYPE;
    return true;
  }
- if (spec[2]=="s32")
+ if (vspec=="s32")
  {
    // Depending on the machine, there is still discrepancy on the size of int/long. long is always 32 bits, as far as I know.
    // int is usally 32 bits to nowadays, but one never knows....
@@ -308,16 +384,193 @@ bool CorrectWriteSpecs(vector<string> spec,char &sep,unsigned char &mtype,unsign
    return true;
  }
 
- if (spec[2]=="u64") { valtype=ULLTYPE; return true; }
- if (spec[2]=="s64") { valtype=SLLTYPE; return true; }
- if (spec[2]=="f") { valtype=FTYPE; return true; }
- if (spec[2]=="d") { valtype=DTYPE; return true; }
- if (spec[2]=="ld") { valtype=LDTYPE; return true; }
+ if (vspec=="u64") { valtype=ULLTYPE; return true; }
+ if (vspec=="s64") { valtype=SLLTYPE; return true; }
+ if (vspec=="f") { valtype=FTYPE; return true; }
+ if (vspec=="d") { valtype=DTYPE; return true; }
+ if (vspec=="ld") { valtype=LDTYPE; return true; }
 
- JMatrixStop("Incorrect format specifier for matrix data type in csvread subcommand.\n");
+ JMatrixStop("Incorrect format specifier for matrix data type in "+com+" subcommand.\n");
  return false;
 }
 
+bool CorrectWriteSpecs(vector<string> spec,char &sep,unsigned char &mtype,unsigned char &valtype)
+{
+ if ( (spec[0][0]!='c') && (spec[0][0]!='t') )
+ {
+   JMatrixStop("Incorrect format specifier for separator character in csvread subcommand.\n");
+   return false;
+ }
+ sep=(spec[0][0]=='c') ? ',' : '\t';
+
+ return CorrectTypeSpecs(spec[1],spec[2],"csvread",mtype,valtype);
+}
+
+bool IsReal(string n,double &v)
+{
+ char *end;
+ v=strtod(n.c_str(),&end);
+ return (!n.empty() && *end=='\0');
+}
+
+// Parses the arguments of the gen command: mtype valtype nrows ncols followed by optional key=value pairs
+bool CorrectGenSpecs(string mspec,vector<string> args,unsigned char &mtype,unsigned char &valtype,indextype &nrows,indextype &ncols,
+                     double &density,double &skew,unsigned long long &seed,bool &withnames,unsigned int &nthreads)
+{
+ if (args.size()<3)
+  return false;
+ if ( !CorrectTypeSpecs(mspec,args[0],"gen",mtype,valtype) || !IsNum(args[1],nrows) || !IsNum(args[2],ncols) )
+  return false;
+
+ density=1.0;
+ skew=0.0;
+ seed=1;
+ withnames=false;
+ nthreads=0;
+ indextype n;
+ for (size_t i=3;i<args.size();i++)
+ {
+  if (args[i]=="names")
+  {
+   withnames=true;
+   continue;
+  }
+  size_t eq=args[i].find('=');
+  if (eq==string::npos)
+   return false;
+  string key=args[i].substr(0,eq);
+  string val=args[i].substr(eq+1);
+  if (key=="density")
+  {
+   if (!IsReal(val,density))
+    return false;
+  }
+  else if (key=="skew")
+  {
+   if (!IsReal(val,skew))
+    return false;
+  }
+  else if (key=="seed")
+  {
+   if (val.empty() || val.find_first_not_of("0123456789")!=string::npos)
+    return false;
+   seed=strtoull(val.c_str(),nullptr,10);
+  }
+  else if (key=="threads")
+  {
+   if (!IsNum(val,n))
+    return false;
+   nthreads=(unsigned int)n;
+  }
+  else
+   return false;
+ }
+ return true;
+}
+
+// Parses the arguments of the convert command: mtype valtype followed by the optional round, wrap and threads=n
+bool CorrectConvertSpecs(vector<string> args,unsigned char &mtype,unsigned char &valtype,unsigned char &flags,unsigned int &nthreads)
+{
+ if (args.size()<2)
+  return false;
+ if ( !CorrectTypeSpecs(args[0],args[1],"convert",mtype,valtype) )
+  return false;
+
+ flags=CONVERT_SATURATE;
+ nthreads=0;
+ indextype n;
+ for (size_t i=2;i<args.size();i++)
+ {
+  if (args[i]=="round")
+   flags |= CONVERT_ROUND;
+  else if (args[i]=="wrap")
+   flags &= (unsigned char)(~CONVERT_SATURATE);
+  else if ( (args[i].compare(0,8,"threads=")==0) && IsNum(args[i].substr(8),n) )
+   nthreads=(unsigned int)n;
+  else
+   return false;
+ }
+ return true;
+}
+
+// Parses the arguments of the filter command: optional key=value pairs, those starting with c being the conditions on the columns
+bool CorrectFilterSpecs(vector<string> args,MatrixFilter &rowfilter,MatrixFilter &colfilter)
+{
+ for (size_t i=0;i<args.size();i++)
+ {
+  size_t eq=args[i].find('=');
+  if (eq==string::npos)
+   return false;
+  string key=args[i].substr(0,eq);
+  string val=args[i].substr(eq+1);
+  MatrixFilter &f=(key[0]=='c') ? colfilter : rowfilter;
+  if (key[0]=='c')
+   key=key.substr(1);
+  bool ok;
+  if (key=="minnnz")
+   ok=IsNum(val,f.minnnz);
+  else if (key=="minsum")
+   ok=IsReal(val,f.minsum);
+  else if (key=="maxsum")
+   ok=IsReal(val,f.maxsum);
+  else if (key=="regex")
+  {
+   f.regex=val;
+   ok=!val.empty();
+  }
+  else if (key=="names")
+   ok=NameListInFile(val,f.names);
+  else
+   ok=false;
+  if (!ok)
+   return false;
+ }
+ return true;
+}
+
+// Parses the arguments of the stats command: the optional csv and threads=n
+bool CorrectSampleSpecs(vector<string> args,indextype &nsample,unsigned char &method,unsigned long long &seed,char &sep)
+{
+ method=SAMPLE_UNIFORM;
+ seed=1;
+ sep='_';
+ if ( (args.size()<1) || !IsNum(args[0],nsample) )
+  return false;
+ for (size_t i=1;i<args.size();i++)
+ {
+  if (args[i]=="uniform")
+   method=SAMPLE_UNIFORM;
+  else if (args[i]=="reservoir")
+   method=SAMPLE_RESERVOIR;
+  else if (args[i]=="stratified")
+   method=SAMPLE_STRATIFIED;
+  else if ( (args[i].compare(0,5,"seed=")==0) && (args[i].size()>5) && (args[i].find_first_not_of("0123456789",5)==string::npos) )
+   seed=strtoull(args[i].substr(5).c_str(),nullptr,10);
+  else if ( (args[i].compare(0,4,"sep=")==0) && (args[i].size()==5) )
+   sep=args[i][4];
+  else
+   return false;
+ }
+ return true;
+}
+
+bool CorrectStatsSpecs(vector<string> args,bool &csv,unsigned int &nthreads)
+{
+ csv=false;
+ nthreads=0;
+ indextype n;
+ for (size_t i=0;i<args.size();i++)
+ {
+  if (args[i]=="csv")
+   csv=true;
+  else if ( (args[i].compare(0,8,"threads=")==0) && IsNum(args[i].substr(8),n) )
+   nthreads=(unsigned int)n;
+  else
+   return false;
+ }
+ return true;
+}
+
 void NameChanged(vector<string> ends)
 {
  cerr << "You have changed the name of this program. Don't do that. Its name must be (or at least, must end in) ";
@@ -351,12 +604,16 @@ int CheckProgName(string pname,vector<string> possible_endings)
  *
  * The program must be called as
  *
- *     jmat command matrix_file other_options -o out_matrix file
+ *     jmat [--stats] [--varint] [--encode half|bfloat16|q8|q16] command matrix_file other_options -o out_matrix file
  *
  * where command is one of a predefined list (see below) which is followed by the matrix to be manipulated, other relevant options
  * for the particular command and (optionally) the -o option with the result of the command.\n
  * If -o option is not given, the result is dumped to the console in ASCII\n
  * <b>other_options</b> are options dependent on the command (call 'jmat any_command' for specific information)\n
+ * With <b>--stats</b> the I/O counters of the library (see JMatrixPrintStats) are printed to the console when the command finishes.\n
+ * With <b>--varint</b> the sparse matrices written by the command store their column indices as varint-encoded gaps (see JMatrixSetSparseEncoding).\n
+ * With <b>--encode</b> the values of the floating point full and symmetric matrices written by the command are stored with fewer bits (see JMatrixSetValueEncoding).\n
+ * If the environment variable <b>JMATRIX_TRACE</b> is set to a file name, a trace of the phases of each operation (see JMatrixSetTrace) is written to it.\n
  * Also, remember that if this program is called as <b>jmatd</b> (symbolic link to jmat) you will get debugging messages in the console.\n
  * \n
  * Possible commands are:
@@ -449,7 +706,8 @@ int CheckProgName(string pname,vector<string> possible_endings)
  *
  *   Reads the input file, which must be a csv file, and creates a binary jmatrix file with its content.\n
  *   sepchar must be c or t to indicate that the expected field separator will be a comma or a tab, respectively.\n
- *   mtype must be one of the strings 'full', 'sparse' or 'symmetric'\n
+ *   mtype must be one of the strings 'full', 'sparse', 'symmetric' or 'bit'\n
+ *   A bit matrix stores each value in a single bit: non-zero values are read as 1. valtype is used to read them, but the file is always of type u8.\n
  *    WARNING: if you read a symmetric matrix from a .csv file, the file must be a square table but ONLY the lower-diagonal matrix\n
  *             and the main diagonal will be stored. The upper-diagonal matrix is read BUT THEIR VALUES ARE IGNORED.\n
  *   valtype must be one of the strings 'u8','s8','u16','s16','u32','s32','u64','s64','f','d' or 'ld'.\n
@@ -459,12 +717,87 @@ int CheckProgName(string pname,vector<string> possible_endings)
  *
  *   Copy the input matrix in the output file, setting the comment to the one specified (which can be the empty string, '')
  *
+ *     jmat gen mtype valtype nrows ncols [density=d] [skew=s] [seed=n] [threads=n] [names] -o res_file
+ *
+ *   Creates a jmatrix file with a synthetic matrix of random values (see GenerateMatrix). mtype and valtype are as in csvread.\n
+ *   density is the expected fraction of non-zero entries (default 1) and skew the spread of the number of non-zero entries of the rows (default 0).\n
+ *   The same seed (default 1) always produces the same file, whatever the number of threads. With names, rows and columns get synthetic names.
+ *
+ *     jmat convert matrix_file mtype valtype [round] [wrap] [threads=n] -o res_file
+ *
+ *   Creates a jmatrix file with the matrix in matrix_file converted to another matrix type and/or data type (see ConvertMatrix). mtype and valtype are as in csvread.\n
+ *   Values out of the range of valtype are saturated to it, unless wrap is given. round rounds floating point values converted to integers instead of truncating them.
+ *
+ *     jmat submatrix matrix_file n1,n2,... m1,m2,... -o res_file
+ *
+ *   Creates a jmatrix file with the submatrix formed by the rows n1,n2,... and the columns m1,m2,... (indices from 0) of the jmatrix in file matrix_file (see GetSubmatrix).
+ *
+ *     jmat submatrixn matrix_file rn1,rn2,... cn1,cn2,... -o res_file
+ *
+ *   Creates a jmatrix file with the submatrix formed by the rows named rn1,rn2,... and the columns named cn1,cn2,... of the jmatrix in file matrix_file.
+ *
+ *     jmat stats matrix_file [csv] [threads=n] -o res_file
+ *
+ *   Writes the sum, mean, variance, number of non-zeros, minimum and maximum of each row and each column of the jmatrix in file matrix_file (see MatrixStatistics)
+ *   to the full jmatrix files res_file.rows and res_file.cols, or to the csv files res_file.rows.csv and res_file.cols.csv if csv is given.
+ *
+ *     jmat filter matrix_file [minnnz=n] [minsum=x] [maxsum=x] [regex=re] [names=file] [cminnnz=n] [cminsum=x] [cmaxsum=x] [cregex=re] [cnames=file] -o res_file
+ *
+ *   Creates a jmatrix file with the rows of the jmatrix in file matrix_file with at least minnnz non-zeros, a sum between minsum and maxsum, a name matched
+ *   by the regular expression re and a name in file (one per line), and with its columns that fulfil the conditions starting with c (see FilterMatrix).
+ *
+ *     jmat rbind matrix_file1 matrix_file2 ... -o res_file
+ *
+ *   Creates a jmatrix file with the rows of all the jmatrices, one after the other (see BindRows). Data types are promoted as needed (see PromotedType).
+ *
+ *     jmat cbind matrix_file1 matrix_file2 ... -o res_file
+ *
+ *   Creates a jmatrix file with the columns of all the jmatrices, one after the other (see BindColumns).
+ *
+ *     jmat append rows_file -o matrix_file
+ *
+ *   Appends the rows of the jmatrix in rows_file to the jmatrix in matrix_file, in place (see AppendRows).
+ *
+ *     jmat permute matrix_file order_file -o res_file
+ *
+ *   Creates a jmatrix file with the rows (and, if it is symmetric, the columns) of the jmatrix in file matrix_file in the order given in order_file,
+ *   one row name or row number (from 0) per line (see PermuteMatrix).
+ *
+ *     jmat sample matrix_file n [uniform|reservoir|stratified] [seed=n] [sep=c] -o res_file
+ *
+ *   Creates a jmatrix file with n rows of the jmatrix in file matrix_file chosen at random, uniformly, as reservoir sampling does in a sequential pass,
+ *   or in proportion to the size of the groups of rows whose names share the part before the character c (see SampleMatrix).
+ *
  */
 int main(int argc,char *argv[])
 {
  if (CheckProgName(string(argv[0]),{"jmat","jmatd"})==1)
   JMatrixSetDebug(true);
 
+ // --stats, --varint and --encode are taken out of the arguments, so that the command is always in argv[1]
+ bool stats=false;
+ while ((argc>1) && ((string(argv[1])=="--stats") || (string(argv[1])=="--varint") || (string(argv[1])=="--encode")))
+ {
+  if (string(argv[1])=="--encode")
+  {
+   unsigned char enc=(argc>2) ? ValueEncodingFromName(string(argv[2])) : NOTYPE;
+   if (enc==NOTYPE)
+    JMatrixStop("The --encode option must be followed by one of native, half, bfloat16, q8 or q16.\n");
+   JMatrixSetValueEncoding(enc);
+   argv[2]=argv[0];
+   argv+=2;
+   argc-=2;
+   continue;
+  }
+  if (string(argv[1])=="--stats")
+   stats=true;
+  else
+   JMatrixSetSparseEncoding(true);
+  argv[1]=argv[0];
+  argv++;
+  argc--;
+ }
+
  if (argc==1)
   Usage(argv[0],NUM_COMMANDS);
  if (argc==2)
@@ -485,11 +818,17 @@ int main(int argc,char *argv[])
   args.push_back(string(argv[i]));
 
  indextype n;
- vector<indextype> nl;
+ vector<indextype> nl,nlc;
  vector<string> sl,slc;
  char sep;
  bool quotes;
  unsigned char mtype,valtype;
+ indextype nrows,ncols;
+ double density,skew;
+ unsigned long long seed;
+ bool withnames,csv;
+ unsigned int nthreads;
+ unsigned char flags,method;
  switch (com)
  {
   case INFO:
@@ -598,8 +937,82 @@ int main(int argc,char *argv[])
      Usage(argv[0],SETCOM);
     else
      JSetComment(iname,oname,args[0]);
+    break;
+  case GEN:
+    if ( !CorrectGenSpecs(iname,args,mtype,valtype,nrows,ncols,density,skew,seed,withnames,nthreads) )
+     Usage(argv[0],GEN);
+    else
+     JGenMatrix(oname,mtype,valtype,nrows,ncols,density,skew,seed,withnames,nthreads);
+    break;
+  case CONVERT:
+    if ( !CorrectConvertSpecs(args,mtype,valtype,flags,nthreads) )
+     Usage(argv[0],CONVERT);
+    else
+     JConvertMatrix(iname,oname,mtype,valtype,flags,nthreads);
+    break;
+  case SUBMATRIX:
+    if ( (args.size()!=2) || (!IsNumList(args[0],nl)) || (!IsNumList(args[1],nlc)) )
+     Usage(argv[0],SUBMATRIX);
+    else
+     JGetSubmatrix(iname,oname,nl,nlc);
+    break;
+  case SUBMATRIXN:
+    if ( (args.size()!=2) || (!IsNameList(args[0],sl)) || (!IsNameList(args[1],slc)) )
+     Usage(argv[0],SUBMATRIXN);
+    else
+     JGetSubmatrixByNames(iname,oname,sl,slc);
+    break;
+  case STATS:
+    if ( !CorrectStatsSpecs(args,csv,nthreads) )
+     Usage(argv[0],STATS);
+    else
+     JMatStats(iname,oname,csv,nthreads);
+    break;
+  case FILTER:
+  {
+    MatrixFilter rowfilter,colfilter;
+    if ( !CorrectFilterSpecs(args,rowfilter,colfilter) )
+     Usage(argv[0],FILTER);
+    else
+     JFilterMatrix(iname,oname,rowfilter,colfilter);
+    break;
+  }
+  case RBIND:
+  case CBIND:
+    if ( args.size()<1 )
+     Usage(argv[0],com);
+    else
+    {
+     args.insert(args.begin(),iname);
+     if (com==RBIND)
+      JBindRows(args,oname);
+     else
+      JBindColumns(args,oname);
+    }
+    break;
+  case APPEND:
+    if ( args.size()!=0 )
+     Usage(argv[0],APPEND);
+    else
+     JAppendRows(iname,oname);
+    break;
+  case PERMUTE:
+    if ( (args.size()!=1) || (!NameListInFile(args[0],sl)) )
+     Usage(argv[0],PERMUTE);
+    else
+     JPermuteMatrix(iname,sl,oname);
+    break;
+  case SAMPLE:
+    if ( !CorrectSampleSpecs(args,n,method,seed,sep) )
+     Usage(argv[0],SAMPLE);
+    else
+     SampleMatrix(iname,oname,n,method,seed,sep);
+    break;
   default: break;
  }
 
+ if (stats)
+  JMatrixPrintStats(cerr);
+
  return 0;
 }
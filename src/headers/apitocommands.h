@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 #include "indextype.h"
+#include "matfilter.h"
 
 /// @file apitocommands.h
 
@@ -105,6 +106,27 @@ void JGetNamesRow(std::string iname,std::string oname,std::vector<std::string> l
  */
 void JGetNamesCol(std::string iname,std::string oname,std::vector<std::string> lcols);
 
+/*!
+ * Function to get the submatrix formed by several rows and columns, by number, and write it as a JMatrix in a binary file.\n
+ * Only the requested rows (and, for full matrices, the requested columns of them) are read. See GetSubmatrix.
+ *
+ * @param[in] iname Name of the JMatrix binary file
+ * @param[in] oname Name of the binary file to write the submatrix
+ * @param[in] lrows A vector with the numbers of the rows (0-based index) we want to extract
+ * @param[in] lcols A vector with the numbers of the columns (0-based index) we want to extract
+ */
+void JGetSubmatrix(std::string iname,std::string oname,std::vector<indextype> lrows,std::vector<indextype> lcols);
+
+/*!
+ * Function to get the submatrix formed by several rows and columns, by their names, and write it as a JMatrix in a binary file
+ *
+ * @param[in] iname Name of the JMatrix binary file
+ * @param[in] oname Name of the binary file to write the submatrix
+ * @param[in] lrows A vector of strings with the names of the rows we want to extract
+ * @param[in] lcols A vector of strings with the names of the columns we want to extract
+ */
+void JGetSubmatrixByNames(std::string iname,std::string oname,std::vector<std::string> lrows,std::vector<std::string> lcols);
+
 /*!
  * Function to get the subdiagonal of a SymmetricMatrix of size (n x n) stored in a binary file and write them as
  * a vector of one row and n x (n-1)/2 columns (rows under the main diagonal, without the diagonal itself) stored
@@ -182,7 +204,7 @@ void JCsvDump(std::string iname,std::string oname,char sep,bool with_quotes);
  * @param[in] iname CSV file with the data
  * @param[in] oname Name of the binary file to contain the created JMatrix
  * @param[in] sep   The character that csv file uses as field sepparator
- * @param[in] mtype The type of the JMatrix. Possible values: 'full', 'sparse' or 'symmetric'
+ * @param[in] mtype The type of the JMatrix. Possible values: 'full', 'sparse', 'symmetric' or 'bit'
  * @param[in] ctype The data type to store the read values (value type of the JMatrix). Possible values: 'u8','s8','u16','s16','u32','s32','u64','s64','f','d' or 'ld'
  */
 void JCsvToJMat(std::string iname,std::string oname,char sep,unsigned char mtype,unsigned char ctype);
@@ -195,4 +217,93 @@ void JCsvToJMat(std::string iname,std::string oname,char sep,unsigned char mtype
  * @param[in] comment The comment to be set (it can be the empty string)
  */
 void JSetComment(std::string iname,std::string oname,std::string comment);
+
+/*!
+ * Function to generate a binary JMatrix file with a synthetic matrix of random values. The same parameters always produce the same file.\n
+ * See GenerateMatrix for the meaning of the parameters.
+ *
+ * @param[in] oname     Name of the binary file to contain the generated JMatrix
+ * @param[in] mtype     The type of the JMatrix: MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT
+ * @param[in] ctype     The data type of the values of the JMatrix
+ * @param[in] nrows     The number of rows
+ * @param[in] ncols     The number of columns (equal to nrows for symmetric matrices)
+ * @param[in] density   The expected fraction of non-zero entries, between 0 and 1
+ * @param[in] skew      The spread of the number of non-zero entries of the rows (0 for none)
+ * @param[in] seed      The seed of the random generators
+ * @param[in] withnames If true, synthetic row and column names are written, too
+ * @param[in] nthreads  The number of generating threads (0 to use as many as hardware threads)
+ */
+void JGenMatrix(std::string oname,unsigned char mtype,unsigned char ctype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+
+/*!
+ * Function to convert the matrix in a binary JMatrix file to another matrix type and/or data type, writing it to another binary file.\n
+ * See ConvertMatrix for the possible conversions and the meaning of the parameters.
+ *
+ * @param[in] iname    Name of the JMatrix binary file with the original matrix
+ * @param[in] oname    Name of the JMatrix binary file to contain the converted matrix
+ * @param[in] mtype    The type of the new JMatrix: MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT
+ * @param[in] ctype    The data type of the values of the new JMatrix (ignored for bit matrices, which are always of type unsigned char)
+ * @param[in] flags    Combination of the CONVERT_... flags
+ * @param[in] nthreads The number of converting threads (0 to use as many as hardware threads)
+ */
+void JConvertMatrix(std::string iname,std::string oname,unsigned char mtype,unsigned char ctype,unsigned char flags,unsigned int nthreads);
+
+/*!
+ * Function to get the statistics of each row and each column of the matrix in a binary JMatrix file (see MatrixStatistics), with a single pass over it,
+ * and write them as two full matrices of doubles in files oname.rows and oname.cols (or, as csv, oname.rows.csv and oname.cols.csv)
+ *
+ * @param[in] iname    Name of the JMatrix binary file
+ * @param[in] oname    Prefix of the names of the files to write the statistics
+ * @param[in] csv      true to write the statistics as csv files, false to write them as binary JMatrix files
+ * @param[in] nthreads The number of processing threads (0 to use as many as hardware threads)
+ */
+void JMatStats(std::string iname,std::string oname,bool csv,unsigned int nthreads);
+
+/*!
+ * Function to write to another binary JMatrix file the rows, and optionally the columns, of the matrix in a binary JMatrix file that fulfil some conditions
+ * on their number of non-zeros, their sum or their names, reading the file sequentially. See FilterMatrix.
+ *
+ * @param[in] iname     Name of the JMatrix binary file
+ * @param[in] oname     Name of the JMatrix binary file to write the rows and columns kept
+ * @param[in] rowfilter The conditions on the rows
+ * @param[in] colfilter The conditions on the columns
+ */
+void JFilterMatrix(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter);
+
+/*!
+ * Function to write to a binary JMatrix file the rows of the matrices in several binary JMatrix files, one after the other (rbind).
+ * The data type of the result is the one to which those of all of them are promoted. See BindRows and PromotedType.
+ *
+ * @param[in] inames Names of the JMatrix binary files to bind
+ * @param[in] oname  Name of the JMatrix binary file to write
+ */
+void JBindRows(std::vector<std::string> inames,std::string oname);
+
+/*!
+ * Function to write to a binary JMatrix file the columns of the matrices in several binary JMatrix files, one after the other (cbind).
+ * The data type of the result is the one to which those of all of them are promoted. See BindColumns and PromotedType.
+ *
+ * @param[in] inames Names of the JMatrix binary files to bind
+ * @param[in] oname  Name of the JMatrix binary file to write
+ */
+void JBindColumns(std::vector<std::string> inames,std::string oname);
+
+/*!
+ * Function to append the rows of the matrix in a binary JMatrix file to the matrix in another binary JMatrix file, in place,
+ * writing only the new rows and the metadata. See AppendRows.
+ *
+ * @param[in] iname Name of the JMatrix binary file with the rows to append
+ * @param[in] oname Name of the JMatrix binary file to append them to
+ */
+void JAppendRows(std::string iname,std::string oname);
+
+/*!
+ * Function to write to another binary JMatrix file the matrix in a binary JMatrix file with its rows (and, if it is symmetric, its columns) in another order,
+ * without loading it. See PermuteMatrix.
+ *
+ * @param[in] iname Name of the JMatrix binary file with the original matrix
+ * @param[in] order The rows in the order they must have in the result, as row names (if the matrix has them and all are found) or as row numbers from 0
+ * @param[in] oname Name of the JMatrix binary file to write
+ */
+void JPermuteMatrix(std::string iname,std::vector<std::string> order,std::string oname);
 #endif
@@ -0,0 +1,102 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/// @file asyncwriter.h
+
+const size_t DEFAULT_ASYNC_BUFFER_SIZE=8*1024*1024;    /*!< Default size in bytes of each of the buffers of AsyncWriteBuf (8 MiB) */
+const unsigned int DEFAULT_ASYNC_NUM_BUFFERS=2;        /*!< Default number of buffers of AsyncWriteBuf (double buffering) */
+const size_t DIRECT_IO_ALIGNMENT=4096;                 /*!< Alignment of addresses, sizes and offsets required by O_DIRECT writes */
+
+/**
+ * @AsyncWriteBuf Output stream buffer whose contents are written to disk by a background thread.\n
+ *                The caller fills one buffer while the writer thread flushes the others (double buffering with the default of two buffers,
+ *                triple buffering with three,...), so serialization and disk writes overlap. It is meant to be used through a std::ostream
+ *                so that all the code writing binary matrices can serve both for synchronous and asynchronous writes.\n
+ *                With direct I/O the file is opened with O_DIRECT (where available) to bypass the page cache for very big files;
+ *                if the file system does not support it, normal buffered I/O is used.\n
+ *                Errors do not stop the program: they are kept and returned by Close as one of the WRITE_* constants.
+ */
+class AsyncWriteBuf: public std::streambuf
+{
+ public:
+    /**
+     * Constructor. Only allocates the buffers; the file is opened by Open.
+     *
+     * @param[in] bufsize The size in bytes of each buffer. It is rounded up to a multiple of DIRECT_IO_ALIGNMENT
+     * @param[in] nbufs   The number of buffers (at least 2)
+     */
+    AsyncWriteBuf(size_t bufsize=DEFAULT_ASYNC_BUFFER_SIZE,unsigned int nbufs=DEFAULT_ASYNC_NUM_BUFFERS);
+
+    /**
+     * Destructor. Closes the file if Close was not called.
+     */
+    ~AsyncWriteBuf();
+
+    /**
+     * Opens (and truncates) the file and starts the writer thread.
+     *
+     * @param[in] fname  The name of the file to write
+     * @param[in] direct If true, try to open the file with O_DIRECT
+     * @return WRITE_OK or ERROR_OPENING_FILE_TO_WRITE
+     */
+    int Open(std::string fname,bool direct=false);
+
+    /**
+     * Sends the remaining data to the writer thread, waits for it to finish and closes the file.
+     *
+     * @return WRITE_OK or the first error found while writing
+     */
+    int Close();
+
+ protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+    std::streampos seekoff(std::streamoff off,std::ios_base::seekdir dir,std::ios_base::openmode which) override;
+
+ private:
+    size_t bufsize;
+    std::vector<char *> buffers;
+    std::vector<size_t> buflens;
+    std::deque<unsigned int> fullq;     // Buffers waiting to be written, in order
+    std::deque<unsigned int> freeq;     // Buffers available to be filled
+    unsigned int current;               // Buffer being filled by the caller
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread writer;
+    bool finishing;
+    bool isopen;
+    int status;
+    int fd;
+    bool direct;
+    unsigned long long handedoff;       // Bytes in buffers already sent to the writer thread
+    void HandOff();
+    void WriterLoop();
+};
+
+#endif // ASYNCWRITER_H
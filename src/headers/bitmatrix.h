@@ -0,0 +1,233 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BITMATRIX_H
+#define BITMATRIX_H
+
+#include "jmatrix.h"
+#include "fullmatrix.h"
+#include "asyncwriter.h"
+
+/// @file bitmatrix.h
+
+/**
+ * @BitMatrix Class to hold dense binary (0/1) matrices with each row packed in 64-bit words, so that a cell takes a single bit
+ *            instead of the byte of a FullMatrix<unsigned char>.\n
+ *            Distances between rows (Hamming, Jaccard) work on whole words with a population count, 64 columns at a time.\n
+ *            In binary files the matrix type is MTYPEBIT and the data type is that of unsigned char (UCTYPE). After the header,
+ *            each row is stored as BitRowWords(ncols) words in the endianness of the writing machine, column c being bit c%64 of word c/64.
+ */
+class BitMatrix: public JMatrix<unsigned char>
+{
+ public:
+    /**
+     * Default constructor
+     */
+    BitMatrix();
+
+    /**
+     * Constructor with number of rows and columns. All the elements are 0.
+     *
+     * @param[in] nrows Number of rows
+     * @param[in] ncols Number of columns
+     */
+    BitMatrix(indextype nrows,indextype ncols);
+
+    /**
+     * Copy constructor
+     *
+     * @param[in] other Reference to the BitMatrix to be copied
+     */
+    BitMatrix(const BitMatrix& other);
+
+    /**
+     * Constructor from a full matrix of any type. Non-zero elements become 1. Row and column names and comment are copied, too.
+     *
+     * @param[in] other Reference to the FullMatrix to be converted
+     */
+    template <typename T>
+    BitMatrix(FullMatrix<T>& other);
+
+    /**
+     * Constructor to fill the matrix content from a binary file
+     *
+     * @param[in] fname The name of the file to read
+     */
+    BitMatrix(std::string fname);
+
+    /**
+     * Function to resize the matrix\n
+     * WARNING: previous content, if any, IS LOST
+     *
+     * @param[in] newnr New number of rows
+     * @param[in] newnc New number of cols
+     */
+    void Resize(indextype newnr,indextype newnc);
+
+    /**
+     * Assignment operator
+     *
+     * @param[in] other Reference to the Matrix to be assigned
+     * @return Reference to the newly created Matrix
+     */
+    BitMatrix& operator= (const BitMatrix& other);
+
+    /**
+     * Transpose-assignment
+     *
+     * @param[in] other Reference to the Matrix to be assigned
+     * @return Reference to the newly created Matrix, which is the transpose of the passed one
+     */
+    BitMatrix& operator!= (const BitMatrix& other);
+
+    /**
+     * Function to get acess to an element
+     *
+     * @param[in] r The row to access
+     * @param[in] c The columns to access
+     *
+     * @return value at (r,c), 0 or 1
+     */
+#ifdef WITH_CHECKS_MATRIX
+    unsigned char Get(indextype r,indextype c) const;
+#else
+    inline unsigned char Get(indextype r,indextype c) const { return (unsigned char)((data[r*nw+c/BIT_WORD_BITS] >> (c%BIT_WORD_BITS)) & 1ULL); };
+#endif
+
+    /**
+     * Function to set an element
+     *
+     * @param[in] r The row to access
+     * @param[in] c The column to access
+     * @param[in] v The value to be set. Any non-zero value sets the bit to 1
+     */
+#ifdef WITH_CHECKS_MATRIX
+    void Set(indextype r,indextype c,unsigned char v);
+#else
+    inline void Set(indextype r,indextype c,unsigned char v)
+    {
+     unsigned long long m=1ULL << (c%BIT_WORD_BITS);
+     unsigned long long &w=data[r*nw+c/BIT_WORD_BITS];
+     w = (v!=0) ? (w | m) : (w & ~m);
+    };
+#endif
+
+    /**
+     * Function to get a row as values 0 or 1 of any of the types of the library.
+     * The pointer to hold the result is passed as parameter and it is supposed to be properly allocated (ncols elements).
+     *
+     * @param[in]   r The row to get
+     * @param[out] *v Pointer to the result
+     */
+    template <typename T>
+    void GetRow(indextype r,T *v) const;
+
+    /**
+     * Function to get direct access to the packed words of a row, for instance to write distance kernels with other matrices
+     *
+     * @param[in] r The row
+     * @return Pointer to the GetWordsPerRow() words of row r
+     */
+    const unsigned long long *GetRowWords(indextype r) const { return data.data()+(size_t)r*nw; };
+
+    /**
+     * Function to get the number of words of each row
+     *
+     * @return The number of 64-bit words that store each row
+     */
+    size_t GetWordsPerRow() const { return nw; };
+
+    /**
+     * Function to get the number of ones of a row
+     *
+     * @param[in] r The row
+     * @return The number of columns with value 1
+     */
+    indextype RowCount(indextype r) const;
+
+    /**
+     * Function to get the number of columns in which two rows (of this or another bit matrix with the same number of columns) are both 1
+     *
+     * @param[in] r1    Row of this matrix
+     * @param[in] other The matrix with the other row (it may be this same matrix)
+     * @param[in] r2    Row of other
+     * @return The size of the intersection of the sets of columns with value 1 of both rows
+     */
+    indextype RowIntersection(indextype r1,const BitMatrix &other,indextype r2) const;
+
+    /**
+     * Function to get the Jaccard distance, 1-|intersection(A,B)|/|union(A,B)|, between the sets A and B of columns with value 1 of two rows (0 if both are empty)
+     *
+     * @param[in] r1    Row of this matrix
+     * @param[in] other The matrix with the other row (it may be this same matrix)
+     * @param[in] r2    Row of other
+     * @return The Jaccard distance, between 0 and 1
+     */
+    double JaccardDistance(indextype r1,const BitMatrix &other,indextype r2) const;
+
+    /**
+     * Function to get the Hamming distance between two rows, which is the number of columns in which they differ
+     *
+     * @param[in] r1    Row of this matrix
+     * @param[in] other The matrix with the other row (it may be this same matrix)
+     * @param[in] r2    Row of other
+     * @return The number of columns with different values
+     */
+    indextype HammingDistance(indextype r1,const BitMatrix &other,indextype r2) const;
+
+    /**
+     * Function to write the matrix content to a CSV file
+     *
+     *  @param[in] fname      The name of the file to write
+     *  @param[in] csep       The separator character between fields (default: , (comma))
+     *  @param[in] withquotes Boolean value to indicate if field names in .csv must be written surrounded by quotes.
+     */
+    void WriteCsv(std::string fname,char csep=',',bool withquotes=false);
+
+    /**
+     * Function to write the matrix content to a binary file
+     * See format at documentation of JMatrix::WriteBin and of this class
+     *
+     *  @param[in] fname The name of the file to write
+     */
+    void WriteBin(std::string fname);
+
+    /**
+     * Function to write the matrix content to a binary file asynchronously. See FullMatrix::WriteBinAsync.
+     *
+     * @param[in] fname  The name of the file to write
+     * @param[in] direct If true, the file is written with O_DIRECT (bypassing the page cache) where available
+     * @param[in] nbufs  Number of buffers (2 for double buffering, 3 for triple buffering,...)
+     * @return A future whose value will be WRITE_OK, ERROR_OPENING_FILE_TO_WRITE or ERROR_WRITING_FILE
+     */
+    std::future<int> WriteBinAsync(std::string fname,bool direct=false,unsigned int nbufs=DEFAULT_ASYNC_NUM_BUFFERS);
+
+    /**
+     * Function to get memory in MB used by this bit matrix
+     *
+     * @return The amount of memory in MB
+     */
+    float GetUsedMemoryMB();
+
+ private:
+    void WriteBinContents(std::ostream &os);
+    size_t nw;                               // Words per row
+    std::vector<unsigned long long> data;    // All the rows, one after the other
+};
+
+#endif // BITMATRIX_H
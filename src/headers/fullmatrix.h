@@ -20,10 +20,17 @@
 #define FULLMATRIX_H
 
 #include "jmatrix.h"
+#include "asyncwriter.h"
 #include "memhelper.h"
 
 /// @file fullmatrix.h
 
+template <typename T>
+class SparseMatrix;
+
+template <typename T>
+class SymmetricMatrix;
+
 /**
  * @FullMatrix class to hold full matrices (all space booked in memory)
  */
@@ -62,6 +69,25 @@ class FullMatrix: public JMatrix<T>
      */
     FullMatrix( const FullMatrix<T>& other );
 
+    /**
+     * Constructor from a sparse matrix. Each thread fills with zeros a range of rows and scatters into them the non-zero values of the sparse rows.
+     * Row and column names and comment are copied, too.
+     *
+     * @param[in] other    Reference to the SparseMatrix to be converted
+     * @param[in] nthreads Number of threads (0 means as many as hardware threads)
+     */
+    FullMatrix(SparseMatrix<T>& other,unsigned int nthreads=0);
+
+    /**
+     * Constructor from a symmetric matrix. The lower triangle is copied row by row and the upper one mirrored by blocks of SYMMETRIC_TILE_SIZE rows,
+     * so that the reads of the columns of the symmetric matrix walk its rows. Blocks are distributed among the threads.
+     * Row and column names and comment are copied, too.
+     *
+     * @param[in] other    Reference to the SymmetricMatrix to be converted
+     * @param[in] nthreads Number of threads (0 means as many as hardware threads)
+     */
+    FullMatrix(SymmetricMatrix<T>& other,unsigned int nthreads=0);
+
     /**
      * Constructor to fill the matrix contents from a binary file\n
      * Binary file header as explained in the documentation to JMatrix::WriteBin
@@ -221,13 +247,25 @@ class FullMatrix: public JMatrix<T>
     
     /**
      * Function to write the matrix content to a binary file
-     * See format at documentation of JMatrix::WriteBin
+     * See format at documentation of JMatrix::WriteBin. Floating point values are stored with the encoding set with JMatrixSetValueEncoding.
      * 
      *  @param[in] fname The name of the file to write
      * 
      */
     void WriteBin(std::string fname);
     
+    /**
+     * Function to write the matrix content to a binary file asynchronously. It returns immediately: the matrix is serialized
+     * in a background thread into a set of buffers which another thread writes to disk, so the caller can go on computing.\n
+     * The file is identical to the one written by WriteBin. The matrix must not be modified nor destroyed until the returned future is ready.
+     *
+     * @param[in] fname  The name of the file to write
+     * @param[in] direct If true, the file is written with O_DIRECT (bypassing the page cache) where available
+     * @param[in] nbufs  Number of buffers (2 for double buffering, 3 for triple buffering,...)
+     * @return A future whose value will be WRITE_OK, ERROR_OPENING_FILE_TO_WRITE or ERROR_WRITING_FILE
+     */
+    std::future<int> WriteBinAsync(std::string fname,bool direct=false,unsigned int nbufs=DEFAULT_ASYNC_NUM_BUFFERS);
+    
     /**
      * Function to get memory in MB used by this full matrix
      * 
@@ -236,6 +274,10 @@ class FullMatrix: public JMatrix<T>
     float GetUsedMemoryMB();
     
  private:
+     friend class SparseMatrix<T>;           // The converting constructors read the rows directly
+     friend class SymmetricMatrix<T>;
+     void WriteBinContents(std::ostream &os);
+     void SetValueCodec();
      T **data;
 };
 
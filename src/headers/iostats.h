@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IOSTATS_H
+#define _IOSTATS_H
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+/// @file iostats.h
+
+///@{
+/**
+*	Constants to identify the instrumented operations of the library
+*
+*/
+const unsigned char STATS_LOAD=0;        /*!< Load of a matrix from a binary file (constructors of FullMatrix, SparseMatrix and SymmetricMatrix) */
+const unsigned char STATS_WRITEBIN=1;    /*!< Write of a matrix to a binary file (WriteBin and WriteBinAsync) */
+const unsigned char STATS_READCSV=2;     /*!< Load of a matrix from a csv file */
+const unsigned char STATS_WRITECSV=3;    /*!< Write of a matrix to a csv file (WriteCsv) */
+const unsigned char STATS_GETROWS=4;     /*!< Extraction of rows from a binary file (Get...RowFrom... functions) */
+const unsigned char STATS_GETCOLS=5;     /*!< Extraction of columns from a binary file (Get...ColumnFrom... functions) */
+const unsigned char STATS_GETDIAG=6;     /*!< Extraction of the subdiagonal of a symmetric matrix from a binary file */
+const unsigned char STATS_GENERATE=7;    /*!< Generation of a synthetic matrix in a binary file (GenerateMatrix) */
+const unsigned char STATS_FILEOP=8;      /*!< Out-of-core operation that reads binary files and writes the result to another one (ConvertMatrix, GetSubmatrix, FilterMatrix, BindRows, BindColumns, AppendRows, PermuteMatrix, SampleMatrix) */
+const unsigned char STATS_NUM_OPS=9;     /*!< Number of instrumented operations */
+///@}
+
+/**
+ * @JMatrixOpStats Counters accumulated by the calls to one of the instrumented operations.\n
+ *                 Read and write calls are the calls to the read/write functions of the streams (or to the buffer fills of JMatrixReader),
+ *                 which is an upper bound of the system calls actually issued.
+ */
+struct JMatrixOpStats
+{
+ unsigned long long calls;          /*!< Number of times the operation was called */
+ unsigned long long bytesread;      /*!< Bytes read from files */
+ unsigned long long byteswritten;   /*!< Bytes written to files */
+ unsigned long long readcalls;      /*!< Number of read calls */
+ unsigned long long writecalls;     /*!< Number of write calls */
+ unsigned long long seeks;          /*!< Number of seeks */
+ unsigned long long rows;           /*!< Rows (or columns, in column extractions) processed */
+ unsigned long long elements;       /*!< Matrix elements processed */
+ unsigned long long wallns;         /*!< Wall time in nanoseconds */
+};
+
+/*!
+ * Function to get the counters of one of the instrumented operations, accumulated since program start or the last call to JMatrixResetStats.\n
+ * Counters of all the threads are added.
+ *
+ * @param[in]  op One of the STATS_... constants
+ * @param[out] st The counters
+ */
+void JMatrixGetStats(unsigned char op,JMatrixOpStats &st);
+
+/*!
+ * Function to set to zero the counters of all operations
+ */
+void JMatrixResetStats();
+
+/*!
+ * Function to get the name of an instrumented operation
+ *
+ * @param[in] op One of the STATS_... constants
+ * @return The name (as printed by JMatrixPrintStats)
+ */
+std::string JMatrixStatsOpName(unsigned char op);
+
+/*!
+ * Function to print as a table the counters of the operations that have been called at least once
+ *
+ * @param[in] os The stream to print to
+ */
+void JMatrixPrintStats(std::ostream &os);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+// Counters of the operation in course in this thread. The instrumented places of the library add to them
+// and the outermost JMatrixOpScope moves them to the global counters when it ends.
+extern thread_local JMatrixOpStats JStatCurrent;
+
+inline void JStatRead(unsigned long long nbytes) { JStatCurrent.bytesread += nbytes; JStatCurrent.readcalls++; }
+inline void JStatWrite(unsigned long long nbytes) { JStatCurrent.byteswritten += nbytes; JStatCurrent.writecalls++; }
+// Bytes taken from a memory-mapped file, where no read call is issued
+inline void JStatMappedRead(unsigned long long nbytes) { JStatCurrent.bytesread += nbytes; }
+inline void JStatSeek() { JStatCurrent.seeks++; }
+inline void JStatRows(unsigned long long n) { JStatCurrent.rows += n; }
+inline void JStatElements(unsigned long long n) { JStatCurrent.elements += n; }
+
+// Measures one operation from construction to destruction. Scopes opened while another one is alive in the same thread
+// (an operation implemented with other instrumented operations) do nothing, so that everything is attributed to the outer one.
+// The base class constructors open scopes with countcall=false, since the operation is counted by the derived class constructor.
+class JMatrixOpScope
+{
+ public:
+    JMatrixOpScope(unsigned char op,bool countcall=true);
+    ~JMatrixOpScope();
+ private:
+    unsigned char op;
+    bool countcall;
+    bool outer;
+    std::chrono::steady_clock::time_point start;
+};
+#endif
+
+#endif
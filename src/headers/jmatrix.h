@@ -30,8 +30,12 @@
 #include <vector>
 #include <algorithm>		//std::remove_copy
 #include <type_traits>
+#include <future>
 #include <sys/stat.h>
 #include "debugpar.h"
+#include "iostats.h"
+#include "tracing.h"
+#include "valuecodec.h"
 #include "indextype.h"
 #include "matinfo.h"
 
@@ -54,13 +58,29 @@
 ///@{
 /** 
  *       Constants for the possible matrix types
- *         Currently, they are no type (for errors), full matrix, sparse matrix and symmetric matrix.
+ *         Currently, they are no type (for errors), full matrix, sparse matrix, symmetric matrix and bit matrix.
  *
  */
 const unsigned char MTYPENOTYPE=0x0F;		/*!< No matrix type */	
 const unsigned char MTYPEFULL=0x00;		/*!< Full matrix */	
 const unsigned char MTYPESPARSE=0x01;		/*!< Sparse matrix */	
 const unsigned char MTYPESYMMETRIC=0x02;	/*!< Symmetric matrix */	
+const unsigned char MTYPEBIT=0x03;		/*!< Binary (0/1) matrix with its rows packed in 64-bit words */
+///@}
+
+///@{
+/**
+ *        Constants for the possible formats of the rows of a sparse matrix in a binary file.
+ *         All of them start each row with its number of non-zero entries (as indextype) and end it with their values;
+ *         they differ in the way the column indices of these entries are stored. The format is recorded in the header, at byte SPARSE_FORMAT_POS.
+ *
+ */
+const unsigned char SPARSE_IDX32=0x00;		/*!< Column indices stored as indextype (32 bits). The only format of the files written by former versions */
+const unsigned char SPARSE_IDX16=0x01;		/*!< Column indices stored as unsigned short (16 bits). Used for matrices with at most SPARSE_IDX16_MAX_COLS columns */
+const indextype SPARSE_IDX16_MAX_COLS=65536;	/*!< Maximum number of columns of a sparse matrix whose column indices fit in 16 bits */
+const unsigned char SPARSE_VARINT=0x02;		/*!< Column indices stored as the gaps between consecutive columns, each one as a varint (7 bits per byte), preceded by the number of bytes they take (as indextype). Written only when requested with JMatrixSetSparseEncoding */
+const unsigned char SPARSE_PATTERN=0x80;		/*!< Flag OR'ed to any of the former formats for pattern-only matrices, whose rows have no values since all their non-zero entries are 1 */
+const unsigned char SPARSE_INDEX_MASK=0x7F;	/*!< Mask to get the format of the column indices from the format byte of the header */
 ///@}
 
 ///@{
@@ -102,7 +122,7 @@ const unsigned char LITEND=0xF0;	/*!< Little endian */
 /**
 *	Constants for information about the metadata included with the matrix
 *       Possible metadata stored are currently names of rows and names of columns
-*       Errors are returned with these constants in case of bad reads
+*       Errors are returned with these constants in case of bad reads or writes
 *
 */
 const int READ_OK=0;
@@ -111,6 +131,10 @@ const int ERROR_READING_ROW_NAMES=2;
 const int ERROR_READING_COL_NAMES=3;
 const int ERROR_READING_SEP_MARK=4;
 
+const int WRITE_OK=0;
+const int ERROR_OPENING_FILE_TO_WRITE=5;
+const int ERROR_WRITING_FILE=6;
+
 const unsigned int  MAX_LEN_NAME=1023;
 const unsigned int  COMMENT_SIZE=1024;      // All comments have fixed length. If no comment is used this will be a chunck of null characters.
 
@@ -186,7 +210,199 @@ std::string MetadataInfo(unsigned char metadatainfo);
  */
 int SizeOfType(unsigned char datatypeident);
 
+/**
+ * Returns the format used to store the rows of a sparse matrix, which depends only on its number of columns
+ *
+ * @param ncols. The number of columns of the matrix
+ * @return SPARSE_IDX16 if the column indices fit in 16 bits, SPARSE_IDX32 otherwise
+ */
+unsigned char SparseFormatForColumns(indextype ncols);
+
+/**
+ * Sets whether sparse matrices written to binary files from now on (with WriteBin, WriteBinAsync, JMatrixWriter or JMatGenerate) store their column indices
+ * as varint-encoded gaps (format SPARSE_VARINT) instead of as plain 16 or 32 bit numbers. Gaps between sorted columns are small, so most indices take a single byte
+ * and scans of big sparse files read far fewer bytes, at the price of decoding them. Files are read in any format, whatever this setting is. Default is OFF.
+ *
+ * @param[in] varint true to write sparse matrices in format SPARSE_VARINT, false to go back to the plain formats
+ */
+void JMatrixSetSparseEncoding(bool varint);
+
+/**
+ * Returns the format in which the rows of a sparse matrix are written to a binary file, which depends on its number of columns and on JMatrixSetSparseEncoding
+ *
+ * @param ncols. The number of columns of the matrix
+ * @return SPARSE_VARINT if encoding has been requested, otherwise the same as SparseFormatForColumns
+ */
+unsigned char SparseWriteFormat(indextype ncols);
+
+/**
+ * Returns the size in bytes of each column index of the rows of a sparse matrix
+ *
+ * @param sformat. The format of the rows (one of the SPARSE_... constants)
+ * @return The size in bytes of one column index (for SPARSE_VARINT, the size of the decoded indices, as indextype)
+ */
+size_t SparseIndexSize(unsigned char sformat);
+
+/**
+ * Returns the format of the rows of a sparse matrix stored in a binary file, looking only at its header
+ *
+ * @param header. Pointer to the HEADER_SIZE bytes read from the beginning of the binary file
+ * @return One of the SPARSE_... constants (the program stops if the format is unknown)
+ */
+unsigned char SparseFormatFromHeader(const unsigned char *header);
+
+/**
+ * Returns the format of the rows of a sparse matrix stored in a binary file, reading its header
+ *
+ * @param fname. File path
+ * @return One of the SPARSE_... constants (the program stops if the format is unknown)
+ */
+unsigned char SparseFormat(std::string fname);
+
 const unsigned short HEADER_SIZE=128;	/*!< The header size. We fix a header of 128 bytes. We don't need so much, but just in case in the future... */
+const unsigned short SPARSE_FORMAT_POS=3+2*sizeof(indextype);	/*!< Position in the header of the byte with the format of the rows of sparse matrices */
+const unsigned short VALUE_ENCODING_POS=SPARSE_FORMAT_POS+1;	/*!< Position in the header of the byte with the encoding of the values of full and symmetric matrices */
+const unsigned short VALUE_SCALE_POS=VALUE_ENCODING_POS+1;	/*!< Position in the header of the scale (as double) of quantised values */
+const unsigned short VALUE_OFFSET_POS=VALUE_SCALE_POS+sizeof(double);	/*!< Position in the header of the offset (as double) of quantised values */
+const unsigned short VALUE_CODEC_END=VALUE_OFFSET_POS+sizeof(double);	/*!< First position of the header after the encoding of the values. The rest of the header is empty (0) */
+
+/**
+ * Returns the encoding of the values of a matrix stored in a binary file, looking only at its header
+ *
+ * @param header. Pointer to the HEADER_SIZE bytes read from the beginning of the binary file
+ * @return The encoding, with its scale and offset and the data type of the stored values. Always VALUE_NATIVE for sparse and bit matrices (the program stops if the encoding is unknown)
+ */
+ValueCodec ValueCodecFromHeader(const unsigned char *header);
+
+/**
+ * Returns the encoding of the values of a matrix stored in a binary file, reading its header
+ *
+ * @param fname. File path
+ * @return The encoding, with its scale and offset (the program stops if the encoding is unknown)
+ */
+ValueCodec ValueCodecFromFile(std::string fname);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+// Gets the encoding of the values of a matrix of type mtype from the VALUE_CODEC_END-VALUE_ENCODING_POS bytes of the header at p
+ValueCodec ValueCodecFromBytes(unsigned char mtype,const unsigned char *p);
+
+// Puts the encoding of the values in its place of the header
+void ValueCodecToHeader(const ValueCodec &vc,unsigned char *header);
+
+// Number of bytes at the beginning of each sparse row stored in format sformat, before its column indices
+inline size_t SparseRowHeadSize(unsigned char sformat)
+{
+ return ((sformat & SPARSE_INDEX_MASK)==SPARSE_VARINT) ? 2*sizeof(indextype) : sizeof(indextype);
+}
+
+// Number of bytes of the values of a sparse row with ncr entries of tsize bytes stored in format sformat (none for pattern-only matrices)
+inline unsigned long long SparseValueBytes(unsigned char sformat,indextype ncr,size_t tsize)
+{
+ return (sformat & SPARSE_PATTERN) ? 0 : (unsigned long long)ncr*tsize;
+}
+
+// Reads the beginning of a sparse row stored in format sformat: its number of entries, ncr, and the number of bytes of its column indices, ibytes.
+// The values come after these ibytes bytes.
+void ReadSparseRowHead(std::istream &f,unsigned char sformat,indextype &ncr,unsigned long long &ibytes);
+
+// Reads the ncr column indices (ibytes bytes, as returned by ReadSparseRowHead) of a sparse row stored in format sformat, converting them to indextype.
+// idx must have room for ncr indextype values.
+void ReadSparseIndices(std::istream &f,unsigned char sformat,indextype ncr,unsigned long long ibytes,indextype *idx);
+
+// Reads the ncr values of a sparse row stored in format sformat, converting them to T if vc says they are stored as another type.
+// Pattern-only rows have no values in the file, and all of them are 1.
+template <typename T>
+inline void ReadSparseValues(std::istream &f,unsigned char sformat,const ValueCodec &vc,indextype ncr,T *v)
+{
+ if (sformat & SPARSE_PATTERN)
+ {
+  std::fill(v,v+ncr,T(1));
+  return;
+ }
+ ReadValues(f,vc,ncr,v);
+}
+
+// Decodes the ncr column indices of a row in format SPARSE_VARINT from the nbytes bytes at src. Returns false if they do not take exactly nbytes.
+bool DecodeSparseIndices(const unsigned char *src,size_t nbytes,indextype ncr,indextype *idx);
+
+// Appends to out the encoding in format SPARSE_VARINT of the n sorted column indices at idx (which may be indextype or unsigned short).
+// Each index is stored as its distance to the former one minus one (the first one, as it is), 7 bits per byte with the high bit set in all bytes but the last.
+template <typename I>
+inline void EncodeSparseIndices(const I *idx,indextype n,std::vector<unsigned char> &out)
+{
+ indextype next=0,g;
+ for (indextype k=0;k<n;k++)
+ {
+  g=indextype(idx[k])-next;
+  next=indextype(idx[k])+1;
+  while (g>=0x80)
+  {
+   out.push_back((unsigned char)(g | 0x80));
+   g >>= 7;
+  }
+  out.push_back((unsigned char)g);
+ }
+}
+
+// Converts in place the n 16-bit column indices stored at the beginning of idx to indextype. idx must have room for n indextype values.
+inline void WidenSparseIndices(indextype *idx,indextype n)
+{
+ unsigned short s;
+ // Backwards, so that no index is overwritten before being converted
+ for (indextype k=n;k>0;k--)
+ {
+  memcpy((void *)&s,(const void *)(((const unsigned char *)idx)+(k-1)*sizeof(unsigned short)),sizeof(unsigned short));
+  idx[k-1]=indextype(s);
+ }
+}
+
+// Rows of bit matrices (MTYPEBIT) are stored as BIT_WORD_BITS-bit words, column c being bit c%BIT_WORD_BITS of word c/BIT_WORD_BITS.
+// Unused bits of the last word of each row are always 0, so that whole words can be compared.
+const indextype BIT_WORD_BITS=64;
+
+// Number of words of each row of a bit matrix with ncols columns
+inline size_t BitRowWords(indextype ncols)
+{
+ return ((size_t)ncols+BIT_WORD_BITS-1)/BIT_WORD_BITS;
+}
+
+// Number of bits set in a word. Without a popcount instruction, the usual SWAR reduction is faster than the library call of the builtin.
+inline unsigned int BitCount(unsigned long long w)
+{
+#if defined(__POPCNT__) || defined(__aarch64__)
+ return (unsigned int)__builtin_popcountll(w);
+#else
+ w = w-((w >> 1) & 0x5555555555555555ULL);
+ w = (w & 0x3333333333333333ULL)+((w >> 2) & 0x3333333333333333ULL);
+ w = (w+(w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+ return (unsigned int)((w*0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Packs the ncols values at v as a row of a bit matrix in the BitRowWords(ncols) words at w. Non-zero values become 1.
+template <typename T>
+inline void PackBitRow(const T *v,indextype ncols,unsigned long long *w)
+{
+ size_t nw=BitRowWords(ncols);
+ for (size_t k=0;k<nw;k++)
+ {
+  indextype c0=indextype(k*BIT_WORD_BITS);
+  indextype n=std::min(BIT_WORD_BITS,ncols-c0);
+  unsigned long long b=0;
+  for (indextype i=0;i<n;i++)
+   b |= (unsigned long long)(v[c0+i]!=T(0)) << i;
+  w[k]=b;
+ }
+}
+
+// Unpacks a row of a bit matrix with ncols columns from the words at w to the ncols values at v (0 or 1)
+template <typename T>
+inline void UnpackBitRow(const unsigned long long *w,indextype ncols,T *v)
+{
+ for (indextype c=0;c<ncols;c++)
+  v[c]=T((w[c/BIT_WORD_BITS] >> (c%BIT_WORD_BITS)) & 1ULL);
+}
+#endif
 
 /**
  * @JMatrix Wrapper class for all types of matrices. It is meant to hold some basic operations common to all of them
@@ -215,7 +431,9 @@ class JMatrix
     /**
      * Constructor to fill the matrix content from a binary file
      * 
-     * Binary file header as explained in the documentation to WriteBin
+     * Binary file header as explained in the documentation to WriteBin\n
+     * The values may be stored as any data type: the subclasses convert them to T row by row as they read them,
+     * so that, for instance, a matrix of doubles can be loaded directly as a matrix of floats with no copy of it in memory.
      * 
      * TODO PRELIMINARY VERSION. ASSUMES SAME ENDIANESS FOR WRITER AND READER MACHINE
      * 
@@ -352,8 +570,10 @@ class JMatrix
      *  - indextype nr: number of rows
      *  - indextype nc: number of columns
      *  - unsigned char mdinfo: information on the presence/absence of metadata, currently row and/or column names and comment.
+     *  - unsigned char sformat: the format of the rows of sparse matrices (see SPARSE_FORMAT_POS).
+     *  - unsigned char enc, double scale, double offset: the encoding of the values of full and symmetric matrices (see VALUE_ENCODING_POS and JMatrixSetValueEncoding).
      *
-     *  This means that the size of the header is 2+2*sizeof(indextype)+1+empty_space.
+     *  This means that the size of the header is 2+2*sizeof(indextype)+3+2*sizeof(double)+empty_space.
      *  We have fixed the empty space so that total header size be 128 bytes.
      *
      *  After the header the binary file contains the matrix raw data, by rows.
@@ -378,13 +598,16 @@ class JMatrix
  protected: 
  	indextype nr,nc;
  	unsigned char jctype;
+ 	unsigned char sparseformat;     // Format of the rows of the sparse matrix read from a binary file
+ 	ValueCodec vcodec;              // Encoding of the values of the full or symmetric matrix read from (or being written to) a binary file
  	std::ifstream ifile;
  	std::ofstream ofile;
  	unsigned char TypeNameToId();
  	bool ProcessDataLineCsv(std::string line,char csep,T *rowofdata);
  	bool ProcessDataLineCsvForSymmetric(std::string line,char csep,indextype rnum,std::vector<T> &rowofdata);
  	int ReadMetadata();
- 	void WriteMetadata();
+ 	void WriteHeader(std::ostream &os,unsigned char mtype);
+ 	void WriteMetadata(std::ostream &os);
  	std::vector<std::string> rownames;
  	std::vector<std::string> colnames;
  	char comment[COMMENT_SIZE];
@@ -395,7 +618,7 @@ class JMatrix
  	unsigned char jmtype;
  	unsigned char mdinfo;
  	bool ProcessFirstLineCsv(std::string line,char csep);
-	void WriteNames(std::vector<std::string> &names);
+	void WriteNames(std::ostream &os,std::vector<std::string> &names);
 	indextype ReadNames(std::vector<std::string> &names);
 	indextype CheckSep();
 
@@ -0,0 +1,205 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JMATRIXREADER_H
+#define JMATRIXREADER_H
+
+#include "jmatrix.h"
+
+/// @file jmatrixreader.h
+
+const size_t DEFAULT_READ_BUFFER_SIZE=16*1024*1024;    /*!< Default size in bytes of the read-ahead buffer of JMatrixReader (16 MiB) */
+
+/**
+ * Row of a full matrix (or the stored part of a row of a symmetric matrix) as seen by JMatrixReader\n
+ * The pointer is owned by the reader and remains valid only until the next call to NextRow or SeekRow.
+ */
+template <typename T>
+struct DenseRowSpan
+{
+ const T *v;            /*!< Pointer to the n values of the row */
+ indextype n;           /*!< Number of values: the number of columns for full matrices, r+1 for row r of a symmetric matrix */
+};
+
+/**
+ * Row of a sparse matrix as seen by JMatrixReader\n
+ * The pointers are owned by the reader and remain valid only until the next call to NextRow or SeekRow.
+ */
+template <typename T>
+struct SparseRowSpan
+{
+ const indextype *c;    /*!< Pointer to the n column indices of the non-zero entries, in increasing order */
+ const T *v;            /*!< Pointer to the n values of the non-zero entries */
+ indextype n;           /*!< Number of non-zero entries in the row */
+};
+
+/**
+ * @JMatrixReader Cursor to read the rows of a matrix stored in a binary file without loading the matrix into memory.\n
+ *                The file is opened once, its header is interpreted in the same way as MatrixType does, and then rows are
+ *                served sequentially from a large read-ahead buffer, or from any position after a call to SeekRow.\n
+ *                Rows are exposed as DenseRowSpan (full, symmetric and bit matrices) or SparseRowSpan (sparse matrices) so that
+ *                streaming algorithms can process files much bigger than the available memory at disk speed.\n
+ *                For symmetric matrices each row exposes only what is physically stored, i.e. the r+1 values of the lower-triangular part.\n
+ *                Values stored as a data type other than T are converted to T as each row is loaded.
+ */
+template <typename T>
+class JMatrixReader
+{
+ public:
+    /**
+     * Constructor. Opens the file and reads its header
+     *
+     * @param[in] fname   The name of the binary file to read
+     * @param[in] bufsize The size in bytes of the read-ahead buffer. It will be enlarged if a single row does not fit in it.
+     */
+    JMatrixReader(std::string fname,size_t bufsize=DEFAULT_READ_BUFFER_SIZE);
+
+    /**
+     * Destructor. Closes the file.
+     */
+    ~JMatrixReader();
+
+    /**
+     * Function to get number of rows
+     *
+     * @return Number of rows of the matrix stored in the file
+     */
+    indextype GetNRows() { return nr; };
+
+    /**
+     * Function to get number of columns
+     *
+     * @return Number of columns of the matrix stored in the file
+     */
+    indextype GetNCols() { return nc; };
+
+    /**
+     * Function to get the type of the stored matrix
+     *
+     * @return One of the constants MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT
+     */
+    unsigned char GetMatrixType() { return mtype; };
+
+    /**
+     * Function to get the information on the metadata present in the file
+     *
+     * @return The OR'ed combination of ROW_NAMES, COL_NAMES and COMMENT stored in the header
+     */
+    unsigned char GetMetadataInfo() { return mdinfo; };
+
+    /**
+     * Function to load the next row. Just after construction, the next row is row 0. After SeekRow(r), it is row r+1.
+     *
+     * @return true if a row has been loaded, false if there are no more rows.
+     */
+    bool NextRow();
+
+    /**
+     * Function to load an arbitrary row. Following calls to NextRow continue from this row on.\n
+     * For sparse matrices the offsets of the rows are discovered (and remembered) jumping from row to row, so the first
+     * seek to a far row of a big file is the most costly one.
+     *
+     * @param[in] r The row to load
+     */
+    void SeekRow(indextype r);
+
+    /**
+     * Function to get the index of the currently loaded row
+     *
+     * @return The index of the row which is currently loaded
+     */
+    indextype CurrentRow() { return currow; };
+
+    /**
+     * Function to get the currently loaded row of a full, symmetric or bit matrix. Rows of bit matrices are unpacked to values 0 and 1.
+     *
+     * @return A DenseRowSpan pointing to the values of the row
+     */
+    DenseRowSpan<T> GetDenseRow();
+
+    /**
+     * Function to get the currently loaded row of a sparse matrix
+     *
+     * @return A SparseRowSpan pointing to the column indices and values of the row
+     */
+    SparseRowSpan<T> GetSparseRow();
+
+    /**
+     * Function to get the currently loaded row of a bit matrix as it is stored, packed in BitRowWords(ncols) words (see BitMatrix)
+     *
+     * @return Pointer to the words of the row
+     */
+    const unsigned long long *GetBitRowWords();
+
+    /**
+     * Function to copy the currently loaded row to an array of ncols elements, with zeros where there is no value.
+     * For symmetric matrices only the first r+1 places (the stored ones) get values from the file; the rest are set to zero.\n
+     * The array is supposed to be properly allocated.
+     *
+     * @param[out] *v Pointer to the result
+     */
+    void GetRow(T *v);
+
+    /**
+     * Function to get the row names stored in the file, if any
+     *
+     * @return A vector of strings with the row names. Empty vector if not present
+     */
+    std::vector<std::string> GetRowNames();
+
+    /**
+     * Function to get the column names stored in the file, if any
+     *
+     * @return A vector of strings with the column names. Empty vector if not present
+     */
+    std::vector<std::string> GetColNames();
+
+ private:
+    std::string fname;
+    std::ifstream ifile;
+    indextype nr,nc;
+    unsigned char mtype;
+    unsigned char mdinfo;
+    unsigned char sformat;
+    bool pattern;
+    size_t isize,vsize;
+    // Encoding of the values of full and symmetric matrices, and bytes taken by each of them
+    ValueCodec vcodec;
+    size_t esize;
+    indextype currow;
+    indextype nextrow;
+    // Read-ahead buffer. buf[0] corresponds to the file offset bufstart, and bytes from pos to buflen are still to be consumed
+    std::vector<char> buf;
+    unsigned long long bufstart;
+    size_t buflen;
+    size_t pos;
+    // The currently loaded row, copied from the buffer to properly aligned memory
+    std::vector<T> rowv;
+    std::vector<indextype> rowc;
+    std::vector<unsigned long long> roww;
+    indextype rown;
+    // Offsets (from the beginning of the file) of the rows of sparse matrices discovered so far
+    std::vector<unsigned long long> sparse_offsets;
+    bool Ensure(size_t need);
+    void MoveTo(unsigned long long offset);
+    void ReadCurrentRow();
+    unsigned long long RowOffset(indextype r);
+    size_t RowIndexBytes(indextype ncr);
+};
+
+#endif // JMATRIXREADER_H
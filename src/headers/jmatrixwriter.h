@@ -0,0 +1,217 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JMATRIXWRITER_H
+#define JMATRIXWRITER_H
+
+#include "jmatrix.h"
+
+/// @file jmatrixwriter.h
+
+const size_t DEFAULT_WRITE_BUFFER_SIZE=16*1024*1024;    /*!< Default size in bytes of the write buffer of JMatrixWriter (16 MiB) */
+
+/**
+ * @JMatrixWriter Class to build a binary matrix file row by row, without holding the matrix in memory.\n
+ *                The header is written on construction with zero rows, rows are appended through a large buffer and
+ *                Close writes the metadata and the end-of-data offset and patches the header with the final number of rows.\n
+ *                The resulting file is byte-identical to the one written by WriteBin for the same matrix.\n
+ *                Rows of full matrices have ncols values, rows of sparse matrices are given as (column,value) pairs or as
+ *                dense rows from which only non-zero values are stored, and row r of a symmetric matrix has the r+1 values of its lower-triangular part.\n
+ *                Rows of bit matrices are given as those of full or sparse matrices; non-zero values are stored as 1.\n
+ *                A writer can also be opened on an existing file to append rows to it in place: they are written where its binary data end,
+ *                and Close writes the metadata again after them, so that the cost is proportional to the appended rows, not to the whole file.
+ */
+template <typename T>
+class JMatrixWriter
+{
+ public:
+    /**
+     * Constructor. Creates the file and writes its header
+     *
+     * @param[in] fname   The name of the binary file to write
+     * @param[in] mtype   The type of matrix, one of MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT
+     * @param[in] ncols   The number of columns. For symmetric matrices, this is also the number of rows to be appended.
+     * @param[in] bufsize The size in bytes of the write buffer
+     */
+    JMatrixWriter(std::string fname,unsigned char mtype,indextype ncols,size_t bufsize=DEFAULT_WRITE_BUFFER_SIZE);
+
+    /**
+     * Constructor to append rows to the matrix in an existing binary file. Its header and metadata (names and comment) are read, and
+     * rows are appended after its last row, stored as the former ones (with the same format of sparse rows and the same encoding of values;
+     * values out of the range of a quantised encoding are clamped to it). The file must be of the data type T and of the endianness of this machine,
+     * and it cannot be a pattern-only sparse matrix.\n
+     * Appending a row to a symmetric matrix of dimension n makes it of dimension n+1: the row has n+1 values, its lower-triangular part.\n
+     * If the file has row names, the names of the new rows must be given with AppendRowNames; those not given are named R<i> at Close, with a warning.
+     *
+     * @param[in] fname   The name of the binary file to append rows to
+     * @param[in] bufsize The size in bytes of the write buffer
+     */
+    JMatrixWriter(std::string fname,size_t bufsize=DEFAULT_WRITE_BUFFER_SIZE);
+
+    /**
+     * Destructor. Closes the file, if Close has not been called before.
+     */
+    ~JMatrixWriter();
+
+    /**
+     * Function to get the number of rows appended so far
+     *
+     * @return Number of rows written
+     */
+    indextype GetNRows() { return nr; };
+
+    /**
+     * Function to get number of columns
+     *
+     * @return Number of columns of the matrix being written
+     */
+    indextype GetNCols() { return nc; };
+
+    /**
+     * Function to get the type of the matrix being written
+     *
+     * @return One of the constants MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT
+     */
+    unsigned char GetMatrixType() { return mtype; };
+
+    /**
+     * Function to append a row given as a dense array.\n
+     * For full, sparse and bit matrices v must have ncols elements (only the non-zero ones are stored in sparse matrices).
+     * For symmetric matrices, v must have r+1 elements, being r the number of rows already appended.
+     *
+     * @param[in] *v Pointer to the values of the row
+     */
+    void AppendRow(const T *v);
+
+    /**
+     * Function to append a row given by its non-zero entries.\n
+     * It can be used with full and bit matrices, too, in which case the row is expanded with zeros.
+     *
+     * @param[in] n  The number of non-zero entries
+     * @param[in] *c Pointer to the n column indices, which must be in increasing order
+     * @param[in] *v Pointer to the n values
+     */
+    void AppendSparseRow(indextype n,const indextype *c,const T *v);
+
+    /**
+     * Function to set the range of the values of a floating point full or symmetric matrix, needed to write them with the quantised encodings
+     * set with JMatrixSetValueEncoding when it was given no range. It must be called before appending any row. If it is not called, the matrix
+     * is written without encoding. It has no effect on other matrices or encodings.
+     *
+     * @param[in] minv Lowest value of the matrix (lower values are clamped to it)
+     * @param[in] maxv Highest value of the matrix (higher values are clamped to it)
+     */
+    void SetValueRange(double minv,double maxv);
+
+    /**
+     * Function to know whether the values will be written with a quantised encoding whose range is still unknown, so that SetValueRange should be called
+     *
+     * @return true if SetValueRange has to be called before appending the first row
+     */
+    bool NeedsValueRange() { return needrange; };
+
+    /**
+     * Function to set the row names. They are written at Close, so their number must equal then the number of appended rows.
+     *
+     * @param[in] rnames A vector of strings with the row names
+     */
+    void SetRowNames(std::vector<std::string> rnames);
+
+    /**
+     * Function to add names after the row names given so far (or read from the file, when appending to it), typically those of the rows being appended.
+     * If there were no names, but there were rows (those of the file being appended to), they are named R1,R2... first.
+     *
+     * @param[in] rnames A vector of strings with the names to add
+     */
+    void AppendRowNames(std::vector<std::string> rnames);
+
+    /**
+     * Function to set the column names
+     *
+     * @param[in] cnames A vector of strings with the column names. Its length must be the number of columns
+     */
+    void SetColNames(std::vector<std::string> cnames);
+
+    /**
+     * Function to set the comment. As in JMatrix, an empty string means no comment and longer strings are truncated.
+     *
+     * @param[in] cm The comment
+     */
+    void SetComment(std::string cm);
+
+    /**
+     * Function to know whether the rows of the matrix stored in a binary file are stored exactly as this writer stores its rows
+     * (same matrix type, number of columns, data type, endianness, encoding of the values and format of the rows of sparse matrices),
+     * so that they can be appended byte by byte with AppendRowsOfFile. Symmetric matrices never are.
+     *
+     * @param[in] iname The name of the binary file
+     * @return true if the rows of the file can be appended as they are
+     */
+    bool StoresAlike(std::string iname);
+
+    /**
+     * Function to append all the rows of the matrix stored in a binary file, copying them byte by byte without decoding them.
+     * Where available, copy_file_range is used, so that the data do not even go through user space. Names and comment of the file are not copied.\n
+     * The program stops if the rows of the file are not stored as those of this writer (see StoresAlike).
+     *
+     * @param[in] iname The name of the binary file
+     */
+    void AppendRowsOfFile(std::string iname);
+
+    /**
+     * Function to finish the file: flushes the rows, writes the metadata and the end-of-data offset and patches the header.
+     * No more rows can be appended after calling it.
+     */
+    void Close();
+
+ private:
+    std::string fname;
+    std::ofstream ofile;
+    unsigned char mtype;
+    indextype nr,nc;
+    unsigned char mdinfo;
+    unsigned char sformat;
+    // Encoding of the values of full and symmetric matrices, and whether it still waits for SetValueRange
+    ValueCodec vcodec;
+    bool needrange;
+    std::vector<std::string> rownames;
+    std::vector<std::string> colnames;
+    char comment[COMMENT_SIZE];
+    bool closed;
+    // Whether rows are being appended to an existing file, and its number of rows when it was opened
+    bool appending;
+    indextype nropen;
+    // Write buffer. Bytes from 0 to buflen are still to be written to disk.
+    std::vector<char> buf;
+    size_t buflen;
+    // Number of bytes sent to the file (or to the buffer) so far, to know where binary data end
+    unsigned long long written;
+    std::vector<indextype> tmpc;
+    std::vector<unsigned short> tmpc16;
+    std::vector<unsigned char> tmpenc;
+    std::vector<T> tmpv;
+    std::vector<unsigned long long> tmpw;
+    unsigned char TypeNameToId();
+    void Put(const void *p,size_t nbytes);
+    void PutIndices(indextype n,const indextype *c);
+    void PutValues(indextype n,const T *v);
+    void Flush();
+    void WriteNames(std::vector<std::string> &names);
+};
+
+#endif // JMATRIXWRITER_H
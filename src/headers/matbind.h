@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATBIND_H
+#define _MATBIND_H
+
+#include "jmatrix.h"
+
+/// @file matbind.h
+
+const size_t BIND_READ_BUFFERS_SIZE=256*1024*1024;    /*!< Total size in bytes of the read buffers of the files bound by BindColumns, which reads all of them at once (256 MiB) */
+
+/**
+ * Function to get the data type to which the values of matrices of several data types are promoted when they are bound together:
+ * the same type, if all of them are alike; the widest floating point type if any of them is floating point (but at least double
+ * if there are integers of 32 bits or more); otherwise the widest unsigned integer type if all are unsigned, or a signed integer type wide enough
+ * for all of them (up to 64 bits).
+ *
+ * @param[in] ctypes The data types of the matrices (...TYPE constants)
+ * @return The data type of the bound matrix
+ */
+unsigned char PromotedType(const std::vector<unsigned char> &ctypes);
+
+/**
+ * Function to get the matrix type of the result of binding matrices of several types: sparse if all of them are sparse,
+ * bit if all of them are bit matrices, and full otherwise. The program stops if any of them is symmetric.
+ *
+ * @param[in] mtypes The types of the matrices (MTYPE... constants)
+ * @return The type of the bound matrix
+ */
+unsigned char PromotedMatrixType(const std::vector<unsigned char> &mtypes);
+
+/**
+ * Function to write to a binary file the matrix made by the rows of several matrices stored in binary files, one after the other (rbind).
+ * They must have the same number of columns. The matrix type and data type of the result are got with PromotedMatrixType and PromotedType.\n
+ * Rows of files stored as those of the result (see JMatrixWriter::StoresAlike) are copied byte by byte, with no decoding, with copy_file_range where available.
+ * The rest are read with JMatrixReader and converted to the data type of the result on the fly. Neither of them is held in memory.\n
+ * Row names are joined (rows of files without names are named R1,R2... as in csv files, numbering all rows of the result), if any of the files has them.
+ * Column names are those of the first file that has them; a warning is issued if other files have different ones.
+ *
+ * @param[in] inames The names of the binary files to read
+ * @param[in] oname  The name of the binary file to write
+ */
+template <typename T>
+void BindRows(std::vector<std::string> inames,std::string oname);
+
+/**
+ * Function to write to a binary file the matrix made by the columns of several matrices stored in binary files, one after the other (cbind).
+ * They must have the same number of rows. The matrix type and data type of the result are got with PromotedMatrixType and PromotedType.\n
+ * All the files are read at once with JMatrixReader, each one with a buffer of BIND_READ_BUFFERS_SIZE divided by the number of files,
+ * and each row of the result is built from the rows of all of them and written before reading the next ones.\n
+ * Column names are joined (columns of files without names are named C1,C2... as in csv files, numbering all columns of the result), if any of the files has them.
+ * Row names are those of the first file that has them; a warning is issued if other files have different ones.
+ *
+ * @param[in] inames The names of the binary files to read
+ * @param[in] oname  The name of the binary file to write
+ */
+template <typename T>
+void BindColumns(std::vector<std::string> inames,std::string oname);
+
+/**
+ * Function to append the rows of the matrix stored in a binary file to the matrix stored in another binary file in place (see the constructor of
+ * JMatrixWriter that opens an existing file), so that only the appended rows and the metadata are written.\n
+ * To full, sparse and bit matrices, the rows of a full, sparse or bit matrix with the same number of columns are appended. Those stored alike are copied
+ * byte by byte, and the rest are converted to the data type T on the fly. To a symmetric matrix of dimension n, the rows of a full or sparse matrix of m rows
+ * and at least n+m columns are appended: the first n+i+1 values of its row i, which are the lower-triangular part of the new row.\n
+ * Names of the appended rows are added after those of the file, if any of both files has row names.
+ *
+ * @param[in] iname The name of the binary file with the rows to append
+ * @param[in] oname The name of the binary file to append them to, which must be of data type T
+ */
+template <typename T>
+void AppendRows(std::string iname,std::string oname);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATCONVERT_H
+#define _MATCONVERT_H
+
+#include "jmatrix.h"
+
+/// @file matconvert.h
+
+const size_t CONVERT_BLOCK_SIZE=32*1024*1024;    /*!< Approximate size in bytes of each block of rows converted in parallel by ConvertMatrix (32 MiB) */
+const size_t CONVERT_SWEEP_MEMORY_SIZE=1024*1024*1024;  /*!< Amount of memory in bytes for the complete rows gathered by each pass over a symmetric matrix converted by ConvertMatrix to another type (1 GiB) */
+
+///@{
+/**
+ *        Flags for the conversion of values between data types done by ConvertMatrix. They can be combined with |.
+ *
+ */
+const unsigned char CONVERT_SATURATE=0x01;   /*!< Values out of the range of the new data type become its lowest or highest value, instead of wrapping around (integers) or becoming infinite (floats) */
+const unsigned char CONVERT_ROUND=0x02;      /*!< Floating point values converted to an integer type are rounded to the nearest integer (halves away from zero) instead of truncated */
+///@}
+
+/**
+ * Function to convert a matrix stored in a binary file to another matrix type and/or data type, writing it to another binary file
+ * without holding any of them in memory.\n
+ * Rows are read in blocks of about CONVERT_BLOCK_SIZE bytes, which several threads convert while the main thread reads the next block
+ * and writes the former one with a JMatrixWriter, so the new file has exactly the format of WriteBin.\n
+ * The possible conversions are:
+ *   - any matrix to the same matrix type with another data type
+ *   - full or bit to sparse, keeping only the non-zero values (once converted, so that values which become 0 are dropped, too)
+ *   - sparse to full or bit, filling with zeros
+ *   - full, sparse or bit to symmetric, keeping the lower triangle and main diagonal. The matrix must be square; its upper triangle is ignored.
+ *   - symmetric to full, sparse or bit. The upper triangle of the rows is gathered from the rest of the file in windows of about
+ *     CONVERT_SWEEP_MEMORY_SIZE bytes of complete rows, each of them with a sequential pass from its first row to the end of the file.
+ *     A matrix whose complete rows fit in that memory is read once; otherwise it is read about (1+nwindows)/2 times.
+ *
+ * Floating point values converted to integer types are always kept in the range of the new type, and NaN becomes 0.
+ * Row and column names and comment are copied, too.
+ *
+ * @param[in] iname    The name of the binary file to read
+ * @param[in] oname    The name of the binary file to write
+ * @param[in] mtype    The type of the new matrix, one of MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT (non-zero values become 1)
+ * @param[in] flags    Combination of the CONVERT_... flags to convert the values
+ * @param[in] nthreads The number of converting threads (0 to use as many as hardware threads)
+ */
+template <typename S,typename T>
+void ConvertMatrix(std::string iname,std::string oname,unsigned char mtype,unsigned char flags=CONVERT_SATURATE,unsigned int nthreads=0);
+
+#endif
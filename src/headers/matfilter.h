@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATFILTER_H
+#define _MATFILTER_H
+
+#include <limits>
+#include <string>
+#include <vector>
+#include "indextype.h"
+
+/// @file matfilter.h
+
+/**
+ * @MatrixFilter Conditions that the rows (or the columns) kept by FilterMatrix must fulfil. They are kept only if they fulfil all of them,
+ *               so the default values, which impose no condition, keep everything.
+ */
+struct MatrixFilter
+{
+ indextype minnnz=0;                                            /*!< Lowest number of non-zero values */
+ double minsum=-std::numeric_limits<double>::infinity();        /*!< Lowest sum of the values */
+ double maxsum=std::numeric_limits<double>::infinity();         /*!< Highest sum of the values */
+ std::string regex="";                                          /*!< If not empty, a regular expression (ECMAScript grammar) that must match part of the name */
+ std::vector<std::string> names;                                /*!< If not empty, the names of those that may be kept */
+};
+
+/**
+ * Function to write to another binary file the rows of a matrix stored in a binary file that fulfil some conditions, and optionally only
+ * its columns that fulfil other conditions, without holding the matrix in memory.\n
+ * The conditions on the rows are checked as they are read, and the rows kept are written, with their names, in the same pass.
+ * Conditions on the number of non-zeros or the sum of the columns are checked on the rows kept, and take a former pass that gets these
+ * statistics of all columns. Conditions on names alone need no extra pass. If values are written with a quantised encoding for which no
+ * range was given, that former pass gets the range too.\n
+ * Rows of symmetric matrices are only complete once the whole file has been read, so their statistics are got first with MatrixStatistics.
+ * Then the rows that fulfil the conditions on rows and also those on columns are kept as rows and as columns, with GetSubmatrix, and the result is symmetric.\n
+ * The result is of the same matrix type and data type as the original matrix. If no row fulfils the conditions the result has no rows, and a warning is issued.
+ * The program stops if no column fulfils them, or if there are conditions on names and the matrix has no names.
+ *
+ * @param[in] iname     The name of the binary file to read
+ * @param[in] oname     The name of the binary file to write
+ * @param[in] rowfilter The conditions on the rows
+ * @param[in] colfilter The conditions on the columns
+ */
+template <typename T>
+void FilterMatrix(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter);
+
+#endif
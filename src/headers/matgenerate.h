@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATGENERATE_H
+#define _MATGENERATE_H
+
+#include <cmath>
+#include "jmatrix.h"
+
+/// @file matgenerate.h
+
+const size_t GEN_BLOCK_SIZE=32*1024*1024;    /*!< Approximate size in bytes of each block of rows generated in parallel by GenerateMatrix (32 MiB) */
+
+/**
+ * Function to write to a binary file a synthetic matrix of random values, without holding it in memory.\n
+ * Rows are generated in blocks by several threads while the previous block is being written with a JMatrixWriter, so the file
+ * has exactly the format of WriteBin.\n
+ * Each row uses its own random generator, seeded from seed and the row index, so that the same parameters always produce
+ * the same file, whatever the number of threads.\n
+ * The number of non-zero entries of each row is density times its length (ncols, or r+1 for row r of a symmetric matrix)
+ * multiplied by a log-normal weight of mean 1 whose spread is set by skew, so that skew=0 gives rows of (almost) equal length
+ * and larger values give a few long rows and many short ones. Non-zero values are uniform in (0,1] for floating point types
+ * and integers from 1 to 100 otherwise.
+ *
+ * @param[in] fname     The name of the binary file to write
+ * @param[in] mtype     The type of matrix, one of MTYPEFULL, MTYPESPARSE, MTYPESYMMETRIC or MTYPEBIT (non-zero values become 1)
+ * @param[in] nrows     The number of rows
+ * @param[in] ncols     The number of columns. For symmetric matrices it must be equal to nrows.
+ * @param[in] density   The expected fraction of non-zero entries, between 0 and 1
+ * @param[in] skew      The spread of the row lengths (0 for none)
+ * @param[in] seed      The seed of the random generators
+ * @param[in] withnames If true, rows are named R1,R2... and columns C1,C2... (in symmetric matrices columns get the row names)
+ * @param[in] nthreads  The number of generating threads (0 to use as many as hardware threads)
+ */
+template <typename T>
+void GenerateMatrix(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density=1.0,double skew=0.0,unsigned long long seed=1,bool withnames=false,unsigned int nthreads=0);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+// xoshiro256** generator seeded with splitmix64. Its output is fully specified (contrary to that of the distributions of <random>)
+// so generated files are identical in any platform.
+struct GenRNG
+{
+ unsigned long long s[4];
+
+ GenRNG(unsigned long long seed,unsigned long long row)
+ {
+  unsigned long long x=seed ^ (row*0xD1B54A32D192ED03ULL);
+  for (unsigned i=0;i<4;i++)
+  {
+   x += 0x9E3779B97F4A7C15ULL;
+   unsigned long long z=x;
+   z=(z ^ (z>>30))*0xBF58476D1CE4E5B9ULL;
+   z=(z ^ (z>>27))*0x94D049BB133111EBULL;
+   s[i]=z ^ (z>>31);
+  }
+ }
+
+ static unsigned long long Rotl(unsigned long long x,int k) { return (x<<k) | (x>>(64-k)); }
+
+ unsigned long long Next()
+ {
+  unsigned long long r=Rotl(s[1]*5,7)*9;
+  unsigned long long t=s[1]<<17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3]=Rotl(s[3],45);
+  return r;
+ }
+
+ // Uniform in [0,1)
+ double Uniform() { return double(Next()>>11)*(1.0/9007199254740992.0); }
+
+ // Uniform integer in [0,n)
+ unsigned long long Below(unsigned long long n) { return (unsigned long long)(Uniform()*double(n)); }
+
+ // Standard normal (Box-Muller)
+ double Normal() { return sqrt(-2.0*log(1.0-Uniform()))*cos(2.0*M_PI*Uniform()); }
+};
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATGETCOLS_H
+#define _MATGETCOLS_H
+
+#include "jmatrix.h"
+
+/// @file matgetcols.h
+
+// Auxiliary functions to read one or many columns of the matrices stored in binary jmatrix format without reading the full matrix in memory.
+// Many columns are returned transposed: m has one vector per row of the matrix, each with the values of the requested columns in that row.
+// T needs not be the data type of the stored values: they are converted to it as they are read.
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+template <typename T>
+void GetJustOneColumnFromFull(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyColumnsFromFull(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneColumnFromSparse(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyColumnsFromSparse(std::string fname,std::vector<indextype> nc,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneColumnFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyColumnsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m);
+#endif
+
+#endif
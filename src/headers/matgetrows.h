@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATGETROWS_H
+#define _MATGETROWS_H
+
+#include "jmatrix.h"
+
+/// @file matgetrows.h
+
+// Auxiliary functions to read one or many rows of the matrices stored in binary jmatrix format without reading the full matrix in memory.
+// Rows are always returned complete (ncols values, with zeros where a sparse matrix has no entry, and the upper-triangular part
+// of symmetric matrices reconstructed from the lower one). Rows are left in m in the same order as their indices in nr.
+// T needs not be the data type of the stored values: they are converted to it as they are read.
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+template <typename T>
+void GetJustOneRowFromFull(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneRowFromSparse(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneRowFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m);
+
+template <typename T>
+void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<T> &v);
+
+template <typename T>
+void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m);
+#endif
+
+#endif
@@ -45,6 +45,19 @@ void MatrixType(std::string fname,unsigned char &mtype,unsigned char &ctype,unsi
 void MatrixType(std::string fname,unsigned char &mtype,unsigned char &ctype,unsigned char &endianness,unsigned char &mdinf,indextype &nrows,indextype &ncols);
 ///@}
 
+/*!
+ Same as MatrixType, but interpreting a header already read into memory by the caller.\n
+ This is meant for those who keep the binary file open (as the streaming readers do) and don't want to open it again.
+ @param[in]  header       Pointer to the HEADER_SIZE bytes read from the beginning of the binary file
+ @param[out] mtype        Returns matrix type (full,sparse,symmetric)
+ @param[out] ctype        Returns matrix data type
+ @param[out] endianness   Returns endianness (big,little) of the data stored in the matrix
+ @param[out] mdinf        Returns the signal for the presence of metadata
+ @param[out] nrows        Returns the number of rows
+ @param[out] ncols        Returns the number of columns
+ */
+void MatrixTypeFromHeader(const unsigned char *header,unsigned char &mtype,unsigned char &ctype,unsigned char &endianness,unsigned char &mdinf,indextype &nrows,indextype &ncols);
+
 /*!
  Gives information about the JMatrix stored in a file
  @param[in] fname The name of the binary file that contains the matrix
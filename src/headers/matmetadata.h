@@ -22,6 +22,7 @@
 #include "fullmatrix.h"
 #include "sparsematrix.h"
 #include "symmetricmatrix.h"
+#include "bitmatrix.h"
 #include <cmath>
 
 /// @file matmetadata.h
@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATPERMUTE_H
+#define _MATPERMUTE_H
+
+#include <string>
+#include <vector>
+#include "indextype.h"
+
+/// @file matpermute.h
+
+const size_t PERMUTE_MEMORY_SIZE=1024*1024*1024;       /*!< Default amount of memory in bytes that PermuteMatrix may use for the rows (or values) being moved (1 GiB) */
+const size_t PERMUTE_READ_BUFFER_SIZE=16*1024*1024;    /*!< Size in bytes of the blocks in which PermuteMatrix reads files sequentially (16 MiB) */
+const size_t PERMUTE_SEEK_ROW_SIZE=1024*1024;          /*!< Average size in bytes of the rows from which PermuteMatrix reads each row from its place, since a seek costs little compared to the read (1 MiB) */
+
+/**
+ * Function to write to another binary file the matrix stored in a binary file with its rows in another order, without holding the matrix in memory.
+ * Row i of the result is row order[i] of the original matrix. Symmetric matrices are permuted by rows and columns at once, so that value (i,j)
+ * of the result is value (order[i],order[j]) of the original matrix, which is still symmetric.\n
+ * Rows (or, for symmetric matrices, values) are moved as they are stored, with no decoding, so the result has the same matrix type, data type,
+ * encoding of the values and format of sparse rows as the original file. Row names (and column names of symmetric matrices) are permuted the same way,
+ * and the comment is kept.\n
+ * The result is built in batches of consecutive rows that take at most half of memsize. If all of it fits in a single batch, the rows needed are read in the order
+ * in which they are stored. Rows are read from their places, batch by batch, in the same way when they take PERMUTE_SEEK_ROW_SIZE or more on average.
+ * Otherwise the original file is read once, sequentially, and each row (or value) is written to the part of the result of its batch, in the order in which it is read
+ * (external bucketing in the result file itself). Then each batch is read back, ordered in memory and written again in place. Each byte is thus read twice
+ * and written twice, in big blocks, whatever the size of the file.
+ *
+ * @param[in] iname   The name of the binary file to read
+ * @param[in] order   The indices of the rows of the original matrix, in the order they must have in the result. Each one must appear exactly once.
+ * @param[in] oname   The name of the binary file to write
+ * @param[in] memsize The amount of memory in bytes to use for the rows being moved
+ */
+void PermuteMatrix(std::string iname,const std::vector<indextype> &order,std::string oname,size_t memsize=PERMUTE_MEMORY_SIZE);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+// Read and write nbytes at the given offset of the file open as fd, stopping the program if it is not possible
+void ReadFileAt(int fd,std::string fname,char *p,size_t nbytes,unsigned long long offset);
+void WriteFileAt(int fd,std::string fname,const char *p,size_t nbytes,unsigned long long offset);
+
+// Bytes taken by the row of a sparse matrix stored in format sformat, with values of vsize bytes, whose beginning (SparseRowHeadSize(sformat) bytes) is at p
+unsigned long long SparseRowBytes(const char *p,unsigned char sformat,size_t vsize);
+
+// Offsets of the first nrows rows of the full, sparse or bit matrix whose header is given, stored in the file open as fd, followed by the offset where the last one ends.
+// Those of sparse matrices are found reading the beginning of each row, up to endofbindata.
+std::vector<unsigned long long> RowOffsets(int fd,std::string fname,const unsigned char *header,indextype nrows,unsigned long long endofbindata);
+
+// Writes at offset endofbindata of the file open as out the metadata selected by mdinfo: the given names and the comment of the file open as in, which is at start_comment
+void WriteRawMetadata(int in,std::string iname,unsigned long long start_comment,int out,std::string oname,unsigned long long endofbindata,
+                      unsigned char mdinfo,const std::vector<std::string> &rnames,const std::vector<std::string> &cnames);
+
+// Parts of a file, starting at the given offsets, to which bytes are appended through a buffer for each one. PermuteMatrix puts there the rows (or values)
+// of each batch in the order they are read, as in external bucketing; a single part is just a buffered sequential writer.
+class BucketWriter
+{
+ public:
+    BucketWriter(int fd,std::string fname,const std::vector<unsigned long long> &starts,size_t bufsize) : fd(fd),fname(fname),fill(starts),bufsize(bufsize)
+    {
+     bufs.resize(starts.size());
+    };
+
+    void Put(size_t k,const char *p,size_t nbytes)
+    {
+     std::vector<char> &b=bufs[k];
+     if (b.size()+nbytes>bufsize)
+      Flush(k);
+     if (nbytes>=bufsize)
+     {
+      WriteFileAt(fd,fname,p,nbytes,fill[k]);
+      fill[k] += nbytes;
+      return;
+     }
+     if (b.capacity()<bufsize)
+      b.reserve(bufsize);
+     b.insert(b.end(),p,p+nbytes);
+    };
+
+    void Flush(size_t k)
+    {
+     std::vector<char> &b=bufs[k];
+     if (b.size()==0)
+      return;
+     WriteFileAt(fd,fname,b.data(),b.size(),fill[k]);
+     fill[k] += b.size();
+     b.clear();
+    };
+
+    void FlushAll()
+    {
+     for (size_t k=0; k<bufs.size(); k++)
+     {
+      Flush(k);
+      std::vector<char>().swap(bufs[k]);
+     }
+    };
+
+ private:
+    int fd;
+    std::string fname;
+    std::vector<unsigned long long> fill;
+    size_t bufsize;
+    std::vector<std::vector<char>> bufs;
+};
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATSAMPLE_H
+#define _MATSAMPLE_H
+
+#include <string>
+#include <vector>
+#include "indextype.h"
+
+/// @file matsample.h
+
+///@{
+/**
+ *        Constants for the ways in which SampleMatrix chooses the rows of the sample
+ *
+ */
+const unsigned char SAMPLE_UNIFORM=0x00;        /*!< Rows chosen uniformly at random, without replacement, and read in the order in which they are stored */
+const unsigned char SAMPLE_RESERVOIR=0x01;      /*!< Rows chosen as reservoir sampling (Algorithm L) does, and read in a single sequential pass over the file, with no seeks */
+const unsigned char SAMPLE_STRATIFIED=0x02;     /*!< Rows chosen uniformly within each group of rows whose names share the prefix before a separator, in proportion to the size of the group */
+///@}
+
+const unsigned long long SAMPLE_MAX_GAP=64*1024;    /*!< Sampled rows whose stored bytes are closer than this are read with a single read, which includes the gap */
+
+/**
+ * Function to choose the rows of a random sample without replacement, without reading any row. The same parameters always give the same rows, in any platform.\n
+ * With SAMPLE_UNIFORM the rows are chosen with Floyd's algorithm, and with SAMPLE_RESERVOIR with the skips of Algorithm L, which is what a single pass over the rows
+ * would keep; both give uniform samples. With SAMPLE_STRATIFIED rows are grouped by the part of their names before the first occurrence of sep (the whole name
+ * if sep does not appear), each group gets a share of the sample proportional to its size (the remainders of the shares go to the groups with the largest ones),
+ * and its rows are chosen uniformly.
+ *
+ * @param[in] nrows   The number of rows to choose from
+ * @param[in] nsample The number of rows to choose. If it is not lower than nrows, all rows are chosen; if it is 0, none.
+ * @param[in] method  One of the SAMPLE_... constants
+ * @param[in] seed    The seed of the random generator
+ * @param[in] rnames  The names of the rows, needed only by SAMPLE_STRATIFIED
+ * @param[in] sep     The character that ends the prefix of the names that defines the groups of SAMPLE_STRATIFIED
+ * @return The indices of the chosen rows, in increasing order
+ */
+std::vector<indextype> SampleRowIndices(indextype nrows,indextype nsample,unsigned char method,unsigned long long seed,const std::vector<std::string> &rnames=std::vector<std::string>(),char sep='_');
+
+/**
+ * Function to write to another binary file a random sample of the rows of a matrix stored in a binary file, chosen with SampleRowIndices, without loading the matrix.\n
+ * Rows of full, sparse and bit matrices are copied as they are stored, with no decoding, to a matrix of the same type, data type and encoding, with the names
+ * of the chosen rows, the column names and the comment. They keep the order they have in the file.\n
+ * With SAMPLE_UNIFORM and SAMPLE_STRATIFIED only the chosen rows are read, in the order in which they are stored, joining in a single read those closer
+ * than SAMPLE_MAX_GAP bytes. For full and bit matrices the offset of each row is known from its index, so the time taken depends on the size of the sample,
+ * not on that of the file. Sparse files store no index of their rows, so the beginning of every row up to the last chosen one is read to find where they are.
+ * With SAMPLE_RESERVOIR the file is read once sequentially and the chosen rows are written as they pass, which suits devices where seeks are expensive.\n
+ * Samples of symmetric matrices take the chosen rows and the same columns, so that they are symmetric too, and are extracted with GetSubmatrix.
+ *
+ * @param[in] iname   The name of the binary file to read
+ * @param[in] oname   The name of the binary file to write
+ * @param[in] nsample The number of rows of the sample
+ * @param[in] method  One of the SAMPLE_... constants
+ * @param[in] seed    The seed of the random generator
+ * @param[in] sep     The character that ends the prefix of the row names that defines the groups of SAMPLE_STRATIFIED
+ */
+void SampleMatrix(std::string iname,std::string oname,indextype nsample,unsigned char method=SAMPLE_UNIFORM,unsigned long long seed=1,char sep='_');
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATSTATS_H
+#define _MATSTATS_H
+
+#include "fullmatrix.h"
+
+/// @file matstats.h
+
+const size_t STATS_BLOCK_SIZE=32*1024*1024;    /*!< Approximate size in bytes of each block of rows processed in parallel by MatrixStatistics (32 MiB) */
+
+///@{
+/**
+ *        Columns of the matrices of statistics returned by MatrixStatistics, which are named as the strings in MATRIX_STATS_NAMES
+ *
+ */
+const unsigned int MSTAT_SUM=0;        /*!< Sum of the values */
+const unsigned int MSTAT_MEAN=1;       /*!< Mean of the values */
+const unsigned int MSTAT_VAR=2;        /*!< Sample variance of the values (divided by n-1), or 0 if there is just one value */
+const unsigned int MSTAT_NNZ=3;        /*!< Number of non-zero values */
+const unsigned int MSTAT_MIN=4;        /*!< Lowest value */
+const unsigned int MSTAT_MAX=5;        /*!< Highest value */
+const unsigned int NUM_MATRIX_STATS=6; /*!< Number of statistics */
+///@}
+
+/**
+ * Names of the statistics, which become the column names of the matrices returned by MatrixStatistics
+ */
+extern const std::vector<std::string> MATRIX_STATS_NAMES;
+
+/**
+ * Function to get statistics of each row and each column of a matrix stored in a binary file, with a single sequential pass over it
+ * and without holding it in memory: only the statistics are kept, which takes memory proportional to nrows+ncols (ncols times the number of threads).\n
+ * The main thread reads blocks of about STATS_BLOCK_SIZE bytes with JMatrixReader while several threads process the former block.
+ * Each row is processed by one thread, whose partial statistics of the columns are joined at the end.
+ * Variances are computed in a numerically stable way: those of dense rows with two passes over the row in memory, and those of the
+ * columns with Welford's updates or (for dense matrices) block by block, joining the mean and sum of squared deviations of each block
+ * of rows with those of the former ones as in Chan et al. pairwise algorithm.\n
+ * Every row and column has all its values, including the zeros of sparse matrices (which are not read, but counted) and the upper triangle
+ * of symmetric matrices (for which row and column statistics are the same).
+ *
+ * @param[in]  fname    The name of the binary file to read
+ * @param[out] rowstats A matrix with a row for each row of the matrix in the file, and a column for each statistic (see the MSTAT_... constants).
+ *                      Its row names are those of the matrix (R1,R2... if it has none), and its column names those in MATRIX_STATS_NAMES.
+ * @param[out] colstats A matrix with a row for each column of the matrix in the file (named as them, or C1,C2...), and a column for each statistic
+ * @param[in]  nthreads The number of processing threads (0 to use as many as hardware threads)
+ */
+template <typename T>
+void MatrixStatistics(std::string fname,FullMatrix<double> &rowstats,FullMatrix<double> &colstats,unsigned int nthreads=0);
+
+#endif
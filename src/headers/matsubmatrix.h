@@ -0,0 +1,46 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATSUBMATRIX_H
+#define _MATSUBMATRIX_H
+
+#include "jmatrix.h"
+
+/// @file matsubmatrix.h
+
+const unsigned long long SUBMATRIX_MAX_GAP=4096;    /*!< Requested columns of a full matrix closer than this number of bytes in a row are read with a single read, which includes the gap */
+
+/**
+ * Function to extract from a matrix stored in a binary file the submatrix formed by some of its rows and some of its columns,
+ * writing it to another binary file without holding any of both matrices in memory.\n
+ * Only the requested rows are read. For full matrices, only the requested columns of each of them are read: the columns are grouped in runs
+ * of consecutive stored columns (joining those closer than SUBMATRIX_MAX_GAP bytes), and each run takes a single read per row.
+ * Rows of symmetric matrices are gathered from the mapped file; rows of sparse and bit matrices are read with JMatrixReader.\n
+ * Rows and columns appear in the submatrix in the order in which they are requested, and they may be repeated.
+ * The submatrix is of the same type as the original one, except for symmetric matrices, whose submatrix is full unless the
+ * requested rows and columns are the same ones. Row and column names, if any, are those of the selected rows and columns.
+ *
+ * @param[in] iname The name of the binary file to read
+ * @param[in] oname The name of the binary file to write
+ * @param[in] rows  Indices of the rows to extract (from 0)
+ * @param[in] cols  Indices of the columns to extract (from 0)
+ */
+template <typename T>
+void GetSubmatrix(std::string iname,std::string oname,std::vector<indextype> rows,std::vector<indextype> cols);
+
+#endif
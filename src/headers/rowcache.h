@@ -0,0 +1,183 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROWCACHE_H
+#define ROWCACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include "jmatrixreader.h"
+
+/// @file rowcache.h
+
+///@{
+/**
+*	Constants for the eviction policy of JMatrixRowCache
+*
+*/
+const unsigned char CACHE_LRU=0x00;      /*!< Evict the least recently used row */
+const unsigned char CACHE_CLOCK=0x01;    /*!< Evict with the CLOCK (second chance) approximation to LRU, which is cheaper on hits */
+///@}
+
+const size_t DEFAULT_ROW_CACHE_BUDGET=256*1024*1024;    /*!< Default memory budget of JMatrixRowCache in bytes (256 MiB) */
+
+/**
+ * @JMatrixRowCache Thread-safe cache of complete rows of a matrix stored in a binary file.\n
+ *                  Rows are read from disk only the first time they are requested (or after being evicted) and kept in memory
+ *                  while the total size of the cached rows does not exceed a byte budget. Rows are always complete, i.e.
+ *                  ncols values with zeros in the empty places of sparse matrices and the upper-triangular part of symmetric matrices reconstructed.\n
+ *                  Rows requested together with GetRows or Prefetch are read from disk in one batch, in increasing order.
+ *                  Pinned rows are never evicted, even if this means exceeding the budget.
+ */
+template <typename T>
+class JMatrixRowCache
+{
+ public:
+    /**
+     * Constructor. Reads the header of the file; no row is read yet.
+     *
+     * @param[in] fname  The name of the binary file
+     * @param[in] budget Maximum amount of memory in bytes for the cached rows
+     * @param[in] policy Eviction policy, CACHE_LRU or CACHE_CLOCK
+     */
+    JMatrixRowCache(std::string fname,size_t budget=DEFAULT_ROW_CACHE_BUDGET,unsigned char policy=CACHE_LRU);
+
+    /**
+     * Function to get number of rows
+     *
+     * @return Number of rows of the matrix stored in the file
+     */
+    indextype GetNRows() { return nr; };
+
+    /**
+     * Function to get number of columns
+     *
+     * @return Number of columns of the matrix stored in the file
+     */
+    indextype GetNCols() { return nc; };
+
+    /**
+     * Function to get a complete row
+     *
+     * @param[in]  r  The row index
+     * @param[out] v  The row. It is resized to the number of columns.
+     */
+    void GetRow(indextype r,std::vector<T> &v);
+
+    /**
+     * Function to get many complete rows. The ones not in the cache are read from disk in one batch.
+     *
+     * @param[in]  rows The row indices
+     * @param[out] m    The rows, in the same order as in rows
+     */
+    void GetRows(std::vector<indextype> rows,std::vector<std::vector<T>> &m);
+
+    /**
+     * Function to load into the cache (in one batch) the rows which are not yet there, so that later calls to GetRow are hits.
+     *
+     * @param[in] rows The row indices
+     */
+    void Prefetch(std::vector<indextype> rows);
+
+    /**
+     * Function to pin a row, loading it if needed. A pinned row is never evicted until unpinned as many times as it was pinned.
+     *
+     * @param[in] r The row index
+     */
+    void Pin(indextype r);
+
+    /**
+     * Function to unpin a row formerly pinned with Pin
+     *
+     * @param[in] r The row index
+     */
+    void Unpin(indextype r);
+
+    /**
+     * Function to remove from the cache all the rows which are not pinned
+     */
+    void Clear();
+
+    /**
+     * Function to get the number of rows requested which were found in the cache
+     *
+     * @return The number of hits since construction or the last call to ResetCounters
+     */
+    unsigned long long GetHits();
+
+    /**
+     * Function to get the number of rows requested which had to be read from disk
+     *
+     * @return The number of misses since construction or the last call to ResetCounters
+     */
+    unsigned long long GetMisses();
+
+    /**
+     * Function to get the number of rows evicted to make room for others
+     *
+     * @return The number of evictions since construction or the last call to ResetCounters
+     */
+    unsigned long long GetEvictions();
+
+    /**
+     * Function to set to zero the hit, miss and eviction counters
+     */
+    void ResetCounters();
+
+    /**
+     * Function to get the memory used by the cached rows
+     *
+     * @return The memory in bytes
+     */
+    size_t GetUsedBytes();
+
+ private:
+    struct CachedRow
+    {
+     std::vector<T> v;
+     unsigned int pins;
+     bool referenced;                           // CLOCK reference bit
+     std::list<indextype>::iterator lrupos;     // Position in the LRU list
+     size_t clockpos;                           // Position in the CLOCK ring
+    };
+    std::string fname;
+    indextype nr,nc;
+    unsigned char mtype;
+    unsigned char policy;
+    size_t budget;
+    size_t rowbytes;
+    size_t used;
+    unsigned long long hits,misses,evictions;
+    std::unordered_map<indextype,CachedRow> rows;
+    std::list<indextype> lru;                  // Most recently used rows first
+    std::vector<indextype> ring;               // CLOCK ring
+    size_t hand;
+    std::mutex mtx;                            // Protects the cache structures and counters
+    std::mutex iomtx;                          // Serializes the reads from disk
+    std::unique_ptr<JMatrixReader<T>> reader;  // Kept open for full and sparse matrices, so that the offsets of sparse rows are remembered
+    void CheckRow(indextype r);
+    void Touch(CachedRow &e);
+    bool EvictOne();
+    void Insert(indextype r,std::vector<T> &v,unsigned int pins);
+    void ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<T>> &m);
+    void Fetch(std::vector<indextype> &wanted,std::vector<std::vector<T>> *m,unsigned int pins);
+};
+
+#endif // ROWCACHE_H
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSEBUILDER_H
+#define SPARSEBUILDER_H
+
+#include <mutex>
+#include <memory>
+#include "sparsematrix.h"
+
+/// @file sparsebuilder.h
+
+///@{
+/**
+*	Constants for the treatment of repeated (row,column) positions in SparseMatrixBuilder
+*
+*/
+const unsigned char DUP_SUM=0x00;      /*!< Values added to the same position are summed */
+const unsigned char DUP_LAST=0x01;     /*!< The value added last to a position is kept */
+const unsigned char DUP_ERROR=0x02;    /*!< A repeated position is an error */
+///@}
+
+/**
+ * @SparseMatrixBuilder Class to build a SparseMatrix from (row,column,value) triplets given in any order.\n
+ *                      Triplets are just stored when added, which can be done concurrently from many threads.
+ *                      Build sorts them by row and column with two stable, parallel counting sort passes and moves them into the matrix,
+ *                      so that the whole construction is O(number of triplets + rows + columns) instead of the O(row length) of each call to SparseMatrix::Set.\n
+ *                      DUP_LAST refers to the order in which the triplets were added by each thread; among different threads the order is undefined.
+ *                      As with SparseMatrix::Set, positions whose final value is zero are not stored.
+ */
+template <typename T>
+class SparseMatrixBuilder
+{
+ public:
+    /**
+     * Constructor
+     *
+     * @param[in] nrows     Number of rows of the matrix to build
+     * @param[in] ncols     Number of columns of the matrix to build
+     * @param[in] duppolicy What to do with repeated positions: DUP_SUM, DUP_LAST or DUP_ERROR
+     */
+    SparseMatrixBuilder(indextype nrows,indextype ncols,unsigned char duppolicy=DUP_SUM);
+
+    /**
+     * Function to book memory in advance for the triplets to be added by the calling thread
+     *
+     * @param[in] n Expected number of triplets
+     */
+    void Reserve(size_t n);
+
+    /**
+     * Function to add a triplet. It can be called concurrently from several threads.
+     *
+     * @param[in] r The row
+     * @param[in] c The column
+     * @param[in] v The value
+     */
+    void Add(indextype r,indextype c,T v);
+
+    /**
+     * Function to add many triplets at once, as three vectors of the same length. It can be called concurrently from several threads
+     * and it is much cheaper per triplet than Add.
+     *
+     * @param[in] rows The rows
+     * @param[in] cols The columns
+     * @param[in] v    The values
+     */
+    void AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<T> &v);
+
+    /**
+     * Function to get the number of triplets added so far
+     *
+     * @return The number of triplets
+     */
+    size_t Size();
+
+    /**
+     * Function to build the matrix from the added triplets. Former content of M, if any, is lost.
+     * The builder is left empty, ready to be used again. It must not be called while other threads are adding triplets.
+     *
+     * @param[out] M        The matrix. It is resized to the dimensions passed to the constructor.
+     * @param[in]  nthreads Number of threads to sort and fill rows (0 means as many as hardware threads)
+     */
+    void Build(SparseMatrix<T> &M,unsigned int nthreads=0);
+
+ private:
+    // Triplets are kept in several shards, each one with its own lock, and each thread always adds to the same shard.
+    // This keeps the order of the additions of each thread and avoids most of the contention.
+    struct Shard
+    {
+     std::mutex mtx;
+     std::vector<indextype> r;
+     std::vector<indextype> c;
+     std::vector<T> v;
+    };
+    indextype nr,nc;
+    unsigned char duppolicy;
+    unsigned int nshards;
+    std::unique_ptr<Shard[]> shards;
+    Shard &MyShard();
+    void CheckPosition(indextype r,indextype c);
+};
+
+#endif // SPARSEBUILDER_H
@@ -20,6 +20,7 @@
 #define SPARSEMATRIX_H
 
 #include "jmatrix.h"
+#include "asyncwriter.h"
 
 #include <algorithm>    // std::sort, std::stable_sort
 
@@ -30,11 +31,19 @@ void sort_indexes_and_value(const std::vector<T> &v,std::vector<size_t> &idx,std
 
 enum TrMark { transpose=0 };
 
+template <typename T>
+class SparseMatrixBuilder;
+
+template <typename T>
+class FullMatrix;
+
 /**
  * @SparseMatrix Class to hold arbitrarily big sparse matrices. Elements are stored with column index + value in a vector associated to each row.\n
  *               Time to set and get elements are of order O(log_2(Nc)) being Nc the number of columns.\n
  *               Space is O(N*(sizeof(element)+sizeof(index)), being element the type of the matrix contents and index that of the matrix index
- *               (which is currently unsigned int).
+ *               (which is currently unsigned int, or unsigned short for matrices with at most SPARSE_IDX16_MAX_COLS columns).\n
+ *               A pattern-only matrix (see SetPatternOnly) stores just the column indices: all its non-zero entries are 1.
+ *               This is meant for presence/absence data, for which the distances based on set intersection (Jaccard, Hamming) are also provided.
  */
 template <typename T>
 class SparseMatrix: public JMatrix<T>
@@ -107,6 +116,16 @@ class SparseMatrix: public JMatrix<T>
      */
     SparseMatrix(const SparseMatrix& other);
 
+    /**
+     * Constructor from a full matrix, keeping its non-zero values. Each thread converts a range of rows: the non-zero values of a row
+     * are counted first, in a loop the compiler vectorises, so that the row is allocated once and then filled.
+     * Row and column names and comment are copied, too.
+     *
+     * @param[in] other    Reference to the FullMatrix to be converted
+     * @param[in] nthreads Number of threads (0 means as many as hardware threads)
+     */
+    SparseMatrix(FullMatrix<T>& other,unsigned int nthreads=0);
+
     /**
      * Destructor
      */
@@ -140,7 +159,7 @@ class SparseMatrix: public JMatrix<T>
      T Get(indextype r,indextype c) const;
     
     /** 
-     * Function to set an element
+     * Function to set an element. In pattern-only matrices any non-zero value marks the position as present (and it is read back as 1)
      * 
      * @param[in] r The row of the element to be set
      * @param[in] c The column of the element to be set
@@ -154,7 +173,7 @@ class SparseMatrix: public JMatrix<T>
      * 
      * @param[in]  r The row to be set
      * @param[in] vc The vector with the columns to be set
-     * @param[in]  v The vector with the corresponding values to be set. Must be the same length as vc
+     * @param[in]  v The vector with the corresponding values to be set. Must be the same length as vc. Ignored in pattern-only matrices
      * 
      */
      void SetRow(indextype r,std::vector<indextype> vc,std::vector<T> v);
@@ -197,6 +216,52 @@ class SparseMatrix: public JMatrix<T>
       * 
       */
      void GetMarksOfSparseRow(indextype r,unsigned char *m,unsigned char s);
+
+     /**
+      * Function to turn the matrix into a pattern-only matrix, which keeps only the positions of its non-zero entries (all of them are 1 from then on)
+      * and frees the memory of the values, or to turn a pattern-only matrix back into a normal one, whose non-zero entries are 1.
+      *
+      * @param[in] on true to keep only the pattern, false to keep values again
+      */
+     void SetPatternOnly(bool on);
+
+     /**
+      * Function to know whether the matrix is pattern-only
+      *
+      * @return true if only the positions of the non-zero entries are stored
+      */
+     bool IsPatternOnly() const { return pattern; };
+
+     /**
+      * Function to get the number of columns in which two rows (of this or another sparse matrix with the same number of columns) both have non-zero entries.
+      * It works on the sorted column indices, without looking at the values, in O(n1+n2) or O(n1*log(n2)) if row r1 has much less entries than row r2.
+      *
+      * @param[in] r1    Row of this matrix
+      * @param[in] other The matrix with the other row (it may be this same matrix)
+      * @param[in] r2    Row of other
+      * @return The size of the intersection of the sets of non-zero columns of both rows
+      */
+     indextype RowIntersection(indextype r1,const SparseMatrix<T> &other,indextype r2) const;
+
+     /**
+      * Function to get the Jaccard distance, 1-|intersection(A,B)|/|union(A,B)|, between the sets A and B of non-zero columns of two rows (0 if both are empty)
+      *
+      * @param[in] r1    Row of this matrix
+      * @param[in] other The matrix with the other row (it may be this same matrix)
+      * @param[in] r2    Row of other
+      * @return The Jaccard distance, between 0 and 1
+      */
+     double JaccardDistance(indextype r1,const SparseMatrix<T> &other,indextype r2) const;
+
+     /**
+      * Function to get the Hamming distance between the patterns of two rows, which is the number of columns non-zero in only one of them
+      *
+      * @param[in] r1    Row of this matrix
+      * @param[in] other The matrix with the other row (it may be this same matrix)
+      * @param[in] r2    Row of other
+      * @return The number of columns in which one row has a non-zero entry and the other does not
+      */
+     indextype HammingDistance(indextype r1,const SparseMatrix<T> &other,indextype r2) const;
      
      /**
       * Function to alter the internal values of the matrix so that each row is normalized according to the requested normalization type
@@ -205,6 +270,7 @@ class SparseMatrix: public JMatrix<T>
       *
       * @param[in] ctype The requested type of normalization: rawn, log1 or log1n
       *
+      * Pattern-only matrices cannot be normalized.
       */
      void SelfRowNorm(std::string ctype);
      
@@ -215,6 +281,7 @@ class SparseMatrix: public JMatrix<T>
       *
       * @param[in] ctype The requested type of normalization: rawn, log1 or log1n
       *
+      * Pattern-only matrices cannot be normalized.
       */
      void SelfColNorm(std::string ctype);
      
@@ -234,12 +301,27 @@ class SparseMatrix: public JMatrix<T>
      *
      *  After the header comes the content as raw data, by rows, with this content for each row:
      *   - indextype ncr: number of non-zero entries of this row
-     *   - ncr values of indextype with the numbers of the columns of this row occupied by non-zero entries
-     *   - ncr elements of the current value type (the values of all non-zero entries of this row).
+     *   - ncr values with the numbers of the columns of this row occupied by non-zero entries. They are of indextype or,
+     *     if the matrix has at most SPARSE_IDX16_MAX_COLS columns, unsigned short (as recorded in the header, see SparseFormatForColumns).
+     *     If requested with JMatrixSetSparseEncoding, they are instead the number of bytes of the encoded indices followed by the varint-encoded gaps (SPARSE_VARINT)
+     *   - ncr elements of the current value type (the values of all non-zero entries of this row), except in pattern-only matrices,
+     *     which have no values (the header has the flag SPARSE_PATTERN).
      * 
      *  @param[in] fname The name of the file to write
      */
     void WriteBin(std::string fname);
+    
+    /**
+     * Function to write the matrix content to a binary file asynchronously. It returns immediately: the matrix is serialized
+     * in a background thread into a set of buffers which another thread writes to disk, so the caller can go on computing.\n
+     * The file is identical to the one written by WriteBin. The matrix must not be modified nor destroyed until the returned future is ready.
+     *
+     * @param[in] fname  The name of the file to write
+     * @param[in] direct If true, the file is written with O_DIRECT (bypassing the page cache) where available
+     * @param[in] nbufs  Number of buffers (2 for double buffering, 3 for triple buffering,...)
+     * @return A future whose value will be WRITE_OK, ERROR_OPENING_FILE_TO_WRITE or ERROR_WRITING_FILE
+     */
+    std::future<int> WriteBinAsync(std::string fname,bool direct=false,unsigned int nbufs=DEFAULT_ASYNC_NUM_BUFFERS);
      
     /**
      * Function to get memory in MB used by this sparse matrix (including values and additional indexes)
@@ -249,7 +331,14 @@ class SparseMatrix: public JMatrix<T>
     float GetUsedMemoryMB();
     
 private:
+    friend class SparseMatrixBuilder<T>;      // It fills the rows directly
+    void WriteBinContents(std::ostream &os);
+    void AllocateRows();
+    indextype RowSize(indextype r) const { return narrow ? indextype(datacols16[r].size()) : indextype(datacols[r].size()); };
+    bool narrow;                                        // If true, column indices are kept in datacols16 (and datacols is empty)
+    bool pattern;                                       // If true, only the column indices are kept and all rows of data are empty
     std::vector<std::vector<indextype>> datacols;
+    std::vector<std::vector<unsigned short>> datacols16;
     std::vector<std::vector<T>> data;
 };
 
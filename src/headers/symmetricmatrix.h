@@ -20,10 +20,16 @@
 #define SYMMETRICMATRIX_H
 
 #include "jmatrix.h"
+#include "asyncwriter.h"
 #include "memhelper.h"
 
 /// @file symmetricmatrix.h
 
+const indextype SYMMETRIC_TILE_SIZE=64;    /*!< Number of rows of the blocks in which the upper triangle is mirrored or checked when converting to or from full matrices */
+
+template <typename T>
+class FullMatrix;
+
 /**
  * @SymmetricMatrix Class to hold arbitrarily big symmetric square matrices. For a matrix of size NxN, only Nx(N+1)/2 elements are stored.
  */
@@ -107,6 +113,18 @@ class SymmetricMatrix: public JMatrix<T>
      */
     SymmetricMatrix(const SymmetricMatrix<T>& other);
 
+    /**
+     * Constructor from a square full matrix, keeping its lower triangle and main diagonal. Rows are copied by several threads.\n
+     * If check is true, the upper triangle is compared with the lower one, by blocks of SYMMETRIC_TILE_SIZE rows, and the program stops
+     * if the matrix is not symmetric. Otherwise the upper triangle is ignored.
+     * Row and column names and comment are copied, too.
+     *
+     * @param[in] other    Reference to the FullMatrix to be converted
+     * @param[in] check    Whether to check that the full matrix is symmetric
+     * @param[in] nthreads Number of threads (0 means as many as hardware threads)
+     */
+    SymmetricMatrix(FullMatrix<T>& other,bool check=false,unsigned int nthreads=0);
+
     /**
      * Destructor
      */
@@ -179,12 +197,24 @@ class SymmetricMatrix: public JMatrix<T>
     
     /**
      * Function to write the matrix content to a binary file\n
-     * See format at documentation of JMatrix::WriteBin
+     * See format at documentation of JMatrix::WriteBin. Floating point values are stored with the encoding set with JMatrixSetValueEncoding.
      * 
      * @param[in] fname The name of the file to write
      */
     void WriteBin(std::string fname);
     
+    /**
+     * Function to write the matrix content to a binary file asynchronously. It returns immediately: the matrix is serialized
+     * in a background thread into a set of buffers which another thread writes to disk, so the caller can go on computing.\n
+     * The file is identical to the one written by WriteBin. The matrix must not be modified nor destroyed until the returned future is ready.
+     *
+     * @param[in] fname  The name of the file to write
+     * @param[in] direct If true, the file is written with O_DIRECT (bypassing the page cache) where available
+     * @param[in] nbufs  Number of buffers (2 for double buffering, 3 for triple buffering,...)
+     * @return A future whose value will be WRITE_OK, ERROR_OPENING_FILE_TO_WRITE or ERROR_WRITING_FILE
+     */
+    std::future<int> WriteBinAsync(std::string fname,bool direct=false,unsigned int nbufs=DEFAULT_ASYNC_NUM_BUFFERS);
+    
     /**
      * Function to get memory in MB used by this symmetric matrix
      * 
@@ -193,6 +223,9 @@ class SymmetricMatrix: public JMatrix<T>
     float GetUsedMemoryMB();
     
  private:
+     friend class FullMatrix<T>;             // Its converting constructor reads the rows directly
+     void WriteBinContents(std::ostream &os);
+     void SetValueCodec();
      std::vector< std::vector<T> > data;
 };
 
@@ -58,6 +58,21 @@ template B<float>::B(C,D); \
 template B<double>::B(C,D); \
 template B<long double>::B(C,D);
 
+#define TEMPLATES_CONVERT_CONST(A,B,D) \
+template A<unsigned char>::A(B<unsigned char>& other,D); \
+template A<char>::A(B<char>& other,D); \
+template A<unsigned short>::A(B<unsigned short>& other,D); \
+template A<short>::A(B<short>& other,D); \
+template A<unsigned int>::A(B<unsigned int>& other,D); \
+template A<int>::A(B<int>& other,D); \
+template A<unsigned long>::A(B<unsigned long>& other,D); \
+template A<long>::A(B<long>& other,D); \
+template A<unsigned long long>::A(B<unsigned long long>& other,D); \
+template A<long long>::A(B<long long>& other,D); \
+template A<float>::A(B<float>& other,D); \
+template A<double>::A(B<double>& other,D); \
+template A<long double>::A(B<long double>& other,D);
+
 #define TEMPLATES_DEFAULT_DEST(B) \
 template B<unsigned char>::~B(); \
 template B<char>::~B(); \
@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TRACING_H
+#define _TRACING_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+
+/// @file tracing.h
+
+/*!
+ * Sets tracing of the phases of the long operations of the library (loads, writes, csv conversion and extractions) ON or OFF.\n
+ * Spans are kept in memory and written as a Chrome trace (JSON, to be opened with chrome://tracing or https://ui.perfetto.dev)
+ * when tracing is set to OFF or the program ends, even through JMatrixStop.\n
+ * Tracing can also be set ON without changing the program by setting the environment variable JMATRIX_TRACE to the name of the trace file.
+ * When it is OFF, the cost of each span is the test of a flag.
+ *
+ * @param[in] fname Name of the file to write the trace to. The empty string sets tracing OFF and writes the trace collected so far.
+ */
+void JMatrixSetTrace(std::string fname);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+extern std::atomic<bool> JTraceOn;
+
+void JTraceEmit(const char *name,long long start,long long end);
+
+inline long long JTraceNow()
+{
+ return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A span of the trace, from construction to destruction. Next ends it and starts another one at the same nesting level,
+// which is handy for the successive phases of a function. Names must be string literals.
+class JMatrixTraceSpan
+{
+ public:
+    JMatrixTraceSpan(const char *name) { Start(name); };
+    ~JMatrixTraceSpan() { End(); };
+    void Next(const char *name) { End(); Start(name); };
+    void End() { if (active) { JTraceEmit(name,start,JTraceNow()); active=false; } };
+ private:
+    const char *name;
+    long long start;
+    bool active;
+    void Start(const char *name) { this->name=name; active=JTraceOn.load(std::memory_order_relaxed); if (active) start=JTraceNow(); };
+};
+#endif
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VALUECODEC_H
+#define VALUECODEC_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "iostats.h"
+
+/// @file valuecodec.h
+
+///@{
+/**
+ *        Constants for the possible encodings of the values of full and symmetric matrices in a binary file.
+ *         Values may be stored with fewer bits than those of the data type declared in the header, which is still the type of the matrix
+ *         that reads them: they are converted back to it when read. This cuts the size of the file, and the amount of data read, 2 to 4 times
+ *         for float matrices (4 to 8 times for double) when the full precision is not needed, as happens with the dissimilarities used just to compare distances.\n
+ *         The encoding is recorded in the header, at byte VALUE_ENCODING_POS, followed by the scale and the offset of the quantised encodings.
+ *
+ */
+const unsigned char VALUE_NATIVE=0x00;		/*!< Values stored as the data type of the matrix. The only encoding of the files written by former versions */
+const unsigned char VALUE_HALF=0x01;		/*!< IEEE-754 half precision floats (16 bits: 5 of exponent, 10 of mantissa). Range up to 65504, 3 significant digits */
+const unsigned char VALUE_BFLOAT16=0x02;	/*!< bfloat16 (16 bits: the upper half of a float, 8 of exponent and 7 of mantissa). Range of a float, 2 significant digits */
+const unsigned char VALUE_Q8=0x03;		/*!< Unsigned 8-bit integers q, being the value offset+scale*q */
+const unsigned char VALUE_Q16=0x04;		/*!< Unsigned 16-bit integers q, being the value offset+scale*q */
+///@}
+
+/**
+ * @ValueCodec The encoding of the values of a matrix in a binary file, with the scale and offset that turn the integers of the quantised encodings into values.\n
+ *             When it is read from a file it also holds the data type of the stored values, so that they can be converted to that of a matrix of another type.
+ */
+struct ValueCodec
+{
+ unsigned char enc=VALUE_NATIVE;
+ double scale=1.0;
+ double offset=0.0;
+ unsigned char stype=0x0F;      // Data type of the stored values (one of the ...TYPE constants), or NOTYPE (0x0F) if it is that of the matrix
+};
+
+/**
+ * Returns the name of the encoding whose identifier is passed
+ *
+ * @param enc. The encoding, as defined by the VALUE_... constants
+ * @return A human-meaningful string describing the encoding
+ */
+std::string ValueEncodingName(unsigned char enc);
+
+/**
+ * Returns the encoding whose name (native, half, bfloat16, q8 or q16) is passed
+ *
+ * @param name. The name of the encoding
+ * @return One of the VALUE_... constants, or NOTYPE if the name is not known
+ */
+unsigned char ValueEncodingFromName(std::string name);
+
+/**
+ * Returns the number of bytes taken in a binary file by each value of a matrix
+ *
+ * @param vc.    The encoding of the values
+ * @param tsize. The size of the data type of the matrix, which is the size of the values not encoded unless vc says they are stored as another type
+ * @return The size in bytes of one stored value
+ */
+size_t ValueSize(const ValueCodec &vc,size_t tsize);
+
+/**
+ * Sets the encoding of the values of the floating point full and symmetric matrices written to binary files from now on (with WriteBin, WriteBinAsync,
+ * JMatrixWriter or JMatGenerate). Other matrices, and matrices of integer types, are always written as they are. Files are read with any encoding,
+ * whatever this setting is, and their values are converted back to the type of the matrix. Default is VALUE_NATIVE (no encoding).\n
+ * Values are rounded to the nearest one that can be represented. Quantised encodings map the range [minv,maxv] to 256 (VALUE_Q8) or 65536 (VALUE_Q16)
+ * equally spaced values, and values out of it are clamped to its limits. If no range is given here (minv>=maxv) the range of the values of each matrix is used
+ * when the whole matrix is written at once, and the one given to JMatrixWriter::SetValueRange when it is written row by row.
+ *
+ * @param[in] enc  One of the VALUE_... constants
+ * @param[in] minv Lowest value of the range of quantised encodings
+ * @param[in] maxv Highest value of the range of quantised encodings
+ */
+void JMatrixSetValueEncoding(unsigned char enc,double minv=0.0,double maxv=0.0);
+
+/**
+ * Returns whether the values of a matrix of data type ctype would be written with a quantised encoding for which JMatrixSetValueEncoding gave no range,
+ * so that the writer must find it out (or be given it) before calling ValueWriteCodec
+ *
+ * @param ctype. The data type of the matrix (one of the ...TYPE constants)
+ * @return true if ValueWriteCodec needs the range of the values
+ */
+bool ValueWriteNeedsRange(unsigned char ctype);
+
+/**
+ * Returns the encoding with which the values of a full or symmetric matrix of data type ctype are written, as set with JMatrixSetValueEncoding
+ *
+ * @param ctype. The data type of the matrix (one of the ...TYPE constants)
+ * @param minv.  Lowest of its values, used by quantised encodings when JMatrixSetValueEncoding gave no range
+ * @param maxv.  Highest of its values, used by quantised encodings when JMatrixSetValueEncoding gave no range
+ * @return The encoding, with its scale and offset (the program stops if a range is needed and minv>maxv)
+ */
+ValueCodec ValueWriteCodec(unsigned char ctype,double minv=1.0,double maxv=0.0);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+// Tells whether values stored as vc are exactly those of type T, so that they can be copied without any conversion
+template <typename T>
+bool ValueIsRaw(const ValueCodec &vc);
+
+// Converts n values encoded as vc at src to the type T. src needs no particular alignment.
+template <typename T>
+void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,T *v);
+
+// Encodes the n values at v as vc, leaving them at dst, which must have room for n*ValueSize(vc,sizeof(T)) bytes
+template <typename T>
+void EncodeValues(const ValueCodec &vc,const T *v,size_t n,unsigned char *dst);
+
+// Reads n values of a row stored with encoding vc and converts them to T
+template <typename T>
+inline void ReadValues(std::istream &f,const ValueCodec &vc,size_t n,T *v)
+{
+ if (ValueIsRaw<T>(vc))
+ {
+  f.read((char *)v,(std::streamsize)(n*sizeof(T)));
+  JStatRead(n*sizeof(T));
+  return;
+ }
+ static thread_local std::vector<unsigned char> enc;
+ size_t nbytes=n*ValueSize(vc,sizeof(T));
+ enc.resize(nbytes);
+ f.read((char *)enc.data(),(std::streamsize)nbytes);
+ JStatRead(nbytes);
+ DecodeValues(vc,enc.data(),n,v);
+}
+
+// Writes n values of a row with encoding vc
+template <typename T>
+inline void WriteValues(std::ostream &f,const ValueCodec &vc,const T *v,size_t n)
+{
+ if (vc.enc==VALUE_NATIVE)
+ {
+  f.write((const char *)v,(std::streamsize)(n*sizeof(T)));
+  JStatWrite(n*sizeof(T));
+  return;
+ }
+ static thread_local std::vector<unsigned char> enc;
+ size_t nbytes=n*ValueSize(vc,sizeof(T));
+ enc.resize(nbytes);
+ EncodeValues(vc,v,n,enc.data());
+ f.write((const char *)enc.data(),(std::streamsize)nbytes);
+ JStatWrite(nbytes);
+}
+#endif
+
+#endif // VALUECODEC_H
@@ -0,0 +1,239 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include "../headers/asyncwriter.h"
+#include "../headers/jmatrix.h"
+
+extern unsigned char DEB;
+
+AsyncWriteBuf::AsyncWriteBuf(size_t bufsize,unsigned int nbufs)
+{
+ if (nbufs<2)
+  nbufs=2;
+ // Buffers are aligned and of a size multiple of the alignment, so that full buffers can always be written with O_DIRECT
+ this->bufsize=((bufsize+DIRECT_IO_ALIGNMENT-1)/DIRECT_IO_ALIGNMENT)*DIRECT_IO_ALIGNMENT;
+ if (this->bufsize==0)
+  this->bufsize=DIRECT_IO_ALIGNMENT;
+ for (unsigned int i=0;i<nbufs;i++)
+ {
+  void *p=nullptr;
+  if (posix_memalign(&p,DIRECT_IO_ALIGNMENT,this->bufsize)!=0)
+   JMatrixStop("AsyncWriteBuf: cannot allocate memory for the write buffers.\n");
+  buffers.push_back((char *)p);
+  buflens.push_back(0);
+ }
+ current=0;
+ finishing=false;
+ isopen=false;
+ status=WRITE_OK;
+ fd=-1;
+ direct=false;
+ handedoff=0;
+}
+
+//////////////////////////////////////////////////////////////////
+
+AsyncWriteBuf::~AsyncWriteBuf()
+{
+ if (isopen)
+  Close();
+ for (size_t i=0;i<buffers.size();i++)
+  free(buffers[i]);
+}
+
+//////////////////////////////////////////////////////////////////
+
+int AsyncWriteBuf::Open(std::string fname,bool direct)
+{
+ if (isopen)
+  Close();
+
+ this->direct=false;
+#ifdef O_DIRECT
+ if (direct)
+ {
+  fd=open(fname.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT,0644);
+  if (fd>=0)
+   this->direct=true;
+  else if (DEB & DEBJM)
+   std::cout << "Direct I/O is not available for file " << fname << ". Using buffered I/O.\n";
+ }
+#else
+ if (direct && (DEB & DEBJM))
+  std::cout << "Direct I/O is not supported in this system. Using buffered I/O for file " << fname << ".\n";
+#endif
+ if (fd<0)
+  fd=open(fname.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+ if (fd<0)
+ {
+  status=ERROR_OPENING_FILE_TO_WRITE;
+  return status;
+ }
+
+ status=WRITE_OK;
+ finishing=false;
+ handedoff=0;
+ fullq.clear();
+ freeq.clear();
+ current=0;
+ for (unsigned int i=1;i<buffers.size();i++)
+  freeq.push_back(i);
+ setp(buffers[current],buffers[current]+bufsize);
+ isopen=true;
+
+ writer=std::thread(&AsyncWriteBuf::WriterLoop,this);
+
+ if (DEB & DEBJM)
+  std::cout << "Asynchronous writing to file " << fname << " with " << buffers.size() << " buffers of " << bufsize << " bytes" << (this->direct ? " and direct I/O.\n" : ".\n");
+
+ return WRITE_OK;
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Sends the buffer being filled to the writer thread and waits for a free one.
+void AsyncWriteBuf::HandOff()
+{
+ size_t len=size_t(pptr()-pbase());
+ if (len==0)
+  return;
+
+ std::unique_lock<std::mutex> lock(mtx);
+ buflens[current]=len;
+ fullq.push_back(current);
+ handedoff += len;
+ cv.notify_all();
+ cv.wait(lock,[this]{ return !freeq.empty(); });
+ current=freeq.front();
+ freeq.pop_front();
+ lock.unlock();
+
+ setp(buffers[current],buffers[current]+bufsize);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void AsyncWriteBuf::WriterLoop()
+{
+ while (true)
+ {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock,[this]{ return (!fullq.empty() || finishing); });
+  if (fullq.empty())
+   break;
+  unsigned int b=fullq.front();
+  fullq.pop_front();
+  bool ok=(status==WRITE_OK);
+  lock.unlock();
+
+  // After an error the remaining buffers are just discarded, so that the caller is never blocked.
+  if (ok)
+  {
+#ifdef O_DIRECT
+   // Only the last buffer may have a size which is not a multiple of the alignment. It is written without O_DIRECT.
+   if (direct && (buflens[b] % DIRECT_IO_ALIGNMENT != 0))
+   {
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) & ~O_DIRECT);
+    direct=false;
+   }
+#endif
+   const char *p=buffers[b];
+   size_t rem=buflens[b];
+   while (rem>0)
+   {
+    ssize_t w=write(fd,p,rem);
+    if (w<0)
+    {
+     if (errno==EINTR)
+      continue;
+     ok=false;
+     break;
+    }
+    p += w;
+    rem -= size_t(w);
+   }
+  }
+
+  lock.lock();
+  if (!ok)
+   status=ERROR_WRITING_FILE;
+  freeq.push_back(b);
+  cv.notify_all();
+ }
+}
+
+//////////////////////////////////////////////////////////////////
+
+int AsyncWriteBuf::Close()
+{
+ if (!isopen)
+  return status;
+
+ HandOff();
+ {
+  std::lock_guard<std::mutex> lock(mtx);
+  finishing=true;
+ }
+ cv.notify_all();
+ writer.join();
+
+ if (close(fd)!=0 && status==WRITE_OK)
+  status=ERROR_WRITING_FILE;
+ fd=-1;
+ isopen=false;
+ setp(nullptr,nullptr);
+
+ return status;
+}
+
+//////////////////////////////////////////////////////////////////
+
+std::streambuf::int_type AsyncWriteBuf::overflow(int_type ch)
+{
+ if (!isopen)
+  return traits_type::eof();
+ HandOff();
+ if (!traits_type::eq_int_type(ch,traits_type::eof()))
+ {
+  *pptr()=traits_type::to_char_type(ch);
+  pbump(1);
+ }
+ return traits_type::not_eof(ch);
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Buffers are handed off only when full (or at Close), so that O_DIRECT writes are always aligned. Errors are reported by Close.
+int AsyncWriteBuf::sync()
+{
+ return 0;
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Only the query of the current position, as done by tellp, is supported
+std::streampos AsyncWriteBuf::seekoff(std::streamoff off,std::ios_base::seekdir dir,std::ios_base::openmode which)
+{
+ if ((off!=0) || (dir!=std::ios_base::cur) || !(which & std::ios_base::out))
+  return std::streampos(std::streamoff(-1));
+ return std::streampos(std::streamoff(handedoff+(unsigned long long)(pptr()-pbase())));
+}
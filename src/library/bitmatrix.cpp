@@ -0,0 +1,421 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../headers/bitmatrix.h"
+
+extern unsigned char DEB;
+
+// Adds up the bits set in op(a[k],b[k]) along the nw words of two rows. Four accumulators let consecutive population counts overlap.
+template <typename Op>
+static inline unsigned long long BitRowReduce(const unsigned long long *a,const unsigned long long *b,size_t nw,Op op)
+{
+ unsigned long long s0=0,s1=0,s2=0,s3=0;
+ size_t k=0;
+ for (;k+4<=nw;k+=4)
+ {
+  s0+=BitCount(op(a[k],b[k]));
+  s1+=BitCount(op(a[k+1],b[k+1]));
+  s2+=BitCount(op(a[k+2],b[k+2]));
+  s3+=BitCount(op(a[k+3],b[k+3]));
+ }
+ for (;k<nw;k++)
+  s0+=BitCount(op(a[k],b[k]));
+ return s0+s1+s2+s3;
+}
+
+/****************************************
+  CONSTRUCTORS AND FUNCTIONS
+*****************************************/
+
+BitMatrix::BitMatrix() : JMatrix<unsigned char>(MTYPEBIT)
+{
+ nw=0;
+}
+
+//////////////////////////////////////////////////////////////////
+
+BitMatrix::BitMatrix(indextype nrows,indextype ncols) : JMatrix<unsigned char>(MTYPEBIT,nrows,ncols)
+{
+ nw=BitRowWords(ncols);
+ data.assign((size_t)nrows*nw,0ULL);
+}
+
+//////////////////////////////////////////////////////////////////
+
+BitMatrix::BitMatrix(const BitMatrix& other) : JMatrix<unsigned char>(other)
+{
+ nw=other.nw;
+ data=other.data;
+}
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+BitMatrix::BitMatrix(FullMatrix<T>& other) : JMatrix<unsigned char>(MTYPEBIT,other.GetNRows(),other.GetNCols())
+{
+ nw=BitRowWords(this->nc);
+ data.assign((size_t)this->nr*nw,0ULL);
+ std::vector<T> v(this->nc);
+ for (indextype r=0;r<this->nr;r++)
+ {
+  other.GetRow(r,v.data());
+  PackBitRow(v.data(),this->nc,data.data()+(size_t)r*nw);
+ }
+ std::vector<std::string> names=other.GetRowNames();
+ if (names.size()>0)
+  this->SetRowNames(names);
+ names=other.GetColNames();
+ if (names.size()>0)
+  this->SetColNames(names);
+ this->SetComment(other.GetComment());
+}
+
+template BitMatrix::BitMatrix(FullMatrix<unsigned char>& other);
+template BitMatrix::BitMatrix(FullMatrix<char>& other);
+template BitMatrix::BitMatrix(FullMatrix<unsigned short>& other);
+template BitMatrix::BitMatrix(FullMatrix<short>& other);
+template BitMatrix::BitMatrix(FullMatrix<unsigned int>& other);
+template BitMatrix::BitMatrix(FullMatrix<int>& other);
+template BitMatrix::BitMatrix(FullMatrix<unsigned long>& other);
+template BitMatrix::BitMatrix(FullMatrix<long>& other);
+template BitMatrix::BitMatrix(FullMatrix<unsigned long long>& other);
+template BitMatrix::BitMatrix(FullMatrix<long long>& other);
+template BitMatrix::BitMatrix(FullMatrix<float>& other);
+template BitMatrix::BitMatrix(FullMatrix<double>& other);
+template BitMatrix::BitMatrix(FullMatrix<long double>& other);
+
+//////////////////////////////////////////////////////////////////
+
+// Constructor to read from a binary file
+BitMatrix::BitMatrix(std::string fname) : JMatrix<unsigned char>(fname,MTYPEBIT)
+{
+ JMatrixOpScope opscope(STATS_LOAD);
+ JMatrixTraceSpan span("BitMatrix load");
+ JMatrixTraceSpan phase("allocate");
+ nw=BitRowWords(this->nc);
+ data.resize((size_t)this->nr*nw);
+ phase.Next("read data");
+ unsigned long long nbytes=(unsigned long long)data.size()*sizeof(unsigned long long);
+ this->ifile.read((char *)data.data(),(std::streamsize)nbytes);
+ if ((unsigned long long)this->ifile.gcount()!=nbytes)
+ {
+  std::string err="Unexpected end of file "+fname+" reading the rows of the bit matrix.\n";
+  JMatrixStop(err);
+ }
+ JStatRead(nbytes);
+ JStatRows(this->nr);
+ JStatElements((unsigned long long)this->nr*this->nc);
+ phase.End();
+
+ this->ReadMetadata();
+
+ this->ifile.close();
+
+ if (DEB & DEBJM)
+  std::cout << "Read bit matrix with size (" << this->nr << "," << this->nc << ")\n";
+}
+
+//////////////////////////////////////////////////////////////////
+
+void BitMatrix::Resize(indextype newnr,indextype newnc)
+{
+ ((JMatrix<unsigned char> *)this)->Resize(newnr,newnc);
+
+ nw=BitRowWords(this->nc);
+ data.assign((size_t)this->nr*nw,0ULL);
+
+ if (DEB & DEBJM)
+  std::cout << "Bit matrix resized to (" << this->nr << "," << this->nc << ")\n";
+}
+
+//////////////////////////////////////////////////////////////////
+
+BitMatrix& BitMatrix::operator=(const BitMatrix& other)
+{
+ ((JMatrix<unsigned char> *)this)->operator=((const JMatrix<unsigned char> &)other);
+
+ nw=other.nw;
+ data=other.data;
+
+ return *this;
+}
+
+//////////////////////////////////////////////////////////////////
+
+BitMatrix& BitMatrix::operator!=(const BitMatrix& other)
+{
+ ((JMatrix<unsigned char> *)this)->operator!=((const JMatrix<unsigned char> &)other);
+
+ nw=BitRowWords(this->nc);
+ data.assign((size_t)this->nr*nw,0ULL);
+ for (indextype r=0;r<other.nr;r++)
+ {
+  const unsigned long long *w=other.GetRowWords(r);
+  for (size_t k=0;k<other.nw;k++)
+  {
+   // Only the bits set are visited
+   unsigned long long b=w[k];
+   while (b!=0)
+   {
+    indextype c=indextype(k*BIT_WORD_BITS)+BitCount((b & (~b+1))-1);
+    data[(size_t)c*nw+r/BIT_WORD_BITS] |= 1ULL << (r%BIT_WORD_BITS);
+    b &= b-1;
+   }
+  }
+ }
+
+ return *this;
+}
+
+//////////////////////////////////////////////////////////////////
+
+#ifdef WITH_CHECKS_MATRIX
+unsigned char BitMatrix::Get(indextype r,indextype c) const
+{
+ if ((r>=this->nr) || (c>=this->nc))
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in BitMatrix::Get: at least one index (" << r << " or " << c << ") out of bounds.\n";
+  errst << "This matrix was of dimension (" << this->nr << " x " << this->nc << ")\n";
+  JMatrixStop(errst.str());
+ }
+ return (unsigned char)((data[r*nw+c/BIT_WORD_BITS] >> (c%BIT_WORD_BITS)) & 1ULL);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void BitMatrix::Set(indextype r,indextype c,unsigned char v)
+{
+ if ((r>=this->nr) || (c>=this->nc))
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in BitMatrix::Set: at least one index (" << r << " or " << c << ") out of bounds.\n";
+  errst << "This matrix was of dimension (" << this->nr << " x " << this->nc << ")\n";
+  JMatrixStop(errst.str());
+ }
+ unsigned long long m=1ULL << (c%BIT_WORD_BITS);
+ unsigned long long &w=data[r*nw+c/BIT_WORD_BITS];
+ w = (v!=0) ? (w | m) : (w & ~m);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void BitMatrix::GetRow(indextype r,T *v) const
+{
+#ifdef WITH_CHECKS_MATRIX
+ if (r>=this->nr)
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in BitMatrix::GetRow: the row index " << r << " is out of bounds.\n";
+  errst << "This matrix was of dimension (" << this->nr << " x " << this->nc << ")\n";
+  JMatrixStop(errst.str());
+ }
+#endif
+ UnpackBitRow(GetRowWords(r),this->nc,v);
+}
+
+template void BitMatrix::GetRow(indextype r,unsigned char *v) const;
+template void BitMatrix::GetRow(indextype r,char *v) const;
+template void BitMatrix::GetRow(indextype r,unsigned short *v) const;
+template void BitMatrix::GetRow(indextype r,short *v) const;
+template void BitMatrix::GetRow(indextype r,unsigned int *v) const;
+template void BitMatrix::GetRow(indextype r,int *v) const;
+template void BitMatrix::GetRow(indextype r,unsigned long *v) const;
+template void BitMatrix::GetRow(indextype r,long *v) const;
+template void BitMatrix::GetRow(indextype r,unsigned long long *v) const;
+template void BitMatrix::GetRow(indextype r,long long *v) const;
+template void BitMatrix::GetRow(indextype r,float *v) const;
+template void BitMatrix::GetRow(indextype r,double *v) const;
+template void BitMatrix::GetRow(indextype r,long double *v) const;
+
+//////////////////////////////////////////////////////////////////
+
+indextype BitMatrix::RowCount(indextype r) const
+{
+ const unsigned long long *w=GetRowWords(r);
+ return indextype(BitRowReduce(w,w,nw,[](unsigned long long a,unsigned long long) { return a; }));
+}
+
+//////////////////////////////////////////////////////////////////
+
+indextype BitMatrix::RowIntersection(indextype r1,const BitMatrix &other,indextype r2) const
+{
+#ifdef WITH_CHECKS_MATRIX
+ if ((r1>=this->nr) || (r2>=other.nr) || (this->nc!=other.nc))
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in BitMatrix::RowIntersection: at least one row index (" << r1 << " or " << r2 << ") out of bounds, or different number of columns.\n";
+  errst << "Matrices were of dimension (" << this->nr << " x " << this->nc << ") and (" << other.nr << " x " << other.nc << ")\n";
+  JMatrixStop(errst.str());
+ }
+#endif
+ return indextype(BitRowReduce(GetRowWords(r1),other.GetRowWords(r2),nw,[](unsigned long long a,unsigned long long b) { return a & b; }));
+}
+
+//////////////////////////////////////////////////////////////////
+
+double BitMatrix::JaccardDistance(indextype r1,const BitMatrix &other,indextype r2) const
+{
+#ifdef WITH_CHECKS_MATRIX
+ if (this->nc!=other.nc)
+  JMatrixStop("Runtime error in BitMatrix::JaccardDistance: the matrices have different number of columns.\n");
+#endif
+ const unsigned long long *a=GetRowWords(r1);
+ const unsigned long long *b=other.GetRowWords(r2);
+ // Intersection and union in the same pass over the words
+ unsigned long long ni=0,nu=0;
+ for (size_t k=0;k<nw;k++)
+ {
+  ni+=BitCount(a[k] & b[k]);
+  nu+=BitCount(a[k] | b[k]);
+ }
+ return (nu==0) ? 0.0 : 1.0-double(ni)/double(nu);
+}
+
+//////////////////////////////////////////////////////////////////
+
+indextype BitMatrix::HammingDistance(indextype r1,const BitMatrix &other,indextype r2) const
+{
+#ifdef WITH_CHECKS_MATRIX
+ if (this->nc!=other.nc)
+  JMatrixStop("Runtime error in BitMatrix::HammingDistance: the matrices have different number of columns.\n");
+#endif
+ return indextype(BitRowReduce(GetRowWords(r1),other.GetRowWords(r2),nw,[](unsigned long long a,unsigned long long b) { return a ^ b; }));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BitMatrix::WriteBin(std::string fname)
+{
+ JMatrixOpScope opscope(STATS_WRITEBIN);
+ JMatrixTraceSpan span("BitMatrix WriteBin");
+ ((JMatrix<unsigned char> *)this)->WriteBin(fname,MTYPEBIT);
+
+ if (DEB & DEBJM)
+ {
+  std::cout << "Writing binary matrix " << fname << " of (" << this->nr << "x" << this->nc << ")\n";
+  std::cout.flush();
+ }
+
+ WriteBinContents(this->ofile);
+
+ this->ofile.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes all that comes after the header: the packed rows, the metadata and the end-of-data offset.
+void BitMatrix::WriteBinContents(std::ostream &os)
+{
+ JMatrixTraceSpan phase("write data");
+ unsigned long long nbytes=(unsigned long long)data.size()*sizeof(unsigned long long);
+ os.write((const char *)data.data(),(std::streamsize)nbytes);
+ JStatWrite(nbytes);
+ JStatRows(this->nr);
+ JStatElements((unsigned long long)this->nr*this->nc);
+ phase.End();
+
+ unsigned long long endofbindata = (unsigned long long)os.tellp();
+
+ if (DEB & DEBJM)
+  std::cout << "End of block of binary data at offset " << endofbindata << "\n";
+
+ this->WriteMetadata(os);
+
+ os.write((const char *)&endofbindata,sizeof(unsigned long long));
+ JStatWrite(sizeof(unsigned long long));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::future<int> BitMatrix::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs)
+{
+ if (DEB & DEBJM)
+ {
+  std::cout << "Writing binary matrix " << fname << " of (" << this->nr << "x" << this->nc << ") asynchronously\n";
+  std::cout.flush();
+ }
+
+ return std::async(std::launch::async,[this,fname,direct,nbufs]()
+ {
+  JMatrixOpScope opscope(STATS_WRITEBIN);
+  JMatrixTraceSpan span("BitMatrix WriteBinAsync");
+  AsyncWriteBuf wb(DEFAULT_ASYNC_BUFFER_SIZE,nbufs);
+  int st=wb.Open(fname,direct);
+  if (st!=WRITE_OK)
+   return st;
+  std::ostream os(&wb);
+  this->WriteHeader(os,MTYPEBIT);
+  WriteBinContents(os);
+  return wb.Close();
+ });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BitMatrix::WriteCsv(std::string fname,char csep,bool withquotes)
+{
+ JMatrixOpScope opscope(STATS_WRITECSV);
+ JMatrixTraceSpan span("BitMatrix WriteCsv");
+ ((JMatrix<unsigned char> *)this)->WriteCsv(fname,csep,withquotes);
+
+ if ((this->nc==0) || (this->nr==0))
+ {
+  this->ofile.close();
+  return;
+ }
+
+ JMatrixTraceSpan phase("write rows");
+ indextype rns=this->rownames.size();
+ std::string line;
+ for (indextype r=0;r<this->nr;r++)
+ {
+  if (rns>0)
+   this->ofile << FixQuotes(this->rownames[r],withquotes) << csep;
+  else
+  {
+   if (withquotes)
+    this->ofile << "\"R" << r+1 << "\"";
+   else
+    this->ofile << "R" << r+1;
+   this->ofile << csep;
+  }
+
+  // Each row is built as a string of 0's and 1's with the separators, which is much faster than writing the values one by one
+  line.assign(2*(size_t)this->nc,csep);
+  for (indextype c=0;c<this->nc;c++)
+   line[2*(size_t)c]=char('0'+Get(r,c));
+  line[line.size()-1]='\n';
+  this->ofile << line;
+ }
+
+ JStatWrite((unsigned long long)this->ofile.tellp());
+ JStatRows(this->nr);
+ JStatElements((unsigned long long)this->nr*this->nc);
+ this->ofile.close();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float BitMatrix::GetUsedMemoryMB()
+{
+ std::cout << this->nr << " rows of " << nw << " words of " << sizeof(unsigned long long) << " bytes each with accounts for ";
+ return float(data.size())*float(sizeof(unsigned long long))/(1024.0*1024.0);
+}
@@ -16,7 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <thread>
 #include "../headers/fullmatrix.h"
+#include "../headers/sparsematrix.h"
+#include "../headers/symmetricmatrix.h"
 #include "../headers/templatemacros.h"
 
 extern unsigned char DEB;
@@ -97,10 +100,134 @@ TEMPLATES_COPY_CONST(FullMatrix)
 
 //////////////////////////////////////////////////////////////////
 
+template <typename T>
+FullMatrix<T>::FullMatrix(SparseMatrix<T>& other,unsigned int nthreads) : JMatrix<T>(MTYPEFULL,other.GetNRows(),other.GetNCols())
+{
+ JMatrixTraceSpan span("FullMatrix from sparse");
+
+ // Rows are allocated here but filled (and so touched for the first time) by the threads
+ data = new (std::nothrow) T* [this->nr];
+ if (data==nullptr)
+     JMatrixStop("Cannot allocate memory for pointer to rows.\n");
+ for (unsigned long r=0;r<this->nr;r++)
+ {
+     data[r] = new (std::nothrow) T[this->nc];
+     if (data[r]==nullptr)
+         JMatrixStop("Cannot allocate memory for at least one of the rows.\n");
+ }
+
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads>this->nr)
+  nthreads=(unsigned int)this->nr;
+ if (nthreads==0)
+  nthreads=1;
+
+ auto scatter=[&](indextype first,indextype last)
+ {
+  for (indextype r=first;r<last;r++)
+  {
+   std::fill(data[r],data[r]+this->nc,T(0));
+   other.GetRow(r,data[r]);
+  }
+ };
+
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(scatter,indextype((size_t(this->nr)*t)/nthreads),indextype((size_t(this->nr)*(t+1))/nthreads)));
+ scatter(0,indextype(size_t(this->nr)/nthreads));
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+
+ std::vector<std::string> names=other.GetRowNames();
+ if (names.size()>0)
+  this->SetRowNames(names);
+ names=other.GetColNames();
+ if (names.size()>0)
+  this->SetColNames(names);
+ this->SetComment(other.GetComment());
+}
+
+TEMPLATES_CONVERT_CONST(FullMatrix,SparseMatrix,unsigned int nthreads)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+FullMatrix<T>::FullMatrix(SymmetricMatrix<T>& other,unsigned int nthreads) : JMatrix<T>(MTYPEFULL,other.GetNRows(),other.GetNCols())
+{
+ JMatrixTraceSpan span("FullMatrix from symmetric");
+
+ data = new (std::nothrow) T* [this->nr];
+ if (data==nullptr)
+     JMatrixStop("Cannot allocate memory for pointer to rows.\n");
+ for (unsigned long r=0;r<this->nr;r++)
+ {
+     data[r] = new (std::nothrow) T[this->nc];
+     if (data[r]==nullptr)
+         JMatrixStop("Cannot allocate memory for at least one of the rows.\n");
+ }
+
+ // Blocks of rows go to the threads in turn, since the upper triangle of the first ones is longer
+ indextype nblocks=(this->nr+SYMMETRIC_TILE_SIZE-1)/SYMMETRIC_TILE_SIZE;
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads>nblocks)
+  nthreads=(unsigned int)nblocks;
+ if (nthreads==0)
+  nthreads=1;
+
+ auto mirror=[&](unsigned int t)
+ {
+  for (indextype b=t;b<nblocks;b+=nthreads)
+  {
+   indextype r0=b*SYMMETRIC_TILE_SIZE;
+   indextype r1=std::min(this->nr,r0+SYMMETRIC_TILE_SIZE);
+   for (indextype r=r0;r<r1;r++)
+    memcpy((void *)data[r],(const void *)other.data[r].data(),(r+1)*sizeof(T));
+   // Column c of the upper triangle of the block is in row c of the symmetric matrix, read sequentially.
+   // The block rows written meanwhile are few enough to stay in cache.
+   for (indextype c=r0+1;c<this->nc;c++)
+   {
+    const T *src=other.data[c].data();
+    indextype rl=std::min(r1,c);
+    for (indextype r=r0;r<rl;r++)
+     data[r][c]=src[r];
+   }
+  }
+ };
+
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(mirror,t));
+ mirror(0);
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+
+ std::vector<std::string> names=other.GetRowNames();
+ if (names.size()>0)
+  this->SetRowNames(names);
+ names=other.GetColNames();
+ if (names.size()>0)
+  this->SetColNames(names);
+ this->SetComment(other.GetComment());
+}
+
+TEMPLATES_CONVERT_CONST(FullMatrix,SymmetricMatrix,unsigned int nthreads)
+
+//////////////////////////////////////////////////////////////////
+
 template <typename T>
 void FullMatrix<T>::Resize(indextype newnr,indextype newnc)
 {
-   this->~FullMatrix();
+   // Only the rows are released: calling the destructor would destroy also the members of JMatrix (names, output file)
+   if (data!=nullptr)
+   {
+    for (unsigned long r=0;r<this->nr;r++)
+     if (data[r]!=nullptr)
+      delete[] data[r];
+    delete[] data;
+    data=nullptr;
+   }
 
    ((JMatrix<T> *)this)->Resize(newnr,newnc);
    
@@ -149,6 +276,9 @@ TEMPLATES_DEFAULT_DEST(FullMatrix)
 template <typename T>
 FullMatrix<T>::FullMatrix(std::string fname) : JMatrix<T>(fname,MTYPEFULL)
 {
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("FullMatrix load");
+    JMatrixTraceSpan phase("allocate");
     data = new (std::nothrow) T* [this->nr];
     if (data==nullptr)
      JMatrixStop("Cannot allocate memory for pointer to rows.\n");
@@ -158,22 +288,35 @@ FullMatrix<T>::FullMatrix(std::string fname) : JMatrix<T>(fname,MTYPEFULL)
         if (data[r]==nullptr)
             JMatrixStop("Cannot allocate memory for at least one of the rows.\n");
     }
+    phase.Next("read data");
     if (this->full_read_as_symmetric)
      for (indextype r=0;r<this->nr;r++)
-        this->ifile.read((char *)data[r],(r+1)*sizeof(T));           // Here we read only the first r+1 columns of row r, since this is
+     {
+        ReadValues(this->ifile,this->vcodec,r+1,data[r]);            // Here we read only the first r+1 columns of row r, since this is
                                                                      // what it is stored in the binary symmetric matrix we are reading....
+        JStatElements(r+1);
+     }
     else
      for (indextype r=0;r<this->nr;r++)
-        this->ifile.read((char *)data[r],this->nc*sizeof(T));
+     {
+        ReadValues(this->ifile,this->vcodec,this->nc,data[r]);
+     }
+    JStatRows(this->nr);
+    if (!this->full_read_as_symmetric)
+     JStatElements((unsigned long long)this->nr*this->nc);
+    phase.End();
       
     this->ReadMetadata();                  // This is exclusively used when reading from a binary file, not from a csv file
       
     this->ifile.close();
 
    if (this->full_read_as_symmetric)                // Here we have to fill the upper part of the full matrix by copying the lower part.
+   {
+    JMatrixTraceSpan fill("fill upper triangle");
     for (indextype r=0;r<this->nr;r++)
      for (indextype c=r+1;c<this->nc;c++)
       data[r][c]=data[c][r];
+   }
 
    if (DEB & DEBJM)
      std::cout << "Read full matrix with size (" << this->nr << "," << this->nc << ")\n";
@@ -187,6 +330,9 @@ TEMPLATES_CONST(FullMatrix,std::string fname)
 template <typename T>
 FullMatrix<T>::FullMatrix(std::string fname, bool warn) : JMatrix<T>(fname,MTYPEFULL)
 {
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("FullMatrix load");
+    JMatrixTraceSpan phase("allocate");
     if (warn)
      MemoryWarnings(this->nr,this->nc,sizeof(T));
     data = new (std::nothrow) T* [this->nr];
@@ -198,22 +344,35 @@ FullMatrix<T>::FullMatrix(std::string fname, bool warn) : JMatrix<T>(fname,MTYPE
         if (data[r]==nullptr)
             JMatrixStop("Cannot allocate memory for at least one of the rows.\n");
     }
+    phase.Next("read data");
     if (this->full_read_as_symmetric)
      for (indextype r=0;r<this->nr;r++)
-        this->ifile.read((char *)data[r],(r+1)*sizeof(T));           // Here we read only the first r+1 columns of row r, since this is
+     {
+        ReadValues(this->ifile,this->vcodec,r+1,data[r]);            // Here we read only the first r+1 columns of row r, since this is
                                                                      // what it is stored in the binary symmetric matrix we are reading....
+        JStatElements(r+1);
+     }
     else
      for (indextype r=0;r<this->nr;r++)
-        this->ifile.read((char *)data[r],this->nc*sizeof(T));
+     {
+        ReadValues(this->ifile,this->vcodec,this->nc,data[r]);
+     }
+    JStatRows(this->nr);
+    if (!this->full_read_as_symmetric)
+     JStatElements((unsigned long long)this->nr*this->nc);
+    phase.End();
 
     this->ReadMetadata();                  // This is exclusively used when reading from a binary file, not from a csv file
 
     this->ifile.close();
 
    if (this->full_read_as_symmetric)                // Here we have to fill the upper part of the full matrix by copying the lower part.
+   {
+    JMatrixTraceSpan fill("fill upper triangle");
     for (indextype r=0;r<this->nr;r++)
      for (indextype c=r+1;c<this->nc;c++)
       data[r][c]=data[c][r];
+   }
 
    if (DEB & DEBJM)
      std::cout << "Read full matrix with size (" << this->nr << "," << this->nc << ")\n";
@@ -280,12 +439,16 @@ TEMPLATES_OPERATOR(FullMatrix,!=)
 template <typename T>
 FullMatrix<T>::FullMatrix(std::string fname,unsigned char vtype,char csep) : JMatrix<T>(fname,MTYPEFULL,vtype,csep)
 {
+    JMatrixOpScope opscope(STATS_READCSV);
+    JMatrixTraceSpan span("FullMatrix load from csv");
+    JMatrixTraceSpan phase("count lines");
     std::string line;
     // This is just to know number of rows
     this->nr=0;
     while (!this->ifile.eof())
     {
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
             this->nr++;
     }
@@ -302,6 +465,7 @@ FullMatrix<T>::FullMatrix(std::string fname,unsigned char vtype,char csep) : JMa
         }
     }
     
+    phase.Next("allocate");
     data = new (std::nothrow) T* [this->nr];
     if (data==nullptr)
         JMatrixStop("Cannot allocate memory for pointer to rows.\n");
@@ -311,17 +475,20 @@ FullMatrix<T>::FullMatrix(std::string fname,unsigned char vtype,char csep) : JMa
         if (data[r]==nullptr)
          JMatrixStop("Cannot allocate memory for at least one of the rows.\n");
     }
+    phase.Next("parse lines");
     // Reposition pointer at the begin and re-read first (header) line
     // and no, seekg does not work (possibly, because we had reached the eof ???)
     this->ifile.close();
     this->ifile.open(fname.c_str());
     size_t p=0;
     getline(this->ifile,line);
+    JStatRead(line.size()+1);
     // No need to process first line here, it was done at the parent's class constructor
 
     while (!this->ifile.eof())
     {
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
         {
           if (!this->ProcessDataLineCsv(line,csep,data[p]))
@@ -346,6 +513,9 @@ FullMatrix<T>::FullMatrix(std::string fname,unsigned char vtype,char csep) : JMa
             std::cout << " instead of " << this->nr << ".\n";
     }
     
+    JStatRows(p);
+    JStatElements((unsigned long long)p*this->nc);
+
     // No call to ReadMetadata must be done here, since these data are NOT binary. The column names were read by the parent's class constructor
     // and the row names are stored as they are read by the former call to ProcessDataLine
     
@@ -539,6 +709,9 @@ TEMPLATES_FUNC(void,FullMatrix,SelfColNorm,std::string ctype)
 template <typename T>
 void FullMatrix<T>::WriteBin(std::string fname)
 {
+    JMatrixOpScope opscope(STATS_WRITEBIN);
+    JMatrixTraceSpan span("FullMatrix WriteBin");
+    SetValueCodec();
     ((JMatrix<T> *)this)->WriteBin(fname,MTYPEFULL);
     
     if (DEB & DEBJM)
@@ -547,28 +720,118 @@ void FullMatrix<T>::WriteBin(std::string fname)
      std::cout.flush();
     }
     
+    WriteBinContents(this->ofile);
+    
+    this->ofile.close();
+}
+
+TEMPLATES_FUNC(void,FullMatrix,WriteBin,std::string fname)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes all that comes after the header: the binary data, the metadata and the end-of-data offset.
+template <typename T>
+void FullMatrix<T>::WriteBinContents(std::ostream &os)
+{
+    JMatrixTraceSpan phase("write data");
     for (unsigned long r=0;r<this->nr;r++)
-        this->ofile.write((const char *)data[r],this->nc*sizeof(T));
+        WriteValues(os,this->vcodec,data[r],this->nc);
+    JStatRows(this->nr);
+    JStatElements((unsigned long long)this->nr*this->nc);
+    phase.End();
     
-    unsigned long long endofbindata = this->ofile.tellp();
+    unsigned long long endofbindata = (unsigned long long)os.tellp();
     
     if (DEB & DEBJM)
      std::cout << "End of block of binary data at offset " << endofbindata << "\n";
 
-    this->WriteMetadata();                // Here we must write the metadata at the end of the binary contents of the matrix
+    this->WriteMetadata(os);                // Here we must write the metadata at the end of the binary contents of the matrix
 
-    this->ofile.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    os.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    JStatWrite(sizeof(unsigned long long));
+}
+
+TEMPLATES_FUNC(void,FullMatrix,WriteBinContents,std::ostream &os)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Chooses the encoding of the values to be written, as set with JMatrixSetValueEncoding. Quantised encodings with no given range take that of the values.
+template <typename T>
+void FullMatrix<T>::SetValueCodec()
+{
+    double minv=1.0,maxv=0.0;
+    if (ValueWriteNeedsRange(this->TypeNameToId()))
+    {
+        minv=std::numeric_limits<double>::max();
+        maxv=std::numeric_limits<double>::lowest();
+        for (indextype r=0;r<this->nr;r++)
+            for (indextype c=0;c<this->nc;c++)
+            {
+                // NaN fails both comparisons, so it does not change the range
+                if (double(data[r][c])<minv)
+                    minv=double(data[r][c]);
+                if (double(data[r][c])>maxv)
+                    maxv=double(data[r][c]);
+            }
+        if (minv>maxv)
+            minv=maxv=0.0;
+    }
+    this->vcodec=ValueWriteCodec(this->TypeNameToId(),minv,maxv);
+}
+
+TEMPLATES_FUNC(void,FullMatrix,SetValueCodec,)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::future<int> FullMatrix<T>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs)
+{
+    if (DEB & DEBJM)
+    {
+     std::cout << "Writing binary matrix " << fname << " of (" << this->nr << "x" << this->nc << ") asynchronously\n";
+     std::cout.flush();
+    }
     
-    this->ofile.close();
+    // The encoding is chosen now, with the setting of the moment of the call
+    SetValueCodec();
+
+    // The serialization runs in its own thread and the disk writes in the writer thread of AsyncWriteBuf, so that the caller is not blocked at all.
+    return std::async(std::launch::async,[this,fname,direct,nbufs]()
+    {
+        JMatrixOpScope opscope(STATS_WRITEBIN);
+        JMatrixTraceSpan span("FullMatrix WriteBinAsync");
+        AsyncWriteBuf wb(DEFAULT_ASYNC_BUFFER_SIZE,nbufs);
+        int st=wb.Open(fname,direct);
+        if (st!=WRITE_OK)
+            return st;
+        std::ostream os(&wb);
+        this->WriteHeader(os,MTYPEFULL);
+        WriteBinContents(os);
+        return wb.Close();
+    });
 }
 
-TEMPLATES_FUNC(void,FullMatrix,WriteBin,std::string fname)
+template std::future<int> FullMatrix<unsigned char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<unsigned short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<unsigned int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<unsigned long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<unsigned long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<float>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> FullMatrix<long double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
 void FullMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
 {
+    JMatrixOpScope opscope(STATS_WRITECSV);
+    JMatrixTraceSpan span("FullMatrix WriteCsv");
     // Remember: this writes the header, even if there were no column names (then, the header will be "","C1","C2",...)
     ((JMatrix<T> *)this)->WriteCsv(fname,csep,withquotes);
     
@@ -581,6 +844,7 @@ void FullMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
     }
     
     int p = std::numeric_limits<T>::max_digits10;
+    JMatrixTraceSpan phase("write rows");
 
     // We have rows to write; otherwise we would have returned four lines ago...
     indextype rns=this->rownames.size();
@@ -603,6 +867,9 @@ void FullMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
      this->ofile << std::setprecision(p) << data[r][this->nc-1] << std::endl;
     }
 
+    JStatWrite((unsigned long long)this->ofile.tellp());
+    JStatRows(this->nr);
+    JStatElements((unsigned long long)this->nr*this->nc);
     this->ofile.close();
 }
 
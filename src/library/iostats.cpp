@@ -0,0 +1,120 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <iomanip>
+#include "../headers/iostats.h"
+
+thread_local JMatrixOpStats JStatCurrent={0,0,0,0,0,0,0,0,0};
+
+static thread_local unsigned int JStatDepth=0;
+
+static JMatrixOpStats JStatTotals[STATS_NUM_OPS];
+static std::mutex JStatMutex;
+
+static const std::string JStatNames[STATS_NUM_OPS]={"load","writebin","readcsv","writecsv","getrows","getcols","getdiag","generate","fileop"};
+
+JMatrixOpScope::JMatrixOpScope(unsigned char op,bool countcall)
+{
+ this->op=op;
+ this->countcall=countcall;
+ outer=(JStatDepth==0);
+ JStatDepth++;
+ if (outer)
+ {
+  JStatCurrent={0,0,0,0,0,0,0,0,0};
+  start=std::chrono::steady_clock::now();
+ }
+}
+
+//////////////////////////////////////////////////////////////////
+
+JMatrixOpScope::~JMatrixOpScope()
+{
+ JStatDepth--;
+ if (!outer)
+  return;
+
+ unsigned long long ns=(unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+
+ std::lock_guard<std::mutex> lock(JStatMutex);
+ JMatrixOpStats &t=JStatTotals[op];
+ if (countcall)
+  t.calls++;
+ t.bytesread += JStatCurrent.bytesread;
+ t.byteswritten += JStatCurrent.byteswritten;
+ t.readcalls += JStatCurrent.readcalls;
+ t.writecalls += JStatCurrent.writecalls;
+ t.seeks += JStatCurrent.seeks;
+ t.rows += JStatCurrent.rows;
+ t.elements += JStatCurrent.elements;
+ t.wallns += ns;
+}
+
+//////////////////////////////////////////////////////////////////
+
+void JMatrixGetStats(unsigned char op,JMatrixOpStats &st)
+{
+ std::lock_guard<std::mutex> lock(JStatMutex);
+ if (op>=STATS_NUM_OPS)
+  st={0,0,0,0,0,0,0,0,0};
+ else
+  st=JStatTotals[op];
+}
+
+//////////////////////////////////////////////////////////////////
+
+void JMatrixResetStats()
+{
+ std::lock_guard<std::mutex> lock(JStatMutex);
+ for (unsigned char op=0;op<STATS_NUM_OPS;op++)
+  JStatTotals[op]={0,0,0,0,0,0,0,0,0};
+}
+
+//////////////////////////////////////////////////////////////////
+
+std::string JMatrixStatsOpName(unsigned char op)
+{
+ return (op<STATS_NUM_OPS) ? JStatNames[op] : "unknown";
+}
+
+//////////////////////////////////////////////////////////////////
+
+void JMatrixPrintStats(std::ostream &os)
+{
+ std::ios_base::fmtflags flags=os.flags();
+ std::streamsize prec=os.precision();
+ os << std::left << std::setw(10) << "operation" << std::right
+    << std::setw(8) << "calls" << std::setw(16) << "bytes read" << std::setw(16) << "bytes written"
+    << std::setw(12) << "read calls" << std::setw(12) << "write calls" << std::setw(10) << "seeks"
+    << std::setw(12) << "rows" << std::setw(14) << "elements" << std::setw(12) << "time (ms)" << "\n";
+ for (unsigned char op=0;op<STATS_NUM_OPS;op++)
+ {
+  JMatrixOpStats st;
+  JMatrixGetStats(op,st);
+  if (st.calls==0)
+   continue;
+  os << std::left << std::setw(10) << JStatNames[op] << std::right
+     << std::setw(8) << st.calls << std::setw(16) << st.bytesread << std::setw(16) << st.byteswritten
+     << std::setw(12) << st.readcalls << std::setw(12) << st.writecalls << std::setw(10) << st.seeks
+     << std::setw(12) << st.rows << std::setw(14) << st.elements
+     << std::setw(12) << std::fixed << std::setprecision(3) << double(st.wallns)/1e6 << "\n";
+ }
+ os.flags(flags);
+ os.precision(prec);
+}
@@ -44,6 +44,12 @@ void MatrixType(std::string fname,unsigned char &mtype,unsigned char &ctype,unsi
  ifile.read((char *)header,HEADER_SIZE);
  ifile.close();
  
+ MatrixTypeFromHeader(header,mtype,ctype,endianness,mdinf,nrows,ncols);
+}
+
+// The same, but from a header that has already been read into memory by the caller (used by those who keep the file open)
+void MatrixTypeFromHeader(const unsigned char *header,unsigned char &mtype,unsigned char &ctype,unsigned char &endianness,unsigned char &mdinf,indextype &nrows,indextype &ncols)
+{
  mtype=header[0];
  ctype=header[1] & 0x0F;
  endianness=header[1] & 0xF0;
@@ -72,12 +78,12 @@ void MatrixType(std::string fname,unsigned char &mtype,unsigned char &ctype,unsi
  // Alternatively, this should work in all platforms, assuming the compiler aligns properly simple variable declarations,
  // i.e. we now use a variable instead of a pointer
  indextype t=0;              // This should be aligned, I hope..
- unsigned char *t1;
+ const unsigned char *t1;
  t1=header+2;
- memcpy((void *)&t,(void *)t1,size_t(sizeof(indextype)));
+ memcpy((void *)&t,(const void *)t1,size_t(sizeof(indextype)));
  nrows=t;
  t1=header+2+sizeof(indextype);
- memcpy((void *)&t,(void *)t1,size_t(sizeof(indextype)));
+ memcpy((void *)&t,(const void *)t1,size_t(sizeof(indextype)));
  ncols=t;
  t1=header+2+2*sizeof(indextype);
  mdinf=*t1;
@@ -141,6 +147,7 @@ JMatrix<T>::JMatrix(unsigned char mtype)
 {
  jmtype=mtype;
  jctype=NOTYPE;
+ sparseformat=SPARSE_IDX32;
  nr=nc=0;
  mdinfo=NO_METADATA;
  for (size_t i=0;i<COMMENT_SIZE;i++)
@@ -158,6 +165,7 @@ JMatrix<T>::JMatrix(unsigned char mtype,indextype nrows,indextype ncols)
 {
  jmtype=mtype;
  jctype=TypeNameToId();                 // TODO: WARNING. See if this call may provoke problems, as it does in constructor from csv file.
+ sparseformat=SPARSE_IDX32;
  nr=nrows;
  nc=ncols;
  mdinfo=NO_METADATA;
@@ -173,6 +181,8 @@ TEMPLATES_CONST(JMatrix,SINGLE_ARG(unsigned char mtype,indextype nrows,indextype
 template <typename T>
 JMatrix<T>::JMatrix(std::string fname,unsigned char mtype)
 {
+ JMatrixOpScope opscope(STATS_LOAD,false);
+ JMatrixTraceSpan span("read header");
  ifile.open(fname.c_str(),std::ios::binary);
  if (!ifile.is_open())
     {
@@ -202,18 +212,17 @@ JMatrix<T>::JMatrix(std::string fname,unsigned char mtype)
  unsigned char td;
  ifile.read((char *)(&td),1);
  
- size_t tds=SizeOfType(td);
- if (tds != sizeof(T))
+ // Values stored as another data type are converted to that of this matrix as they are read, row by row
+ if (SizeOfType(td & 0x0F)<0)
  {
     std::ostringstream errst;
-    
-    errst << "Matrix stored in file " << fname << " has data of different size than those of the matrix supposed to hold it.\n";
-    errst << "The stored matrix says to have elements of size " << tds << " whereas this matrix is declared to hold elements of size " << sizeof(T) << std::endl;
+    errst << "Matrix stored in file " << fname << " has data of an unknown type (" << int(td & 0x0F) << ").\n";
     JMatrixStop(errst.str());
  }
+ if (((td & 0x0F) != TypeNameToId()) && (DEB & DEBJM))
+  std::cout << "Values of the matrix stored in file " << fname << " are of type " << DataTypeName(td & 0x0F) << " and will be converted to " << DataTypeName(TypeNameToId()) << " as they are read.\n";
  
- // TODO: check this is OK, but.. how??
- jctype = td & 0x0F;
+ jctype = TypeNameToId();
  
  if ( (td & 0xF0) != ThisMachineEndianness() )
  {
@@ -228,15 +237,33 @@ JMatrix<T>::JMatrix(std::string fname,unsigned char mtype)
  ifile.read((char *)&nr,sizeof(indextype));
  ifile.read((char *)&nc,sizeof(indextype));
  ifile.read((char *)&mdinfo,sizeof(unsigned char));
+
+ // Next byte is the format of the rows of sparse matrices. It is 0 (SPARSE_IDX32) for other matrices and in files of former versions.
+ ifile.read((char *)&sparseformat,sizeof(unsigned char));
+ unsigned char iformat=sparseformat & SPARSE_INDEX_MASK;
+ if ((mt==MTYPESPARSE) && (iformat!=SPARSE_IDX32) && (iformat!=SPARSE_IDX16) && (iformat!=SPARSE_VARINT))
+ {
+  std::ostringstream errst;
+  errst << "Sparse matrix stored in file " << fname << " has rows in an unknown format (" << int(sparseformat) << "). It might have been written by a newer version of this library.\n";
+  JMatrixStop(errst.str());
+ }
  
+ // Then, the encoding of the values of full and symmetric matrices. It is also 0 (VALUE_NATIVE) in files of former versions.
+ unsigned char vbytes[VALUE_CODEC_END-VALUE_ENCODING_POS];
+ ifile.read((char *)vbytes,VALUE_CODEC_END-VALUE_ENCODING_POS);
+ vcodec=ValueCodecFromBytes(mt,vbytes);
+ vcodec.stype=td & 0x0F;
+
  // We read the rest of the header, which should be empty...
  unsigned char zero;
  bool empty=true;
- for (size_t i=0;i<HEADER_SIZE-3-2*sizeof(indextype);i++)
+ for (size_t i=0;i<HEADER_SIZE-VALUE_CODEC_END;i++)
  {
   ifile.read((char *)&zero,1);
   empty=(zero==0x00);
  }
+ // The header is counted as a single read of all its fields
+ JStatRead(HEADER_SIZE);
  if (!empty)
   JMatrixWarning("At least one byte in the (supposingly) empty part of the header is not 0.\n");
 }
@@ -441,8 +468,11 @@ template bool JMatrix<long double>::ProcessDataLineCsvForSymmetric(std::string l
 template <typename T>
 JMatrix<T>::JMatrix(std::string fname,unsigned char mtype,unsigned char valuetype,char csep)
 {
+ JMatrixOpScope opscope(STATS_READCSV,false);
+ JMatrixTraceSpan span("read csv header line");
  jmtype=mtype;
  jctype=valuetype;
+ sparseformat=SPARSE_IDX32;
   
  // In principle, csv files contain names for rows and columns, even row names could be empty srings...
  mdinfo = ROW_NAMES | COL_NAMES;
@@ -458,6 +488,7 @@ JMatrix<T>::JMatrix(std::string fname,unsigned char mtype,unsigned char valuetyp
  std::string first_line;
  
  getline(ifile,first_line);
+ JStatRead(first_line.size()+1);
  if (!ProcessFirstLineCsv(first_line,csep))
  {
      std::string err = "Incorrect format of first line of file "+fname+".\n";
@@ -490,6 +521,8 @@ JMatrix<T>::JMatrix( const JMatrix<T>& other )
  nr=other.nr;
  nc=other.nc;
  mdinfo=other.mdinfo;
+ sparseformat=other.sparseformat;
+ vcodec=other.vcodec;
  rownames=other.rownames;
  colnames=other.colnames;
  for (size_t i=0;i<COMMENT_SIZE;i++)
@@ -520,6 +553,8 @@ JMatrix<T>& JMatrix<T>::operator= ( const JMatrix<T>& other )
  nr=other.nr;
  nc=other.nc;
  mdinfo=other.mdinfo;
+ sparseformat=other.sparseformat;
+ vcodec=other.vcodec;
  rownames=other.rownames;
  colnames=other.colnames;
  for (size_t i=0;i<COMMENT_SIZE;i++)
@@ -546,6 +581,8 @@ JMatrix<T>& JMatrix<T>::operator!= ( const JMatrix<T>& other )
  // Number of rows and columns is swapped
  nr=other.nc;
  nc=other.nr;
+ sparseformat=other.sparseformat;
+ vcodec=other.vcodec;
  
  mdinfo=NO_METADATA;
  
@@ -592,6 +629,7 @@ TEMPLATES_OPERATOR(JMatrix,!=)
 template <typename T>
 void JMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
 {
+ JMatrixTraceSpan span("write csv header line");
  ofile.open(fname.c_str());
  if (!ofile.is_open())
  {
@@ -650,6 +688,18 @@ void JMatrix<T>::WriteBin(std::string fname,unsigned char mtype)
         std::string err = "Cannot open file "+fname+" to write the matrix.\n";
         JMatrixStop(err);
  }
+ WriteHeader(ofile,mtype);
+}
+
+TEMPLATES_FUNC(void,JMatrix,WriteBin,SINGLE_ARG(std::string fname,unsigned char mtype))
+
+//////////////////////////////////////////////////////////////////////////////////
+
+// Writes the header of the binary format to any output stream (the file of WriteBin or the buffer of an asynchronous write)
+template <typename T>
+void JMatrix<T>::WriteHeader(std::ostream &os,unsigned char mtype)
+{
+ JMatrixTraceSpan span("write header");
  unsigned char td=TypeNameToId();
  if (td==NOTYPE)
  {
@@ -661,20 +711,37 @@ void JMatrix<T>::WriteBin(std::string fname,unsigned char mtype)
  // We always write in the endianness of this machine, so we mark it.
  td |= ThisMachineEndianness();
  
- ofile.write((const char *)(&mtype),1);
- ofile.write((const char *)(&td),1);
- ofile.write((const char *)(&nr),sizeof(indextype));
- ofile.write((const char *)(&nc),sizeof(indextype));
- ofile.write((const char *)(&mdinfo),1);
+ os.write((const char *)(&mtype),1);
+ os.write((const char *)(&td),1);
+ os.write((const char *)(&nr),sizeof(indextype));
+ os.write((const char *)(&nc),sizeof(indextype));
+ os.write((const char *)(&mdinfo),1);
+ // For sparse matrices the chosen format is kept, since WriteBinContents must write the rows in it. The pattern-only flag is set by the caller.
+ unsigned char sformat = (mtype==MTYPESPARSE) ? (SparseWriteFormat(nc) | (sparseformat & SPARSE_PATTERN)) : SPARSE_IDX32;
+ if (mtype==MTYPESPARSE)
+  sparseformat=sformat;
+ os.write((const char *)(&sformat),1);
+
+ // The encoding of the values has been chosen by the WriteBin of full and symmetric matrices. The others are always written as they are.
+ unsigned char header[HEADER_SIZE];
+ memset((void *)header,0,HEADER_SIZE);
+ header[0]=mtype;
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+  ValueCodecToHeader(vcodec,header);
+ os.write((const char *)(header+VALUE_ENCODING_POS),VALUE_CODEC_END-VALUE_ENCODING_POS);
  
  // We fill the header with 0 up to the predetermined header size, which is 128 bytes.
  // This is to have room to change the header if some time in the future we decide we need other information
  unsigned char zero=0x00;
- for (size_t i=0;i<HEADER_SIZE-3-2*sizeof(indextype);i++)
-  ofile.write((const char *)(&zero),1);
+ for (size_t i=0;i<HEADER_SIZE-VALUE_CODEC_END;i++)
+ {
+  os.write((const char *)(&zero),1);
+ }
+ // The header is counted as a single write of all its fields
+ JStatWrite(HEADER_SIZE);
 }
 
-TEMPLATES_FUNC(void,JMatrix,WriteBin,SINGLE_ARG(std::string fname,unsigned char mtype))
+TEMPLATES_FUNC(void,JMatrix,WriteHeader,SINGLE_ARG(std::ostream &os,unsigned char mtype))
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -685,18 +752,24 @@ indextype JMatrix<T>::ReadNames(std::vector<std::string> &names)
  char b;
  
  indextype j=0;
+ unsigned long long nbytes=0;     // The block of names is counted as a single read of all its bytes
  do
  {
   b=char(ifile.get());
   
   if (ifile.eof())    // We have reached the end-of-file
+  {
+   JStatRead(nbytes);
    return ((j==0) ? READ_OK : ERROR_READING_STRINGS);
+  }
    
   if ((unsigned char)b==BLOCK_MARK)     // We have at the start between block of metadata
   {
    ifile.unget();
+   JStatRead(nbytes);
    return READ_OK;
   }
+  nbytes++;
   
   if (b==0x00)   // We have reached end of this name
   {
@@ -709,11 +782,15 @@ indextype JMatrix<T>::ReadNames(std::vector<std::string> &names)
    dummy[j]=b;         // Usual case: still reading characters
    j++;
    if (j>=MAX_LEN_NAME)
+   {
+    JStatRead(nbytes);
     return ERROR_READING_STRINGS;
+   }
   }
  } 
  while (!ifile.eof());
  
+ JStatRead(nbytes);
  return ERROR_READING_STRINGS;
 }
 
@@ -727,6 +804,7 @@ indextype JMatrix<T>::CheckSep()
  unsigned char dummy[BLOCKSEP_LEN];
  
  ifile.read((char *)dummy,BLOCKSEP_LEN);
+ JStatRead(BLOCKSEP_LEN);
  
  size_t i=0;
  while (i<BLOCKSEP_LEN && dummy[i]==BLOCKSEP[i])
@@ -740,10 +818,11 @@ TEMPLATES_FUNC(indextype,JMatrix,CheckSep,)
 //////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
-void JMatrix<T>::WriteNames(std::vector<std::string> &names)
+void JMatrix<T>::WriteNames(std::ostream &os,std::vector<std::string> &names)
 {
  char dummy[MAX_LEN_NAME+1];
  char *dummy2;
+ unsigned long long nbytes=0;
  
  for (size_t i=0; i<names.size(); i++)
  {
@@ -755,17 +834,21 @@ void JMatrix<T>::WriteNames(std::vector<std::string> &names)
   }
   else
    dummy2=dummy;
-  ofile.write((const char *)dummy2,strlen(dummy2)+1);   // +1 is because we want the final null character be copied, too.
+  os.write((const char *)dummy2,strlen(dummy2)+1);   // +1 is because we want the final null character be copied, too.
+  nbytes += strlen(dummy2)+1;
  }
+ // The block of names is counted as a single write of all its bytes
+ JStatWrite(nbytes);
 }
 
-TEMPLATES_FUNC(void,JMatrix,WriteNames,SINGLE_ARG(std::vector<std::string> &names))
+TEMPLATES_FUNC(void,JMatrix,WriteNames,SINGLE_ARG(std::ostream &os,std::vector<std::string> &names))
 
 /////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
 int JMatrix<T>::ReadMetadata()
 {
+ JMatrixTraceSpan span("read metadata");
  if (mdinfo == NO_METADATA)
   return READ_OK;
   
@@ -788,6 +871,7 @@ int JMatrix<T>::ReadMetadata()
  if (mdinfo & COMMENT)
  {
   ifile.read((char *)comment,COMMENT_SIZE);
+  JStatRead(COMMENT_SIZE);
   if (CheckSep() == ERROR_READING_SEP_MARK)
    return ERROR_READING_SEP_MARK;
  }
@@ -800,8 +884,9 @@ TEMPLATES_FUNC(int,JMatrix,ReadMetadata,)
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
-void JMatrix<T>::WriteMetadata()
+void JMatrix<T>::WriteMetadata(std::ostream &os)
 {
+ JMatrixTraceSpan span("write metadata");
  if (mdinfo == NO_METADATA)
   return;
 
@@ -809,29 +894,33 @@ void JMatrix<T>::WriteMetadata()
  {
   if (DEB & DEBJM)
    std::cout << "   Writing row names (" << rownames.size() << " strings written, from " << rownames[0] << " to " << rownames[rownames.size()-1] << ").\n";
-  WriteNames(rownames);
-  ofile.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  WriteNames(os,rownames);
+  os.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  JStatWrite(BLOCKSEP_LEN);
  }
 
  if ((mdinfo & COL_NAMES) && (colnames.size()>0))
  {
   if (DEB & DEBJM)
    std::cout << "   Writing column names (" << colnames.size() << " strings written, from " << colnames[0] << " to " << colnames[colnames.size()-1] << ").\n";
-  WriteNames(colnames);
-  ofile.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  WriteNames(os,colnames);
+  os.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  JStatWrite(BLOCKSEP_LEN);
  }
  
  if (mdinfo & COMMENT)
  {
   if (DEB & DEBJM)
    std::cout << "   Writing comment: " << comment << "\n";
-  ofile.write((const char *)comment,COMMENT_SIZE);
-  ofile.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  os.write((const char *)comment,COMMENT_SIZE);
+  JStatWrite(COMMENT_SIZE);
+  os.write((const char *)BLOCKSEP,BLOCKSEP_LEN);
+  JStatWrite(BLOCKSEP_LEN);
  }
  
 }
 
-TEMPLATES_FUNC(void,JMatrix,WriteMetadata,)
+TEMPLATES_FUNC(void,JMatrix,WriteMetadata,std::ostream &os)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -916,6 +1005,10 @@ unsigned char JMatrix<T>::TypeNameToId()
   return ULTYPE;  
  if (std::is_same<T,long>::value)
   return SLTYPE;  
+ if (std::is_same<T,unsigned long long>::value)
+  return ULLTYPE;
+ if (std::is_same<T,long long>::value)
+  return SLLTYPE;
  if (std::is_same<T,float>::value)
   return FTYPE;
  if (std::is_same<T,double>::value)
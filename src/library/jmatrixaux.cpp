@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
 #include "../headers/jmatrix.h"
 
 // Auxiliary functions:
@@ -75,6 +76,7 @@ std::string MatrixTypeName(unsigned char typeident)
         case MTYPEFULL:         return "FullMatrix";
         case MTYPESPARSE:       return "SparseMatrix";
         case MTYPESYMMETRIC:    return "SymmetricMatrix";
+        case MTYPEBIT:          return "BitMatrix";
         default:                return "UnknownTypeMatrix";
     }
 }
@@ -121,3 +123,181 @@ int SizeOfType(unsigned char typeident)
         default:        return -1;
     }
 }
+
+// Helper functions for the formats of the rows of sparse matrices
+static std::atomic<bool> SparseVarint(false);
+
+unsigned char SparseFormatForColumns(indextype ncols)
+{
+    return (ncols<=SPARSE_IDX16_MAX_COLS) ? SPARSE_IDX16 : SPARSE_IDX32;
+}
+
+void JMatrixSetSparseEncoding(bool varint)
+{
+    SparseVarint=varint;
+}
+
+unsigned char SparseWriteFormat(indextype ncols)
+{
+    return SparseVarint ? SPARSE_VARINT : SparseFormatForColumns(ncols);
+}
+
+size_t SparseIndexSize(unsigned char sformat)
+{
+    return ((sformat & SPARSE_INDEX_MASK)==SPARSE_IDX16) ? sizeof(unsigned short) : sizeof(indextype);
+}
+
+unsigned char SparseFormatFromHeader(const unsigned char *header)
+{
+    unsigned char sformat=header[SPARSE_FORMAT_POS];
+    unsigned char iformat=sformat & SPARSE_INDEX_MASK;
+    if ((header[0]==MTYPESPARSE) && (iformat!=SPARSE_IDX32) && (iformat!=SPARSE_IDX16) && (iformat!=SPARSE_VARINT))
+    {
+     std::ostringstream errst;
+     errst << "Sparse matrix has rows in an unknown format (" << int(sformat) << "). It might have been written by a newer version of this library.\n";
+     JMatrixStop(errst.str());
+    }
+    return sformat;
+}
+
+unsigned char SparseFormat(std::string fname)
+{
+    unsigned char header[HEADER_SIZE];
+    std::ifstream f(fname.c_str(),std::ios::binary);
+    if (!f.is_open())
+    {
+     std::string err="Cannot open file "+fname+" to read its header.\n";
+     JMatrixStop(err);
+    }
+    f.read((char *)header,HEADER_SIZE);
+    f.close();
+    return SparseFormatFromHeader(header);
+}
+
+// Helper functions for the encoding of the values of full and symmetric matrices
+ValueCodec ValueCodecFromBytes(unsigned char mtype,const unsigned char *p)
+{
+    ValueCodec vc;
+    // Other matrices, and files of former versions, have here zeros
+    if ((mtype!=MTYPEFULL) && (mtype!=MTYPESYMMETRIC))
+     return vc;
+    vc.enc=p[0];
+    if (vc.enc>VALUE_Q16)
+    {
+     std::ostringstream errst;
+     errst << "Matrix has values in an unknown encoding (" << int(vc.enc) << "). It might have been written by a newer version of this library.\n";
+     JMatrixStop(errst.str());
+    }
+    if ((vc.enc==VALUE_Q8) || (vc.enc==VALUE_Q16))
+    {
+     memcpy((void *)&vc.scale,(const void *)(p+VALUE_SCALE_POS-VALUE_ENCODING_POS),sizeof(double));
+     memcpy((void *)&vc.offset,(const void *)(p+VALUE_OFFSET_POS-VALUE_ENCODING_POS),sizeof(double));
+    }
+    return vc;
+}
+
+ValueCodec ValueCodecFromHeader(const unsigned char *header)
+{
+    ValueCodec vc=ValueCodecFromBytes(header[0],header+VALUE_ENCODING_POS);
+    vc.stype=header[1] & 0x0F;
+    return vc;
+}
+
+ValueCodec ValueCodecFromFile(std::string fname)
+{
+    unsigned char header[HEADER_SIZE];
+    std::ifstream f(fname.c_str(),std::ios::binary);
+    if (!f.is_open())
+    {
+     std::string err="Cannot open file "+fname+" to read its header.\n";
+     JMatrixStop(err);
+    }
+    f.read((char *)header,HEADER_SIZE);
+    f.close();
+    return ValueCodecFromHeader(header);
+}
+
+void ValueCodecToHeader(const ValueCodec &vc,unsigned char *header)
+{
+    header[VALUE_ENCODING_POS]=vc.enc;
+    if ((vc.enc==VALUE_Q8) || (vc.enc==VALUE_Q16))
+    {
+     memcpy((void *)(header+VALUE_SCALE_POS),(const void *)&vc.scale,sizeof(double));
+     memcpy((void *)(header+VALUE_OFFSET_POS),(const void *)&vc.offset,sizeof(double));
+    }
+}
+
+void ReadSparseRowHead(std::istream &f,unsigned char sformat,indextype &ncr,unsigned long long &ibytes)
+{
+    f.read((char *)&ncr,sizeof(indextype));
+    JStatRead(sizeof(indextype));
+    if ((sformat & SPARSE_INDEX_MASK)==SPARSE_VARINT)
+    {
+     indextype nb;
+     f.read((char *)&nb,sizeof(indextype));
+     JStatRead(sizeof(indextype));
+     ibytes=(unsigned long long)nb;
+    }
+    else
+     ibytes=(unsigned long long)ncr*SparseIndexSize(sformat);
+}
+
+void ReadSparseIndices(std::istream &f,unsigned char sformat,indextype ncr,unsigned long long ibytes,indextype *idx)
+{
+    sformat &= SPARSE_INDEX_MASK;
+    if (sformat==SPARSE_VARINT)
+    {
+     static thread_local std::vector<unsigned char> enc;
+     enc.resize(ibytes);
+     f.read((char *)enc.data(),(std::streamsize)ibytes);
+     JStatRead(ibytes);
+     if ((f.gcount()!=(std::streamsize)ibytes) || !DecodeSparseIndices(enc.data(),ibytes,ncr,idx))
+      JMatrixStop("Corrupted column indices of a sparse row stored in format SPARSE_VARINT.\n");
+     return;
+    }
+    f.read((char *)idx,(std::streamsize)ibytes);
+    JStatRead(ibytes);
+    if (sformat==SPARSE_IDX16)
+     WidenSparseIndices(idx,ncr);
+}
+
+bool DecodeSparseIndices(const unsigned char *src,size_t nbytes,indextype ncr,indextype *idx)
+{
+    const unsigned long long HIGHBITS=0x8080808080808080ULL;
+    size_t p=0;
+    indextype k=0,next=0;
+    unsigned long long w;
+    while (k<ncr)
+    {
+     // Fast path: when the next 8 bytes have no continuation bit, they are 8 complete one-byte gaps, which is the most common case
+     if ((k+8<=ncr) && (p+8<=nbytes))
+     {
+      memcpy((void *)&w,(const void *)(src+p),sizeof(unsigned long long));
+      if ((w & HIGHBITS)==0)
+      {
+       for (unsigned int b=0;b<8;b++)
+       {
+        idx[k+b]=next+indextype(src[p+b]);
+        next=idx[k+b]+1;
+       }
+       k+=8;
+       p+=8;
+       continue;
+      }
+     }
+     indextype g=0;
+     unsigned int shift=0;
+     do
+     {
+      if ((p>=nbytes) || (shift>=8*sizeof(indextype)))
+       return false;
+      g |= indextype(src[p] & 0x7F) << shift;
+      shift+=7;
+     }
+     while (src[p++] & 0x80);
+     idx[k]=next+g;
+     next=idx[k]+1;
+     k++;
+    }
+    return (p==nbytes);
+}
@@ -0,0 +1,467 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../headers/jmatrixreader.h"
+#include "../headers/matmetadata.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+/****************************************
+  TEMPLATED CONSTRUCTORS AND FUNCTIONS
+*****************************************/
+
+template <typename T>
+JMatrixReader<T>::JMatrixReader(std::string fname,size_t bufsize)
+{
+ this->fname=fname;
+ ifile.open(fname.c_str(),std::ios::binary);
+ if (!ifile.is_open())
+ {
+  std::string err="Cannot open file "+fname+" to read the matrix.\n";
+  JMatrixStop(err);
+ }
+
+ unsigned char header[HEADER_SIZE];
+ ifile.read((char *)header,HEADER_SIZE);
+ JStatRead((unsigned long long)ifile.gcount());
+ if (ifile.gcount()!=HEADER_SIZE)
+ {
+  std::string err="File "+fname+" is too short to contain a matrix header.\n";
+  JMatrixStop(err);
+ }
+
+ unsigned char ctype,endianness;
+ MatrixTypeFromHeader(header,mtype,ctype,endianness,mdinfo,nr,nc);
+
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+ {
+  std::string err="Matrix stored in file "+fname+" is of type "+MatrixTypeName(mtype)+", which cannot be read.\n";
+  JMatrixStop(err);
+ }
+ // Rows of pattern-only sparse matrices have no values; they are returned as 1
+ sformat=SparseFormatFromHeader(header);
+ pattern=((sformat & SPARSE_PATTERN)!=0);
+ sformat &= SPARSE_INDEX_MASK;
+ isize=SparseIndexSize(sformat);
+ // Values may be stored as another data type, or with fewer bytes than T in full and symmetric matrices; they are converted as each row is loaded.
+ // Bits can be returned as values of any type, too.
+ if (SizeOfType(ctype)<0)
+ {
+  std::ostringstream errst;
+  errst << "Matrix stored in file " << fname << " has data of an unknown type (" << int(ctype) << ").\n";
+  JMatrixStop(errst.str());
+ }
+ vcodec=ValueCodecFromHeader(header);
+ esize=ValueSize(vcodec,sizeof(T));
+ vsize = pattern ? 0 : esize;
+
+ if (endianness != ThisMachineEndianness())
+ {
+  std::string err;
+  err = "Matrix stored in file " +fname+" has different endianness to that of this machine, which is ";
+  err = err + ((ThisMachineEndianness() == BIGEND) ? "big endian.\n" : "little endian.\n");
+  err = err + "Changing endianness when reading is not yet implemented. Sorry.\n";
+  JMatrixStop(err);
+ }
+
+ // There is no point in a buffer bigger than the file (it grows later if a single row needs it)
+ unsigned long long fsize=GetFileSize(fname);
+ if ((unsigned long long)bufsize>fsize)
+  bufsize=size_t(fsize);
+ if (bufsize<HEADER_SIZE)
+  bufsize=HEADER_SIZE;
+ buf.resize(bufsize);
+ bufstart=HEADER_SIZE;
+ buflen=0;
+ pos=0;
+
+ // Rows of full and bit matrices have nc elements, rows of symmetric matrices at most nr. Sparse rows grow as needed, up to nc.
+ if ((mtype==MTYPEFULL) || (mtype==MTYPEBIT))
+  rowv.resize(nc);
+ if (mtype==MTYPEBIT)
+  roww.resize(BitRowWords(nc));
+ if (mtype==MTYPESYMMETRIC)
+  rowv.resize(nr);
+ rown=0;
+
+ if (mtype==MTYPESPARSE)
+  sparse_offsets.push_back(HEADER_SIZE);
+
+ currow=nr;            // No row loaded yet
+ nextrow=0;
+
+ if (DEB & DEBJM)
+  std::cout << "Opened " << MatrixTypeName(mtype) << " of (" << nr << "x" << nc << ") in file " << fname << " for streaming read with a buffer of " << buf.size() << " bytes.\n";
+}
+
+TEMPLATES_CONST(JMatrixReader,SINGLE_ARG(std::string fname,size_t bufsize))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+JMatrixReader<T>::~JMatrixReader()
+{
+ if (ifile.is_open())
+  ifile.close();
+}
+
+TEMPLATES_DEFAULT_DEST(JMatrixReader)
+
+//////////////////////////////////////////////////////////////////
+
+// Makes sure that at least need bytes are available in the buffer from pos on, reading from the file if needed.
+// Returns false if the file ends before that.
+template <typename T>
+bool JMatrixReader<T>::Ensure(size_t need)
+{
+ if (pos+need<=buflen)
+  return true;
+
+ // The part not yet consumed is moved to the beginning of the buffer
+ size_t rem=buflen-pos;
+ if (rem>0)
+  memmove(buf.data(),buf.data()+pos,rem);
+ bufstart+=pos;
+ pos=0;
+ buflen=rem;
+
+ if (need>buf.size())
+  buf.resize(need);
+
+ ifile.read(buf.data()+buflen,(std::streamsize)(buf.size()-buflen));
+ buflen+=(size_t)ifile.gcount();
+ JStatRead((unsigned long long)ifile.gcount());
+ if (ifile.eof())
+  ifile.clear();
+
+ return (need<=buflen);
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Places the reading position at the given offset of the file. If it is inside the buffer, no real seek is done.
+template <typename T>
+void JMatrixReader<T>::MoveTo(unsigned long long offset)
+{
+ if ((offset>=bufstart) && (offset<=bufstart+buflen))
+ {
+  pos=(size_t)(offset-bufstart);
+  return;
+ }
+ ifile.clear();
+ ifile.seekg((std::streampos)offset,std::ios::beg);
+ JStatSeek();
+ bufstart=offset;
+ buflen=0;
+ pos=0;
+}
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+unsigned long long JMatrixReader<T>::RowOffset(indextype r)
+{
+ unsigned long long rl=(unsigned long long)r;
+ switch (mtype)
+ {
+  case MTYPEFULL:      return HEADER_SIZE+rl*(unsigned long long)nc*esize;
+  case MTYPESYMMETRIC: return HEADER_SIZE+((rl*(rl+1))/2)*esize;
+  case MTYPEBIT:       return HEADER_SIZE+rl*(unsigned long long)roww.size()*sizeof(unsigned long long);
+  default: break;
+ }
+
+ // Sparse matrices: we jump from the last known row reading only its number of non-zero entries, and take note of each offset.
+ indextype ncr;
+ while (sparse_offsets.size()<=r)
+ {
+  MoveTo(sparse_offsets.back());
+  if (!Ensure(SparseRowHeadSize(sformat)))
+  {
+   std::ostringstream errst;
+   errst << "Unexpected end of file " << fname << " looking for the beginning of row " << sparse_offsets.size() << ".\n";
+   JMatrixStop(errst.str());
+  }
+  memcpy((void *)&ncr,(const void *)(buf.data()+pos),sizeof(indextype));
+  sparse_offsets.push_back(sparse_offsets.back()+SparseRowHeadSize(sformat)+RowIndexBytes(ncr)+(unsigned long long)ncr*vsize);
+ }
+ return sparse_offsets[r];
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Number of bytes of the column indices of the sparse row whose beginning (of SparseRowHeadSize bytes) is at pos in the buffer
+template <typename T>
+size_t JMatrixReader<T>::RowIndexBytes(indextype ncr)
+{
+ if (sformat!=SPARSE_VARINT)
+  return (size_t)ncr*isize;
+ indextype nb;
+ memcpy((void *)&nb,(const void *)(buf.data()+pos+sizeof(indextype)),sizeof(indextype));
+ return (size_t)nb;
+}
+
+TEMPLATES_FUNC(size_t,JMatrixReader,RowIndexBytes,indextype ncr)
+
+//////////////////////////////////////////////////////////////////
+
+// Reads row nextrow from the current position, which is supposed to be the beginning of it.
+template <typename T>
+void JMatrixReader<T>::ReadCurrentRow()
+{
+ std::ostringstream errst;
+ errst << "Unexpected end of file " << fname << " reading row " << nextrow << ".\n";
+
+ size_t nbytes,ibytes;
+ switch (mtype)
+ {
+  case MTYPEFULL:
+  case MTYPESYMMETRIC:
+   rown = (mtype==MTYPEFULL) ? nc : nextrow+1;
+   nbytes = (size_t)rown*esize;
+   if (!Ensure(nbytes))
+    JMatrixStop(errst.str());
+   DecodeValues(vcodec,(const unsigned char *)(buf.data()+pos),rown,rowv.data());
+   pos+=nbytes;
+   break;
+  case MTYPEBIT:
+   rown = nc;
+   nbytes = roww.size()*sizeof(unsigned long long);
+   if (!Ensure(nbytes))
+    JMatrixStop(errst.str());
+   memcpy((void *)roww.data(),(const void *)(buf.data()+pos),nbytes);
+   pos+=nbytes;
+   UnpackBitRow(roww.data(),nc,rowv.data());
+   break;
+  case MTYPESPARSE:
+   if (!Ensure(SparseRowHeadSize(sformat)))
+    JMatrixStop(errst.str());
+   memcpy((void *)&rown,(const void *)(buf.data()+pos),sizeof(indextype));
+   ibytes=RowIndexBytes(rown);
+   pos+=SparseRowHeadSize(sformat);
+   if (rown>nc)
+   {
+    std::ostringstream errst2;
+    errst2 << "Row " << nextrow << " of file " << fname << " says to have " << rown << " non-zero entries, but the matrix has only " << nc << " columns.\n";
+    JMatrixStop(errst2.str());
+   }
+   if (rowv.size()<rown)
+   {
+    rowv.resize(rown);
+    rowc.resize(rown);
+   }
+   nbytes = ibytes+(size_t)rown*vsize;
+   if (!Ensure(nbytes))
+    JMatrixStop(errst.str());
+   if (sformat==SPARSE_VARINT)
+   {
+    if (!DecodeSparseIndices((const unsigned char *)(buf.data()+pos),ibytes,rown,rowc.data()))
+    {
+     std::ostringstream errst2;
+     errst2 << "Corrupted column indices in row " << nextrow << " of file " << fname << ".\n";
+     JMatrixStop(errst2.str());
+    }
+   }
+   else
+   {
+    memcpy((void *)rowc.data(),(const void *)(buf.data()+pos),ibytes);
+    if (sformat==SPARSE_IDX16)
+     WidenSparseIndices(rowc.data(),rown);
+   }
+   pos+=ibytes;
+   if (pattern)
+    std::fill(rowv.begin(),rowv.begin()+rown,T(1));
+   else
+    DecodeValues(vcodec,(const unsigned char *)(buf.data()+pos),rown,rowv.data());
+   pos+=rown*vsize;
+   // Take note of the beginning of next row, if it was not known
+   if (sparse_offsets.size()==(size_t)nextrow+1)
+    sparse_offsets.push_back(bufstart+pos);
+   break;
+  default: break;
+ }
+ currow=nextrow;
+ nextrow++;
+}
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+bool JMatrixReader<T>::NextRow()
+{
+ if (nextrow>=nr)
+  return false;
+ ReadCurrentRow();
+ return true;
+}
+
+TEMPLATES_FUNC(bool,JMatrixReader,NextRow,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixReader<T>::SeekRow(indextype r)
+{
+ if (r>=nr)
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in JMatrixReader<T>::SeekRow: the row index " << r << " is out of bounds.\n";
+  errst << "The matrix in file " << fname << " has " << nr << " rows.\n";
+  JMatrixStop(errst.str());
+ }
+ MoveTo(RowOffset(r));
+ nextrow=r;
+ ReadCurrentRow();
+}
+
+TEMPLATES_FUNC(void,JMatrixReader,SeekRow,indextype r)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+DenseRowSpan<T> JMatrixReader<T>::GetDenseRow()
+{
+ if (mtype==MTYPESPARSE)
+  JMatrixStop("JMatrixReader<T>::GetDenseRow cannot be used with sparse matrices. Use GetSparseRow or GetRow instead.\n");
+ if (currow>=nr)
+  JMatrixStop("JMatrixReader<T>::GetDenseRow called before loading any row with NextRow or SeekRow.\n");
+ DenseRowSpan<T> ret;
+ ret.v=rowv.data();
+ ret.n=rown;
+ return ret;
+}
+
+template DenseRowSpan<unsigned char> JMatrixReader<unsigned char>::GetDenseRow();
+template DenseRowSpan<char> JMatrixReader<char>::GetDenseRow();
+template DenseRowSpan<unsigned short> JMatrixReader<unsigned short>::GetDenseRow();
+template DenseRowSpan<short> JMatrixReader<short>::GetDenseRow();
+template DenseRowSpan<unsigned int> JMatrixReader<unsigned int>::GetDenseRow();
+template DenseRowSpan<int> JMatrixReader<int>::GetDenseRow();
+template DenseRowSpan<unsigned long> JMatrixReader<unsigned long>::GetDenseRow();
+template DenseRowSpan<long> JMatrixReader<long>::GetDenseRow();
+template DenseRowSpan<unsigned long long> JMatrixReader<unsigned long long>::GetDenseRow();
+template DenseRowSpan<long long> JMatrixReader<long long>::GetDenseRow();
+template DenseRowSpan<float> JMatrixReader<float>::GetDenseRow();
+template DenseRowSpan<double> JMatrixReader<double>::GetDenseRow();
+template DenseRowSpan<long double> JMatrixReader<long double>::GetDenseRow();
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+SparseRowSpan<T> JMatrixReader<T>::GetSparseRow()
+{
+ if (mtype!=MTYPESPARSE)
+  JMatrixStop("JMatrixReader<T>::GetSparseRow can be used only with sparse matrices. Use GetDenseRow or GetRow instead.\n");
+ if (currow>=nr)
+  JMatrixStop("JMatrixReader<T>::GetSparseRow called before loading any row with NextRow or SeekRow.\n");
+ SparseRowSpan<T> ret;
+ ret.c=rowc.data();
+ ret.v=rowv.data();
+ ret.n=rown;
+ return ret;
+}
+
+template SparseRowSpan<unsigned char> JMatrixReader<unsigned char>::GetSparseRow();
+template SparseRowSpan<char> JMatrixReader<char>::GetSparseRow();
+template SparseRowSpan<unsigned short> JMatrixReader<unsigned short>::GetSparseRow();
+template SparseRowSpan<short> JMatrixReader<short>::GetSparseRow();
+template SparseRowSpan<unsigned int> JMatrixReader<unsigned int>::GetSparseRow();
+template SparseRowSpan<int> JMatrixReader<int>::GetSparseRow();
+template SparseRowSpan<unsigned long> JMatrixReader<unsigned long>::GetSparseRow();
+template SparseRowSpan<long> JMatrixReader<long>::GetSparseRow();
+template SparseRowSpan<unsigned long long> JMatrixReader<unsigned long long>::GetSparseRow();
+template SparseRowSpan<long long> JMatrixReader<long long>::GetSparseRow();
+template SparseRowSpan<float> JMatrixReader<float>::GetSparseRow();
+template SparseRowSpan<double> JMatrixReader<double>::GetSparseRow();
+template SparseRowSpan<long double> JMatrixReader<long double>::GetSparseRow();
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+const unsigned long long *JMatrixReader<T>::GetBitRowWords()
+{
+ if (mtype!=MTYPEBIT)
+  JMatrixStop("JMatrixReader<T>::GetBitRowWords can be used only with bit matrices. Use GetDenseRow, GetSparseRow or GetRow instead.\n");
+ if (currow>=nr)
+  JMatrixStop("JMatrixReader<T>::GetBitRowWords called before loading any row with NextRow or SeekRow.\n");
+ return roww.data();
+}
+
+TEMPLATES_FUNC(const unsigned long long *,JMatrixReader,GetBitRowWords,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixReader<T>::GetRow(T *v)
+{
+ if (currow>=nr)
+  JMatrixStop("JMatrixReader<T>::GetRow called before loading any row with NextRow or SeekRow.\n");
+ if (mtype==MTYPESPARSE)
+ {
+  for (indextype c=0;c<nc;c++)
+   v[c]=T(0);
+  for (indextype k=0;k<rown;k++)
+   v[rowc[k]]=rowv[k];
+ }
+ else
+ {
+  memcpy((void *)v,(const void *)rowv.data(),rown*sizeof(T));
+  for (indextype c=rown;c<nc;c++)
+   v[c]=T(0);
+ }
+}
+
+template void JMatrixReader<unsigned char>::GetRow(unsigned char *v);
+template void JMatrixReader<char>::GetRow(char *v);
+template void JMatrixReader<unsigned short>::GetRow(unsigned short *v);
+template void JMatrixReader<short>::GetRow(short *v);
+template void JMatrixReader<unsigned int>::GetRow(unsigned int *v);
+template void JMatrixReader<int>::GetRow(int *v);
+template void JMatrixReader<unsigned long>::GetRow(unsigned long *v);
+template void JMatrixReader<long>::GetRow(long *v);
+template void JMatrixReader<unsigned long long>::GetRow(unsigned long long *v);
+template void JMatrixReader<long long>::GetRow(long long *v);
+template void JMatrixReader<float>::GetRow(float *v);
+template void JMatrixReader<double>::GetRow(double *v);
+template void JMatrixReader<long double>::GetRow(long double *v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::vector<std::string> JMatrixReader<T>::GetRowNames()
+{
+ std::vector<std::string> rnames,cnames;
+ if (mdinfo & ROW_NAMES)
+  InternalGetBinNames(fname,ROW_NAMES,rnames,cnames);
+ return rnames;
+}
+
+TEMPLATES_FUNC(std::vector<std::string>,JMatrixReader,GetRowNames,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::vector<std::string> JMatrixReader<T>::GetColNames()
+{
+ std::vector<std::string> rnames,cnames;
+ if (mdinfo & COL_NAMES)
+  InternalGetBinNames(fname,COL_NAMES,rnames,cnames);
+ return cnames;
+}
+
+TEMPLATES_FUNC(std::vector<std::string>,JMatrixReader,GetColNames,)
@@ -0,0 +1,771 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "../headers/jmatrixwriter.h"
+#include "../headers/matinfo.h"
+#include "../headers/matmetadata.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+/****************************************
+  TEMPLATED CONSTRUCTORS AND FUNCTIONS
+*****************************************/
+
+template <typename T>
+JMatrixWriter<T>::JMatrixWriter(std::string fname,unsigned char mtype,indextype ncols,size_t bufsize)
+{
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+ {
+  std::string err="JMatrixWriter cannot write matrices of type "+MatrixTypeName(mtype)+".\n";
+  JMatrixStop(err);
+ }
+ if (TypeNameToId()==NOTYPE)
+  JMatrixStop("JMatrixWriter: the element type is not a valid data type.\n");
+
+ this->fname=fname;
+ this->mtype=mtype;
+ nr=0;
+ nc=ncols;
+ mdinfo=NO_METADATA;
+ sformat = (mtype==MTYPESPARSE) ? SparseWriteFormat(nc) : SPARSE_IDX32;
+ if (mtype==MTYPEBIT)
+  tmpw.resize(BitRowWords(nc));
+ // Values of sparse and bit matrices are never encoded. Quantised encodings without a fixed range wait for SetValueRange.
+ needrange=false;
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ {
+  needrange=ValueWriteNeedsRange(TypeNameToId());
+  if (!needrange)
+   vcodec=ValueWriteCodec(TypeNameToId());
+ }
+ for (size_t i=0;i<COMMENT_SIZE;i++)
+  comment[i]='\0';
+ closed=false;
+ appending=false;
+ nropen=0;
+
+ ofile.open(fname.c_str(),std::ios::binary);
+ if (!ofile.is_open())
+ {
+  std::string err = "Cannot open file "+fname+" to write the matrix.\n";
+  JMatrixStop(err);
+ }
+
+ if (bufsize<HEADER_SIZE)
+  bufsize=HEADER_SIZE;
+ buf.resize(bufsize);
+ buflen=0;
+ written=0;
+
+ // Provisional header. The number of rows and the metadata information are not known until Close.
+ unsigned char header[HEADER_SIZE];
+ memset((void *)header,0,HEADER_SIZE);
+ Put((const void *)header,HEADER_SIZE);
+
+ if (DEB & DEBJM)
+  std::cout << "Writing binary matrix " << fname << " of type " << MatrixTypeName(mtype) << " with " << nc << " columns row by row.\n";
+}
+
+TEMPLATES_CONST(JMatrixWriter,SINGLE_ARG(std::string fname,unsigned char mtype,indextype ncols,size_t bufsize))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+JMatrixWriter<T>::JMatrixWriter(std::string fname,size_t bufsize)
+{
+ if (TypeNameToId()==NOTYPE)
+  JMatrixStop("JMatrixWriter: the element type is not a valid data type.\n");
+
+ unsigned char ctype,endian;
+ MatrixType(fname,mtype,ctype,endian,mdinfo,nr,nc);
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+  JMatrixStop("JMatrixWriter cannot append rows to matrices of type "+MatrixTypeName(mtype)+".\n");
+ if (ctype!=((mtype==MTYPEBIT) ? UCTYPE : TypeNameToId()))
+  JMatrixStop("JMatrixWriter: the matrix in file "+fname+" is of type "+DataTypeName(ctype)+", and rows of type "+DataTypeName(TypeNameToId())+" cannot be appended to it.\n");
+ if (endian!=ThisMachineEndianness())
+  JMatrixStop("JMatrixWriter: rows cannot be appended to file "+fname+", whose endianness is not that of this machine.\n");
+
+ this->fname=fname;
+ sformat=(mtype==MTYPESPARSE) ? SparseFormat(fname) : SPARSE_IDX32;
+ if (sformat & SPARSE_PATTERN)
+  JMatrixStop("JMatrixWriter: rows cannot be appended to file "+fname+", which contains a pattern-only sparse matrix.\n");
+ if (mtype==MTYPEBIT)
+  tmpw.resize(BitRowWords(nc));
+ // New values are encoded as the former ones
+ needrange=false;
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+  vcodec=ValueCodecFromFile(fname);
+
+ if (mdinfo & ROW_NAMES)
+  InternalGetBinNames(fname,ROW_NAMES,rownames,colnames);
+ if (mdinfo & COL_NAMES)
+  InternalGetBinNames(fname,COL_NAMES,rownames,colnames);
+ unsigned long long endofbindata,start_comment;
+ PositionsInFile(fname,&endofbindata,&start_comment);
+ for (size_t i=0;i<COMMENT_SIZE;i++)
+  comment[i]='\0';
+ if (mdinfo & COMMENT)
+ {
+  std::ifstream f(fname.c_str(),std::ios::binary);
+  f.seekg(start_comment,std::ios::beg);
+  f.read(comment,COMMENT_SIZE);
+  comment[COMMENT_SIZE-1]='\0';
+ }
+ closed=false;
+ appending=true;
+ nropen=nr;
+
+ // Rows go where the binary data end, over the former metadata, which Close writes again after them
+ ofile.open(fname.c_str(),std::ios::binary | std::ios::in | std::ios::out);
+ if (!ofile.is_open())
+ {
+  std::string err = "Cannot open file "+fname+" to append rows to it.\n";
+  JMatrixStop(err);
+ }
+ ofile.seekp(std::streamoff(endofbindata),std::ios::beg);
+ written=endofbindata;
+
+ if (bufsize<HEADER_SIZE)
+  bufsize=HEADER_SIZE;
+ buf.resize(bufsize);
+ buflen=0;
+
+ if (DEB & DEBJM)
+  std::cout << "Appending rows to binary matrix " << fname << " of type " << MatrixTypeName(mtype) << " with " << nr << " rows and " << nc << " columns.\n";
+}
+
+TEMPLATES_CONST(JMatrixWriter,SINGLE_ARG(std::string fname,size_t bufsize))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+JMatrixWriter<T>::~JMatrixWriter()
+{
+ if (!closed)
+  Close();
+}
+
+TEMPLATES_DEFAULT_DEST(JMatrixWriter)
+
+//////////////////////////////////////////////////////////////////
+
+// Same identifiers as those of JMatrix<T>::TypeNameToId
+template <typename T>
+unsigned char JMatrixWriter<T>::TypeNameToId()
+{
+ if (std::is_same<T,unsigned char>::value)
+  return UCTYPE;
+ if (std::is_same<T,char>::value)
+  return SCTYPE;
+ if (std::is_same<T,unsigned short>::value)
+  return USTYPE;
+ if (std::is_same<T,short>::value)
+  return SSTYPE;
+ if (std::is_same<T,unsigned int>::value)
+  return UITYPE;
+ if (std::is_same<T,int>::value)
+  return SITYPE;
+ if (std::is_same<T,unsigned long>::value)
+  return ULTYPE;
+ if (std::is_same<T,long>::value)
+  return SLTYPE;
+ if (std::is_same<T,unsigned long long>::value)
+  return ULLTYPE;
+ if (std::is_same<T,long long>::value)
+  return SLLTYPE;
+ if (std::is_same<T,float>::value)
+  return FTYPE;
+ if (std::is_same<T,double>::value)
+  return DTYPE;
+ if (std::is_same<T,long double>::value)
+  return LDTYPE;
+
+ return NOTYPE;
+}
+
+TEMPLATES_FUNC(unsigned char,JMatrixWriter,TypeNameToId,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::Flush()
+{
+ if (buflen==0)
+  return;
+ ofile.write(buf.data(),(std::streamsize)buflen);
+ if (ofile.fail())
+ {
+  std::string err = "Error writing to file "+fname+". Is the disk full?\n";
+  JMatrixStop(err);
+ }
+ JStatWrite(buflen);
+ buflen=0;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,Flush,)
+
+//////////////////////////////////////////////////////////////////
+
+// Adds nbytes to the buffer, flushing it when full. Blocks bigger than the buffer go directly to the file.
+template <typename T>
+void JMatrixWriter<T>::Put(const void *p,size_t nbytes)
+{
+ written += nbytes;
+ if (buflen+nbytes>buf.size())
+ {
+  Flush();
+  if (nbytes>buf.size())
+  {
+   ofile.write((const char *)p,(std::streamsize)nbytes);
+   if (ofile.fail())
+   {
+    std::string err = "Error writing to file "+fname+". Is the disk full?\n";
+    JMatrixStop(err);
+   }
+   JStatWrite(nbytes);
+   return;
+  }
+ }
+ memcpy((void *)(buf.data()+buflen),p,nbytes);
+ buflen += nbytes;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,Put,SINGLE_ARG(const void *p,size_t nbytes))
+
+//////////////////////////////////////////////////////////////////
+
+// Adds the n column indices of a sparse row in the format of the matrix
+template <typename T>
+void JMatrixWriter<T>::PutIndices(indextype n,const indextype *c)
+{
+ if (sformat==SPARSE_VARINT)
+ {
+  tmpenc.clear();
+  EncodeSparseIndices(c,n,tmpenc);
+  indextype nb=indextype(tmpenc.size());
+  Put((const void *)&nb,sizeof(indextype));
+  Put((const void *)tmpenc.data(),nb);
+ }
+ else if (sformat==SPARSE_IDX16)
+ {
+  tmpc16.resize(n);
+  for (indextype k=0;k<n;k++)
+   tmpc16[k]=(unsigned short)c[k];
+  Put((const void *)tmpc16.data(),n*sizeof(unsigned short));
+ }
+ else
+  Put((const void *)c,n*sizeof(indextype));
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,PutIndices,SINGLE_ARG(indextype n,const indextype *c))
+
+//////////////////////////////////////////////////////////////////
+
+// Adds the n values of a row of a full or symmetric matrix with the encoding of the file
+template <typename T>
+void JMatrixWriter<T>::PutValues(indextype n,const T *v)
+{
+ if (needrange)
+ {
+  JMatrixWarning("JMatrixWriter: no range was given with SetValueRange for the quantised encoding of the values. They will be written without encoding.\n");
+  needrange=false;
+ }
+ if (vcodec.enc==VALUE_NATIVE)
+ {
+  Put((const void *)v,n*sizeof(T));
+  return;
+ }
+ size_t nbytes=n*ValueSize(vcodec,sizeof(T));
+ tmpenc.resize(nbytes);
+ EncodeValues(vcodec,v,n,tmpenc.data());
+ Put((const void *)tmpenc.data(),nbytes);
+}
+
+template void JMatrixWriter<unsigned char>::PutValues(indextype n,const unsigned char *v);
+template void JMatrixWriter<char>::PutValues(indextype n,const char *v);
+template void JMatrixWriter<unsigned short>::PutValues(indextype n,const unsigned short *v);
+template void JMatrixWriter<short>::PutValues(indextype n,const short *v);
+template void JMatrixWriter<unsigned int>::PutValues(indextype n,const unsigned int *v);
+template void JMatrixWriter<int>::PutValues(indextype n,const int *v);
+template void JMatrixWriter<unsigned long>::PutValues(indextype n,const unsigned long *v);
+template void JMatrixWriter<long>::PutValues(indextype n,const long *v);
+template void JMatrixWriter<unsigned long long>::PutValues(indextype n,const unsigned long long *v);
+template void JMatrixWriter<long long>::PutValues(indextype n,const long long *v);
+template void JMatrixWriter<float>::PutValues(indextype n,const float *v);
+template void JMatrixWriter<double>::PutValues(indextype n,const double *v);
+template void JMatrixWriter<long double>::PutValues(indextype n,const long double *v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::SetValueRange(double minv,double maxv)
+{
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESYMMETRIC))
+  return;
+ if ((nr>0) && needrange)
+  JMatrixStop("JMatrixWriter<T>::SetValueRange: the range of the values must be set before appending any row.\n");
+ if (!needrange)
+  return;
+ vcodec=ValueWriteCodec(TypeNameToId(),minv,maxv);
+ needrange=false;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,SetValueRange,SINGLE_ARG(double minv,double maxv))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::AppendRow(const T *v)
+{
+ if (closed)
+  JMatrixStop("JMatrixWriter<T>::AppendRow: trying to append a row to a writer which has been closed.\n");
+
+ switch (mtype)
+ {
+  case MTYPEFULL:
+   PutValues(nc,v);
+   break;
+  case MTYPESYMMETRIC:
+   // Each row appended to an existing symmetric matrix adds a column, too
+   if (appending)
+    nc=nr+1;
+   if (nr>=nc)
+   {
+    std::ostringstream errst;
+    errst << "JMatrixWriter<T>::AppendRow: trying to append more than " << nc << " rows to a symmetric matrix of dimension " << nc << ".\n";
+    JMatrixStop(errst.str());
+   }
+   PutValues(nr+1,v);
+   break;
+  case MTYPESPARSE:
+  {
+   tmpc.clear();
+   tmpv.clear();
+   for (indextype c=0;c<nc;c++)
+    if (v[c]!=T(0))
+    {
+     tmpc.push_back(c);
+     tmpv.push_back(v[c]);
+    }
+   indextype ncr=indextype(tmpc.size());
+   Put((const void *)&ncr,sizeof(indextype));
+   PutIndices(ncr,tmpc.data());
+   Put((const void *)tmpv.data(),ncr*sizeof(T));
+   break;
+  }
+  case MTYPEBIT:
+   PackBitRow(v,nc,tmpw.data());
+   Put((const void *)tmpw.data(),tmpw.size()*sizeof(unsigned long long));
+   break;
+  default: break;
+ }
+ nr++;
+}
+
+template void JMatrixWriter<unsigned char>::AppendRow(const unsigned char *v);
+template void JMatrixWriter<char>::AppendRow(const char *v);
+template void JMatrixWriter<unsigned short>::AppendRow(const unsigned short *v);
+template void JMatrixWriter<short>::AppendRow(const short *v);
+template void JMatrixWriter<unsigned int>::AppendRow(const unsigned int *v);
+template void JMatrixWriter<int>::AppendRow(const int *v);
+template void JMatrixWriter<unsigned long>::AppendRow(const unsigned long *v);
+template void JMatrixWriter<long>::AppendRow(const long *v);
+template void JMatrixWriter<unsigned long long>::AppendRow(const unsigned long long *v);
+template void JMatrixWriter<long long>::AppendRow(const long long *v);
+template void JMatrixWriter<float>::AppendRow(const float *v);
+template void JMatrixWriter<double>::AppendRow(const double *v);
+template void JMatrixWriter<long double>::AppendRow(const long double *v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::AppendSparseRow(indextype n,const indextype *c,const T *v)
+{
+ if (closed)
+  JMatrixStop("JMatrixWriter<T>::AppendSparseRow: trying to append a row to a writer which has been closed.\n");
+
+ for (indextype k=0;k<n;k++)
+  if ((c[k]>=nc) || ((k>0) && (c[k]<=c[k-1])))
+  {
+   std::ostringstream errst;
+   errst << "JMatrixWriter<T>::AppendSparseRow: column indices of row " << nr << " must be increasing and lower than " << nc << ".\n";
+   JMatrixStop(errst.str());
+  }
+
+ switch (mtype)
+ {
+  case MTYPESPARSE:
+   Put((const void *)&n,sizeof(indextype));
+   PutIndices(n,c);
+   Put((const void *)v,n*sizeof(T));
+   nr++;
+   break;
+  case MTYPEFULL:
+   tmpv.assign(nc,T(0));
+   for (indextype k=0;k<n;k++)
+    tmpv[c[k]]=v[k];
+   PutValues(nc,tmpv.data());
+   nr++;
+   break;
+  case MTYPEBIT:
+   std::fill(tmpw.begin(),tmpw.end(),0ULL);
+   for (indextype k=0;k<n;k++)
+    if (v[k]!=T(0))
+     tmpw[c[k]/BIT_WORD_BITS] |= 1ULL << (c[k]%BIT_WORD_BITS);
+   Put((const void *)tmpw.data(),tmpw.size()*sizeof(unsigned long long));
+   nr++;
+   break;
+  default:
+   JMatrixStop("JMatrixWriter<T>::AppendSparseRow cannot be used with symmetric matrices.\n");
+ }
+}
+
+template void JMatrixWriter<unsigned char>::AppendSparseRow(indextype n,const indextype *c,const unsigned char *v);
+template void JMatrixWriter<char>::AppendSparseRow(indextype n,const indextype *c,const char *v);
+template void JMatrixWriter<unsigned short>::AppendSparseRow(indextype n,const indextype *c,const unsigned short *v);
+template void JMatrixWriter<short>::AppendSparseRow(indextype n,const indextype *c,const short *v);
+template void JMatrixWriter<unsigned int>::AppendSparseRow(indextype n,const indextype *c,const unsigned int *v);
+template void JMatrixWriter<int>::AppendSparseRow(indextype n,const indextype *c,const int *v);
+template void JMatrixWriter<unsigned long>::AppendSparseRow(indextype n,const indextype *c,const unsigned long *v);
+template void JMatrixWriter<long>::AppendSparseRow(indextype n,const indextype *c,const long *v);
+template void JMatrixWriter<unsigned long long>::AppendSparseRow(indextype n,const indextype *c,const unsigned long long *v);
+template void JMatrixWriter<long long>::AppendSparseRow(indextype n,const indextype *c,const long long *v);
+template void JMatrixWriter<float>::AppendSparseRow(indextype n,const indextype *c,const float *v);
+template void JMatrixWriter<double>::AppendSparseRow(indextype n,const indextype *c,const double *v);
+template void JMatrixWriter<long double>::AppendSparseRow(indextype n,const indextype *c,const long double *v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::SetRowNames(std::vector<std::string> rnames)
+{
+ rownames.clear();
+ rownames=rnames;
+ mdinfo |= ROW_NAMES;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,SetRowNames,std::vector<std::string> rnames)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::AppendRowNames(std::vector<std::string> rnames)
+{
+ if (rownames.empty())
+  for (indextype r=0; r<nropen; r++)
+   rownames.push_back("R"+std::to_string(r+1));
+ rownames.insert(rownames.end(),rnames.begin(),rnames.end());
+ mdinfo |= ROW_NAMES;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,AppendRowNames,std::vector<std::string> rnames)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::SetColNames(std::vector<std::string> cnames)
+{
+ if ((indextype)cnames.size() != nc)
+  JMatrixStop("Trying to set column names with a vector of length different to the current number of columns.\n");
+
+ colnames.clear();
+ colnames=cnames;
+ mdinfo |= COL_NAMES;
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,SetColNames,std::vector<std::string> cnames)
+
+//////////////////////////////////////////////////////////////////
+
+// Same behaviour as JMatrix<T>::SetComment
+template <typename T>
+void JMatrixWriter<T>::SetComment(std::string cm)
+{
+ mdinfo |= COMMENT;
+ if (cm.size()>COMMENT_SIZE)
+ {
+  JMatrixWarning("Too long comment. Final characters will be ignored.\n");
+  for (size_t i=0; i<COMMENT_SIZE-1; i++)
+   comment[i]=cm[i];
+  comment[COMMENT_SIZE-1]='\0';
+ }
+ else
+ {
+  if (cm.size()==0)
+   mdinfo &= (~COMMENT);  // Sets the comment bit to 0 if the comment is empty.
+  else
+  {
+   for (size_t i=0; i<cm.size(); i++)
+    comment[i]=cm[i];
+   for (size_t i=cm.size(); i<COMMENT_SIZE; i++)
+    comment[i]='\0';
+  }
+ }
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,SetComment,std::string cm)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+bool JMatrixWriter<T>::StoresAlike(std::string iname)
+{
+ unsigned char imtype,ictype,iendian,imdinfo;
+ indextype inrows,incols;
+ MatrixType(iname,imtype,ictype,iendian,imdinfo,inrows,incols);
+
+ if ((imtype!=mtype) || (mtype==MTYPESYMMETRIC) || (incols!=nc) || needrange)
+  return false;
+ if ((ictype!=((mtype==MTYPEBIT) ? UCTYPE : TypeNameToId())) || (iendian!=ThisMachineEndianness()))
+  return false;
+ if (mtype==MTYPESPARSE)
+  return (SparseFormat(iname)==sformat);
+ if (mtype==MTYPEFULL)
+ {
+  ValueCodec ivc=ValueCodecFromFile(iname);
+  return (ivc.enc==vcodec.enc) && (ivc.scale==vcodec.scale) && (ivc.offset==vcodec.offset);
+ }
+ return true;
+}
+
+TEMPLATES_FUNC(bool,JMatrixWriter,StoresAlike,std::string iname)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::AppendRowsOfFile(std::string iname)
+{
+ if (closed)
+  JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: trying to append rows to a writer which has been closed.\n");
+ if (!StoresAlike(iname))
+  JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: the rows of file "+iname+" are not stored as those of file "+fname+".\n");
+
+ unsigned char imtype,ictype,iendian,imdinfo;
+ indextype inrows,incols;
+ MatrixType(iname,imtype,ictype,iendian,imdinfo,inrows,incols);
+
+ int in=open(iname.c_str(),O_RDONLY);
+ if (in<0)
+  JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: cannot open file "+iname+"\n");
+
+ // The rows are the block of binary data, from the end of the header to the offset written at the end of the file
+ off_t fsize=lseek(in,0,SEEK_END);
+ unsigned long long endofbindata=0;
+ if ((fsize<off_t(HEADER_SIZE+sizeof(unsigned long long))) || (pread(in,(void *)&endofbindata,sizeof(unsigned long long),fsize-off_t(sizeof(unsigned long long)))!=ssize_t(sizeof(unsigned long long))) ||
+     (endofbindata<HEADER_SIZE) || (endofbindata>(unsigned long long)fsize))
+ {
+  close(in);
+  JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: file "+iname+" seems to be corrupted.\n");
+ }
+ unsigned long long nbytes=endofbindata-HEADER_SIZE;
+
+ if (DEB & DEBJM)
+  std::cout << "Appending " << inrows << " rows (" << nbytes << " bytes) of file " << iname << " to file " << fname << " as they are stored.\n";
+
+ // Everything in the buffer goes to the file before the rows are copied after it, through another descriptor
+ Flush();
+ ofile.flush();
+ int out=open(fname.c_str(),O_WRONLY);
+ if (out<0)
+ {
+  close(in);
+  JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: cannot open file "+fname+" to append rows to it.\n");
+ }
+ off_t ioff=off_t(HEADER_SIZE);
+ off_t ooff=off_t(written);
+ unsigned long long left=nbytes;
+#if defined(__linux__)
+ while (left>0)
+ {
+  ssize_t got=copy_file_range(in,&ioff,out,&ooff,size_t(left),0);
+  if (got<=0)
+   break;       // Not supported between these files (or an error, which the plain copy will find again)
+  left -= (unsigned long long)got;
+ }
+#endif
+ if (left>0)
+ {
+  std::vector<char> tmp(std::min((unsigned long long)buf.size(),left));
+  while (left>0)
+  {
+   ssize_t got=pread(in,(void *)tmp.data(),size_t(std::min((unsigned long long)tmp.size(),left)),ioff);
+   if ((got<=0) || (pwrite(out,(const void *)tmp.data(),size_t(got),ooff)!=got))
+   {
+    close(in);
+    close(out);
+    JMatrixStop("JMatrixWriter<T>::AppendRowsOfFile: error copying the rows of file "+iname+" to file "+fname+". Is the disk full?\n");
+   }
+   ioff += got;
+   ooff += got;
+   left -= (unsigned long long)got;
+  }
+ }
+ close(in);
+ close(out);
+
+ // The rows end before the former metadata when appending to a file, so the stream goes to the end of the rows, not to that of the file
+ written += nbytes;
+ ofile.seekp(std::streamoff(written),std::ios::beg);
+ nr += inrows;
+ JStatRead(nbytes);
+ JStatWrite(nbytes);
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,AppendRowsOfFile,std::string iname)
+
+//////////////////////////////////////////////////////////////////
+
+// Same format as JMatrix<T>::WriteNames
+template <typename T>
+void JMatrixWriter<T>::WriteNames(std::vector<std::string> &names)
+{
+ char dummy[MAX_LEN_NAME+1];
+ char *dummy2;
+
+ for (size_t i=0; i<names.size(); i++)
+ {
+  strncpy(dummy,names[i].c_str(),MAX_LEN_NAME);
+  dummy[MAX_LEN_NAME]='\0';
+  if (dummy[0]=='"' && dummy[strlen(dummy)-1]=='"')
+  {
+   dummy[strlen(dummy)-1]='\0';
+   dummy2=dummy+1;
+  }
+  else
+   dummy2=dummy;
+  Put((const void *)dummy2,strlen(dummy2)+1);   // +1 is because we want the final null character be copied, too.
+ }
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,WriteNames,SINGLE_ARG(std::vector<std::string> &names))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixWriter<T>::Close()
+{
+ if (closed)
+  return;
+
+ if ((mtype==MTYPESYMMETRIC) && (nr!=nc))
+ {
+  std::ostringstream errst;
+  errst << "JMatrixWriter<T>::Close: the symmetric matrix in file " << fname << " should have " << nc << " rows, but only " << nr << " have been appended.\n";
+  JMatrixStop(errst.str());
+ }
+
+ // Rows appended to a file with names get them, if they were not given
+ if (appending && (mdinfo & ROW_NAMES) && ((indextype)rownames.size()<nr))
+ {
+  std::ostringstream errst;
+  errst << "JMatrixWriter<T>::Close: no name was given to " << nr-rownames.size() << " rows appended to file " << fname << ". They are named as R<row number>.\n";
+  JMatrixWarning(errst.str());
+  for (indextype r=indextype(rownames.size()); r<nr; r++)
+   rownames.push_back("R"+std::to_string(r+1));
+ }
+ // Columns added to a symmetric matrix are named as the rows
+ if (appending && (mtype==MTYPESYMMETRIC) && (mdinfo & COL_NAMES))
+  for (indextype c=indextype(colnames.size()); c<nc; c++)
+   colnames.push_back((c<(indextype)rownames.size()) ? rownames[c] : "C"+std::to_string(c+1));
+
+ if ((mdinfo & ROW_NAMES) && (rownames.size()>0) && ((indextype)rownames.size()!=nr))
+ {
+  std::ostringstream errst;
+  errst << "JMatrixWriter<T>::Close: " << rownames.size() << " row names were given, but " << nr << " rows have been appended to file " << fname << ".\n";
+  JMatrixStop(errst.str());
+ }
+
+ unsigned long long endofbindata = written;
+
+ // Metadata must go just after the rows; otherwise whatever lies in between (such as the former metadata of a file appended to) would corrupt the file
+ if ((unsigned long long)ofile.tellp()+buflen!=endofbindata)
+ {
+  std::ostringstream errst;
+  errst << "Unexpected error in JMatrixWriter<T>::Close: the rows of file " << fname << " end at offset " << endofbindata << ", but the file is being written at offset " << (unsigned long long)ofile.tellp()+buflen << ".\n";
+  JMatrixStop(errst.str());
+ }
+
+ if (DEB & DEBJM)
+  std::cout << "End of block of binary data at offset " << endofbindata << "\n";
+
+ // Metadata are written as JMatrix<T>::WriteMetadata does
+ if ((mdinfo & ROW_NAMES) && (rownames.size()>0))
+ {
+  if (DEB & DEBJM)
+   std::cout << "   Writing row names (" << rownames.size() << " strings written, from " << rownames[0] << " to " << rownames[rownames.size()-1] << ").\n";
+  WriteNames(rownames);
+  Put((const void *)BLOCKSEP,BLOCKSEP_LEN);
+ }
+
+ if ((mdinfo & COL_NAMES) && (colnames.size()>0))
+ {
+  if (DEB & DEBJM)
+   std::cout << "   Writing column names (" << colnames.size() << " strings written, from " << colnames[0] << " to " << colnames[colnames.size()-1] << ").\n";
+  WriteNames(colnames);
+  Put((const void *)BLOCKSEP,BLOCKSEP_LEN);
+ }
+
+ if (mdinfo & COMMENT)
+ {
+  if (DEB & DEBJM)
+   std::cout << "   Writing comment: " << comment << "\n";
+  Put((const void *)comment,COMMENT_SIZE);
+  Put((const void *)BLOCKSEP,BLOCKSEP_LEN);
+ }
+
+ Put((const void *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+ Flush();
+
+ // Now the number of rows and the metadata are known, so the header can be written in its final form, as JMatrix<T>::WriteBin does.
+ // Bit matrices are always declared as of unsigned char, whatever the type of the values they were given
+ unsigned char td = ((mtype==MTYPEBIT) ? UCTYPE : TypeNameToId()) | ThisMachineEndianness();
+ unsigned char header[HEADER_SIZE];
+ memset((void *)header,0,HEADER_SIZE);
+ header[0]=mtype;
+ header[1]=td;
+ memcpy((void *)(header+2),(const void *)&nr,sizeof(indextype));
+ memcpy((void *)(header+2+sizeof(indextype)),(const void *)&nc,sizeof(indextype));
+ header[2+2*sizeof(indextype)]=mdinfo;
+ header[SPARSE_FORMAT_POS]=sformat;
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+  ValueCodecToHeader(vcodec,header);
+
+ ofile.seekp(0,std::ios::beg);
+ JStatSeek();
+ ofile.write((const char *)header,HEADER_SIZE);
+ if (ofile.fail())
+ {
+  std::string err = "Error writing the header of file "+fname+".\n";
+  JMatrixStop(err);
+ }
+ JStatWrite(HEADER_SIZE);
+ ofile.close();
+ closed=true;
+
+ // Nothing of the former metadata must remain after the new end of the file, should the new ones be shorter
+ if (appending && (truncate(fname.c_str(),off_t(written))!=0))
+  JMatrixWarning("JMatrixWriter<T>::Close: file "+fname+" could not be truncated to its new size.\n");
+
+ if (DEB & DEBJM)
+  std::cout << "Binary matrix " << fname << " of (" << nr << "x" << nc << ") closed.\n";
+}
+
+TEMPLATES_FUNC(void,JMatrixWriter,Close,)
@@ -0,0 +1,480 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include "../headers/matbind.h"
+#include "../headers/jmatrixreader.h"
+#include "../headers/jmatrixwriter.h"
+#include "../headers/matmetadata.h"
+#include "../headers/matinfo.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+// Integer type of at least size bytes, unsigned or signed (those of the ...TYPE constants are even and odd, respectively)
+static unsigned char IntegerOfSize(size_t size,bool sign)
+{
+ unsigned char t;
+ if (size<=sizeof(char))
+  t=UCTYPE;
+ else if (size<=sizeof(short))
+  t=USTYPE;
+ else if (size<=sizeof(int))
+  t=UITYPE;
+ else if (size<=sizeof(long))
+  t=ULTYPE;
+ else
+  t=ULLTYPE;
+ return sign ? t+1 : t;
+}
+
+unsigned char PromotedType(const std::vector<unsigned char> &ctypes)
+{
+ if (ctypes.empty())
+  return NOTYPE;
+ if (std::count(ctypes.begin(),ctypes.end(),ctypes[0])==(long)ctypes.size())
+  return ctypes[0];
+
+ unsigned char fltype=NOTYPE;
+ size_t usize=0,ssize=0;
+ for (size_t i=0; i<ctypes.size(); i++)
+ {
+  if (ctypes[i]>=FTYPE)
+   fltype=(fltype==NOTYPE) ? ctypes[i] : std::max(fltype,ctypes[i]);
+  else if (ctypes[i]%2==0)
+   usize=std::max(usize,size_t(SizeOfType(ctypes[i])));
+  else
+   ssize=std::max(ssize,size_t(SizeOfType(ctypes[i])));
+ }
+
+ // Integers of 32 bits or more do not fit in the 24 bits of the mantissa of a float
+ if (fltype!=NOTYPE)
+  return ((fltype==FTYPE) && (std::max(usize,ssize)>=sizeof(int))) ? DTYPE : fltype;
+ if (ssize==0)
+  return IntegerOfSize(usize,false);
+ return IntegerOfSize(std::max(ssize,std::min(sizeof(long long),2*usize)),true);
+}
+
+unsigned char PromotedMatrixType(const std::vector<unsigned char> &mtypes)
+{
+ for (size_t i=0; i<mtypes.size(); i++)
+  if ((mtypes[i]!=MTYPEFULL) && (mtypes[i]!=MTYPESPARSE) && (mtypes[i]!=MTYPEBIT))
+   JMatrixStop("Only full, sparse and bit matrices can be bound together.\n");
+ if (mtypes.empty() || (std::count(mtypes.begin(),mtypes.end(),mtypes[0])!=(long)mtypes.size()))
+  return MTYPEFULL;
+ return mtypes[0];
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Joins the names of the rows (or columns) of the bound files, naming R1,R2... (or C1,C2...) those of files without them, and gets
+// the names of the columns (or rows) shared by all files from the first one that has them. Both are left empty if no file has such names.
+static void BindNames(const std::vector<std::string> &inames,bool byrows,const std::vector<indextype> &counts,std::vector<std::string> &joined,std::vector<std::string> &common)
+{
+ std::vector<std::vector<std::string>> own(inames.size());
+ bool any=false,warned=false;
+ common.clear();
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  std::vector<std::string> rn,cn;
+  InternalGetBinNames(inames[i],ROW_NAMES,rn,cn);
+  InternalGetBinNames(inames[i],COL_NAMES,rn,cn);
+  std::vector<std::string> &other=byrows ? cn : rn;
+  own[i]=byrows ? rn : cn;
+  any = any || (own[i].size()>0);
+  if (other.size()>0)
+  {
+   if (common.empty())
+    common=other;
+   else if ((other!=common) && !warned)
+   {
+    JMatrixWarning(std::string("The ")+(byrows ? "column" : "row")+" names of file "+inames[i]+" are not those of the former files. The names of the first file that has them are kept.\n");
+    warned=true;
+   }
+  }
+ }
+
+ joined.clear();
+ if (!any)
+  return;
+ const std::string prefix=byrows ? "R" : "C";
+ for (size_t i=0; i<inames.size(); i++)
+  for (indextype k=0; k<counts[i]; k++)
+   joined.push_back(own[i].empty() ? prefix+std::to_string(joined.size()+1) : own[i][k]);
+}
+
+// Widens [minv,maxv] to the values of the row loaded in the reader (and 0, if some of them are not stored)
+template <typename T>
+static void RowRange(JMatrixReader<T> &R,double &minv,double &maxv)
+{
+ const T *v;
+ indextype n;
+ if (R.GetMatrixType()==MTYPESPARSE)
+ {
+  SparseRowSpan<T> s=R.GetSparseRow();
+  v=s.v;
+  n=s.n;
+  if (n<R.GetNCols())
+  {
+   minv=std::min(minv,0.0);
+   maxv=std::max(maxv,0.0);
+  }
+ }
+ else
+ {
+  DenseRowSpan<T> s=R.GetDenseRow();
+  v=s.v;
+  n=s.n;
+ }
+ for (indextype k=0; k<n; k++)
+ {
+  minv=std::min(minv,double(v[k]));
+  maxv=std::max(maxv,double(v[k]));
+ }
+}
+
+// Quantised encodings need the range of the values before the first row is written, which takes a first pass over all files
+template <typename T>
+static void SetBindRange(const std::vector<std::string> &inames,JMatrixWriter<T> &w)
+{
+ if (!w.NeedsValueRange())
+  return;
+ double minv=std::numeric_limits<double>::max();
+ double maxv=std::numeric_limits<double>::lowest();
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  JMatrixReader<T> R(inames[i]);
+  while (R.NextRow())
+   RowRange(R,minv,maxv);
+ }
+ w.SetValueRange(minv,maxv);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename T>
+void BindRows(std::vector<std::string> inames,std::string oname)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("BindRows");
+
+ if (inames.empty())
+  JMatrixStop("BindRows: no file to bind.\n");
+
+ std::vector<unsigned char> mtypes(inames.size());
+ std::vector<indextype> nrows(inames.size());
+ indextype ncols=0;
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  unsigned char ctype,endian,mdinfo;
+  indextype nc;
+  MatrixType(inames[i],mtypes[i],ctype,endian,mdinfo,nrows[i],nc);
+  if (i==0)
+   ncols=nc;
+  else if (nc!=ncols)
+   JMatrixStop("BindRows: the matrix in file "+inames[i]+" has "+std::to_string(nc)+" columns, but the one in file "+inames[0]+" has "+std::to_string(ncols)+".\n");
+ }
+ const unsigned char mtype=PromotedMatrixType(mtypes);
+
+ JMatrixWriter<T> w(oname,mtype,ncols);
+ SetBindRange(inames,w);
+
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  if (w.StoresAlike(inames[i]))
+  {
+   w.AppendRowsOfFile(inames[i]);
+   continue;
+  }
+
+  if (DEB & DEBJM)
+   std::cout << "Appending the " << nrows[i] << " rows of file " << inames[i] << " converting them.\n";
+
+  JMatrixReader<T> R(inames[i]);
+  while (R.NextRow())
+  {
+   if (R.GetMatrixType()==MTYPESPARSE)
+   {
+    SparseRowSpan<T> s=R.GetSparseRow();
+    w.AppendSparseRow(s.n,s.c,s.v);
+   }
+   else
+    w.AppendRow(R.GetDenseRow().v);
+  }
+ }
+ JStatRows(w.GetNRows());
+ JStatElements((unsigned long long)w.GetNRows()*ncols);
+
+ std::vector<std::string> rnames,cnames;
+ BindNames(inames,true,nrows,rnames,cnames);
+ if (rnames.size()>0)
+  w.SetRowNames(rnames);
+ if (cnames.size()>0)
+  w.SetColNames(cnames);
+ w.Close();
+}
+
+TEMPLATES_ISOLATED_FUNC(void,BindRows,SINGLE_ARG(std::vector<std::string> inames,std::string oname))
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename T>
+void BindColumns(std::vector<std::string> inames,std::string oname)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("BindColumns");
+
+ if (inames.empty())
+  JMatrixStop("BindColumns: no file to bind.\n");
+
+ std::vector<unsigned char> mtypes(inames.size());
+ std::vector<indextype> ncols(inames.size()),first(inames.size());
+ indextype nrows=0,ntotal=0;
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  unsigned char ctype,endian,mdinfo;
+  indextype nr;
+  MatrixType(inames[i],mtypes[i],ctype,endian,mdinfo,nr,ncols[i]);
+  if (i==0)
+   nrows=nr;
+  else if (nr!=nrows)
+   JMatrixStop("BindColumns: the matrix in file "+inames[i]+" has "+std::to_string(nr)+" rows, but the one in file "+inames[0]+" has "+std::to_string(nrows)+".\n");
+  first[i]=ntotal;
+  ntotal += ncols[i];
+ }
+ const unsigned char mtype=PromotedMatrixType(mtypes);
+
+ if (DEB & DEBJM)
+  std::cout << "Binding the columns of " << inames.size() << " files into a (" << nrows << "x" << ntotal << ") matrix in file " << oname << ".\n";
+
+ JMatrixWriter<T> w(oname,mtype,ntotal);
+ SetBindRange(inames,w);
+
+ // All files are read at once, so they share the memory of the read buffers
+ const size_t bufsize=std::max(size_t(64*1024),BIND_READ_BUFFERS_SIZE/inames.size());
+ std::vector<std::unique_ptr<JMatrixReader<T>>> R(inames.size());
+ for (size_t i=0; i<inames.size(); i++)
+  R[i].reset(new JMatrixReader<T>(inames[i],bufsize));
+
+ std::vector<indextype> oc;
+ std::vector<T> ov;
+ for (indextype r=0; r<nrows; r++)
+ {
+  if (mtype==MTYPESPARSE)
+  {
+   oc.clear();
+   ov.clear();
+   for (size_t i=0; i<inames.size(); i++)
+   {
+    R[i]->NextRow();
+    SparseRowSpan<T> s=R[i]->GetSparseRow();
+    for (indextype k=0; k<s.n; k++)
+    {
+     oc.push_back(first[i]+s.c[k]);
+     ov.push_back(s.v[k]);
+    }
+   }
+   w.AppendSparseRow(indextype(oc.size()),oc.data(),ov.data());
+  }
+  else
+  {
+   ov.assign(ntotal,T(0));
+   for (size_t i=0; i<inames.size(); i++)
+   {
+    R[i]->NextRow();
+    if (mtypes[i]==MTYPESPARSE)
+    {
+     SparseRowSpan<T> s=R[i]->GetSparseRow();
+     for (indextype k=0; k<s.n; k++)
+      ov[first[i]+s.c[k]]=s.v[k];
+    }
+    else
+    {
+     DenseRowSpan<T> s=R[i]->GetDenseRow();
+     std::copy(s.v,s.v+s.n,ov.begin()+first[i]);
+    }
+   }
+   w.AppendRow(ov.data());
+  }
+ }
+ R.clear();
+ JStatRows(nrows);
+ JStatElements((unsigned long long)nrows*ntotal);
+
+ std::vector<std::string> rnames,cnames;
+ BindNames(inames,false,ncols,cnames,rnames);
+ if (rnames.size()>0)
+  w.SetRowNames(rnames);
+ if (cnames.size()>0)
+  w.SetColNames(cnames);
+ w.Close();
+}
+
+TEMPLATES_ISOLATED_FUNC(void,BindColumns,SINGLE_ARG(std::vector<std::string> inames,std::string oname))
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename T>
+void AppendRows(std::string iname,std::string oname)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("AppendRows");
+
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nrows,ncols;
+ MatrixType(iname,mtype,ctype,endian,mdinfo,nrows,ncols);
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPEBIT))
+  JMatrixStop("AppendRows: only the rows of full, sparse and bit matrices can be appended to other matrices.\n");
+
+ JMatrixWriter<T> w(oname);
+ const indextype n0=w.GetNRows();
+ if (w.GetMatrixType()==MTYPESYMMETRIC)
+ {
+  if (ncols<n0+nrows)
+   JMatrixStop("AppendRows: the rows appended to a symmetric matrix of dimension "+std::to_string(n0)+" must have at least "+std::to_string(n0+nrows)+" columns.\n");
+
+  std::vector<T> row(ncols);
+  JMatrixReader<T> R(iname);
+  while (R.NextRow())
+  {
+   R.GetRow(row.data());
+   w.AppendRow(row.data());
+  }
+ }
+ else
+ {
+  if (ncols!=w.GetNCols())
+   JMatrixStop("AppendRows: the matrix in file "+iname+" has "+std::to_string(ncols)+" columns, but the one in file "+oname+" has "+std::to_string(w.GetNCols())+".\n");
+
+  if (w.StoresAlike(iname))
+   w.AppendRowsOfFile(iname);
+  else
+  {
+   JMatrixReader<T> R(iname);
+   while (R.NextRow())
+   {
+    if (mtype==MTYPESPARSE)
+    {
+     SparseRowSpan<T> s=R.GetSparseRow();
+     w.AppendSparseRow(s.n,s.c,s.v);
+    }
+    else
+     w.AppendRow(R.GetDenseRow().v);
+   }
+  }
+ }
+ JStatRows(nrows);
+ JStatElements((unsigned long long)nrows*ncols);
+
+ if (DEB & DEBJM)
+  std::cout << "Appended " << nrows << " rows of file " << iname << " to the " << n0 << " rows of file " << oname << ".\n";
+
+ std::vector<std::string> rnames,cnames;
+ if (mdinfo & ROW_NAMES)
+  InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+ if (rnames.size()>0)
+  w.AppendRowNames(rnames);
+ w.Close();
+}
+
+TEMPLATES_ISOLATED_FUNC(void,AppendRows,SINGLE_ARG(std::string iname,std::string oname))
+
+/////////////////////////////////////////////////////////////////////
+
+// Data type of the result of binding the matrices in the files
+static unsigned char BoundType(const std::vector<std::string> &inames)
+{
+ std::vector<unsigned char> ctypes;
+ for (size_t i=0; i<inames.size(); i++)
+ {
+  unsigned char mtype,ctype;
+  MatrixType(inames[i],mtype,ctype);
+  ctypes.push_back(ctype);
+ }
+ return PromotedType(ctypes);
+}
+
+void JBindRows(std::vector<std::string> inames,std::string oname)
+{
+ switch (BoundType(inames))
+ {
+  case UCTYPE: BindRows<unsigned char>(inames,oname); break;
+  case SCTYPE: BindRows<char>(inames,oname); break;
+  case USTYPE: BindRows<unsigned short>(inames,oname); break;
+  case SSTYPE: BindRows<short>(inames,oname); break;
+  case UITYPE: BindRows<unsigned int>(inames,oname); break;
+  case SITYPE: BindRows<int>(inames,oname); break;
+  case ULTYPE: BindRows<unsigned long>(inames,oname); break;
+  case SLTYPE: BindRows<long>(inames,oname); break;
+  case ULLTYPE: BindRows<unsigned long long>(inames,oname); break;
+  case SLLTYPE: BindRows<long long>(inames,oname); break;
+  case FTYPE: BindRows<float>(inames,oname); break;
+  case DTYPE: BindRows<double>(inames,oname); break;
+  case LDTYPE: BindRows<long double>(inames,oname); break;
+  default: JMatrixStop("Unexpected error in JBindRows: unknown data type.\n"); break;
+ }
+}
+
+void JBindColumns(std::vector<std::string> inames,std::string oname)
+{
+ switch (BoundType(inames))
+ {
+  case UCTYPE: BindColumns<unsigned char>(inames,oname); break;
+  case SCTYPE: BindColumns<char>(inames,oname); break;
+  case USTYPE: BindColumns<unsigned short>(inames,oname); break;
+  case SSTYPE: BindColumns<short>(inames,oname); break;
+  case UITYPE: BindColumns<unsigned int>(inames,oname); break;
+  case SITYPE: BindColumns<int>(inames,oname); break;
+  case ULTYPE: BindColumns<unsigned long>(inames,oname); break;
+  case SLTYPE: BindColumns<long>(inames,oname); break;
+  case ULLTYPE: BindColumns<unsigned long long>(inames,oname); break;
+  case SLLTYPE: BindColumns<long long>(inames,oname); break;
+  case FTYPE: BindColumns<float>(inames,oname); break;
+  case DTYPE: BindColumns<double>(inames,oname); break;
+  case LDTYPE: BindColumns<long double>(inames,oname); break;
+  default: JMatrixStop("Unexpected error in JBindColumns: unknown data type.\n"); break;
+ }
+}
+
+void JAppendRows(std::string iname,std::string oname)
+{
+ unsigned char mtype,ctype;
+ MatrixType(oname,mtype,ctype);
+
+ switch (ctype)
+ {
+  case UCTYPE: AppendRows<unsigned char>(iname,oname); break;
+  case SCTYPE: AppendRows<char>(iname,oname); break;
+  case USTYPE: AppendRows<unsigned short>(iname,oname); break;
+  case SSTYPE: AppendRows<short>(iname,oname); break;
+  case UITYPE: AppendRows<unsigned int>(iname,oname); break;
+  case SITYPE: AppendRows<int>(iname,oname); break;
+  case ULTYPE: AppendRows<unsigned long>(iname,oname); break;
+  case SLTYPE: AppendRows<long>(iname,oname); break;
+  case ULLTYPE: AppendRows<unsigned long long>(iname,oname); break;
+  case SLLTYPE: AppendRows<long long>(iname,oname); break;
+  case FTYPE: AppendRows<float>(iname,oname); break;
+  case DTYPE: AppendRows<double>(iname,oname); break;
+  case LDTYPE: AppendRows<long double>(iname,oname); break;
+  default: JMatrixStop("Unexpected error in JAppendRows: unknown data type.\n"); break;
+ }
+}
@@ -0,0 +1,442 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include "../headers/matconvert.h"
+#include "../headers/jmatrixreader.h"
+#include "../headers/jmatrixwriter.h"
+#include "../headers/matgetrows.h"
+#include "../headers/matinfo.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+// Integer to integer. Negative values become 0 for unsigned types and large values the highest one, if saturation is asked for.
+template <typename S,typename T>
+static inline T ConvertInteger(S x,bool saturate)
+{
+ if (!saturate)
+  return T(x);
+ if (std::is_signed<S>::value && (x<S(0)))
+ {
+  if (!std::is_signed<T>::value)
+   return T(0);
+  return ((long long)x<(long long)std::numeric_limits<T>::lowest()) ? std::numeric_limits<T>::lowest() : T(x);
+ }
+ return ((unsigned long long)x>(unsigned long long)std::numeric_limits<T>::max()) ? std::numeric_limits<T>::max() : T(x);
+}
+
+// Floating point to integer. Converting a value out of the range of T is undefined behaviour, so values are always clamped.
+template <typename S,typename T>
+static inline T ConvertFloatToInteger(S x,bool round)
+{
+ if (x!=x)
+  return T(0);
+ if (round)
+  x=std::round(x);
+ if (x<=S(std::numeric_limits<T>::lowest()))
+  return std::numeric_limits<T>::lowest();
+ if (x>=S(std::numeric_limits<T>::max()))
+  return std::numeric_limits<T>::max();
+ return T(x);
+}
+
+// Floating point to a narrower floating point type, with values beyond its range becoming its highest (or lowest) one
+template <typename S,typename T>
+static inline T ConvertFloatToFloat(S x)
+{
+ const S hi=S(std::numeric_limits<T>::max());
+ return (x>hi) ? T(hi) : ((x<-hi) ? T(-hi) : T(x));
+}
+
+template <typename S,typename T>
+static inline T ConvertValue(S x,unsigned char flags)
+{
+ if (std::is_floating_point<T>::value)
+ {
+  if (std::is_floating_point<S>::value && (sizeof(S)>sizeof(T)) && (flags & CONVERT_SATURATE))
+   return ConvertFloatToFloat<S,T>(x);
+  return T(x);
+ }
+ if (std::is_floating_point<S>::value)
+  return ConvertFloatToInteger<S,T>(x,(flags & CONVERT_ROUND)!=0);
+ return ConvertInteger<S,T>(x,(flags & CONVERT_SATURATE)!=0);
+}
+
+// Tells whether every value of type S fits in type T, so that a plain cast converts them (and the compiler can vectorise the loop)
+template <typename S,typename T>
+static bool PlainConversion(unsigned char flags)
+{
+ if (std::is_floating_point<T>::value)
+  return (!std::is_floating_point<S>::value) || (sizeof(S)<=sizeof(T)) || !(flags & CONVERT_SATURATE);
+ if (std::is_floating_point<S>::value)
+  return false;
+ if (!(flags & CONVERT_SATURATE))
+  return true;
+ if (std::is_signed<S>::value)
+  return std::is_signed<T>::value && (sizeof(T)>=sizeof(S));
+ return std::is_signed<T>::value ? (sizeof(T)>sizeof(S)) : (sizeof(T)>=sizeof(S));
+}
+
+template <typename S,typename T>
+static void ConvertRow(const S *s,size_t n,T *d,unsigned char flags)
+{
+ if (std::is_same<S,T>::value)
+ {
+  memcpy((void *)d,(const void *)s,n*sizeof(T));
+  return;
+ }
+ if (PlainConversion<S,T>(flags))
+ {
+  for (size_t i=0; i<n; i++)
+   d[i]=T(s[i]);
+  return;
+ }
+ for (size_t i=0; i<n; i++)
+  d[i]=ConvertValue<S,T>(s[i],flags);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Converts rows t, t+nthreads, t+2*nthreads... of a block whose first row is first. Source rows are either dense (sv) or sparse (sc,sv);
+// converted rows are dense (dv) unless the result is sparse (dc,dv).
+template <typename S,typename T>
+static void ConvertRows(unsigned char mtype,bool sparsein,indextype first,unsigned int t,unsigned int nthreads,indextype ncols,unsigned char flags,
+                        const std::vector<std::vector<indextype>> &sc,const std::vector<std::vector<S>> &sv,
+                        std::vector<std::vector<indextype>> &dc,std::vector<std::vector<T>> &dv)
+{
+ std::vector<T> tmp;
+ for (size_t i=t; i<sv.size(); i+=nthreads)
+ {
+  indextype len=(mtype==MTYPESYMMETRIC) ? first+indextype(i)+1 : ncols;
+  if (mtype==MTYPESPARSE)
+  {
+   const indextype n=indextype(sv[i].size());
+   tmp.resize(n);
+   ConvertRow(sv[i].data(),n,tmp.data(),flags);
+   dc[i].clear();
+   dv[i].clear();
+   for (indextype k=0; k<n; k++)
+    if (tmp[k]!=T(0))
+    {
+     dc[i].push_back(sparsein ? sc[i][k] : k);
+     dv[i].push_back(tmp[k]);
+    }
+  }
+  else
+  {
+   if (sparsein)
+   {
+    dv[i].assign(len,T(0));
+    for (size_t k=0; k<sv[i].size(); k++)
+     if (sc[i][k]<len)
+      dv[i][sc[i][k]]=(mtype==MTYPEBIT) ? T(sv[i][k]!=S(0)) : ConvertValue<S,T>(sv[i][k],flags);
+   }
+   else if (mtype==MTYPEBIT)
+   {
+    dv[i].resize(len);
+    for (indextype k=0; k<len; k++)
+     dv[i][k]=(sv[i][k]!=S(0)) ? T(1) : T(0);
+   }
+   else
+   {
+    dv[i].resize(len);
+    ConvertRow(sv[i].data(),len,dv[i].data(),flags);
+   }
+  }
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename S,typename T>
+void ConvertMatrix(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("ConvertMatrix");
+
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+  JMatrixStop("ConvertMatrix: unknown matrix type.\n");
+
+ JMatrixReader<S> R(iname);
+ const unsigned char imtype=R.GetMatrixType();
+ const indextype nrows=R.GetNRows();
+ const indextype ncols=R.GetNCols();
+
+ if ((mtype==MTYPESYMMETRIC) && (nrows!=ncols))
+  JMatrixStop("ConvertMatrix: the matrix in file "+iname+" is not square, so it cannot be converted to a symmetric matrix.\n");
+
+ if (nthreads==0)
+  nthreads=std::max(1U,std::thread::hardware_concurrency());
+
+ // Rows of a symmetric matrix are gathered complete, unless the result is symmetric, too
+ const bool sweep=(imtype==MTYPESYMMETRIC) && (mtype!=MTYPESYMMETRIC);
+ const bool sparsein=(imtype==MTYPESPARSE);
+
+ double inbytes=sparsein ? double(GetFileSize(iname))/double(std::max(nrows,indextype(1))) : double(ncols)*double(sizeof(S));
+ double outbytes=(mtype==MTYPESPARSE) ? inbytes*double(sizeof(T)+sizeof(indextype))/double(sizeof(S)) : double(ncols)*double(sizeof(T));
+ indextype blockrows=indextype(std::max(1.0,double(CONVERT_BLOCK_SIZE)/std::max(1.0,inbytes+outbytes)));
+ blockrows=std::max(blockrows,indextype(4*nthreads));
+ blockrows=std::max(indextype(1),std::min(blockrows,nrows));
+
+ // Complete rows of a symmetric matrix are gathered in windows of whole blocks, each one with a single pass from its first row to the end
+ indextype windowrows=blockrows;
+ if (sweep)
+ {
+  double wblocks=std::floor(double(CONVERT_SWEEP_MEMORY_SIZE)/(double(ncols)*double(sizeof(S))*double(blockrows)));
+  windowrows=indextype(std::min(std::max(1.0,wblocks)*double(blockrows),double(nrows)));
+  windowrows=std::max(windowrows,blockrows);
+ }
+
+ if (DEB & DEBJM)
+  std::cout << "Converting " << nrows << "x" << ncols << " matrix from " << iname << " to " << oname << " in blocks of " << blockrows << " rows with " << nthreads << " threads.\n";
+ if ((DEB & DEBJM) && sweep)
+  std::cout << "Rows of the symmetric matrix are gathered in " << (nrows+windowrows-1)/windowrows << " windows of " << windowrows << " rows.\n";
+
+ JMatrixWriter<T> w(oname,mtype,ncols);
+
+ // Quantised encodings need the range of the values before the first row is written, which takes a first pass over the file
+ if (w.NeedsValueRange())
+ {
+  double minv=sparsein ? 0.0 : std::numeric_limits<double>::max();
+  double maxv=sparsein ? 0.0 : std::numeric_limits<double>::lowest();
+  JMatrixReader<S> P(iname);
+  std::vector<T> tmp;
+  while (P.NextRow())
+  {
+   const S *v;
+   indextype n;
+   if (sparsein)
+   {
+    SparseRowSpan<S> s=P.GetSparseRow();
+    v=s.v;
+    n=s.n;
+   }
+   else
+   {
+    DenseRowSpan<S> s=P.GetDenseRow();
+    v=s.v;
+    n=s.n;
+   }
+   tmp.resize(n);
+   ConvertRow(v,n,tmp.data(),flags);
+   for (indextype k=0; k<n; k++)
+   {
+    minv=std::min(minv,double(tmp[k]));
+    maxv=std::max(maxv,double(tmp[k]));
+   }
+  }
+  w.SetValueRange(minv,maxv);
+ }
+
+ std::vector<std::vector<indextype>> sc[2],dc[2];
+ std::vector<std::vector<S>> sv[2];
+ std::vector<std::vector<T>> dv[2];
+ std::vector<std::vector<S>> win;
+ indextype winfirst=0;
+ std::vector<std::thread> workers;
+
+ for (indextype first=0,k=0; first<nrows; first+=blockrows,k++)
+ {
+  const unsigned int b=k%2;
+  const indextype last=std::min(nrows,first+blockrows);
+
+  // Read block k while the former one is being converted
+  sc[b].resize(last-first);
+  sv[b].resize(last-first);
+  if (sweep)
+  {
+   if (first%windowrows==0)
+   {
+    winfirst=first;
+    std::vector<indextype> which;
+    for (indextype r=first; r<std::min(nrows,first+windowrows); r++)
+     which.push_back(r);
+    SweepSymmetricRows(iname,which,ncols,win);
+   }
+   for (indextype r=first; r<last; r++)
+    sv[b][r-first].swap(win[r-winfirst]);
+  }
+  else
+   for (indextype r=first; r<last; r++)
+   {
+    R.NextRow();
+    if (sparsein)
+    {
+     SparseRowSpan<S> s=R.GetSparseRow();
+     sc[b][r-first].assign(s.c,s.c+s.n);
+     sv[b][r-first].assign(s.v,s.v+s.n);
+    }
+    else
+    {
+     DenseRowSpan<S> s=R.GetDenseRow();
+     indextype n=(mtype==MTYPESYMMETRIC) ? std::min(s.n,r+1) : s.n;
+     sv[b][r-first].assign(s.v,s.v+n);
+    }
+   }
+
+  for (size_t t=0; t<workers.size(); t++)
+   workers[t].join();
+  workers.clear();
+
+  dc[b].resize(last-first);
+  dv[b].resize(last-first);
+  for (unsigned int t=0; t<nthreads; t++)
+   workers.push_back(std::thread(ConvertRows<S,T>,mtype,sparsein,first,t,nthreads,ncols,flags,std::cref(sc[b]),std::cref(sv[b]),std::ref(dc[b]),std::ref(dv[b])));
+
+  // Write block k-1 while block k is being converted
+  if (k>0)
+  {
+   for (size_t i=0; i<dv[1-b].size(); i++)
+   {
+    if (mtype==MTYPESPARSE)
+     w.AppendSparseRow(indextype(dc[1-b][i].size()),dc[1-b][i].data(),dv[1-b][i].data());
+    else
+     w.AppendRow(dv[1-b][i].data());
+    JStatElements(dv[1-b][i].size());
+   }
+   JStatRows(dv[1-b].size());
+  }
+ }
+
+ for (size_t t=0; t<workers.size(); t++)
+  workers[t].join();
+
+ if (nrows>0)
+ {
+  const unsigned int b=((nrows-1)/blockrows)%2;
+  for (size_t i=0; i<dv[b].size(); i++)
+  {
+   if (mtype==MTYPESPARSE)
+    w.AppendSparseRow(indextype(dc[b][i].size()),dc[b][i].data(),dv[b][i].data());
+   else
+    w.AppendRow(dv[b][i].data());
+   JStatElements(dv[b][i].size());
+  }
+  JStatRows(dv[b].size());
+ }
+
+ std::vector<std::string> rnames=R.GetRowNames();
+ if (!rnames.empty())
+  w.SetRowNames(rnames);
+ std::vector<std::string> cnames=R.GetColNames();
+ if (!cnames.empty())
+  w.SetColNames(cnames);
+
+ if (R.GetMetadataInfo() & COMMENT)
+ {
+  unsigned long long start_md,start_comment;
+  PositionsInFile(iname,&start_md,&start_comment);
+  std::ifstream f(iname.c_str());
+  f.seekg(start_comment,std::ios::beg);
+  char comment[COMMENT_SIZE+1];
+  f.read(comment,COMMENT_SIZE);
+  comment[COMMENT_SIZE]='\0';
+  f.close();
+  w.SetComment(std::string(comment));
+ }
+
+ w.Close();
+}
+
+#define CONVERT_FROM(S) \
+template void ConvertMatrix<S,unsigned char>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,char>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,unsigned short>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,short>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,unsigned int>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,int>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,unsigned long>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,long>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,unsigned long long>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,long long>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,float>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,double>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads); \
+template void ConvertMatrix<S,long double>(std::string iname,std::string oname,unsigned char mtype,unsigned char flags,unsigned int nthreads);
+
+CONVERT_FROM(unsigned char)
+CONVERT_FROM(char)
+CONVERT_FROM(unsigned short)
+CONVERT_FROM(short)
+CONVERT_FROM(unsigned int)
+CONVERT_FROM(int)
+CONVERT_FROM(unsigned long)
+CONVERT_FROM(long)
+CONVERT_FROM(unsigned long long)
+CONVERT_FROM(long long)
+CONVERT_FROM(float)
+CONVERT_FROM(double)
+CONVERT_FROM(long double)
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename S>
+static void JConvertMatrixFrom(std::string iname,std::string oname,unsigned char mtype,unsigned char ctype,unsigned char flags,unsigned int nthreads)
+{
+ switch (ctype)
+ {
+  case UCTYPE: ConvertMatrix<S,unsigned char>(iname,oname,mtype,flags,nthreads); break;
+  case SCTYPE: ConvertMatrix<S,char>(iname,oname,mtype,flags,nthreads); break;
+  case USTYPE: ConvertMatrix<S,unsigned short>(iname,oname,mtype,flags,nthreads); break;
+  case SSTYPE: ConvertMatrix<S,short>(iname,oname,mtype,flags,nthreads); break;
+  case UITYPE: ConvertMatrix<S,unsigned int>(iname,oname,mtype,flags,nthreads); break;
+  case SITYPE: ConvertMatrix<S,int>(iname,oname,mtype,flags,nthreads); break;
+  case ULTYPE: ConvertMatrix<S,unsigned long>(iname,oname,mtype,flags,nthreads); break;
+  case SLTYPE: ConvertMatrix<S,long>(iname,oname,mtype,flags,nthreads); break;
+  case ULLTYPE: ConvertMatrix<S,unsigned long long>(iname,oname,mtype,flags,nthreads); break;
+  case SLLTYPE: ConvertMatrix<S,long long>(iname,oname,mtype,flags,nthreads); break;
+  case FTYPE: ConvertMatrix<S,float>(iname,oname,mtype,flags,nthreads); break;
+  case DTYPE: ConvertMatrix<S,double>(iname,oname,mtype,flags,nthreads); break;
+  case LDTYPE: ConvertMatrix<S,long double>(iname,oname,mtype,flags,nthreads); break;
+  default: JMatrixStop("Unexpected error in JConvertMatrix: unknown data type.\n"); break;
+ }
+}
+
+void JConvertMatrix(std::string iname,std::string oname,unsigned char mtype,unsigned char ctype,unsigned char flags,unsigned int nthreads)
+{
+ unsigned char imtype,ictype;
+ MatrixType(iname,imtype,ictype);
+
+ // Bit matrices hold 0 or 1 and are always of type unsigned char
+ if (mtype==MTYPEBIT)
+  ctype=UCTYPE;
+
+ switch (ictype)
+ {
+  case UCTYPE: JConvertMatrixFrom<unsigned char>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case SCTYPE: JConvertMatrixFrom<char>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case USTYPE: JConvertMatrixFrom<unsigned short>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case SSTYPE: JConvertMatrixFrom<short>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case UITYPE: JConvertMatrixFrom<unsigned int>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case SITYPE: JConvertMatrixFrom<int>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case ULTYPE: JConvertMatrixFrom<unsigned long>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case SLTYPE: JConvertMatrixFrom<long>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case ULLTYPE: JConvertMatrixFrom<unsigned long long>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case SLLTYPE: JConvertMatrixFrom<long long>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case FTYPE: JConvertMatrixFrom<float>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case DTYPE: JConvertMatrixFrom<double>(iname,oname,mtype,ctype,flags,nthreads); break;
+  case LDTYPE: JConvertMatrixFrom<long double>(iname,oname,mtype,ctype,flags,nthreads); break;
+  default: JMatrixStop("Unexpected error in JConvertMatrix: unknown data type of the matrix in file "+iname+".\n"); break;
+ }
+}
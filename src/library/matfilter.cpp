@@ -0,0 +1,333 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <functional>
+#include <regex>
+#include <unordered_set>
+#include "../headers/matfilter.h"
+#include "../headers/matstats.h"
+#include "../headers/matsubmatrix.h"
+#include "../headers/jmatrixreader.h"
+#include "../headers/jmatrixwriter.h"
+#include "../headers/matmetadata.h"
+#include "../headers/matinfo.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+// Tells whether the filter has conditions on the number of non-zeros or on the sum, which need the values
+static bool HasValueConditions(const MatrixFilter &f)
+{
+ return (f.minnnz>0) || (f.minsum>-std::numeric_limits<double>::infinity()) || (f.maxsum<std::numeric_limits<double>::infinity());
+}
+
+static bool FulfilsValueConditions(const MatrixFilter &f,double nnz,double sum)
+{
+ return (nnz>=double(f.minnnz)) && (sum>=f.minsum) && (sum<=f.maxsum);
+}
+
+// Marks which of the n rows (or columns) fulfil the conditions of the filter on their names (all of them, if it has no such conditions)
+static void CheckNames(std::string iname,const MatrixFilter &f,const std::vector<std::string> &names,indextype n,std::string what,std::vector<bool> &ok)
+{
+ ok.assign(n,true);
+ if (f.regex.empty() && f.names.empty())
+  return;
+ if (names.size()==0)
+  JMatrixStop("FilterMatrix: the "+what+"s of the matrix in file "+iname+" have no names, so they cannot be filtered by their names.\n");
+
+ std::unordered_set<std::string> allowed(f.names.begin(),f.names.end());
+ std::regex re;
+ if (!f.regex.empty())
+ {
+  try
+  {
+   re=std::regex(f.regex);
+  }
+  catch (std::regex_error &e)
+  {
+   JMatrixStop("FilterMatrix: incorrect regular expression '"+f.regex+"' for the "+what+" names.\n");
+  }
+ }
+ for (indextype k=0; k<n; k++)
+  ok[k]=(allowed.empty() || (allowed.find(names[k])!=allowed.end())) && (f.regex.empty() || std::regex_search(names[k],re));
+}
+
+// Number of non-zeros and sum of the row loaded in the reader
+template <typename T>
+static void CountAndSum(JMatrixReader<T> &R,double &nnz,double &sum)
+{
+ nnz=0.0;
+ sum=0.0;
+ if (R.GetMatrixType()==MTYPESPARSE)
+ {
+  SparseRowSpan<T> s=R.GetSparseRow();
+  for (indextype k=0; k<s.n; k++)
+  {
+   nnz += (s.v[k]!=T(0));
+   sum += double(s.v[k]);
+  }
+ }
+ else
+ {
+  DenseRowSpan<T> s=R.GetDenseRow();
+  for (indextype c=0; c<s.n; c++)
+  {
+   nnz += (s.v[c]!=T(0));
+   sum += double(s.v[c]);
+  }
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Symmetric matrices: rows are complete only after the whole file is read, and the rows kept must be the columns kept
+template <typename T>
+static void FilterSymmetric(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter,indextype n,const std::vector<std::string> &names)
+{
+ std::vector<bool> rowok,colok;
+ CheckNames(iname,rowfilter,names,n,"row",rowok);
+ CheckNames(iname,colfilter,names,n,"column",colok);
+
+ FullMatrix<double> rowstats,colstats;
+ const bool values=HasValueConditions(rowfilter) || HasValueConditions(colfilter);
+ if (values)
+  MatrixStatistics<T>(iname,rowstats,colstats);
+
+ std::vector<indextype> kept;
+ for (indextype r=0; r<n; r++)
+ {
+  bool keep=rowok[r] && colok[r];
+  if (keep && values)
+   keep=FulfilsValueConditions(rowfilter,rowstats.Get(r,MSTAT_NNZ),rowstats.Get(r,MSTAT_SUM)) &&
+        FulfilsValueConditions(colfilter,rowstats.Get(r,MSTAT_NNZ),rowstats.Get(r,MSTAT_SUM));
+  if (keep)
+   kept.push_back(r);
+ }
+ if (kept.empty())
+  JMatrixStop("FilterMatrix: no row and column of the symmetric matrix in file "+iname+" fulfils the conditions.\n");
+
+ if (DEB & DEBJM)
+  std::cout << "Keeping " << kept.size() << " of the " << n << " rows and columns of the symmetric matrix in file " << iname << ".\n";
+
+ GetSubmatrix<T>(iname,oname,kept,kept);
+}
+
+template <typename T>
+void FilterMatrix(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("FilterMatrix");
+
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nrows,ncols;
+ MatrixType(iname,mtype,ctype,endian,mdinfo,nrows,ncols);
+
+ std::vector<std::string> rnames,cnames;
+ // Asked for separately, since asking for both returns none if only one of them is stored
+ InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+ InternalGetBinNames(iname,COL_NAMES,rnames,cnames);
+
+ if (mtype==MTYPESYMMETRIC)
+ {
+  FilterSymmetric<T>(iname,oname,rowfilter,colfilter,nrows,rnames);
+  return;
+ }
+
+ std::vector<bool> rowok,colok;
+ CheckNames(iname,rowfilter,rnames,nrows,"row",rowok);
+ CheckNames(iname,colfilter,cnames,ncols,"column",colok);
+ const bool rowvalues=HasValueConditions(rowfilter);
+ const bool sparse=(mtype==MTYPESPARSE);
+
+ // Whether each row is kept is decided the first time the file is read, and remembered for the next passes
+ std::vector<bool> rowkeep(nrows,false);
+ bool rowsknown=false;
+ auto readkept=[&](const std::function<void(JMatrixReader<T> &)> &f)
+ {
+  JMatrixReader<T> R(iname);
+  for (indextype r=0; r<nrows; r++)
+  {
+   R.NextRow();
+   if (!rowsknown)
+   {
+    bool keep=rowok[r];
+    if (keep && rowvalues)
+    {
+     double nnz,sum;
+     CountAndSum(R,nnz,sum);
+     keep=FulfilsValueConditions(rowfilter,nnz,sum);
+    }
+    rowkeep[r]=keep;
+   }
+   if (rowkeep[r])
+    f(R);
+  }
+  rowsknown=true;
+ };
+
+ // Conditions on the values of the columns are checked on the rows kept, whose column statistics are got in a first pass
+ if (HasValueConditions(colfilter))
+ {
+  std::vector<double> colnnz(ncols,0.0),colsum(ncols,0.0);
+  readkept([&](JMatrixReader<T> &R)
+  {
+   if (sparse)
+   {
+    SparseRowSpan<T> s=R.GetSparseRow();
+    for (indextype k=0; k<s.n; k++)
+    {
+     colnnz[s.c[k]] += (s.v[k]!=T(0));
+     colsum[s.c[k]] += double(s.v[k]);
+    }
+   }
+   else
+   {
+    DenseRowSpan<T> s=R.GetDenseRow();
+    for (indextype c=0; c<s.n; c++)
+    {
+     colnnz[c] += (s.v[c]!=T(0));
+     colsum[c] += double(s.v[c]);
+    }
+   }
+  });
+  for (indextype c=0; c<ncols; c++)
+   colok[c]=colok[c] && FulfilsValueConditions(colfilter,colnnz[c],colsum[c]);
+ }
+
+ // New place of each column kept (ncols for those not kept)
+ std::vector<indextype> keptcols,newcol(ncols,ncols);
+ for (indextype c=0; c<ncols; c++)
+  if (colok[c])
+  {
+   newcol[c]=indextype(keptcols.size());
+   keptcols.push_back(c);
+  }
+ if (keptcols.empty())
+  JMatrixStop("FilterMatrix: no column of the matrix in file "+iname+" fulfils the conditions.\n");
+ const indextype nout=indextype(keptcols.size());
+ const bool allcols=(nout==ncols);
+
+ if (DEB & DEBJM)
+  std::cout << "Filtering the rows of the (" << nrows << "x" << ncols << ") matrix in file " << iname << ", keeping " << nout << " columns.\n";
+
+ JMatrixWriter<T> w(oname,mtype,nout);
+ std::vector<indextype> oc;
+ std::vector<T> ov(nout);
+
+ // Leaves in ov the kept columns of the loaded row, or in (oc,ov) its non-zero entries in kept columns, with their new indices
+ auto getrow=[&](JMatrixReader<T> &R)
+ {
+  if (sparse)
+  {
+   SparseRowSpan<T> s=R.GetSparseRow();
+   oc.clear();
+   ov.clear();
+   for (indextype k=0; k<s.n; k++)
+    if (newcol[s.c[k]]<ncols)
+    {
+     oc.push_back(newcol[s.c[k]]);
+     ov.push_back(s.v[k]);
+    }
+  }
+  else
+  {
+   DenseRowSpan<T> s=R.GetDenseRow();
+   if (allcols)
+    ov.assign(s.v,s.v+s.n);
+   else
+    for (indextype j=0; j<nout; j++)
+     ov[j]=s.v[keptcols[j]];
+  }
+ };
+
+ // Quantised encodings need the range of the values before the first row is written, which takes another pass
+ if (w.NeedsValueRange())
+ {
+  double minv=std::numeric_limits<double>::max();
+  double maxv=std::numeric_limits<double>::lowest();
+  readkept([&](JMatrixReader<T> &R)
+  {
+   getrow(R);
+   for (size_t j=0; j<ov.size(); j++)
+   {
+    minv=std::min(minv,double(ov[j]));
+    maxv=std::max(maxv,double(ov[j]));
+   }
+  });
+  w.SetValueRange(minv,maxv);
+ }
+
+ std::vector<std::string> sel;
+ readkept([&](JMatrixReader<T> &R)
+ {
+  getrow(R);
+  if (sparse)
+   w.AppendSparseRow(indextype(oc.size()),oc.data(),ov.data());
+  else
+   w.AppendRow(ov.data());
+  if (rnames.size()>0)
+   sel.push_back(rnames[R.CurrentRow()]);
+ });
+
+ indextype nkept=indextype(std::count(rowkeep.begin(),rowkeep.end(),true));
+ JStatRows(nkept);
+ JStatElements((unsigned long long)nkept*nout);
+ if (nkept==0)
+  JMatrixWarning("FilterMatrix: no row of the matrix in file "+iname+" fulfils the conditions. The result has no rows.\n");
+
+ if ((rnames.size()>0) && (nkept>0))
+  w.SetRowNames(sel);
+ if (cnames.size()>0)
+ {
+  sel.clear();
+  for (indextype j=0; j<nout; j++)
+   sel.push_back(cnames[keptcols[j]]);
+  w.SetColNames(sel);
+ }
+ w.Close();
+}
+
+TEMPLATES_ISOLATED_FUNC(void,FilterMatrix,SINGLE_ARG(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter))
+
+/////////////////////////////////////////////////////////////////////
+
+void JFilterMatrix(std::string iname,std::string oname,const MatrixFilter &rowfilter,const MatrixFilter &colfilter)
+{
+ unsigned char mtype,ctype;
+ MatrixType(iname,mtype,ctype);
+
+ switch (ctype)
+ {
+  case UCTYPE: FilterMatrix<unsigned char>(iname,oname,rowfilter,colfilter); break;
+  case SCTYPE: FilterMatrix<char>(iname,oname,rowfilter,colfilter); break;
+  case USTYPE: FilterMatrix<unsigned short>(iname,oname,rowfilter,colfilter); break;
+  case SSTYPE: FilterMatrix<short>(iname,oname,rowfilter,colfilter); break;
+  case UITYPE: FilterMatrix<unsigned int>(iname,oname,rowfilter,colfilter); break;
+  case SITYPE: FilterMatrix<int>(iname,oname,rowfilter,colfilter); break;
+  case ULTYPE: FilterMatrix<unsigned long>(iname,oname,rowfilter,colfilter); break;
+  case SLTYPE: FilterMatrix<long>(iname,oname,rowfilter,colfilter); break;
+  case ULLTYPE: FilterMatrix<unsigned long long>(iname,oname,rowfilter,colfilter); break;
+  case SLLTYPE: FilterMatrix<long long>(iname,oname,rowfilter,colfilter); break;
+  case FTYPE: FilterMatrix<float>(iname,oname,rowfilter,colfilter); break;
+  case DTYPE: FilterMatrix<double>(iname,oname,rowfilter,colfilter); break;
+  case LDTYPE: FilterMatrix<long double>(iname,oname,rowfilter,colfilter); break;
+  default: JMatrixStop("Unexpected error in JFilterMatrix: unknown data type.\n"); break;
+ }
+}
@@ -0,0 +1,254 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <type_traits>
+#include "../headers/matgenerate.h"
+#include "../headers/jmatrixwriter.h"
+
+extern unsigned char DEB;
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+static T GenValue(GenRNG &g)
+{
+ if (std::is_floating_point<T>::value)
+  return T(1.0-g.Uniform());
+ else
+  return T(1+g.Below(100));
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Chooses the sorted positions of the non-zero entries of a row of length len
+static void GenPositions(GenRNG &g,indextype len,double density,double skew,std::vector<indextype> &pos)
+{
+ pos.clear();
+ if (len==0)
+  return;
+
+ double expected=density*double(len);
+ if (skew>0.0)
+  expected *= exp(skew*g.Normal()-0.5*skew*skew);
+ // Randomized rounding, so that the mean length is kept even when expected is below 1
+ double fl=floor(expected);
+ indextype k=(expected>=double(len)) ? len : indextype(fl)+((g.Uniform()<expected-fl) ? 1 : 0);
+ if (k>len)
+  k=len;
+
+ if (k==len)
+ {
+  pos.resize(len);
+  for (indextype c=0;c<len;c++)
+   pos[c]=c;
+  return;
+ }
+
+ if (2*(unsigned long long)k>(unsigned long long)len)
+ {
+  // Dense rows: sequential selection sampling, linear in len
+  indextype needed=k;
+  for (indextype c=0;(c<len) && (needed>0);c++)
+   if (g.Uniform()*double(len-c)<double(needed))
+   {
+    pos.push_back(c);
+    needed--;
+   }
+  return;
+ }
+
+ // Sparse rows: draw, sort and remove repetitions until there are k different positions
+ while (pos.size()<k)
+ {
+  size_t missing=k-pos.size();
+  for (size_t i=0;i<missing;i++)
+   pos.push_back(indextype(g.Below(len)));
+  sort(pos.begin(),pos.end());
+  pos.erase(unique(pos.begin(),pos.end()),pos.end());
+ }
+}
+
+//////////////////////////////////////////////////////////////////
+
+// Generates the rows first+t, first+t+step,... lower than last. Dense rows (full and symmetric matrices) are left in v,
+// sparse rows as (column,value) pairs in c and v.
+template <typename T>
+static void GenRows(unsigned char mtype,indextype first,indextype last,indextype t,indextype step,indextype ncols,
+                    double density,double skew,unsigned long long seed,
+                    std::vector<std::vector<indextype>> &c,std::vector<std::vector<T>> &v)
+{
+ std::vector<indextype> pos;
+ for (indextype r=first+t;r<last;r+=step)
+ {
+  GenRNG g(seed,r);
+  indextype len=(mtype==MTYPESYMMETRIC) ? r+1 : ncols;
+  GenPositions(g,len,density,skew,pos);
+
+  std::vector<T> &rv=v[r-first];
+  if (mtype==MTYPESPARSE)
+  {
+   c[r-first]=pos;
+   rv.resize(pos.size());
+   for (size_t k=0;k<pos.size();k++)
+    rv[k]=GenValue<T>(g);
+  }
+  else
+  {
+   rv.assign(len,T(0));
+   for (size_t k=0;k<pos.size();k++)
+    rv[pos[k]]=GenValue<T>(g);
+  }
+ }
+}
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void GenerateMatrix(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads)
+{
+ JMatrixOpScope opscope(STATS_GENERATE);
+ JMatrixTraceSpan span("GenerateMatrix");
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+  JMatrixStop("GenerateMatrix: unknown matrix type.\n");
+ if ((mtype==MTYPESYMMETRIC) && (nrows!=ncols))
+  JMatrixStop("GenerateMatrix: symmetric matrices must have the same number of rows and columns.\n");
+ if ((density<0.0) || (density>1.0))
+  JMatrixStop("GenerateMatrix: density must be between 0 and 1.\n");
+ if (skew<0.0)
+  JMatrixStop("GenerateMatrix: skew cannot be negative.\n");
+
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads==0)
+  nthreads=1;
+
+ // Rows per block, so that each of the two blocks alive at a time (the one being written and the one being generated) takes about GEN_BLOCK_SIZE bytes
+ double rowbytes=double(ncols)*double(sizeof(T));
+ if (mtype==MTYPESPARSE)
+  rowbytes=std::max(1.0,density*double(ncols))*double(sizeof(T)+sizeof(indextype));
+ if (mtype==MTYPESYMMETRIC)
+  rowbytes *= 0.5;
+ indextype blockrows=indextype(std::max(1.0,double(GEN_BLOCK_SIZE)/std::max(1.0,rowbytes)));
+ blockrows=std::max(blockrows,indextype(4*nthreads));
+ if (blockrows>nrows)
+  blockrows=std::max(nrows,indextype(1));
+
+ if (DEB & DEBJM)
+  std::cout << "Generating " << MatrixTypeName(mtype) << " matrix of " << nrows << "x" << ncols << " with density " << density << ", skew " << skew
+            << " and seed " << seed << " in blocks of " << blockrows << " rows with " << nthreads << " threads.\n";
+
+ JMatrixWriter<T> w(fname,mtype,ncols);
+ // Floating point values are in (0,1], which is all a quantised encoding of them needs to know
+ w.SetValueRange(0.0,1.0);
+
+ std::vector<std::vector<indextype>> c[2];
+ std::vector<std::vector<T>> v[2];
+ std::vector<std::thread> workers;
+
+ auto launch=[&](unsigned b,indextype first)
+ {
+  indextype last=std::min(nrows,first+blockrows);
+  c[b].resize(last-first);
+  v[b].resize(last-first);
+  for (unsigned int t=0;t<nthreads;t++)
+   workers.push_back(std::thread(GenRows<T>,mtype,first,last,indextype(t),indextype(nthreads),ncols,density,skew,seed,std::ref(c[b]),std::ref(v[b])));
+ };
+
+ unsigned cur=0;
+ if (nrows>0)
+  launch(cur,0);
+ for (indextype first=0;first<nrows;first+=blockrows)
+ {
+  for (size_t t=0;t<workers.size();t++)
+   workers[t].join();
+  workers.clear();
+
+  // Next block is generated while this one is written
+  indextype next=first+blockrows;
+  if (next<nrows)
+   launch(1-cur,next);
+
+  for (size_t i=0;i<v[cur].size();i++)
+  {
+   if (mtype==MTYPESPARSE)
+    w.AppendSparseRow(indextype(c[cur][i].size()),c[cur][i].data(),v[cur][i].data());
+   else
+    w.AppendRow(v[cur][i].data());
+   JStatElements(v[cur][i].size());
+  }
+  JStatRows(v[cur].size());
+  cur=1-cur;
+ }
+
+ if (withnames)
+ {
+  std::vector<std::string> names(nrows);
+  for (indextype r=0;r<nrows;r++)
+   names[r]="R"+std::to_string(r+1);
+  w.SetRowNames(names);
+  if (mtype!=MTYPESYMMETRIC)
+  {
+   names.resize(ncols);
+   for (indextype k=0;k<ncols;k++)
+    names[k]="C"+std::to_string(k+1);
+  }
+  w.SetColNames(names);
+ }
+
+ w.Close();
+}
+
+template void GenerateMatrix<unsigned char>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<char>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<unsigned short>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<short>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<unsigned int>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<int>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<unsigned long>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<long>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<unsigned long long>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<long long>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<float>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<double>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+template void GenerateMatrix<long double>(std::string fname,unsigned char mtype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads);
+
+//////////////////////////////////////////////////////////////////
+
+void JGenMatrix(std::string oname,unsigned char mtype,unsigned char ctype,indextype nrows,indextype ncols,double density,double skew,unsigned long long seed,bool withnames,unsigned int nthreads)
+{
+ switch (ctype)
+ {
+  case UCTYPE: GenerateMatrix<unsigned char>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case SCTYPE: GenerateMatrix<char>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case USTYPE: GenerateMatrix<unsigned short>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case SSTYPE: GenerateMatrix<short>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case UITYPE: GenerateMatrix<unsigned int>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case SITYPE: GenerateMatrix<int>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case ULTYPE: GenerateMatrix<unsigned long>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case SLTYPE: GenerateMatrix<long>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case ULLTYPE: GenerateMatrix<unsigned long long>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case SLLTYPE: GenerateMatrix<long long>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case FTYPE: GenerateMatrix<float>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case DTYPE: GenerateMatrix<double>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  case LDTYPE: GenerateMatrix<long double>(oname,mtype,nrows,ncols,density,skew,seed,withnames,nthreads); break;
+  default: JMatrixStop("Unexpected error in JGenMatrix: unknown data type.\n"); break;
+ }
+}
@@ -23,7 +23,11 @@
 #include "../headers/fullmatrix.h"
 #include "../headers/sparsematrix.h"
 #include "../headers/symmetricmatrix.h"
+#include "../headers/bitmatrix.h"
 #include "../headers/matmetadata.h"
+#include "../headers/matgetrows.h"
+#include "../headers/matgetcols.h"
+#include "../headers/jmatrixreader.h"
 
 extern unsigned char DEB;
 
@@ -40,19 +44,26 @@ extern unsigned char DEB;
 template <typename T>
 void GetJustOneColumnFromFull(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v)
 {
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetJustOneColumnFromFull");
+ JStatRows(1);
+ JStatElements(nrows);
  T *data = new T [nrows]; 
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  
  std::ifstream f(fname.c_str());
  // This places us at the nc column of first row (row 0)
- std::streampos offset=HEADER_SIZE+nc*sizeof(T);
+ std::streampos offset=HEADER_SIZE+nc*es;
  for (indextype r=0; r<nrows; r++)
  {
   f.seekg(offset,std::ios::beg);
+  JStatSeek();
   // We read one element
-  f.read((char *)(&data[r]),sizeof(T));
+  ReadValues(f,vc,1,&data[r]);
   // This jumps exactly one row, up to just before the nc column of next row.
   // The number of bytes in one row is the number of columns multiplied by the size of one element.
-  offset += (ncols*sizeof(T));
+  offset += (ncols*es);
  }
  f.close();
 
@@ -81,7 +92,13 @@ template void GetJustOneColumnFromFull(std::string fname,indextype nc,indextype
 template <typename T>
 void GetManyColumnsFromFull(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m)
 {
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetManyColumnsFromFull");
+ JStatRows(ncs.size());
+ JStatElements((unsigned long long)ncs.size()*nrows);
  T data;
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  
  std::ifstream f(fname.c_str());
  std::streampos offset;
@@ -93,17 +110,18 @@ void GetManyColumnsFromFull(std::string fname,std::vector<indextype> ncs,indexty
  for (size_t t=0; t<ncs.size(); t++)
  {
   // This places us at the requested column of the first row
-  offset=HEADER_SIZE+ncs[t]*sizeof(T);
+  offset=HEADER_SIZE+ncs[t]*es;
   for (indextype r=0; r<nrows; r++)
   {
    f.seekg(offset,std::ios::beg);
+   JStatSeek();
    // We read one element
-   f.read((char *)(&data),sizeof(T));
+   ReadValues(f,vc,1,&data);
 
    m[r][t]=data;
    // This jumps exactly one row, up to just before the nc column of next row.
    // The number of bytes in one row is the number of columns multiplied by the size of one element.
-   offset += ((std::streampos)ncols*sizeof(T));
+   offset += ((std::streampos)ncols*es);
   }
   
  }
@@ -124,11 +142,80 @@ template void GetManyColumnsFromFull(std::string fname,std::vector<indextype> nc
 template void GetManyColumnsFromFull(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<double>> &m);
 template void GetManyColumnsFromFull(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<long double>> &m);
 
+// A column of a bit matrix is spread along all the file, which is small, so it is read sequentially with a JMatrixReader
+// instead of seeking to each row. Many columns are taken in the same pass.
+template <typename T>
+void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m)
+{
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetManyColumnsFromBit");
+ JStatRows(ncs.size());
+ JStatElements((unsigned long long)ncs.size()*nrows);
+
+ m=std::vector<std::vector<T>>(nrows,std::vector<T>(ncs.size(),T(0)));
+ JMatrixReader<T> R(fname);
+ if (R.GetMatrixType()!=MTYPEBIT)
+  JMatrixStop("GetManyColumnsFromBit: the matrix in file "+fname+" is not a bit matrix.\n");
+ indextype r=0;
+ while (R.NextRow() && (r<nrows))
+ {
+  const unsigned long long *w=R.GetBitRowWords();
+  for (size_t t=0; t<ncs.size(); t++)
+   m[r][t]=T((w[ncs[t]/BIT_WORD_BITS] >> (ncs[t]%BIT_WORD_BITS)) & 1ULL);
+  r++;
+ }
+}
+
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<char>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<short>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<int>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<long>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<long long>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<float>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<double>> &m);
+template void GetManyColumnsFromBit(std::string fname,std::vector<indextype> ncs,indextype nrows,indextype ncols,std::vector<std::vector<long double>> &m);
+
+template <typename T>
+void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v)
+{
+ std::vector<std::vector<T>> m;
+ GetManyColumnsFromBit(fname,std::vector<indextype>(1,nc),nrows,ncols,m);
+ v=std::vector<T>(nrows,T(0));
+ for (indextype r=0; r<nrows; r++)
+  v[r]=m[r][0];
+}
+
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<unsigned char> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<char> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<unsigned short> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<short> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<unsigned int> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<int> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<unsigned long> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<long> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<unsigned long long> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<long long> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<float> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<double> &v);
+template void GetJustOneColumnFromBit(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<long double> &v);
+
 template <typename T>
 void GetJustOneColumnFromSparse(std::string fname,indextype nc,indextype nrows,indextype ncols,std::vector<T> &v)
 {
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetJustOneColumnFromSparse");
+ JStatRows(1);
+ JStatElements(nrows);
  T *data = new T [nrows];
  indextype *idata = new indextype [ncols];  // This is by excess. Most rows will not have ncols real columns, since the matrix is sparse.
+ unsigned char sformat=SparseFormat(fname);
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  
  std::ifstream f(fname.c_str());
  
@@ -136,36 +223,40 @@ void GetJustOneColumnFromSparse(std::string fname,indextype nc,indextype nrows,i
  // we must go to the start of each row to find out how many...
  std::streampos offset=HEADER_SIZE;
  indextype c,ncr;
- unsigned long long to_add;
+ unsigned long long ibytes,to_add;
  for (indextype r=0; r<nrows; r++)
  {
   f.seekg(offset,std::ios::beg);
+  JStatSeek();
   // At the beginning of row r: read how many element there are in it (ncr):
-  f.read((char *)&ncr,(std::streampos)sizeof(indextype));
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
   // Read the indices of this row
-  f.read((char *)idata,(std::streampos)ncr*sizeof(indextype));
+  ReadSparseIndices(f,sformat,ncr,ibytes,idata);
   // See if the index of the column we are looking for is there (a while loop with premature exit is OK, indices are ordered)
   c=0;
   while ( (c<ncr) && (idata[c]<nc) )
    c++;
   if ((c>=ncr) || (idata[c]!=nc))
    data[r]=0;
+  else if (sformat & SPARSE_PATTERN)
+   data[r]=T(1);
   else
   {
-   // offset is now the beginning of the current row. We jump the indices (and the number of non-null indices, which is the reason of '+1' in ncr+1)
+   // offset is now the beginning of the current row. We jump the number of non-null indices and the indices themselves
    // and also jump the first c data, too.
-   to_add = (ncr+1)*sizeof(indextype)+c*sizeof(T);
+   to_add = SparseRowHeadSize(sformat)+ibytes+c*es;
    f.seekg(offset+(std::streampos)to_add,std::ios::beg);
-   f.read((char *)(&data[r]),(std::streampos)sizeof(T));
+   JStatSeek();
+   ReadValues(f,vc,1,&data[r]);
   }
-  // We advance up to the beginning of next row. The size of this row consists on the nc indices, plus the number of non-null indices, plut the number of present values.
-  offset += (((std::streampos)(ncr+1))*sizeof(indextype)+((std::streampos)ncr*sizeof(T)));
+  // We advance up to the beginning of next row. The size of this row consists on the number of non-null indices, plus the indices, plut the number of present values.
+  offset += (std::streampos)(SparseRowHeadSize(sformat)+ibytes+SparseValueBytes(sformat,ncr,es));
  }
  
  f.close();
 
  // Clear the vector to be returned
- v=std::vector<T>(ncols,T(0));
+ v=std::vector<T>(nrows,T(0));
  for (size_t r=0; r<nrows; r++)
   v[r]=data[r];
   
@@ -192,19 +283,28 @@ template void GetJustOneColumnFromSparse(std::string fname,indextype nc,indextyp
 template <typename T>
 void GetManyColumnsFromSparse(std::string fname,std::vector<indextype> nc,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m)
 {
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetManyColumnsFromSparse");
+ JStatRows(nc.size());
+ JStatElements((unsigned long long)nc.size()*nrows);
  // Differently to the function to get rows, here we need the offsets of absolutely all rows, since at least one element will be extracted from each of them
  std::vector<std::streampos> offsets(nrows,HEADER_SIZE);
  
+ unsigned char sformat=SparseFormat(fname);
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  std::ifstream f(fname.c_str()); 
  std::streampos offset=HEADER_SIZE;
  
  indextype ncr;
+ unsigned long long ibytes;
  for (size_t t=0;t<nrows;t++)
  {
   offsets[t]=offset;
   f.seekg(offset,std::ios::beg);
-  f.read((char *)&ncr,sizeof(indextype));
-  offset += (((std::streampos)(ncr+1))*sizeof(indextype)+(std::streampos)ncr*sizeof(T));
+  JStatSeek();
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
+  offset += (std::streampos)(SparseRowHeadSize(sformat)+ibytes+SparseValueBytes(sformat,ncr,es));
  }
  
  // These are temporary arrays to store the indices and values of a row.
@@ -222,12 +322,13 @@ void GetManyColumnsFromSparse(std::string fname,std::vector<indextype> nc,indext
  for (size_t t=0; t<nrows; t++)
  {
   f.seekg(offsets[t],std::ios::beg);
+  JStatSeek();
   // At the beginning of row r: read how many element there are in it (ncr):
-  f.read((char *)&ncr,(std::streamsize)sizeof(indextype));
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
   // Let's read its indices... No problem with size, ncr is always smaller than ncols
-  f.read((char *)idata,(std::streamsize)ncr*sizeof(indextype));
+  ReadSparseIndices(f,sformat,ncr,ibytes,idata);
   // ... and let's read the data
-  f.read((char *)data,(std::streamsize)ncr*sizeof(T));
+  ReadSparseValues(f,sformat,vc,ncr,data);
   
   // Fill the appropriate places of the matrix (those dictated by the indices in idata)
   for (size_t c=0; c<nc.size(); c++)
@@ -263,38 +364,9 @@ template void GetManyColumnsFromSparse(std::string fname,std::vector<indextype>
 template <typename T>
 void GetJustOneColumnFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
 {
- unsigned long long nrl=(std::streampos)nr;
- T *data = new T [ncols]; 
- 
- std::ifstream f(fname.c_str());
- 
- // This is the beginning of row nr in the binary symmetric data
- std::streampos offset=HEADER_SIZE+((nrl*(nrl+1))/2)*sizeof(T);
- 
- f.seekg(offset,std::ios::beg);
- 
- // Here we read the nr+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
- f.read((char *)data,(std::streamsize)((nrl+1)*sizeof(T)));
- 
- // The rest of this row is not physically after; we must read the rest of the column that starts in the diagonal, down to the end.
- // It would be clearer to write r=nr+1; r<nrows; r++ but we haven't a variable nrows. But we don't need: symmetric matrices are square.
- offset=HEADER_SIZE+(nrl+((nrl+1)*(nrl+2))/2)*sizeof(T);
- for (indextype r=nr+1; r<ncols; r++)
- {
-  f.seekg(offset,std::ios::beg);
-  // Here we read just one value...
-  f.read((char *)&(data[r]),(std::streamsize)sizeof(T));
-  // and advance to the next row, taking into account that each row has a different number of really stored columns, which is r+1
-  offset += ((std::streampos)(r+1)*sizeof(T));
- }
- f.close();
-
- // Clear the vector to be returned
- v=std::vector<T>(ncols,T(0));
- for (size_t c=0; c<ncols; c++)
-  v[c]=data[c];
-  
- delete[] data;
+ JMatrixOpScope opscope(STATS_GETCOLS);     // Counters are incremented by the row function, but attributed to this operation
+ JMatrixTraceSpan span("GetJustOneColumnFromSymmetric");
+ GetJustOneRowFromSymmetric(fname,nr,ncols,v);
 }
 
 template void GetJustOneColumnFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<unsigned char> &v);
@@ -318,48 +390,19 @@ template void GetJustOneColumnFromSymmetric(std::string fname,indextype nr,index
 template <typename T>
 void GetManyColumnsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m)
 {
- T *data = new T [ncols]; 
- 
- std::ifstream f(fname.c_str());
- std::streampos  offset;
- unsigned long long nrl;
- 
+ JMatrixOpScope opscope(STATS_GETCOLS);
+ JMatrixTraceSpan span("GetManyColumnsFromSymmetric");
+ std::vector<std::vector<T>> rows;
+ GetManyRowsFromSymmetric(fname,nr,ncols,rows);
+
  m.clear();
  m=std::vector<std::vector<T>>(ncols);
  for (size_t r=0;r<ncols;r++)
    m[r]=std::vector<T>(nr.size(),T(0));
 
  for (size_t t=0; t<nr.size(); t++)
- {
-  // This is the beginning of row nr in the binary symmetric data
-  nrl=(unsigned long long)nr[t];
-  offset=HEADER_SIZE+((nrl*(nrl+1))/2)*sizeof(T);
-  f.seekg(offset,std::ios::beg);
-  // Here we read the nr+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
-  f.read((char *)data,(std::streamsize)((nrl+1)*sizeof(T)));
- 
-  for (size_t c=0; c<nr[t]+1; c++)
-   m[c][t]=data[c];                   // This is the difference w.r.t. the original, m is filled transposed
-   
-  // The rest of this row is not physically after; we must read the rest of the column that starts in the diagonal, down to the end.
-  // It would be clearer to write r=nr+1; r<nrows; r++ but we haven't a variable nrows. But we don't need: symmetric matrices are square.
-  offset=HEADER_SIZE+sizeof(T)*(nrl+((nrl+1)*(nrl+2))/2);
-  for (indextype r=nr[t]+1; r<ncols; r++)
-  {
-   f.seekg(offset,std::ios::beg);
-   // Here we read just one value...
-   f.read((char *)&(data[r]),(std::streamsize)sizeof(T));
-   // and advance to the next row, taking into account that each row has a different number of really stored columns, which is r+1
-   offset += ((std::streampos)(r+1)*sizeof(T));
-  }
-  
-  for (size_t c=nr[t]+1; c<ncols; c++)
-   m[c][t]=data[c];                  // This is the difference w.r.t. the original, m is filled transposed
- }
- 
- f.close();
- 
- delete[] data;
+  for (size_t c=0; c<ncols; c++)
+   m[c][t]=rows[t][c];                   // This is the difference w.r.t. the original, m is filled transposed
 }
 
 template void GetManyColumnsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned char>> &m);
@@ -381,7 +424,7 @@ using namespace std;
 template <typename T>
 void NCEmit(string ofile,vector<T> &v,unsigned char mtype,const vector<string> &rownames,string colname)
 {
- if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC) || (mtype==MTYPEBIT))
  {
    FullMatrix<T> V(v.size(),1);
    for (size_t i=0;i<v.size();i++)
@@ -394,7 +437,13 @@ void NCEmit(string ofile,vector<T> &v,unsigned char mtype,const vector<string> &
     dummy.push_back(colname);
     V.SetColNames(dummy);
    }
-   V.WriteBin(ofile);
+   if (mtype==MTYPEBIT)
+   {
+    BitMatrix B(V);
+    B.WriteBin(ofile);
+   }
+   else
+    V.WriteBin(ofile);
   }
   else
   {
@@ -416,7 +465,7 @@ void NCEmit(string ofile,vector<T> &v,unsigned char mtype,const vector<string> &
 template <typename T>
 void NCSEmit(string ofile,vector<vector<T>> &v,unsigned char mtype,const vector<string> &rownames,vector<string> &colnames)
 {
- if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC) || (mtype==MTYPEBIT))
  {
    FullMatrix<T> V(v.size(),v[0].size());
    for (size_t i=0;i<v.size();i++)
@@ -426,7 +475,13 @@ void NCSEmit(string ofile,vector<vector<T>> &v,unsigned char mtype,const vector<
     V.SetRowNames(rownames);
    if (colnames.size()!=0)
     V.SetColNames(colnames);
-   V.WriteBin(ofile);
+   if (mtype==MTYPEBIT)
+   {
+    BitMatrix B(V);
+    B.WriteBin(ofile);
+   }
+   else
+    V.WriteBin(ofile);
  }
  else
  {
@@ -465,6 +520,10 @@ void NCSelect(string inmat,indextype ncol,indextype nrows,indextype ncols,string
         GetJustOneColumnFromSymmetric<T>(inmat,ncol,ncols,v);
         NCEmit<T>(ofile,v,MTYPESYMMETRIC,rownames,colname);
         break;
+  case MTYPEBIT:
+        GetJustOneColumnFromBit<T>(inmat,ncol,nrows,ncols,v);
+        NCEmit<T>(ofile,v,MTYPEBIT,rownames,colname);
+        break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
@@ -493,6 +552,10 @@ void NCSSelect(string inmat,vector<indextype> lcols,indextype nrows,indextype nc
         GetManyColumnsFromSymmetric<T>(inmat,lcols,ncols,v);
         NCSEmit<T>(ofile,v,MTYPESYMMETRIC,rownames,sel_colnames);
         break;
+  case MTYPEBIT:
+        GetManyColumnsFromBit<T>(inmat,lcols,nrows,ncols,v);
+        NCSEmit<T>(ofile,v,MTYPEBIT,rownames,sel_colnames);
+        break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
@@ -30,18 +30,25 @@ extern unsigned char DEB;
 template <typename T>
 void GSDiag(std::string fname,indextype nrows,std::vector<T> &v)
 {
+ JMatrixOpScope opscope(STATS_GETDIAG);
+ JMatrixTraceSpan span("GSDiag");
+ JStatRows(nrows);
+ JStatElements(((unsigned long long)nrows*(nrows-1))/2);
  T *data = new T [nrows];
+ v.resize(((unsigned long long)nrows*(nrows-1))/2);
   
+ ValueCodec vc=ValueCodecFromFile(fname);
  std::ifstream f(fname.c_str());
  
  // This is the beginning of row 1 in the binary symmetric data
- size_t offset=HEADER_SIZE+sizeof(T);
+ size_t offset=HEADER_SIZE+ValueSize(vc,sizeof(T));
  f.seekg(offset,std::ios::beg);
+ JStatSeek();
  
  for (indextype r=1; r<nrows; r++)
  {
   // Here we read the r+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
-  f.read((char *)data,(r+1)*sizeof(T));
+  ReadValues(f,vc,r+1,data);
   // but we copy all of them, except the last one, at the appropriate place of return array so that theay are ordered by column.
   for (indextype c=0; c<r; c++)
    v[c*(nrows-1)-((c*(c-1))/2)+r-c-1]=data[c];
@@ -20,10 +20,16 @@
 #include <cstdlib>
 #include <string>
 #include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "../headers/fullmatrix.h"
 #include "../headers/sparsematrix.h"
 #include "../headers/symmetricmatrix.h"
+#include "../headers/bitmatrix.h"
 #include "..//headers/matmetadata.h"
+#include "../headers/matgetrows.h"
+#include "../headers/jmatrixreader.h"
 
 extern unsigned char DEB;
 
@@ -40,14 +46,21 @@ extern unsigned char DEB;
 template <typename T>
 void GetJustOneRowFromFull(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
 {
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetJustOneRowFromFull");
+ JStatRows(1);
+ JStatElements(ncols);
  std::streampos nrl=(std::streampos)nr;
  T *data = new T [ncols]; 
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  
  std::ifstream f(fname.c_str());
  // Start of row nr is at the end of former rows, each of them having ncols elements
- f.seekg(HEADER_SIZE+nrl*ncols*sizeof(T),std::ios::beg);
+ f.seekg(HEADER_SIZE+nrl*ncols*es,std::ios::beg);
+ JStatSeek();
  // Here we simply read ncols elements
- f.read((char *)data,(std::streamsize)ncols*sizeof(T));
+ ReadValues(f,vc,ncols,data);
  f.close();
  
  v=std::vector<T>(ncols,T(0));
@@ -76,7 +89,13 @@ template void GetJustOneRowFromFull(std::string fname,indextype nr,indextype nco
 template <typename T>
 void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m)
 {
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetManyRowsFromFull");
+ JStatRows(nr.size());
+ JStatElements((unsigned long long)nr.size()*ncols);
  T *data = new T [ncols]; 
+ ValueCodec vc=ValueCodecFromFile(fname);
+ unsigned long long es=(unsigned long long)ValueSize(vc,sizeof(T));
  
  m.clear();
  std::vector<T> vdata;
@@ -86,10 +105,12 @@ void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype n
  {
   nrl=(unsigned long long)nr[t];
   // Start of row nr is at the end of former rows, each of them having ncols elements
-  f.seekg((std::streampos)(HEADER_SIZE+nrl*ncols*sizeof(T)),std::ios::beg);
+  f.seekg((std::streampos)(HEADER_SIZE+nrl*ncols*es),std::ios::beg);
+  JStatSeek();
   // Here we simply read ncols elements
-  f.read((char *)data,(std::streamsize)ncols*sizeof(T));
+  ReadValues(f,vc,ncols,data);
   // and put them in the matrix
+  vdata.clear();
   for (indextype c=0; c<ncols; c++)
    vdata.push_back(data[c]);
 
@@ -99,27 +120,122 @@ void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype n
  delete[] data;
 }
 
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<char>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<short>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<int>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long long>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<float>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<double>> &m);
+template void GetManyRowsFromFull(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long double>> &m);
+
+// Rows of bit matrices take BitRowWords(ncols) words each, so they are reached with a single seek, as those of full matrices, and unpacked to values 0 and 1.
+template <typename T>
+void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
+{
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetJustOneRowFromBit");
+ JStatRows(1);
+ JStatElements(ncols);
+ size_t nw=BitRowWords(ncols);
+ std::vector<unsigned long long> w(nw);
+
+ std::ifstream f(fname.c_str());
+ f.seekg((std::streampos)(HEADER_SIZE+(unsigned long long)nr*nw*sizeof(unsigned long long)),std::ios::beg);
+ JStatSeek();
+ f.read((char *)w.data(),(std::streamsize)(nw*sizeof(unsigned long long)));
+ JStatRead(nw*sizeof(unsigned long long));
+ f.close();
+
+ v=std::vector<T>(ncols,T(0));
+ UnpackBitRow(w.data(),ncols,v.data());
+}
+
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<unsigned char> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<char> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<unsigned short> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<short> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<unsigned int> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<int> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<unsigned long> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<long> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<unsigned long long> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<long long> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<float> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<double> &v);
+template void GetJustOneRowFromBit(std::string fname,indextype nr,indextype ncols,std::vector<long double> &v);
+
+template <typename T>
+void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m)
+{
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetManyRowsFromBit");
+ JStatRows(nr.size());
+ JStatElements((unsigned long long)nr.size()*ncols);
+ size_t nw=BitRowWords(ncols);
+ std::vector<unsigned long long> w(nw);
+
+ m=std::vector<std::vector<T>>(nr.size(),std::vector<T>(ncols,T(0)));
+ std::ifstream f(fname.c_str());
+ for (size_t t=0; t<nr.size(); t++)
+ {
+  f.seekg((std::streampos)(HEADER_SIZE+(unsigned long long)nr[t]*nw*sizeof(unsigned long long)),std::ios::beg);
+  JStatSeek();
+  f.read((char *)w.data(),(std::streamsize)(nw*sizeof(unsigned long long)));
+  JStatRead(nw*sizeof(unsigned long long));
+  UnpackBitRow(w.data(),ncols,m[t].data());
+ }
+ f.close();
+}
+
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<char>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<short>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<int>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long long>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<float>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<double>> &m);
+template void GetManyRowsFromBit(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long double>> &m);
+
 template <typename T>
 void GetJustOneRowFromSparse(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
 {
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetJustOneRowFromSparse");
+ JStatRows(1);
+ JStatElements(ncols);
  indextype ncr;
+ unsigned long long ibytes;
+ unsigned char sformat=SparseFormat(fname);
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  
  std::ifstream f(fname.c_str());
  // Start of row nr is at the end of former rows, each of them having a different number of elements
  // we must go to the start of each row to find out how many...
  std::streampos offset=HEADER_SIZE;
  f.seekg(offset,std::ios::beg);
- f.read((char *)&ncr,sizeof(indextype));
+ JStatSeek();
+ ReadSparseRowHead(f,sformat,ncr,ibytes);
  
- unsigned long long ncrl;
  for (indextype r=0; r<nr; r++)
  {
-  ncrl=(unsigned long long)ncr;
-  // Advance to jump over the ncr indextype indices, plus the own ncr value, plus the ncr values of data
-  offset += ((ncrl+1)*sizeof(indextype)+ncrl*sizeof(T));
+  // Advance to jump over the own ncr value, plus the ncr indices, plus the ncr values of data
+  offset += (SparseRowHeadSize(sformat)+ibytes+SparseValueBytes(sformat,ncr,es));
   f.seekg(offset,std::ios::beg);
+  JStatSeek();
   // At the beginning of row r: read how many element there are in it (ncr):
-  f.read((char *)&ncr,(std::streamsize)sizeof(indextype));
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
  }
 
  // Clear the vector to be returned
@@ -132,14 +248,14 @@ void GetJustOneRowFromSparse(std::string fname,indextype nr,indextype ncols,std:
   // We are just at the beginning of the row we want to read, and we have already read its number of non-null entries (ncr)
   // Let's read its indices...
   idata = new indextype [ncr];
-  f.read((char *)idata,(std::streamsize)ncr*sizeof(indextype));
+  ReadSparseIndices(f,sformat,ncr,ibytes,idata);
   // ... and let's read the data
   data = new T [ncr];
-  f.read((char *)data,(std::streamsize)ncr*sizeof(T));
+  ReadSparseValues(f,sformat,vc,ncr,data);
  
   // Fill the appropriate places of the vector (those dictated by the indices in idata)
   for (size_t c=0; c<ncr; c++)
-   v[data[c]]=data[c];
+   v[idata[c]]=data[c];
   
   delete[] data;
   delete[] idata;
@@ -168,22 +284,29 @@ template void GetJustOneRowFromSparse(std::string fname,indextype nr,indextype n
 template <typename T>
 void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<T>> &m)
 {
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetManyRowsFromSparse");
+ JStatRows(nr.size());
+ JStatElements((unsigned long long)nr.size()*ncols);
  std::vector<std::streampos> offsets(nrows);
  
+ unsigned char sformat=SparseFormat(fname);
+ ValueCodec vc=ValueCodecFromFile(fname);
+ size_t es=ValueSize(vc,sizeof(T));
  std::ifstream f(fname.c_str());
 
  indextype ncr;
  offsets[0]=HEADER_SIZE;
- unsigned long long ncrl,to_add;
+ unsigned long long ibytes,to_add;
  for (size_t t=0;t<nrows;t++)
  {
   f.seekg(offsets[t],std::ios::beg);
-  f.read((char *)&ncr,(std::streamsize)sizeof(indextype));
-  ncrl=(std::streampos)ncr;
-  // Advance to jump over the ncr indextype indices, plus the own ncr value, plus the ncr values of data
+  JStatSeek();
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
+  // Advance to jump over the own ncr value, plus the ncr indices, plus the ncr values of data
   if (t<nrows-1)
   {
-   to_add = (ncrl+1)*sizeof(indextype)+ncrl*sizeof(T);
+   to_add = SparseRowHeadSize(sformat)+ibytes+SparseValueBytes(sformat,ncr,es);
    offsets[t+1] = offsets[t]+(std::streampos)to_add;
   }
  }
@@ -201,14 +324,15 @@ void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype
   m.push_back(std::vector<T>(ncols,T(0)));
   
   f.seekg(offsets[nr[t]],std::ios::beg);
+  JStatSeek();
   // At the beginning of row r: read how many element there are in it (ncr):
-  f.read((char *)&ncr,(std::streamsize)sizeof(indextype));
+  ReadSparseRowHead(f,sformat,ncr,ibytes);
   if (ncr!=0)
   {
    // Let's read its indices... No problem with size, ncr is always smaller than ncols
-   f.read((char *)idata,(std::streamsize)ncr*sizeof(indextype));
+   ReadSparseIndices(f,sformat,ncr,ibytes,idata);
    // ... and let's read the data
-   f.read((char *)data,(std::streamsize)ncr*sizeof(T));
+   ReadSparseValues(f,sformat,vc,ncr,data);
   }
   
   // Fill the appropriate places of the  (those dictated by the indices in idata)
@@ -222,42 +346,146 @@ void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype
  f.close();
 }
 
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<char>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<short>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<int>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<long>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<long long>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<float>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<double>> &m);
+template void GetManyRowsFromSparse(std::string fname,std::vector<indextype> nr,indextype nrows,indextype ncols,std::vector<std::vector<long double>> &m);
+
 
+// Row nr of a symmetric matrix is made of the nr+1 values physically stored for it, followed by the elements (r,nr) for r>nr, which are
+// one in each of the following rows, at increasing distances. Instead of one seek and one read per element, we walk through the
+// memory-mapped file, so that only the pages which contain them are read and no system call is done per element.
+// Returns false if the file cannot be mapped.
 template <typename T>
-void GetJustOneRowFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
+bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
 {
- unsigned long long nrl=(std::streampos)nr;
- T *data = new T [ncols]; 
- 
- std::ifstream f(fname.c_str());
- 
- // This is the beginning of row nr in the binary symmetric data
- std::streampos offset=HEADER_SIZE + sizeof(T)*(nrl*(nrl+1))/2;
- 
- f.seekg(offset,std::ios::beg);
- 
- // Here we read the nr+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
- f.read((char *)data,(std::streamsize)(sizeof(T)*(nrl+1)));
- 
- // The rest of this row is not physically after; we must read the rest of the column that starts in the diagonal, down to the end.
- // It would be clearer to write r=nr+1; r<nrows; r++ but we haven't a variable nrows. But we don't need: symmetric matrices are square.
- offset=HEADER_SIZE+sizeof(T)*(nrl+((nrl+1)*(nrl+2))/2);
- for (indextype r=nr+1; r<ncols; r++)
+ unsigned long long nrl=(unsigned long long)nr;
+ unsigned long long n=(unsigned long long)ncols;
+ ValueCodec vc=ValueCodecFromFile(fname);
+ unsigned long long es=(unsigned long long)ValueSize(vc,sizeof(T));
+ size_t len=HEADER_SIZE+((n*(n+1))/2)*es;
+
+ int fd=open(fname.c_str(),O_RDONLY);
+ if (fd<0)
+  return false;
+ struct stat st;
+ if ((fstat(fd,&st)!=0) || ((unsigned long long)st.st_size<len))
  {
-  f.seekg(offset,std::ios::beg);
-  // Here we read just one value...
-  f.read((char *)&(data[r]),(std::streamsize)sizeof(T));
-  // and advance to the next row, taking into account that each row has a different number of really stored columns, which is r+1
-  offset += ((std::streampos)(r+1)*sizeof(T));
+  close(fd);
+  return false;
  }
- f.close();
+ void *p=mmap(nullptr,len,PROT_READ,MAP_PRIVATE,fd,0);
+ close(fd);
+ if (p==MAP_FAILED)
+  return false;
 
- // Clear the vector to be returned
+ const char *base=(const char *)p+HEADER_SIZE;
  v=std::vector<T>(ncols,T(0));
- for (size_t c=0; c<ncols; c++)
-  v[c]=data[c];
-  
- delete[] data;
+
+ // The nr+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
+ DecodeValues(vc,(const unsigned char *)(base+((nrl*(nrl+1))/2)*es),nrl+1,v.data());
+
+ // and the rest of the column that starts in the diagonal, down to the end. Each row r has r+1 stored values.
+ unsigned long long off=nrl+((nrl+1)*(nrl+2))/2;
+ for (indextype r=nr+1; r<ncols; r++)
+ {
+  DecodeValues(vc,(const unsigned char *)(base+off*es),1,&(v[r]));
+  off += (unsigned long long)(r+1);
+ }
+
+ munmap(p,len);
+ // No read call is issued on a mapped file, but the values are read from it all the same
+ JStatMappedRead(n*es);
+ return true;
+}
+
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<unsigned char> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<char> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<unsigned short> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<short> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<unsigned int> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<int> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<unsigned long> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<long> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<unsigned long long> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<long long> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<float> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<double> &v);
+template bool StrideWalkSymmetricRow(std::string fname,indextype nr,indextype ncols,std::vector<long double> &v);
+
+// Gets many complete rows of a symmetric matrix with a single sequential pass over the lower triangle, from the first requested row to the end.
+// Each stored row i gives its values at column r to all the requested rows r<i, and its stored part to itself if requested.
+// Rows are left in m in the same order as in nr.
+template <typename T>
+void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m)
+{
+ m=std::vector<std::vector<T>>(nr.size(),std::vector<T>(ncols,T(0)));
+ if (nr.size()==0)
+  return;
+
+ // Requested rows in increasing order, with their place in m
+ std::vector<std::pair<indextype,size_t>> req;
+ for (size_t t=0; t<nr.size(); t++)
+  req.push_back(std::make_pair(nr[t],t));
+ std::sort(req.begin(),req.end());
+
+ JMatrixReader<T> R(fname);
+ if (R.GetMatrixType()!=MTYPESYMMETRIC)
+  JMatrixStop("SweepSymmetricRows: the matrix in file "+fname+" is not a symmetric matrix.\n");
+
+ indextype i=req[0].first;
+ R.SeekRow(i);
+ do
+ {
+  DenseRowSpan<T> row=R.GetDenseRow();
+  for (size_t k=0; (k<req.size()) && (req[k].first<=i); k++)
+  {
+   if (req[k].first==i)
+    memcpy((void *)m[req[k].second].data(),(const void *)row.v,row.n*sizeof(T));
+   else
+    m[req[k].second][i]=row.v[req[k].first];
+  }
+  i++;
+ }
+ while (R.NextRow());
+}
+
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<char>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<short>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<int>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long long>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<float>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<double>> &m);
+template void SweepSymmetricRows(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long double>> &m);
+
+template <typename T>
+void GetJustOneRowFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<T> &v)
+{
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetJustOneRowFromSymmetric");
+ JStatRows(1);
+ JStatElements(ncols);
+ if (StrideWalkSymmetricRow(fname,nr,ncols,v))
+  return;
+
+ std::vector<std::vector<T>> m;
+ SweepSymmetricRows(fname,std::vector<indextype>(1,nr),ncols,m);
+ v.swap(m[0]);
 }
 
 template void GetJustOneRowFromSymmetric(std::string fname,indextype nr,indextype ncols,std::vector<unsigned char> &v);
@@ -276,55 +504,43 @@ template void GetJustOneRowFromSymmetric(std::string fname,indextype nr,indextyp
 
 // Auxiliary function to get from a symmetric matrix the rows whose indexes are in vector nr. Rows are left consecutively in the passed matrix
 // in the same order as in vector r, so if vector  is not ordered, resulting rows will be unordered, too.
+// A single row is got walking through the mapped file; many rows, sweeping the lower triangle just once.
 template <typename T>
 void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<T>> &m)
 {
- T *data = new T [ncols]; 
- 
- std::ifstream f(fname.c_str());
- std::streampos offset;
- unsigned long long nrl;
- m.clear();
- for (size_t t=0; t<nr.size(); t++)
+ if (nr.size()==1)
  {
-  // This is the beginning of row nr in the binary symmetric data
-  nrl=(unsigned long long)nr[t];
-  offset=HEADER_SIZE+sizeof(T)*((nrl*(nrl+1))/2);
-  f.seekg(offset,std::ios::beg);
-  // Here we read the nr+1 values present in that row, including the (nr,nr) at the main diagonal (which will be normally 0 in a dissimilarity matrix)
-  f.read((char *)data,(std::streamsize)(sizeof(T)*(nrl+1)));
- 
-  m.push_back(std::vector<T>(ncols,T(0)));
-  for (size_t c=0; c<nr[t]+1; c++)
-   m[t][c]=data[c];
-   
-  // The rest of this row is not physically after; we must read the rest of the column that starts in the diagonal, down to the end.
-  // It would be clearer to write r=nr+1; r<nrows; r++ but we haven't a variable nrows. But we don't need: symmetric matrices are square.
-  offset=HEADER_SIZE+sizeof(T)*(nrl+((nrl+1)*(nrl+2))/2);
-  for (indextype r=nr[t]+1; r<ncols; r++)
-  {
-   f.seekg(offset,std::ios::beg);
-   // Here we read just one value...
-   f.read((char *)&(data[r]),(std::streamsize)sizeof(T));
-   // and advance to the next row, taking into account that each row has a different number of really stored columns, which is r+1
-   offset += ((std::streampos)(r+1)*sizeof(T));
-  }
-  
-  for (size_t c=nr[t]+1; c<ncols; c++)
-   m[t][c]=data[c];
-  
+  m=std::vector<std::vector<T>>(1);
+  GetJustOneRowFromSymmetric(fname,nr[0],ncols,m[0]);
+  return;
  }
- 
- f.close();
- delete[] data;
+ JMatrixOpScope opscope(STATS_GETROWS);
+ JMatrixTraceSpan span("GetManyRowsFromSymmetric");
+ JStatRows(nr.size());
+ JStatElements((unsigned long long)nr.size()*ncols);
+ SweepSymmetricRows(fname,nr,ncols,m);
 }
 
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned char>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<char>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned short>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<short>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned int>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<int>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<unsigned long long>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long long>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<float>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<double>> &m);
+template void GetManyRowsFromSymmetric(std::string fname,std::vector<indextype> nr,indextype ncols,std::vector<std::vector<long double>> &m);
+
 using namespace std;
 
 template <typename T>
 void NREmit(string ofile,vector<T> &v,unsigned char mtype,const string rowname,const vector<string> &colnames)
 {
- if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC) || (mtype==MTYPEBIT))
  {
    FullMatrix<T> V(1,v.size());
    for (size_t i=0;i<v.size();i++)
@@ -337,7 +553,13 @@ void NREmit(string ofile,vector<T> &v,unsigned char mtype,const string rowname,c
     dummy.push_back(rowname);
     V.SetRowNames(dummy);
    }
-   V.WriteBin(ofile);
+   if (mtype==MTYPEBIT)
+   {
+    BitMatrix B(V);
+    B.WriteBin(ofile);
+   }
+   else
+    V.WriteBin(ofile);
   }
   else
   {
@@ -359,7 +581,7 @@ void NREmit(string ofile,vector<T> &v,unsigned char mtype,const string rowname,c
 template <typename T>
 void NRSEmit(string ofile,vector<vector<T>> &v,unsigned char mtype,const vector<string> &rownames,vector<string> &colnames)
 {
- if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC) || (mtype==MTYPEBIT))
  {
    FullMatrix<T> V(v.size(),v[0].size());
    for (size_t i=0;i<v.size();i++)
@@ -369,7 +591,13 @@ void NRSEmit(string ofile,vector<vector<T>> &v,unsigned char mtype,const vector<
     V.SetRowNames(rownames);
    if (colnames.size()!=0)
     V.SetColNames(colnames);
-   V.WriteBin(ofile);
+   if (mtype==MTYPEBIT)
+   {
+    BitMatrix B(V);
+    B.WriteBin(ofile);
+   }
+   else
+    V.WriteBin(ofile);
  }
  else
  {
@@ -408,6 +636,10 @@ void NRSelect(string inmat,indextype numrow,indextype ncols,string ofile,unsigne
       GetJustOneRowFromSymmetric<T>(inmat,numrow,ncols,v);
       NREmit<T>(ofile,v,MTYPESYMMETRIC,rowname,colnames);
       break;
+  case MTYPEBIT:
+      GetJustOneRowFromBit<T>(inmat,numrow,ncols,v);
+      NREmit<T>(ofile,v,MTYPEBIT,rowname,colnames);
+      break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
@@ -436,6 +668,10 @@ void NRSSelect(string inmat,vector<indextype> lrows,indextype nrows,indextype nc
         GetManyRowsFromSymmetric<T>(inmat,lrows,ncols,v);
         NRSEmit<T>(ofile,v,MTYPESYMMETRIC,sel_rownames,colnames);
         break;
+  case MTYPEBIT:
+        GetManyRowsFromBit<T>(inmat,lrows,ncols,v);
+        NRSEmit<T>(ofile,v,MTYPEBIT,sel_rownames,colnames);
+        break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
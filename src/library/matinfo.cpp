@@ -83,6 +83,7 @@ void JMatInfo(std::string fname, std::string fres)
         case MTYPEFULL:         out << "FullMatrix\n"; break;
         case MTYPESPARSE:       out << "SparseMatrix\n"; break;
         case MTYPESYMMETRIC:    out << "SymmetricMatrix\n"; break;
+        case MTYPEBIT:          out << "BitMatrix\n"; break;
         default:                out << "UnknownTypeMatrix\n"; break;
     }
  out << "Number of elements: " << (unsigned long)nrows*(unsigned long)ncols;
@@ -90,6 +91,9 @@ void JMatInfo(std::string fname, std::string fres)
   out << " (" << (unsigned long)nrows*(unsigned long)(ncols+1)/2 << " really stored)";
  out << std::endl;
  out << "Data type:          ";
+ if (mtype==MTYPEBIT)
+  out << "bit (0/1), packed in 64-bit words\n";
+ else
  switch (ctype)
     {
         case UCTYPE: out <<  "unsigned char\n"; break;
@@ -113,6 +117,27 @@ void JMatInfo(std::string fname, std::string fres)
   
  out << "Number of rows:     " << nrows << std::endl;
  out << "Number of columns:  " << ncols << std::endl;
+ if (mtype==MTYPESPARSE)
+ {
+  unsigned char sformat=SparseFormat(fname);
+  if ((sformat & SPARSE_INDEX_MASK)==SPARSE_VARINT)
+   out << "Column indices:     varint-encoded gaps\n";
+  else
+   out << "Column indices:     " << 8*SparseIndexSize(sformat) << " bits\n";
+  if (sformat & SPARSE_PATTERN)
+   out << "Values:             none (pattern-only matrix, all non-zero entries are 1)\n";
+ }
+ if ((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC))
+ {
+  ValueCodec vc=ValueCodecFromFile(fname);
+  if (vc.enc!=VALUE_NATIVE)
+  {
+   out << "Values:             " << ValueEncodingName(vc.enc);
+   if ((vc.enc==VALUE_Q8) || (vc.enc==VALUE_Q16))
+    out << ", value = " << vc.offset << " + " << vc.scale << " * q";
+   out << "\n";
+  }
+ }
  out << "Metadata:           ";
  if (mdinfo==NO_METADATA)
   out << "None\n";
@@ -136,6 +161,14 @@ void JMatInfo(std::string fname, std::string fres)
      percent = float(round(100.0*percent))/100.0;
      out << "Binary data size:   " <<  used_size << " bytes, which is " << percent << " % of the full matrix size (which would be " << full_size  << " bytes).\n";
  }
+ if (mtype==MTYPEBIT)
+  out << "Binary data size:   " << start_metadata-HEADER_SIZE << " bytes (" << BitRowWords(ncols) << " words per row).\n";
+ if (((mtype==MTYPEFULL) || (mtype==MTYPESYMMETRIC)) && (ValueCodecFromFile(fname).enc!=VALUE_NATIVE))
+ {
+     unsigned long long nstored=(mtype==MTYPEFULL) ? (unsigned long long)nrows*(unsigned long long)ncols : ((unsigned long long)nrows*(unsigned long long)(nrows+1))/2;
+     unsigned long long used_size=start_metadata-HEADER_SIZE;
+     out << "Binary data size:   " << used_size << " bytes (it would be " << nstored*SizeOfType(ctype) << " bytes without encoding).\n";
+ }
  
  out.flush();
  
@@ -223,6 +223,17 @@ void SRCSelect(string inmat,string ofile,unsigned char mtype,vector<string> rnam
       M.SetColNames(cnames);
     M.WriteBin(ofile);
   }
+  break;
+  case MTYPEBIT:
+  {
+    BitMatrix M(inmat);
+    if (rnames.size()>0)
+      M.SetRowNames(rnames);
+    if (cnames.size()>0)
+      M.SetColNames(cnames);
+    M.WriteBin(ofile);
+  }
+  break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
@@ -253,6 +264,13 @@ void SetComment(string inmat,string ofile,unsigned char mtype,string comment)
     M.WriteBin(ofile);
   }
   break;
+  case MTYPEBIT:
+  {
+    BitMatrix M(inmat);
+    M.SetComment(comment);
+    M.WriteBin(ofile);
+  }
+  break;
   default: cerr << "Unexpected error: unknown matrix type.\n"; exit(1); break;
  }
 }
@@ -0,0 +1,563 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../headers/matpermute.h"
+#include "../headers/apitocommands.h"
+#include "../headers/matmetadata.h"
+#include "../headers/matinfo.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+void ReadFileAt(int fd,std::string fname,char *p,size_t nbytes,unsigned long long offset)
+{
+ JStatRead(nbytes);
+ while (nbytes>0)
+ {
+  ssize_t got=pread(fd,(void *)p,nbytes,off_t(offset));
+  if (got<=0)
+   JMatrixStop("Error reading file "+fname+". Is it truncated?\n");
+  p += got;
+  nbytes -= size_t(got);
+  offset += (unsigned long long)got;
+ }
+}
+
+void WriteFileAt(int fd,std::string fname,const char *p,size_t nbytes,unsigned long long offset)
+{
+ JStatWrite(nbytes);
+ while (nbytes>0)
+ {
+  ssize_t put=pwrite(fd,(const void *)p,nbytes,off_t(offset));
+  if (put<=0)
+   JMatrixStop("Error writing file "+fname+". Is the disk full?\n");
+  p += put;
+  nbytes -= size_t(put);
+  offset += (unsigned long long)put;
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Reads the bytes [begin,end) of a file sequentially, in blocks of at most bufsize bytes, passing each one to f with its offset
+template <typename F>
+static void ForEachBlock(int fd,std::string fname,unsigned long long begin,unsigned long long end,size_t bufsize,F f)
+{
+ std::vector<char> buf(size_t(std::min((unsigned long long)bufsize,end-begin)));
+ while (begin<end)
+ {
+  size_t len=size_t(std::min((unsigned long long)buf.size(),end-begin));
+  ReadFileAt(fd,fname,buf.data(),len,begin);
+  f((const char *)buf.data(),len,begin);
+  begin += len;
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Splits the rows of the result, whose sizes in bytes are rsize(i), in batches of consecutive rows that take at most maxbytes (but at least one row).
+// Returns the first row of each batch, followed by the number of rows.
+template <typename F>
+static std::vector<indextype> Batches(indextype n,unsigned long long maxbytes,F rsize)
+{
+ std::vector<indextype> bstart;
+ indextype i=0;
+ while (i<n)
+ {
+  bstart.push_back(i);
+  unsigned long long bytes=rsize(i);
+  i++;
+  while ((i<n) && (bytes+rsize(i)<=maxbytes))
+  {
+   bytes += rsize(i);
+   i++;
+  }
+ }
+ bstart.push_back(n);
+ return bstart;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Permutation of the rows of full, sparse and bit matrices, which are moved as blocks of bytes. off has the offset of each row in the original file,
+// followed by that of the end of binary data.
+static void PermuteRows(int in,std::string iname,int out,std::string oname,const std::vector<unsigned long long> &off,const std::vector<indextype> &order,size_t memsize)
+{
+ indextype n=indextype(order.size());
+ auto len = [&off](indextype r) { return off[r+1]-off[r]; };
+
+ // Offsets of the rows in the result
+ std::vector<unsigned long long> doff(n+1);
+ doff[0]=HEADER_SIZE;
+ for (indextype i=0; i<n; i++)
+  doff[i+1]=doff[i]+len(order[i]);
+ unsigned long long total=doff[n]-HEADER_SIZE;
+ if (total==0)
+  return;
+
+ std::vector<indextype> bstart=Batches(n,std::max((unsigned long long)memsize/2,1ULL),[&](indextype i) { return len(order[i]); });
+ size_t nb=bstart.size()-1;
+ bool gather=((nb==1) || (total/n>=PERMUTE_SEEK_ROW_SIZE));
+
+ if (DEB & DEBJM)
+  std::cout << "Permuting " << n << " rows (" << total << " bytes) in " << nb << " batches " << (gather ? "read from their places.\n" : "put in buckets of the result file.\n");
+
+ std::vector<char> obuf,ibuf;
+ std::vector<indextype> rows;
+ if (gather)
+ {
+  // The rows of each batch are read in the order in which they are stored, through a window that serves the small ones close to each other.
+  // Rows that do not fit in it are read directly to their places.
+  std::vector<char> win(size_t(std::min((unsigned long long)PERMUTE_READ_BUFFER_SIZE,total)));
+  unsigned long long winstart=0,winlen=0;
+  for (size_t k=0; k<nb; k++)
+  {
+   obuf.resize(size_t(doff[bstart[k+1]]-doff[bstart[k]]));
+   rows.resize(bstart[k+1]-bstart[k]);
+   for (indextype i=bstart[k]; i<bstart[k+1]; i++)
+    rows[i-bstart[k]]=i;
+   std::sort(rows.begin(),rows.end(),[&order](indextype a,indextype b) { return order[a]<order[b]; });
+   for (indextype i : rows)
+   {
+    unsigned long long o=off[order[i]],l=len(order[i]);
+    char *dst=obuf.data()+(doff[i]-doff[bstart[k]]);
+    if (l>=win.size())
+     ReadFileAt(in,iname,dst,size_t(l),o);
+    else
+    {
+     if ((o<winstart) || (o+l>winstart+winlen))
+     {
+      winstart=o;
+      winlen=std::min((unsigned long long)win.size(),off[off.size()-1]-o);
+      ReadFileAt(in,iname,win.data(),size_t(winlen),o);
+      JStatSeek();
+     }
+     memcpy((void *)dst,(const void *)(win.data()+(o-winstart)),size_t(l));
+    }
+   }
+   WriteFileAt(out,oname,obuf.data(),obuf.size(),doff[bstart[k]]);
+  }
+  return;
+ }
+
+ // Batch of each row of the original matrix
+ std::vector<indextype> batch(n);
+ std::vector<unsigned long long> bucket(nb);
+ for (size_t k=0; k<nb; k++)
+ {
+  bucket[k]=doff[bstart[k]];
+  for (indextype i=bstart[k]; i<bstart[k+1]; i++)
+   batch[order[i]]=indextype(k);
+ }
+
+ // First pass: the original file is read sequentially, and each row goes to the bucket of its batch
+ {
+  BucketWriter bw(out,oname,bucket,std::max(memsize/2/nb,size_t(64*1024)));
+  indextype r=0;
+  ForEachBlock(in,iname,off[0],off[n],PERMUTE_READ_BUFFER_SIZE,[&](const char *p,size_t blen,unsigned long long bs)
+  {
+   unsigned long long be=bs+blen;
+   while ((r<n) && (off[r]<be))
+   {
+    unsigned long long from=std::max(off[r],bs),to=std::min(off[r+1],be);
+    bw.Put(batch[r],p+(from-bs),size_t(to-from));
+    if (off[r+1]>be)
+     break;
+    r++;
+   }
+  });
+  bw.FlushAll();
+ }
+
+ // Second pass: each bucket, with the rows of its batch in the order of the original file, is read back and written in the order of the result
+ for (size_t k=0; k<nb; k++)
+ {
+  size_t bbytes=size_t(doff[bstart[k+1]]-doff[bstart[k]]);
+  ibuf.resize(bbytes);
+  obuf.resize(bbytes);
+  ReadFileAt(out,oname,ibuf.data(),bbytes,doff[bstart[k]]);
+  rows.resize(bstart[k+1]-bstart[k]);
+  for (indextype i=bstart[k]; i<bstart[k+1]; i++)
+   rows[i-bstart[k]]=i;
+  std::sort(rows.begin(),rows.end(),[&order](indextype a,indextype b) { return order[a]<order[b]; });
+  size_t p=0;
+  for (indextype i : rows)
+  {
+   size_t l=size_t(len(order[i]));
+   memcpy((void *)(obuf.data()+(doff[i]-doff[bstart[k]])),(const void *)(ibuf.data()+p),l);
+   p += l;
+  }
+  WriteFileAt(out,oname,obuf.data(),bbytes,doff[bstart[k]]);
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Permutation of the rows and columns of a symmetric matrix of dimension n, whose values, of esize bytes, are moved one by one.
+// Value (i,j) of the result, with j<=i, is the stored value (max(order[i],order[j]),min(order[i],order[j])) of the original matrix.
+static void PermuteSymmetric(int in,std::string iname,int out,std::string oname,size_t esize,const std::vector<indextype> &order,size_t memsize)
+{
+ indextype n=indextype(order.size());
+ // Position (in values) of the first value of row i, and its inverse for the values of the original matrix, read in order
+ auto first = [](indextype i) { return ((unsigned long long)i*(unsigned long long)(i+1))/2; };
+ std::vector<indextype> inv(n);
+ for (indextype i=0; i<n; i++)
+  inv[order[i]]=i;
+ unsigned long long total=first(n)*esize;
+ if (total==0)
+  return;
+
+ std::vector<indextype> bstart=Batches(n,std::max((unsigned long long)memsize/2,(unsigned long long)esize),[esize](indextype i) { return (unsigned long long)(i+1)*esize; });
+ size_t nb=bstart.size()-1;
+
+ if (DEB & DEBJM)
+  std::cout << "Permuting rows and columns of a symmetric matrix of dimension " << n << " (" << total << " bytes) in " << nb << " batches.\n";
+
+ // The blocks read hold whole values, since they begin just after the header
+ size_t rbuf=std::max(size_t(1),PERMUTE_READ_BUFFER_SIZE/esize)*esize;
+
+ std::vector<char> obuf,ibuf;
+ if (nb==1)
+ {
+  // Everything fits in memory: each value read goes directly to its place
+  obuf.resize(size_t(total));
+  indextype r=0,c=0;
+  ForEachBlock(in,iname,HEADER_SIZE,HEADER_SIZE+total,rbuf,[&](const char *p,size_t blen,unsigned long long)
+  {
+   for (size_t q=0; q<blen; q+=esize)
+   {
+    indextype i=std::max(inv[r],inv[c]),j=std::min(inv[r],inv[c]);
+    memcpy((void *)(obuf.data()+(first(i)+j)*esize),(const void *)(p+q),esize);
+    if (++c>r)
+    {
+     r++;
+     c=0;
+    }
+   }
+  });
+  WriteFileAt(out,oname,obuf.data(),obuf.size(),HEADER_SIZE);
+  return;
+ }
+
+ std::vector<indextype> batch(n);
+ std::vector<unsigned long long> bucket(nb);
+ for (size_t k=0; k<nb; k++)
+ {
+  bucket[k]=HEADER_SIZE+first(bstart[k])*esize;
+  for (indextype i=bstart[k]; i<bstart[k+1]; i++)
+   batch[i]=indextype(k);
+ }
+
+ // First pass: values are read sequentially and each one goes to the bucket of the batch of the row of the result where it belongs
+ {
+  BucketWriter bw(out,oname,bucket,std::max(memsize/2/nb,size_t(64*1024)));
+  indextype r=0,c=0;
+  ForEachBlock(in,iname,HEADER_SIZE,HEADER_SIZE+total,rbuf,[&](const char *p,size_t blen,unsigned long long)
+  {
+   for (size_t q=0; q<blen; q+=esize)
+   {
+    bw.Put(batch[std::max(inv[r],inv[c])],p+q,esize);
+    if (++c>r)
+    {
+     r++;
+     c=0;
+    }
+   }
+  });
+  bw.FlushAll();
+ }
+
+ // Second pass: the values of each bucket are in the order of the original file, which is followed again, restricted to the values
+ // of the rows of the batch, [a,b), to know where each one goes. Those of original rows that go to rows before a are in the columns of the batch.
+ std::vector<indextype> cols;
+ for (size_t k=0; k<nb; k++)
+ {
+  indextype a=bstart[k],b=bstart[k+1];
+  size_t bbytes=size_t((first(b)-first(a))*esize);
+  ibuf.resize(bbytes);
+  obuf.resize(bbytes);
+  ReadFileAt(out,oname,ibuf.data(),bbytes,HEADER_SIZE+first(a)*esize);
+  cols.assign(order.begin()+a,order.begin()+b);
+  std::sort(cols.begin(),cols.end());
+  const char *p=ibuf.data();
+  auto place = [&](indextype r,indextype c)
+  {
+   indextype i=std::max(inv[r],inv[c]),j=std::min(inv[r],inv[c]);
+   memcpy((void *)(obuf.data()+(first(i)-first(a)+j)*esize),(const void *)p,esize);
+   p += esize;
+  };
+  for (indextype r=0; r<n; r++)
+  {
+   if (inv[r]>=b)
+    continue;
+   if (inv[r]>=a)
+   {
+    for (indextype c=0; c<=r; c++)
+     if (inv[c]<b)
+      place(r,c);
+   }
+   else
+    for (size_t q=0; (q<cols.size()) && (cols[q]<=r); q++)
+     place(r,cols[q]);
+  }
+  WriteFileAt(out,oname,obuf.data(),bbytes,HEADER_SIZE+first(a)*esize);
+ }
+}
+
+/////////////////////////////////////////////////////////////////////
+
+unsigned long long SparseRowBytes(const char *p,unsigned char sformat,size_t vsize)
+{
+ indextype ncr;
+ unsigned long long ibytes;
+ memcpy((void *)&ncr,(const void *)p,sizeof(indextype));
+ if ((sformat & SPARSE_INDEX_MASK)==SPARSE_VARINT)
+ {
+  indextype nb;
+  memcpy((void *)&nb,(const void *)(p+sizeof(indextype)),sizeof(indextype));
+  ibytes=nb;
+ }
+ else
+  ibytes=(unsigned long long)ncr*SparseIndexSize(sformat & SPARSE_INDEX_MASK);
+ return SparseRowHeadSize(sformat)+ibytes+SparseValueBytes(sformat,ncr,vsize);
+}
+
+// Offsets of the rows of a sparse matrix, found reading only the beginning of each one (the whole file, unless rows are bigger than the read buffer)
+static std::vector<unsigned long long> SparseRowOffsets(int in,std::string iname,indextype nr,unsigned char sformat,size_t vsize,unsigned long long endofbindata)
+{
+ std::vector<unsigned long long> off(nr+1);
+ size_t hsize=SparseRowHeadSize(sformat);
+ std::vector<char> buf(size_t(std::min((unsigned long long)PERMUTE_READ_BUFFER_SIZE,endofbindata-HEADER_SIZE+1)));
+ unsigned long long bstart=0,blen=0;
+ off[0]=HEADER_SIZE;
+ for (indextype r=0; r<nr; r++)
+ {
+  unsigned long long o=off[r];
+  if ((o<bstart) || (o+hsize>bstart+blen))
+  {
+   if (o+hsize>endofbindata)
+    JMatrixStop("Unexpected end of the rows of the sparse matrix in file "+iname+" at row "+std::to_string(r)+".\n");
+   bstart=o;
+   blen=std::min((unsigned long long)buf.size(),endofbindata-o);
+   ReadFileAt(in,iname,buf.data(),size_t(blen),o);
+  }
+  off[r+1]=o+SparseRowBytes(buf.data()+(o-bstart),sformat,vsize);
+ }
+ return off;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+std::vector<unsigned long long> RowOffsets(int fd,std::string fname,const unsigned char *header,indextype nrows,unsigned long long endofbindata)
+{
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nr,nc;
+ MatrixTypeFromHeader(header,mtype,ctype,endian,mdinfo,nr,nc);
+ size_t esize=ValueSize(ValueCodecFromHeader(header),size_t(SizeOfType(ctype)));
+ if (mtype==MTYPESPARSE)
+ {
+  if (endian!=ThisMachineEndianness())
+   JMatrixStop("The sparse matrix in file "+fname+" has different endianness to that of this machine. Changing endianness is not yet implemented.\n");
+  return SparseRowOffsets(fd,fname,nrows,SparseFormatFromHeader(header),esize,endofbindata);
+ }
+ unsigned long long rowbytes = (mtype==MTYPEBIT) ? BitRowWords(nc)*sizeof(unsigned long long) : (unsigned long long)nc*esize;
+ std::vector<unsigned long long> off(nrows+1);
+ for (indextype r=0; r<=nrows; r++)
+  off[r]=HEADER_SIZE+r*rowbytes;
+ return off;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Appends names to the metadata block in the format of JMatrix<T>::WriteNames, followed by the block separator
+static void PutNames(std::vector<char> &md,const std::vector<std::string> &names)
+{
+ for (size_t i=0; i<names.size(); i++)
+ {
+  std::string s=names[i].substr(0,MAX_LEN_NAME);
+  md.insert(md.end(),s.c_str(),s.c_str()+s.size()+1);
+ }
+ md.insert(md.end(),(const char *)BLOCKSEP,(const char *)BLOCKSEP+BLOCKSEP_LEN);
+}
+
+void WriteRawMetadata(int in,std::string iname,unsigned long long start_comment,int out,std::string oname,unsigned long long endofbindata,
+                      unsigned char mdinfo,const std::vector<std::string> &rnames,const std::vector<std::string> &cnames)
+{
+ // Metadata are written as JMatrix<T>::WriteMetadata does
+ std::vector<char> md;
+ if (mdinfo & ROW_NAMES)
+  PutNames(md,rnames);
+ if (mdinfo & COL_NAMES)
+  PutNames(md,cnames);
+ if (mdinfo & COMMENT)
+ {
+  std::vector<char> comment(COMMENT_SIZE);
+  ReadFileAt(in,iname,comment.data(),COMMENT_SIZE,start_comment);
+  md.insert(md.end(),comment.begin(),comment.end());
+  md.insert(md.end(),(const char *)BLOCKSEP,(const char *)BLOCKSEP+BLOCKSEP_LEN);
+ }
+ md.insert(md.end(),(const char *)&endofbindata,(const char *)&endofbindata+sizeof(unsigned long long));
+ WriteFileAt(out,oname,md.data(),md.size(),endofbindata);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+void PermuteMatrix(std::string iname,const std::vector<indextype> &order,std::string oname,size_t memsize)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+
+ if (iname==oname)
+  JMatrixStop("PermuteMatrix: the permuted matrix cannot be written to the file "+iname+" from which it is read.\n");
+
+ int in=open(iname.c_str(),O_RDONLY);
+ if (in<0)
+  JMatrixStop("PermuteMatrix: cannot open file "+iname+" to read the matrix.\n");
+ unsigned char header[HEADER_SIZE];
+ ReadFileAt(in,iname,(char *)header,HEADER_SIZE,0);
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nr,nc;
+ MatrixTypeFromHeader(header,mtype,ctype,endian,mdinfo,nr,nc);
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+  JMatrixStop("PermuteMatrix: the matrix in file "+iname+" is of type "+MatrixTypeName(mtype)+", which cannot be permuted.\n");
+ if (SizeOfType(ctype)<0)
+  JMatrixStop("PermuteMatrix: the matrix in file "+iname+" has data of an unknown type.\n");
+
+ // The order must be a permutation of the rows
+ if (order.size()!=size_t(nr))
+  JMatrixStop("PermuteMatrix: the order has "+std::to_string(order.size())+" rows, but the matrix in file "+iname+" has "+std::to_string(nr)+".\n");
+ std::vector<bool> seen(nr,false);
+ for (size_t i=0; i<order.size(); i++)
+ {
+  if (order[i]>=nr)
+   JMatrixStop("PermuteMatrix: row "+std::to_string(order[i])+" of the order is out of bounds. The matrix in file "+iname+" has "+std::to_string(nr)+" rows.\n");
+  if (seen[order[i]])
+   JMatrixStop("PermuteMatrix: row "+std::to_string(order[i])+" appears more than once in the order.\n");
+  seen[order[i]]=true;
+ }
+
+ unsigned long long endofbindata,start_comment;
+ PositionsInFile(iname,&endofbindata,&start_comment);
+
+ if (DEB & DEBJM)
+  std::cout << "Permuting the " << MatrixTypeName(mtype) << " of (" << nr << "x" << nc << ") in file " << iname << " to file " << oname << ".\n";
+
+ int out=open(oname.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+ if (out<0)
+ {
+  close(in);
+  JMatrixStop("PermuteMatrix: cannot open file "+oname+" to write the permuted matrix.\n");
+ }
+
+ // Rows and values are moved as they are stored, so the header is the same
+ WriteFileAt(out,oname,(const char *)header,HEADER_SIZE,0);
+ if (mtype==MTYPESYMMETRIC)
+  PermuteSymmetric(in,iname,out,oname,ValueSize(ValueCodecFromHeader(header),size_t(SizeOfType(ctype))),order,memsize);
+ else
+ {
+  std::vector<unsigned long long> off=RowOffsets(in,iname,header,nr,endofbindata);
+  if (off[nr]!=endofbindata)
+   JMatrixStop("PermuteMatrix: the binary data of file "+iname+" do not have the expected size. Is it corrupted?\n");
+  PermuteRows(in,iname,out,oname,off,order,memsize);
+ }
+ JStatRows(nr);
+ JStatElements((unsigned long long)nr*nc);
+
+ // Names of rows (and of columns, in symmetric matrices) are permuted, and the comment is kept as it is
+ std::vector<std::string> rnames,cnames,prnames,pcnames;
+ if (mdinfo & ROW_NAMES)
+ {
+  InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+  if (rnames.size()!=size_t(nr))
+   JMatrixStop("PermuteMatrix: file "+iname+" has "+std::to_string(rnames.size())+" row names for "+std::to_string(nr)+" rows.\n");
+  for (indextype i=0; i<nr; i++)
+   prnames.push_back(rnames[order[i]]);
+ }
+ if (mdinfo & COL_NAMES)
+ {
+  InternalGetBinNames(iname,COL_NAMES,rnames,cnames);
+  if (mtype==MTYPESYMMETRIC)
+  {
+   if (cnames.size()!=size_t(nr))
+    JMatrixStop("PermuteMatrix: file "+iname+" has "+std::to_string(cnames.size())+" column names for "+std::to_string(nr)+" columns.\n");
+   for (indextype i=0; i<nr; i++)
+    pcnames.push_back(cnames[order[i]]);
+  }
+  else
+   pcnames=cnames;
+ }
+ WriteRawMetadata(in,iname,start_comment,out,oname,endofbindata,mdinfo,prnames,pcnames);
+
+ close(in);
+ close(out);
+
+ if (DEB & DEBJM)
+  std::cout << "Permuted matrix written to file " << oname << ".\n";
+}
+
+/////////////////////////////////////////////////////////////////////
+
+void JPermuteMatrix(std::string iname,std::vector<std::string> order,std::string oname)
+{
+ // The order is given by row names if the matrix has them and all are known, or else by row numbers (from 0)
+ std::vector<std::string> rnames,cnames;
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nr,nc;
+ MatrixType(iname,mtype,ctype,endian,mdinfo,nr,nc);
+ if (mdinfo & ROW_NAMES)
+  InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+
+ std::vector<indextype> ord(order.size());
+ bool bynames=(rnames.size()>0);
+ std::string unknown;
+ if (bynames)
+ {
+  std::unordered_map<std::string,indextype> pos;
+  for (indextype r=0; r<indextype(rnames.size()); r++)
+   pos[rnames[r]]=r;
+  for (size_t i=0; bynames && (i<order.size()); i++)
+  {
+   auto it=pos.find(order[i]);
+   if (it==pos.end())
+   {
+    bynames=false;
+    unknown=order[i];
+   }
+   else
+    ord[i]=it->second;
+  }
+ }
+ if (!bynames)
+  for (size_t i=0; i<order.size(); i++)
+  {
+   const std::string &s=order[i];
+   if (s.empty() || (s.find_first_not_of("0123456789")!=std::string::npos))
+   {
+    if (unknown!="")
+     JMatrixStop("JPermuteMatrix: '"+unknown+"' is not a row name of the matrix in file "+iname+", and '"+s+"' is not a row number.\n");
+    JMatrixStop("JPermuteMatrix: '"+s+"' is not a row number, and the matrix in file "+iname+" has no row names.\n");
+   }
+   ord[i]=indextype(std::stoul(s));
+  }
+
+ PermuteMatrix(iname,ord,oname);
+}
@@ -20,6 +20,7 @@
 #include "../headers/fullmatrix.h"
 #include "../headers/sparsematrix.h"
 #include "../headers/symmetricmatrix.h"
+#include "../headers/bitmatrix.h"
 
 extern unsigned char DEB;
 
@@ -86,11 +87,17 @@ void JCsvDump(string ifile, string csvfile, char csep =',',bool withquotes=false
         default: break;
     }
  }
+ if (mtype==MTYPEBIT)
+ {
+     BitMatrix M(ifile);
+     M.WriteCsv(csvfile,csep,withquotes);
+ }
 }
 
 template <typename T>
 void CsvDataToBinMat(string ifname,string ofname,unsigned char vtype,char csep,unsigned char mtype)
 {
+ JMatrixTraceSpan span("CsvDataToBinMat");
  switch (mtype)
  {
   case MTYPEFULL:
@@ -111,6 +118,14 @@ void CsvDataToBinMat(string ifname,string ofname,unsigned char vtype,char csep,u
    M.WriteBin(ofname);
    break;
   }
+  case MTYPEBIT:
+  {
+   // Values are read with their type and then packed; non-zero values become 1
+   FullMatrix<T> F(ifname,vtype,csep);
+   BitMatrix M(F);
+   M.WriteBin(ofname);
+   break;
+  }
   default: break;
  }
 }
@@ -0,0 +1,294 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../headers/matsample.h"
+#include "../headers/matpermute.h"
+#include "../headers/matgenerate.h"
+#include "../headers/apitocommands.h"
+#include "../headers/matmetadata.h"
+#include "../headers/matinfo.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+// Floyd's algorithm: k different values of [0,n), uniformly chosen, with k draws
+static std::vector<indextype> FloydSample(GenRNG &g,indextype n,indextype k)
+{
+ std::unordered_set<indextype> chosen;
+ chosen.reserve(k);
+ for (indextype j=n-k; j<n; j++)
+ {
+  indextype t=indextype(g.Below((unsigned long long)j+1));
+  if (!chosen.insert(t).second)
+   chosen.insert(j);
+ }
+ std::vector<indextype> ret(chosen.begin(),chosen.end());
+ std::sort(ret.begin(),ret.end());
+ return ret;
+}
+
+// Algorithm L: the reservoir of k values that a pass over [0,n) keeps, jumping directly from each value that enters it to the next one
+static std::vector<indextype> ReservoirSample(GenRNG &g,indextype n,indextype k)
+{
+ std::vector<indextype> res(k);
+ for (indextype i=0; i<k; i++)
+  res[i]=i;
+ double w=exp(log(1.0-g.Uniform())/double(k));
+ unsigned long long i=k-1;
+ while (w<1.0)
+ {
+  double skip=floor(log(1.0-g.Uniform())/log(1.0-w));
+  if (skip>=double(n-i))
+   break;
+  i += (unsigned long long)skip+1;
+  if (i>=n)
+   break;
+  res[g.Below(k)]=indextype(i);
+  w *= exp(log(1.0-g.Uniform())/double(k));
+ }
+ std::sort(res.begin(),res.end());
+ return res;
+}
+
+// Proportional allocation of the sample among the groups of rows with the same prefix, each one sampled with Floyd's algorithm
+static std::vector<indextype> StratifiedSample(GenRNG &g,indextype k,const std::vector<std::string> &rnames,char sep)
+{
+ std::map<std::string,std::vector<indextype>> groups;
+ for (indextype r=0; r<indextype(rnames.size()); r++)
+  groups[rnames[r].substr(0,rnames[r].find(sep))].push_back(r);
+
+ if (DEB & DEBJM)
+  std::cout << "Sampling " << k << " of " << rnames.size() << " rows in " << groups.size() << " groups.\n";
+
+ // Each group gets the integer part of its share, and the rows left go to the groups with the largest fractional parts
+ std::vector<indextype> share;
+ std::vector<std::pair<double,size_t>> rest;
+ indextype given=0;
+ for (auto it=groups.begin(); it!=groups.end(); ++it)
+ {
+  double exact=double(k)*double(it->second.size())/double(rnames.size());
+  share.push_back(indextype(floor(exact)));
+  rest.push_back(std::make_pair(exact-floor(exact),share.size()-1));
+  given += share.back();
+ }
+ std::stable_sort(rest.begin(),rest.end(),[](const std::pair<double,size_t> &a,const std::pair<double,size_t> &b) { return a.first>b.first; });
+ for (size_t q=0; given<k; q++)
+ {
+  share[rest[q].second]++;
+  given++;
+ }
+
+ std::vector<indextype> ret;
+ size_t q=0;
+ for (auto it=groups.begin(); it!=groups.end(); ++it,++q)
+ {
+  std::vector<indextype> s=FloydSample(g,indextype(it->second.size()),share[q]);
+  for (size_t i=0; i<s.size(); i++)
+   ret.push_back(it->second[s[i]]);
+ }
+ std::sort(ret.begin(),ret.end());
+ return ret;
+}
+
+std::vector<indextype> SampleRowIndices(indextype nrows,indextype nsample,unsigned char method,unsigned long long seed,const std::vector<std::string> &rnames,char sep)
+{
+ // An empty sample needs no draw (and the samplers assume at least one row)
+ if (nsample==0)
+  return std::vector<indextype>();
+
+ if (nsample>=nrows)
+ {
+  std::vector<indextype> all(nrows);
+  for (indextype r=0; r<nrows; r++)
+   all[r]=r;
+  return all;
+ }
+
+ GenRNG g(seed,0);
+ switch (method)
+ {
+  case SAMPLE_UNIFORM: return FloydSample(g,nrows,nsample);
+  case SAMPLE_RESERVOIR: return ReservoirSample(g,nrows,nsample);
+  case SAMPLE_STRATIFIED:
+   if (rnames.size()!=size_t(nrows))
+    JMatrixStop("SampleRowIndices: stratified sampling needs the names of the "+std::to_string(nrows)+" rows, but "+std::to_string(rnames.size())+" were given.\n");
+   return StratifiedSample(g,nsample,rnames,sep);
+  default: JMatrixStop("SampleRowIndices: unknown sampling method.\n"); break;
+ }
+ return std::vector<indextype>();
+}
+
+/////////////////////////////////////////////////////////////////////
+
+void SampleMatrix(std::string iname,std::string oname,indextype nsample,unsigned char method,unsigned long long seed,char sep)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+
+ if (iname==oname)
+  JMatrixStop("SampleMatrix: the sample cannot be written to the file "+iname+" from which it is read.\n");
+
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nr,nc;
+ MatrixType(iname,mtype,ctype,endian,mdinfo,nr,nc);
+ if ((mtype!=MTYPEFULL) && (mtype!=MTYPESPARSE) && (mtype!=MTYPESYMMETRIC) && (mtype!=MTYPEBIT))
+  JMatrixStop("SampleMatrix: the matrix in file "+iname+" is of type "+MatrixTypeName(mtype)+", which cannot be sampled.\n");
+
+ std::vector<std::string> rnames,cnames;
+ if (mdinfo & ROW_NAMES)
+  InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+ if ((method==SAMPLE_STRATIFIED) && (rnames.size()==0))
+  JMatrixStop("SampleMatrix: stratified sampling groups the rows by their names, but the matrix in file "+iname+" has no row names.\n");
+ if (nsample>nr)
+  JMatrixWarning("SampleMatrix: a sample of "+std::to_string(nsample)+" rows was requested from the matrix in file "+iname+", which has "+std::to_string(nr)+". All of them are taken.\n");
+
+ std::vector<indextype> rows=SampleRowIndices(nr,nsample,method,seed,rnames,sep);
+ indextype ns=indextype(rows.size());
+
+ if (DEB & DEBJM)
+  std::cout << "Sampling " << ns << " rows of the " << MatrixTypeName(mtype) << " of (" << nr << "x" << nc << ") in file " << iname << " to file " << oname << ".\n";
+
+ // Rows of symmetric matrices are spread over the whole file, so the submatrix of the chosen rows and columns is extracted as usual.
+ // An empty sample is written below, like that of any other matrix.
+ if ((mtype==MTYPESYMMETRIC) && (ns>0))
+ {
+  JGetSubmatrix(iname,oname,rows,rows);
+  return;
+ }
+
+ int in=open(iname.c_str(),O_RDONLY);
+ if (in<0)
+  JMatrixStop("SampleMatrix: cannot open file "+iname+" to read the matrix.\n");
+ unsigned char header[HEADER_SIZE];
+ ReadFileAt(in,iname,(char *)header,HEADER_SIZE,0);
+ unsigned long long endofbindata,start_comment;
+ PositionsInFile(iname,&endofbindata,&start_comment);
+
+ int out=open(oname.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+ if (out<0)
+ {
+  close(in);
+  JMatrixStop("SampleMatrix: cannot open file "+oname+" to write the sample.\n");
+ }
+
+ // Rows are copied as they are stored, one after the other
+ unsigned long long written=0;
+ BucketWriter bw(out,oname,std::vector<unsigned long long>(1,HEADER_SIZE),PERMUTE_READ_BUFFER_SIZE);
+ auto put = [&](const char *p,unsigned long long len) { bw.Put(0,p,size_t(len)); written += len; };
+ if ((method==SAMPLE_RESERVOIR) && (ns>0))
+ {
+  // A single sequential pass, up to the last chosen row, through a buffer where the rows are found one after the other
+  unsigned char sformat=SparseFormatFromHeader(header);
+  size_t vsize=ValueSize(ValueCodecFromHeader(header),size_t(SizeOfType(ctype)));
+  std::vector<unsigned long long> off;
+  if (mtype!=MTYPESPARSE)
+   off=RowOffsets(in,iname,header,nr,endofbindata);
+  else if (endian!=ThisMachineEndianness())
+   JMatrixStop("SampleMatrix: the sparse matrix in file "+iname+" has different endianness to that of this machine. Changing endianness is not yet implemented.\n");
+  std::vector<char> buf(size_t(std::min((unsigned long long)PERMUTE_READ_BUFFER_SIZE,endofbindata-HEADER_SIZE)));
+  unsigned long long bstart=HEADER_SIZE;
+  size_t blen=0,pos=0;
+  auto ensure = [&](size_t need)
+  {
+   if (pos+need<=blen)
+    return true;
+   memmove(buf.data(),buf.data()+pos,blen-pos);
+   bstart += pos;
+   blen -= pos;
+   pos=0;
+   if (need>buf.size())
+    buf.resize(need);
+   size_t len=size_t(std::min((unsigned long long)(buf.size()-blen),endofbindata-(bstart+blen)));
+   if (len>0)
+    ReadFileAt(in,iname,buf.data()+blen,len,bstart+blen);
+   blen += len;
+   return (need<=blen);
+  };
+  size_t q=0;
+  for (indextype r=0; q<rows.size(); r++)
+  {
+   unsigned long long len;
+   if (mtype==MTYPESPARSE)
+   {
+    if (!ensure(SparseRowHeadSize(sformat)))
+     JMatrixStop("SampleMatrix: unexpected end of the rows of the sparse matrix in file "+iname+" at row "+std::to_string(r)+".\n");
+    len=SparseRowBytes(buf.data()+pos,sformat,vsize);
+   }
+   else
+    len=off[r+1]-off[r];
+   if (!ensure(size_t(len)))
+    JMatrixStop("SampleMatrix: unexpected end of the rows of the matrix in file "+iname+" at row "+std::to_string(r)+".\n");
+   if (rows[q]==r)
+   {
+    put(buf.data()+pos,len);
+    q++;
+   }
+   pos += size_t(len);
+  }
+ }
+ else if (ns>0)
+ {
+  // Only the chosen rows are read, in increasing order, joining in a single read those close to each other
+  std::vector<unsigned long long> off=RowOffsets(in,iname,header,rows.back()+1,endofbindata);
+  if (off.back()>endofbindata)
+   JMatrixStop("SampleMatrix: the binary data of file "+iname+" are shorter than expected. Is it corrupted?\n");
+  std::vector<char> buf;
+  size_t q=0;
+  while (q<rows.size())
+  {
+   size_t e=q+1;
+   while ((e<rows.size()) && (off[rows[e]]-off[rows[e-1]+1]<=SAMPLE_MAX_GAP) && (off[rows[e]+1]-off[rows[q]]<=PERMUTE_READ_BUFFER_SIZE))
+    e++;
+   unsigned long long from=off[rows[q]],to=off[rows[e-1]+1];
+   buf.resize(size_t(to-from));
+   ReadFileAt(in,iname,buf.data(),buf.size(),from);
+   JStatSeek();
+   for (size_t i=q; i<e; i++)
+    put(buf.data()+(off[rows[i]]-from),off[rows[i]+1]-off[rows[i]]);
+   q=e;
+  }
+ }
+ bw.FlushAll();
+ JStatRows(ns);
+ JStatElements((unsigned long long)ns*nc);
+
+ // The header is that of the original file, with the number of rows of the sample
+ memcpy((void *)(header+2),(const void *)&ns,sizeof(indextype));
+ if (mtype==MTYPESYMMETRIC)
+  memcpy((void *)(header+2+sizeof(indextype)),(const void *)&ns,sizeof(indextype));
+ WriteFileAt(out,oname,(const char *)header,HEADER_SIZE,0);
+ std::vector<std::string> srnames;
+ if (mdinfo & ROW_NAMES)
+  for (size_t i=0; i<rows.size(); i++)
+   srnames.push_back(rnames[rows[i]]);
+ if ((mdinfo & COL_NAMES) && (mtype!=MTYPESYMMETRIC))
+  InternalGetBinNames(iname,COL_NAMES,rnames,cnames);
+ WriteRawMetadata(in,iname,start_comment,out,oname,HEADER_SIZE+written,mdinfo,srnames,cnames);
+
+ close(in);
+ close(out);
+
+ if (DEB & DEBJM)
+  std::cout << "Sample of " << ns << " rows (" << written << " bytes) written to file " << oname << ".\n";
+}
@@ -0,0 +1,341 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include "../headers/matstats.h"
+#include "../headers/jmatrixreader.h"
+#include "../headers/matinfo.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+const std::vector<std::string> MATRIX_STATS_NAMES={"sum","mean","variance","nonzeros","min","max"};
+
+/////////////////////////////////////////////////////////////////////
+
+// Statistics of a set of values: its number n, mean and sum of squared deviations from the mean (m2), and the rest of them
+struct RunningStats
+{
+ double n=0.0;
+ double mean=0.0;
+ double m2=0.0;
+ double sum=0.0;
+ unsigned long long nnz=0;
+ double minv=std::numeric_limits<double>::infinity();
+ double maxv=-std::numeric_limits<double>::infinity();
+
+ // Welford's update with one more value
+ void Add(double x)
+ {
+  n += 1.0;
+  double d=x-mean;
+  mean += d/n;
+  m2 += d*(x-mean);
+  sum += x;
+  nnz += (x!=0.0);
+  minv=std::min(minv,x);
+  maxv=std::max(maxv,x);
+ }
+
+ // Joins the statistics of another set of nb values, as in Chan et al.
+ void Merge(double nb,double meanb,double m2b,double sumb,unsigned long long nnzb,double minb,double maxb)
+ {
+  if (nb==0.0)
+   return;
+  double nt=n+nb;
+  double d=meanb-mean;
+  mean += d*(nb/nt);
+  m2 += m2b+d*d*(n*nb/nt);
+  n=nt;
+  sum += sumb;
+  nnz += nnzb;
+  minv=std::min(minv,minb);
+  maxv=std::max(maxv,maxb);
+ }
+
+ void Merge(const RunningStats &o) { Merge(o.n,o.mean,o.m2,o.sum,o.nnz,o.minv,o.maxv); }
+
+ // Adds z values that are 0 (those not stored in sparse matrices)
+ void AddZeros(double z) { Merge(z,0.0,0.0,0.0,0,0.0,0.0); }
+};
+
+// Statistics of the n values at v, with a pass to get their mean and another one to get their squared deviations from it
+template <typename T>
+static RunningStats StatsOfValues(const T *v,indextype n)
+{
+ RunningStats s;
+ if (n==0)
+  return s;
+ double sum=0.0,minv=double(v[0]),maxv=double(v[0]);
+ unsigned long long nnz=0;
+ for (indextype k=0; k<n; k++)
+ {
+  double x=double(v[k]);
+  sum += x;
+  nnz += (x!=0.0);
+  minv=std::min(minv,x);
+  maxv=std::max(maxv,x);
+ }
+ double mean=sum/double(n),m2=0.0;
+ for (indextype k=0; k<n; k++)
+ {
+  double d=double(v[k])-mean;
+  m2 += d*d;
+ }
+ s.n=double(n);
+ s.mean=mean;
+ s.m2=m2;
+ s.sum=sum;
+ s.nnz=nnz;
+ s.minv=minv;
+ s.maxv=maxv;
+ return s;
+}
+
+static void PutStats(FullMatrix<double> &M,indextype r,const RunningStats &s)
+{
+ M.Set(r,MSTAT_SUM,s.sum);
+ M.Set(r,MSTAT_MEAN,s.mean);
+ M.Set(r,MSTAT_VAR,(s.n>1.0) ? s.m2/(s.n-1.0) : 0.0);
+ M.Set(r,MSTAT_NNZ,double(s.nnz));
+ M.Set(r,MSTAT_MIN,(s.n>0.0) ? s.minv : 0.0);
+ M.Set(r,MSTAT_MAX,(s.n>0.0) ? s.maxv : 0.0);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+// Partial statistics of the columns of the rows of a block processed by a thread. Dense rows are added a whole row at a time,
+// in loops the compiler vectorises, and the block is then joined to the statistics of the former blocks.
+struct BlockColumns
+{
+ std::vector<double> cnt,sum,minv,maxv,m2;
+ std::vector<unsigned long long> nnz;
+
+ void Reset(indextype ncols)
+ {
+  cnt.assign(ncols,0.0);
+  sum.assign(ncols,0.0);
+  m2.assign(ncols,0.0);
+  nnz.assign(ncols,0);
+  minv.assign(ncols,std::numeric_limits<double>::infinity());
+  maxv.assign(ncols,-std::numeric_limits<double>::infinity());
+ }
+};
+
+// Processes rows t, t+nthreads, t+2*nthreads... of a block whose first row is first. Rows are dense (sv) or sparse (sc,sv).
+// For symmetric matrices, the values of row r at columns c<r are also the values of row c at column r, and are added as such to the column statistics.
+template <typename T>
+static void StatsOfRows(unsigned char mtype,indextype first,unsigned int t,unsigned int nthreads,indextype ncols,
+                        const std::vector<std::vector<indextype>> &sc,const std::vector<std::vector<T>> &sv,
+                        std::vector<RunningStats> &rowacc,std::vector<RunningStats> &colacc,BlockColumns &bc)
+{
+ if (mtype==MTYPESPARSE)
+ {
+  for (size_t i=t; i<sv.size(); i+=nthreads)
+  {
+   rowacc[first+i]=StatsOfValues(sv[i].data(),indextype(sv[i].size()));
+   for (size_t k=0; k<sv[i].size(); k++)
+    colacc[sc[i][k]].Add(double(sv[i][k]));
+  }
+  return;
+ }
+
+ bc.Reset(ncols);
+ for (size_t i=t; i<sv.size(); i+=nthreads)
+ {
+  const T *v=sv[i].data();
+  rowacc[first+i]=StatsOfValues(v,indextype(sv[i].size()));
+  const indextype len=(mtype==MTYPESYMMETRIC) ? first+indextype(i) : indextype(sv[i].size());
+  for (indextype c=0; c<len; c++)
+  {
+   double x=double(v[c]);
+   bc.cnt[c] += 1.0;
+   bc.sum[c] += x;
+   bc.nnz[c] += (x!=0.0);
+   bc.minv[c]=std::min(bc.minv[c],x);
+   bc.maxv[c]=std::max(bc.maxv[c],x);
+  }
+ }
+ for (size_t i=t; i<sv.size(); i+=nthreads)
+ {
+  const T *v=sv[i].data();
+  const indextype len=(mtype==MTYPESYMMETRIC) ? first+indextype(i) : indextype(sv[i].size());
+  for (indextype c=0; c<len; c++)
+  {
+   double d=double(v[c])-bc.sum[c]/bc.cnt[c];
+   bc.m2[c] += d*d;
+  }
+ }
+ for (indextype c=0; c<ncols; c++)
+  if (bc.cnt[c]>0.0)
+   colacc[c].Merge(bc.cnt[c],bc.sum[c]/bc.cnt[c],bc.m2[c],bc.sum[c],bc.nnz[c],bc.minv[c],bc.maxv[c]);
+}
+
+/////////////////////////////////////////////////////////////////////
+
+template <typename T>
+void MatrixStatistics(std::string fname,FullMatrix<double> &rowstats,FullMatrix<double> &colstats,unsigned int nthreads)
+{
+ // The whole file is read, as when the matrix is loaded
+ JMatrixOpScope opscope(STATS_LOAD);
+ JMatrixTraceSpan span("MatrixStatistics");
+
+ JMatrixReader<T> R(fname);
+ const unsigned char mtype=R.GetMatrixType();
+ const indextype nrows=R.GetNRows();
+ const indextype ncols=R.GetNCols();
+ const bool sparse=(mtype==MTYPESPARSE);
+
+ if (nthreads==0)
+  nthreads=std::max(1U,std::thread::hardware_concurrency());
+
+ double rowbytes=sparse ? double(GetFileSize(fname))/double(std::max(nrows,indextype(1))) : double(ncols)*double(sizeof(T));
+ indextype blockrows=indextype(std::max(1.0,double(STATS_BLOCK_SIZE)/std::max(1.0,rowbytes)));
+ blockrows=std::max(blockrows,indextype(4*nthreads));
+ blockrows=std::max(indextype(1),std::min(blockrows,nrows));
+
+ if (DEB & DEBJM)
+  std::cout << "Getting statistics of the " << nrows << "x" << ncols << " matrix in file " << fname << " in blocks of " << blockrows << " rows with " << nthreads << " threads.\n";
+
+ std::vector<RunningStats> rowacc(nrows);
+ std::vector<std::vector<RunningStats>> colacc(nthreads,std::vector<RunningStats>(ncols));
+ std::vector<BlockColumns> bc(nthreads);
+
+ std::vector<std::vector<indextype>> sc[2];
+ std::vector<std::vector<T>> sv[2];
+ std::vector<std::thread> workers;
+
+ for (indextype first=0,k=0; first<nrows; first+=blockrows,k++)
+ {
+  const unsigned int b=k%2;
+  const indextype last=std::min(nrows,first+blockrows);
+
+  // Read block k while the former one is being processed
+  sc[b].resize(last-first);
+  sv[b].resize(last-first);
+  for (indextype r=first; r<last; r++)
+  {
+   R.NextRow();
+   if (sparse)
+   {
+    SparseRowSpan<T> s=R.GetSparseRow();
+    sc[b][r-first].assign(s.c,s.c+s.n);
+    sv[b][r-first].assign(s.v,s.v+s.n);
+   }
+   else
+   {
+    DenseRowSpan<T> s=R.GetDenseRow();
+    sv[b][r-first].assign(s.v,s.v+s.n);
+   }
+  }
+
+  for (size_t t=0; t<workers.size(); t++)
+   workers[t].join();
+  workers.clear();
+
+  for (unsigned int t=0; t<nthreads; t++)
+   workers.push_back(std::thread(StatsOfRows<T>,mtype,first,t,nthreads,ncols,std::cref(sc[b]),std::cref(sv[b]),std::ref(rowacc),std::ref(colacc[t]),std::ref(bc[t])));
+ }
+ for (size_t t=0; t<workers.size(); t++)
+  workers[t].join();
+ bc.clear();
+
+ // Partial statistics of the columns from all threads, and zeros not stored
+ for (unsigned int t=1; t<nthreads; t++)
+ {
+  for (indextype c=0; c<ncols; c++)
+   colacc[0][c].Merge(colacc[t][c]);
+  std::vector<RunningStats>().swap(colacc[t]);
+ }
+ if (sparse)
+ {
+  for (indextype r=0; r<nrows; r++)
+   rowacc[r].AddZeros(double(ncols)-rowacc[r].n);
+  for (indextype c=0; c<ncols; c++)
+   colacc[0][c].AddZeros(double(nrows)-colacc[0][c].n);
+ }
+
+ rowstats.Resize(nrows,NUM_MATRIX_STATS);
+ colstats.Resize(ncols,NUM_MATRIX_STATS);
+ for (indextype r=0; r<nrows; r++)
+ {
+  // The rest of row r of a symmetric matrix is its column r below the diagonal
+  if (mtype==MTYPESYMMETRIC)
+   rowacc[r].Merge(colacc[0][r]);
+  PutStats(rowstats,r,rowacc[r]);
+ }
+ for (indextype c=0; c<ncols; c++)
+  PutStats(colstats,c,(mtype==MTYPESYMMETRIC) ? rowacc[c] : colacc[0][c]);
+
+ rowstats.SetColNames(MATRIX_STATS_NAMES);
+ colstats.SetColNames(MATRIX_STATS_NAMES);
+ // Rows of the statistics are named as the rows and columns of the matrix, or as R1,R2... and C1,C2... if it has no names
+ std::vector<std::string> names=R.GetRowNames();
+ if (names.size()==0)
+  for (indextype r=0; r<nrows; r++)
+   names.push_back("R"+std::to_string(r+1));
+ rowstats.SetRowNames(names);
+ names=R.GetColNames();
+ if (names.size()==0)
+  for (indextype c=0; c<ncols; c++)
+   names.push_back("C"+std::to_string(c+1));
+ colstats.SetRowNames(names);
+}
+
+TEMPLATES_ISOLATED_FUNC(void,MatrixStatistics,SINGLE_ARG(std::string fname,FullMatrix<double> &rowstats,FullMatrix<double> &colstats,unsigned int nthreads))
+
+/////////////////////////////////////////////////////////////////////
+
+void JMatStats(std::string iname,std::string oname,bool csv,unsigned int nthreads)
+{
+ unsigned char mtype,ctype;
+ MatrixType(iname,mtype,ctype);
+
+ FullMatrix<double> rowstats,colstats;
+ switch (ctype)
+ {
+  case UCTYPE: MatrixStatistics<unsigned char>(iname,rowstats,colstats,nthreads); break;
+  case SCTYPE: MatrixStatistics<char>(iname,rowstats,colstats,nthreads); break;
+  case USTYPE: MatrixStatistics<unsigned short>(iname,rowstats,colstats,nthreads); break;
+  case SSTYPE: MatrixStatistics<short>(iname,rowstats,colstats,nthreads); break;
+  case UITYPE: MatrixStatistics<unsigned int>(iname,rowstats,colstats,nthreads); break;
+  case SITYPE: MatrixStatistics<int>(iname,rowstats,colstats,nthreads); break;
+  case ULTYPE: MatrixStatistics<unsigned long>(iname,rowstats,colstats,nthreads); break;
+  case SLTYPE: MatrixStatistics<long>(iname,rowstats,colstats,nthreads); break;
+  case ULLTYPE: MatrixStatistics<unsigned long long>(iname,rowstats,colstats,nthreads); break;
+  case SLLTYPE: MatrixStatistics<long long>(iname,rowstats,colstats,nthreads); break;
+  case FTYPE: MatrixStatistics<float>(iname,rowstats,colstats,nthreads); break;
+  case DTYPE: MatrixStatistics<double>(iname,rowstats,colstats,nthreads); break;
+  case LDTYPE: MatrixStatistics<long double>(iname,rowstats,colstats,nthreads); break;
+  default: JMatrixStop("Unexpected error in JMatStats: unknown data type.\n"); break;
+ }
+
+ if (csv)
+ {
+  rowstats.WriteCsv(oname+".rows.csv");
+  colstats.WriteCsv(oname+".cols.csv");
+ }
+ else
+ {
+  rowstats.WriteBin(oname+".rows");
+  colstats.WriteBin(oname+".cols");
+ }
+}
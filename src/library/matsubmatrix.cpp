@@ -0,0 +1,355 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../headers/matsubmatrix.h"
+#include "../headers/jmatrixreader.h"
+#include "../headers/jmatrixwriter.h"
+#include "../headers/matmetadata.h"
+#include "../headers/matinfo.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+/////////////////////////////////////////////////////////////////////
+
+// A run of consecutive stored columns of a full matrix read at once, and the place of its first value in the segment of a row made by all the runs
+struct ColumnRun
+{
+ indextype first;
+ indextype n;
+ size_t pos;
+};
+
+// Groups the requested columns in runs, joining those whose gap is not longer than SUBMATRIX_MAX_GAP bytes,
+// and finds the place of each requested column in the segment of the runs
+static void ColumnRuns(const std::vector<indextype> &cols,unsigned long long es,std::vector<ColumnRun> &runs,std::vector<size_t> &where)
+{
+ std::vector<indextype> sorted(cols);
+ std::sort(sorted.begin(),sorted.end());
+ sorted.erase(std::unique(sorted.begin(),sorted.end()),sorted.end());
+
+ runs.clear();
+ size_t pos=0;
+ for (size_t k=0; k<sorted.size(); k++)
+ {
+  if (!runs.empty() && ((unsigned long long)(sorted[k]-(runs.back().first+runs.back().n))*es<=SUBMATRIX_MAX_GAP))
+  {
+   indextype n=sorted[k]-runs.back().first+1;
+   pos += n-runs.back().n;
+   runs.back().n=n;
+  }
+  else
+  {
+   runs.push_back(ColumnRun{sorted[k],1,pos});
+   pos++;
+  }
+ }
+
+ where.resize(cols.size());
+ for (size_t j=0; j<cols.size(); j++)
+ {
+  auto it=std::upper_bound(runs.begin(),runs.end(),cols[j],[](indextype c,const ColumnRun &run) { return c<run.first; });
+  --it;
+  where[j]=it->pos+(cols[j]-it->first);
+ }
+}
+
+// Reads exactly n bytes at offset off of the file open as fd
+static void ReadAt(int fd,std::string fname,unsigned char *dst,size_t n,unsigned long long off)
+{
+ JStatSeek();
+ JStatRead(n);
+ while (n>0)
+ {
+  ssize_t got=pread(fd,(void *)dst,n,(off_t)off);
+  if (got<=0)
+   JMatrixStop("GetSubmatrix: unexpected end of file "+fname+" reading the rows of the full matrix.\n");
+  dst += got;
+  n -= size_t(got);
+  off += (unsigned long long)got;
+ }
+}
+
+template <typename T>
+void GetSubmatrix(std::string iname,std::string oname,std::vector<indextype> rows,std::vector<indextype> cols)
+{
+ JMatrixOpScope opscope(STATS_FILEOP);
+ JMatrixTraceSpan span("GetSubmatrix");
+
+ unsigned char mtype,ctype,endian,mdinfo;
+ indextype nrows,ncols;
+ MatrixType(iname,mtype,ctype,endian,mdinfo,nrows,ncols);
+
+ if (rows.empty() || cols.empty())
+  JMatrixStop("GetSubmatrix: at least one row and one column must be requested.\n");
+ for (size_t i=0; i<rows.size(); i++)
+  if (rows[i]>=nrows)
+   JMatrixStop("GetSubmatrix: at least one of the requested rows is beyond the limit of the matrix.\n");
+ for (size_t j=0; j<cols.size(); j++)
+  if (cols[j]>=ncols)
+   JMatrixStop("GetSubmatrix: at least one of the requested columns is beyond the limit of the matrix.\n");
+
+ const unsigned char omtype=((mtype==MTYPESYMMETRIC) && (rows!=cols)) ? MTYPEFULL : mtype;
+ const indextype nsel=indextype(cols.size());
+ JStatRows(rows.size());
+ JStatElements((unsigned long long)rows.size()*nsel);
+
+ if (DEB & DEBJM)
+  std::cout << "Extracting a submatrix of " << rows.size() << " rows and " << nsel << " columns from the (" << nrows << "x" << ncols << ") matrix in file " << iname << ".\n";
+
+ ValueCodec vc=ValueCodecFromFile(iname);
+ const unsigned long long es=(unsigned long long)ValueSize(vc,sizeof(T));
+
+ // Full matrices: runs of columns read from each row
+ int fd=-1;
+ std::vector<ColumnRun> runs;
+ std::vector<size_t> where;
+ std::vector<unsigned char> raw;
+ std::vector<T> seg;
+ // Symmetric matrices: the mapped file
+ void *map=nullptr;
+ size_t maplen=0;
+ // Sparse and bit matrices: the reader and, for sparse ones, the requested places of each column, as [start[c],start[c+1]) in bycol
+ std::unique_ptr<JMatrixReader<T>> R;
+ std::vector<size_t> start;
+ std::vector<indextype> bycol;
+ std::vector<std::pair<indextype,T>> entries;
+
+ switch (mtype)
+ {
+  case MTYPEFULL:
+    ColumnRuns(cols,es,runs,where);
+    raw.resize(size_t(runs.back().pos+runs.back().n)*es);
+    seg.resize(runs.back().pos+runs.back().n);
+    fd=open(iname.c_str(),O_RDONLY);
+    if (fd<0)
+     JMatrixStop("GetSubmatrix: cannot open file "+iname+"\n");
+    break;
+  case MTYPESYMMETRIC:
+  {
+    maplen=HEADER_SIZE+(((unsigned long long)nrows*((unsigned long long)nrows+1))/2)*es;
+    fd=open(iname.c_str(),O_RDONLY);
+    if (fd<0)
+     JMatrixStop("GetSubmatrix: cannot open file "+iname+"\n");
+    map=mmap(nullptr,maplen,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    fd=-1;
+    if (map==MAP_FAILED)
+     JMatrixStop("GetSubmatrix: cannot map file "+iname+"\n");
+    break;
+  }
+  case MTYPESPARSE:
+    start.assign(size_t(ncols)+1,0);
+    for (size_t j=0; j<cols.size(); j++)
+     start[cols[j]+1]++;
+    for (indextype c=0; c<ncols; c++)
+     start[c+1] += start[c];
+    bycol.resize(cols.size());
+    {
+     std::vector<size_t> next(start.begin(),start.end()-1);
+     for (size_t j=0; j<cols.size(); j++)
+      bycol[next[cols[j]]++]=indextype(j);
+    }
+    R.reset(new JMatrixReader<T>(iname));
+    break;
+  case MTYPEBIT:
+    R.reset(new JMatrixReader<T>(iname));
+    break;
+  default:
+    JMatrixStop("GetSubmatrix: unknown matrix type in file "+iname+".\n");
+    break;
+ }
+
+ // Leaves in ov the values of row i of the submatrix (its first i+1 for symmetric submatrices), or in (oc,ov) its non-zero entries for sparse ones
+ auto getrow=[&](size_t i,std::vector<indextype> &oc,std::vector<T> &ov)
+ {
+  const indextype r=rows[i];
+  switch (mtype)
+  {
+   case MTYPEFULL:
+   {
+     const unsigned long long rowoff=HEADER_SIZE+(unsigned long long)r*(unsigned long long)ncols*es;
+     for (size_t k=0; k<runs.size(); k++)
+      ReadAt(fd,iname,raw.data()+runs[k].pos*es,size_t(runs[k].n*es),rowoff+runs[k].first*es);
+     DecodeValues(vc,raw.data(),seg.size(),seg.data());
+     ov.resize(nsel);
+     for (indextype j=0; j<nsel; j++)
+      ov[j]=seg[where[j]];
+     break;
+   }
+   case MTYPESYMMETRIC:
+   {
+     const unsigned char *base=(const unsigned char *)map+HEADER_SIZE;
+     const indextype len=(omtype==MTYPESYMMETRIC) ? indextype(i+1) : nsel;
+     ov.resize(len);
+     for (indextype j=0; j<len; j++)
+     {
+      unsigned long long hi=std::max(r,cols[j]),lo=std::min(r,cols[j]);
+      DecodeValues(vc,base+((hi*(hi+1))/2+lo)*es,1,&ov[j]);
+     }
+     JStatMappedRead((unsigned long long)len*es);
+     break;
+   }
+   case MTYPESPARSE:
+   {
+     R->SeekRow(r);
+     SparseRowSpan<T> s=R->GetSparseRow();
+     entries.clear();
+     for (indextype k=0; k<s.n; k++)
+      for (size_t p=start[s.c[k]]; p<start[s.c[k]+1]; p++)
+       entries.push_back(std::make_pair(bycol[p],s.v[k]));
+     std::sort(entries.begin(),entries.end(),[](const std::pair<indextype,T> &a,const std::pair<indextype,T> &b) { return a.first<b.first; });
+     oc.resize(entries.size());
+     ov.resize(entries.size());
+     for (size_t k=0; k<entries.size(); k++)
+     {
+      oc[k]=entries[k].first;
+      ov[k]=entries[k].second;
+     }
+     break;
+   }
+   default:
+   {
+     R->SeekRow(r);
+     DenseRowSpan<T> s=R->GetDenseRow();
+     ov.resize(nsel);
+     for (indextype j=0; j<nsel; j++)
+      ov[j]=s.v[cols[j]];
+     break;
+   }
+  }
+ };
+
+ JMatrixWriter<T> w(oname,omtype,nsel);
+ std::vector<indextype> oc;
+ std::vector<T> ov;
+
+ // Quantised encodings need the range of the values before the first row is written, which takes a first pass over the rows
+ if (w.NeedsValueRange())
+ {
+  double minv=std::numeric_limits<double>::max();
+  double maxv=std::numeric_limits<double>::lowest();
+  for (size_t i=0; i<rows.size(); i++)
+  {
+   getrow(i,oc,ov);
+   for (size_t j=0; j<ov.size(); j++)
+   {
+    minv=std::min(minv,double(ov[j]));
+    maxv=std::max(maxv,double(ov[j]));
+   }
+  }
+  w.SetValueRange(minv,maxv);
+ }
+
+ for (size_t i=0; i<rows.size(); i++)
+ {
+  getrow(i,oc,ov);
+  if (omtype==MTYPESPARSE)
+   w.AppendSparseRow(indextype(oc.size()),oc.data(),ov.data());
+  else
+   w.AppendRow(ov.data());
+ }
+
+ if (fd>=0)
+  close(fd);
+ if (map!=nullptr)
+  munmap(map,maplen);
+
+ std::vector<std::string> rnames,cnames,sel;
+ // Asked for separately, since asking for both returns none if only one of them is stored
+ InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+ InternalGetBinNames(iname,COL_NAMES,rnames,cnames);
+ if (rnames.size()>0)
+ {
+  for (size_t i=0; i<rows.size(); i++)
+   sel.push_back(rnames[rows[i]]);
+  w.SetRowNames(sel);
+ }
+ if (cnames.size()>0)
+ {
+  sel.clear();
+  for (size_t j=0; j<cols.size(); j++)
+   sel.push_back(cnames[cols[j]]);
+  w.SetColNames(sel);
+ }
+ w.Close();
+}
+
+TEMPLATES_ISOLATED_FUNC(void,GetSubmatrix,SINGLE_ARG(std::string iname,std::string oname,std::vector<indextype> rows,std::vector<indextype> cols))
+
+/////////////////////////////////////////////////////////////////////
+
+void JGetSubmatrix(std::string iname,std::string oname,std::vector<indextype> lrows,std::vector<indextype> lcols)
+{
+ unsigned char mtype,ctype;
+ MatrixType(iname,mtype,ctype);
+
+ switch (ctype)
+ {
+  case UCTYPE: GetSubmatrix<unsigned char>(iname,oname,lrows,lcols); break;
+  case SCTYPE: GetSubmatrix<char>(iname,oname,lrows,lcols); break;
+  case USTYPE: GetSubmatrix<unsigned short>(iname,oname,lrows,lcols); break;
+  case SSTYPE: GetSubmatrix<short>(iname,oname,lrows,lcols); break;
+  case UITYPE: GetSubmatrix<unsigned int>(iname,oname,lrows,lcols); break;
+  case SITYPE: GetSubmatrix<int>(iname,oname,lrows,lcols); break;
+  case ULTYPE: GetSubmatrix<unsigned long>(iname,oname,lrows,lcols); break;
+  case SLTYPE: GetSubmatrix<long>(iname,oname,lrows,lcols); break;
+  case ULLTYPE: GetSubmatrix<unsigned long long>(iname,oname,lrows,lcols); break;
+  case SLLTYPE: GetSubmatrix<long long>(iname,oname,lrows,lcols); break;
+  case FTYPE: GetSubmatrix<float>(iname,oname,lrows,lcols); break;
+  case DTYPE: GetSubmatrix<double>(iname,oname,lrows,lcols); break;
+  case LDTYPE: GetSubmatrix<long double>(iname,oname,lrows,lcols); break;
+  default: JMatrixStop("Unexpected error in JGetSubmatrix: unknown data type.\n"); break;
+ }
+}
+
+// Indices of the names in lnames, looked up in a hash table built once from all the names of the matrix
+static void IndicesOfNames(std::string iname,std::vector<std::string> &allnames,std::vector<std::string> &lnames,std::string what,std::vector<indextype> &idx)
+{
+ std::unordered_map<std::string,indextype> place;
+ for (size_t k=allnames.size(); k>0; k--)        // Backwards, so that the first of repeated names is kept
+  place[allnames[k-1]]=indextype(k-1);
+ idx.clear();
+ for (size_t k=0; k<lnames.size(); k++)
+ {
+  auto it=place.find(lnames[k]);
+  if (it==place.end())
+   JMatrixStop("Error: no "+what+" with name '"+lnames[k]+"' found in matrix contained in file "+iname+".\n");
+  idx.push_back(it->second);
+ }
+}
+
+void JGetSubmatrixByNames(std::string iname,std::string oname,std::vector<std::string> lrows,std::vector<std::string> lcols)
+{
+ std::vector<std::string> rnames,cnames;
+ // Asked for separately, since asking for both returns none if only one of them is stored
+ InternalGetBinNames(iname,ROW_NAMES,rnames,cnames);
+ InternalGetBinNames(iname,COL_NAMES,rnames,cnames);
+ std::vector<indextype> lnrows,lncols;
+ IndicesOfNames(iname,rnames,lrows,"row",lnrows);
+ IndicesOfNames(iname,cnames,lcols,"column",lncols);
+ JGetSubmatrix(iname,oname,lnrows,lncols);
+}
@@ -0,0 +1,482 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../headers/rowcache.h"
+#include "../headers/matgetrows.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+// Size of the read-ahead buffer of the reader used to fetch rows. Accesses are mostly random, so a big buffer would be useless.
+const size_t ROW_CACHE_READ_BUFFER_SIZE=64*1024;
+
+/****************************************
+  TEMPLATED CONSTRUCTORS AND FUNCTIONS
+*****************************************/
+
+template <typename T>
+JMatrixRowCache<T>::JMatrixRowCache(std::string fname,size_t budget,unsigned char policy)
+{
+ if ((policy!=CACHE_LRU) && (policy!=CACHE_CLOCK))
+ {
+  std::ostringstream errst;
+  errst << "JMatrixRowCache: " << int(policy) << " is not a valid eviction policy. Use CACHE_LRU or CACHE_CLOCK.\n";
+  JMatrixStop(errst.str());
+ }
+
+ // The reader checks the matrix type and the endianness, and converts values stored as another data type.
+ reader.reset(new JMatrixReader<T>(fname,ROW_CACHE_READ_BUFFER_SIZE));
+
+ this->fname=fname;
+ this->budget=budget;
+ this->policy=policy;
+ nr=reader->GetNRows();
+ nc=reader->GetNCols();
+ mtype=reader->GetMatrixType();
+ rowbytes=size_t(nc)*sizeof(T);
+ used=0;
+ hits=misses=evictions=0;
+ hand=0;
+
+ if (DEB & DEBJM)
+  std::cout << "Row cache for " << MatrixTypeName(mtype) << " of (" << nr << "x" << nc << ") in file " << fname << " with a budget of " << budget << " bytes (" << budget/((rowbytes>0) ? rowbytes : 1) << " rows) and " << ((policy==CACHE_LRU) ? "LRU" : "CLOCK") << " eviction.\n";
+}
+
+TEMPLATES_CONST(JMatrixRowCache,SINGLE_ARG(std::string fname,size_t budget,unsigned char policy))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::CheckRow(indextype r)
+{
+ if (r>=nr)
+ {
+  std::ostringstream errst;
+  errst << "Runtime error in JMatrixRowCache<T>: the row index " << r << " is out of bounds.\n";
+  errst << "The matrix in file " << fname << " has " << nr << " rows.\n";
+  JMatrixStop(errst.str());
+ }
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,CheckRow,indextype r)
+
+//////////////////////////////////////////////////////////////////
+
+// Marks a row as just used. Called with mtx locked.
+template <typename T>
+void JMatrixRowCache<T>::Touch(CachedRow &e)
+{
+ if (policy==CACHE_LRU)
+  lru.splice(lru.begin(),lru,e.lrupos);
+ else
+  e.referenced=true;
+}
+
+template void JMatrixRowCache<unsigned char>::Touch(JMatrixRowCache<unsigned char>::CachedRow &e);
+template void JMatrixRowCache<char>::Touch(JMatrixRowCache<char>::CachedRow &e);
+template void JMatrixRowCache<unsigned short>::Touch(JMatrixRowCache<unsigned short>::CachedRow &e);
+template void JMatrixRowCache<short>::Touch(JMatrixRowCache<short>::CachedRow &e);
+template void JMatrixRowCache<unsigned int>::Touch(JMatrixRowCache<unsigned int>::CachedRow &e);
+template void JMatrixRowCache<int>::Touch(JMatrixRowCache<int>::CachedRow &e);
+template void JMatrixRowCache<unsigned long>::Touch(JMatrixRowCache<unsigned long>::CachedRow &e);
+template void JMatrixRowCache<long>::Touch(JMatrixRowCache<long>::CachedRow &e);
+template void JMatrixRowCache<unsigned long long>::Touch(JMatrixRowCache<unsigned long long>::CachedRow &e);
+template void JMatrixRowCache<long long>::Touch(JMatrixRowCache<long long>::CachedRow &e);
+template void JMatrixRowCache<float>::Touch(JMatrixRowCache<float>::CachedRow &e);
+template void JMatrixRowCache<double>::Touch(JMatrixRowCache<double>::CachedRow &e);
+template void JMatrixRowCache<long double>::Touch(JMatrixRowCache<long double>::CachedRow &e);
+
+//////////////////////////////////////////////////////////////////
+
+// Removes one unpinned row according to the policy. Returns false if all cached rows are pinned. Called with mtx locked.
+template <typename T>
+bool JMatrixRowCache<T>::EvictOne()
+{
+ indextype victim=0;
+ bool found=false;
+
+ if (policy==CACHE_LRU)
+ {
+  for (auto it=lru.rbegin(); it!=lru.rend(); ++it)
+   if (rows[*it].pins==0)
+   {
+    victim=*it;
+    found=true;
+    break;
+   }
+  if (!found)
+   return false;
+  lru.erase(rows[victim].lrupos);
+ }
+ else
+ {
+  // Two turns of the hand are enough: the first one clears the reference bits
+  for (size_t steps=0; (steps<2*ring.size()) && !found; steps++)
+  {
+   if (hand>=ring.size())
+    hand=0;
+   CachedRow &e=rows[ring[hand]];
+   if (e.pins>0)
+    hand++;
+   else if (e.referenced)
+   {
+    e.referenced=false;
+    hand++;
+   }
+   else
+   {
+    victim=ring[hand];
+    found=true;
+   }
+  }
+  if (!found)
+   return false;
+  // The last row of the ring takes the place of the victim
+  ring[hand]=ring.back();
+  rows[ring[hand]].clockpos=hand;
+  ring.pop_back();
+ }
+
+ rows.erase(victim);
+ used -= rowbytes;
+ evictions++;
+ return true;
+}
+
+TEMPLATES_FUNC(bool,JMatrixRowCache,EvictOne,)
+
+//////////////////////////////////////////////////////////////////
+
+// Stores a row read from disk, making room for it if needed. Called with mtx locked.
+template <typename T>
+void JMatrixRowCache<T>::Insert(indextype r,std::vector<T> &v,unsigned int pins)
+{
+ auto it=rows.find(r);
+ if (it!=rows.end())   // Another thread read it at the same time
+ {
+  it->second.pins += pins;
+  return;
+ }
+
+ while ((used+rowbytes>budget) && EvictOne())
+  ;
+ if ((used+rowbytes>budget) && (pins==0))
+  return;
+
+ CachedRow &e=rows[r];
+ e.v.swap(v);
+ e.pins=pins;
+ e.referenced=true;
+ if (policy==CACHE_LRU)
+ {
+  lru.push_front(r);
+  e.lrupos=lru.begin();
+ }
+ else
+ {
+  e.clockpos=ring.size();
+  ring.push_back(r);
+ }
+ used += rowbytes;
+}
+
+template void JMatrixRowCache<unsigned char>::Insert(indextype r,std::vector<unsigned char> &v,unsigned int pins);
+template void JMatrixRowCache<char>::Insert(indextype r,std::vector<char> &v,unsigned int pins);
+template void JMatrixRowCache<unsigned short>::Insert(indextype r,std::vector<unsigned short> &v,unsigned int pins);
+template void JMatrixRowCache<short>::Insert(indextype r,std::vector<short> &v,unsigned int pins);
+template void JMatrixRowCache<unsigned int>::Insert(indextype r,std::vector<unsigned int> &v,unsigned int pins);
+template void JMatrixRowCache<int>::Insert(indextype r,std::vector<int> &v,unsigned int pins);
+template void JMatrixRowCache<unsigned long>::Insert(indextype r,std::vector<unsigned long> &v,unsigned int pins);
+template void JMatrixRowCache<long>::Insert(indextype r,std::vector<long> &v,unsigned int pins);
+template void JMatrixRowCache<unsigned long long>::Insert(indextype r,std::vector<unsigned long long> &v,unsigned int pins);
+template void JMatrixRowCache<long long>::Insert(indextype r,std::vector<long long> &v,unsigned int pins);
+template void JMatrixRowCache<float>::Insert(indextype r,std::vector<float> &v,unsigned int pins);
+template void JMatrixRowCache<double>::Insert(indextype r,std::vector<double> &v,unsigned int pins);
+template void JMatrixRowCache<long double>::Insert(indextype r,std::vector<long double> &v,unsigned int pins);
+
+//////////////////////////////////////////////////////////////////
+
+// Reads the rows (whose indices are sorted) from the file. Called with iomtx locked.
+template <typename T>
+void JMatrixRowCache<T>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<T>> &m)
+{
+ if (mtype==MTYPESYMMETRIC)
+ {
+  GetManyRowsFromSymmetric(fname,which,nc,m);
+  return;
+ }
+
+ m.resize(which.size());
+ for (size_t k=0; k<which.size(); k++)
+ {
+  reader->SeekRow(which[k]);
+  m[k].resize(nc);
+  reader->GetRow(m[k].data());
+ }
+}
+
+template void JMatrixRowCache<unsigned char>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<unsigned char>> &m);
+template void JMatrixRowCache<char>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<char>> &m);
+template void JMatrixRowCache<unsigned short>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<unsigned short>> &m);
+template void JMatrixRowCache<short>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<short>> &m);
+template void JMatrixRowCache<unsigned int>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<unsigned int>> &m);
+template void JMatrixRowCache<int>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<int>> &m);
+template void JMatrixRowCache<unsigned long>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<unsigned long>> &m);
+template void JMatrixRowCache<long>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<long>> &m);
+template void JMatrixRowCache<unsigned long long>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<unsigned long long>> &m);
+template void JMatrixRowCache<long long>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<long long>> &m);
+template void JMatrixRowCache<float>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<float>> &m);
+template void JMatrixRowCache<double>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<double>> &m);
+template void JMatrixRowCache<long double>::ReadFromDisk(std::vector<indextype> &which,std::vector<std::vector<long double>> &m);
+
+//////////////////////////////////////////////////////////////////
+
+// Serves the wanted rows from the cache and reads the rest from disk in one batch. If m is not null, rows are copied to it.
+template <typename T>
+void JMatrixRowCache<T>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<T>> *m,unsigned int pins)
+{
+ for (size_t k=0; k<wanted.size(); k++)
+  CheckRow(wanted[k]);
+
+ if (m!=nullptr)
+  m->resize(wanted.size());
+
+ std::vector<indextype> missing;
+ std::vector<size_t> missingpos;
+ {
+  std::lock_guard<std::mutex> lock(mtx);
+  for (size_t k=0; k<wanted.size(); k++)
+  {
+   auto it=rows.find(wanted[k]);
+   if (it!=rows.end())
+   {
+    hits++;
+    Touch(it->second);
+    it->second.pins += pins;
+    if (m!=nullptr)
+     (*m)[k]=it->second.v;
+   }
+   else
+   {
+    misses++;
+    missing.push_back(wanted[k]);
+    missingpos.push_back(k);
+   }
+  }
+ }
+
+ if (missing.empty())
+  return;
+
+ // Rows are read in increasing order and only once, even if requested more than once
+ std::vector<indextype> toread(missing);
+ std::sort(toread.begin(),toread.end());
+ toread.erase(std::unique(toread.begin(),toread.end()),toread.end());
+
+ std::vector<std::vector<T>> fetched;
+ {
+  std::lock_guard<std::mutex> iolock(iomtx);
+  ReadFromDisk(toread,fetched);
+ }
+
+ if (m!=nullptr)
+  for (size_t k=0; k<missing.size(); k++)
+  {
+   size_t p=size_t(std::lower_bound(toread.begin(),toread.end(),missing[k])-toread.begin());
+   (*m)[missingpos[k]]=fetched[p];
+  }
+
+ std::lock_guard<std::mutex> lock(mtx);
+ for (size_t p=0; p<toread.size(); p++)
+ {
+  // A row requested n times in the same call of Pin gets n pins
+  unsigned int npins = (pins==0) ? 0 : pins*(unsigned int)std::count(missing.begin(),missing.end(),toread[p]);
+  Insert(toread[p],fetched[p],npins);
+ }
+}
+
+template void JMatrixRowCache<unsigned char>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<unsigned char>> *m,unsigned int pins);
+template void JMatrixRowCache<char>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<char>> *m,unsigned int pins);
+template void JMatrixRowCache<unsigned short>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<unsigned short>> *m,unsigned int pins);
+template void JMatrixRowCache<short>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<short>> *m,unsigned int pins);
+template void JMatrixRowCache<unsigned int>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<unsigned int>> *m,unsigned int pins);
+template void JMatrixRowCache<int>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<int>> *m,unsigned int pins);
+template void JMatrixRowCache<unsigned long>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<unsigned long>> *m,unsigned int pins);
+template void JMatrixRowCache<long>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<long>> *m,unsigned int pins);
+template void JMatrixRowCache<unsigned long long>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<unsigned long long>> *m,unsigned int pins);
+template void JMatrixRowCache<long long>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<long long>> *m,unsigned int pins);
+template void JMatrixRowCache<float>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<float>> *m,unsigned int pins);
+template void JMatrixRowCache<double>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<double>> *m,unsigned int pins);
+template void JMatrixRowCache<long double>::Fetch(std::vector<indextype> &wanted,std::vector<std::vector<long double>> *m,unsigned int pins);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::GetRow(indextype r,std::vector<T> &v)
+{
+ std::vector<indextype> wanted(1,r);
+ std::vector<std::vector<T>> m;
+ Fetch(wanted,&m,0);
+ v.swap(m[0]);
+}
+
+TEMPLATES_SETFUNCVEC(void,JMatrixRowCache,GetRow,indextype r,&v)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::GetRows(std::vector<indextype> rows,std::vector<std::vector<T>> &m)
+{
+ Fetch(rows,&m,0);
+}
+
+template void JMatrixRowCache<unsigned char>::GetRows(std::vector<indextype> rows,std::vector<std::vector<unsigned char>> &m);
+template void JMatrixRowCache<char>::GetRows(std::vector<indextype> rows,std::vector<std::vector<char>> &m);
+template void JMatrixRowCache<unsigned short>::GetRows(std::vector<indextype> rows,std::vector<std::vector<unsigned short>> &m);
+template void JMatrixRowCache<short>::GetRows(std::vector<indextype> rows,std::vector<std::vector<short>> &m);
+template void JMatrixRowCache<unsigned int>::GetRows(std::vector<indextype> rows,std::vector<std::vector<unsigned int>> &m);
+template void JMatrixRowCache<int>::GetRows(std::vector<indextype> rows,std::vector<std::vector<int>> &m);
+template void JMatrixRowCache<unsigned long>::GetRows(std::vector<indextype> rows,std::vector<std::vector<unsigned long>> &m);
+template void JMatrixRowCache<long>::GetRows(std::vector<indextype> rows,std::vector<std::vector<long>> &m);
+template void JMatrixRowCache<unsigned long long>::GetRows(std::vector<indextype> rows,std::vector<std::vector<unsigned long long>> &m);
+template void JMatrixRowCache<long long>::GetRows(std::vector<indextype> rows,std::vector<std::vector<long long>> &m);
+template void JMatrixRowCache<float>::GetRows(std::vector<indextype> rows,std::vector<std::vector<float>> &m);
+template void JMatrixRowCache<double>::GetRows(std::vector<indextype> rows,std::vector<std::vector<double>> &m);
+template void JMatrixRowCache<long double>::GetRows(std::vector<indextype> rows,std::vector<std::vector<long double>> &m);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::Prefetch(std::vector<indextype> rows)
+{
+ Fetch(rows,nullptr,0);
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,Prefetch,std::vector<indextype> rows)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::Pin(indextype r)
+{
+ std::vector<indextype> wanted(1,r);
+ Fetch(wanted,nullptr,1);
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,Pin,indextype r)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::Unpin(indextype r)
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ auto it=rows.find(r);
+ if ((it==rows.end()) || (it->second.pins==0))
+ {
+  std::ostringstream errst;
+  errst << "JMatrixRowCache<T>::Unpin: row " << r << " was not pinned.\n";
+  JMatrixWarning(errst.str());
+  return;
+ }
+ it->second.pins--;
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,Unpin,indextype r)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void JMatrixRowCache<T>::Clear()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ lru.clear();
+ ring.clear();
+ hand=0;
+ for (auto it=rows.begin(); it!=rows.end(); )
+ {
+  if (it->second.pins==0)
+  {
+   it=rows.erase(it);
+   used -= rowbytes;
+  }
+  else
+  {
+   if (policy==CACHE_LRU)
+   {
+    lru.push_back(it->first);
+    it->second.lrupos=std::prev(lru.end());
+   }
+   else
+   {
+    it->second.clockpos=ring.size();
+    ring.push_back(it->first);
+   }
+   ++it;
+  }
+ }
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,Clear,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+unsigned long long JMatrixRowCache<T>::GetHits()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ return hits;
+}
+
+TEMPLATES_FUNC(unsigned long long,JMatrixRowCache,GetHits,)
+
+template <typename T>
+unsigned long long JMatrixRowCache<T>::GetMisses()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ return misses;
+}
+
+TEMPLATES_FUNC(unsigned long long,JMatrixRowCache,GetMisses,)
+
+template <typename T>
+unsigned long long JMatrixRowCache<T>::GetEvictions()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ return evictions;
+}
+
+TEMPLATES_FUNC(unsigned long long,JMatrixRowCache,GetEvictions,)
+
+template <typename T>
+void JMatrixRowCache<T>::ResetCounters()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ hits=misses=evictions=0;
+}
+
+TEMPLATES_FUNC(void,JMatrixRowCache,ResetCounters,)
+
+template <typename T>
+size_t JMatrixRowCache<T>::GetUsedBytes()
+{
+ std::lock_guard<std::mutex> lock(mtx);
+ return used;
+}
+
+TEMPLATES_FUNC(size_t,JMatrixRowCache,GetUsedBytes,)
@@ -0,0 +1,387 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "../headers/sparsebuilder.h"
+#include "../headers/templatemacros.h"
+
+extern unsigned char DEB;
+
+// Below this number of triplets per thread, sorting in parallel does not pay the cost of the threads and of the per-thread counters.
+const size_t BUILDER_MIN_TRIPLETS_PER_THREAD=64*1024;
+
+const unsigned int BUILDER_MAX_SHARDS=64;
+
+/****************************************
+  AUXILIARY FUNCTIONS
+*****************************************/
+
+// One pass of a stable counting sort of the triplets (sr,sc,sv) by row (byrow true) or by column into (dr,dc,dv).
+// The input is split in nthreads consecutive chunks; each thread counts the keys of its chunk and then places its triplets
+// after those of the same key in the former chunks, which keeps the sort stable.
+// On return, the triplets with key k are at positions [start[k],start[k+1]) of the output.
+template <typename T>
+void CountingSortPass(bool byrow,indextype nkeys,const std::vector<indextype> &sr,const std::vector<indextype> &sc,const std::vector<T> &sv,
+                      std::vector<indextype> &dr,std::vector<indextype> &dc,std::vector<T> &dv,std::vector<size_t> &start,unsigned int nthreads)
+{
+ size_t n=sr.size();
+ const std::vector<indextype> &key = byrow ? sr : sc;
+ std::vector<std::vector<size_t>> pos(nthreads,std::vector<size_t>(nkeys,0));
+
+ auto count=[&](unsigned int t)
+ {
+  size_t first=(n*t)/nthreads;
+  size_t last=(n*(t+1))/nthreads;
+  std::vector<size_t> &p=pos[t];
+  for (size_t i=first;i<last;i++)
+   p[key[i]]++;
+ };
+ auto place=[&](unsigned int t)
+ {
+  size_t first=(n*t)/nthreads;
+  size_t last=(n*(t+1))/nthreads;
+  std::vector<size_t> &p=pos[t];
+  for (size_t i=first;i<last;i++)
+  {
+   size_t d=p[key[i]]++;
+   dr[d]=sr[i];
+   dc[d]=sc[i];
+   dv[d]=sv[i];
+  }
+ };
+
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(count,t));
+ count(0);
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+ workers.clear();
+
+ // Counters become the first output position of each key in each chunk
+ start.resize(size_t(nkeys)+1);
+ size_t offset=0;
+ for (indextype k=0;k<nkeys;k++)
+ {
+  start[k]=offset;
+  for (unsigned int t=0;t<nthreads;t++)
+  {
+   size_t cnt=pos[t][k];
+   pos[t][k]=offset;
+   offset += cnt;
+  }
+ }
+ start[nkeys]=offset;
+
+ dr.resize(n);
+ dc.resize(n);
+ dv.resize(n);
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(place,t));
+ place(0);
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+}
+
+// Moves the triplets [b,e) of a row, sorted by column, to its column indices (dc) and values (dv), resolving repeated positions.
+// Returns false if a repeated position is found and they are not allowed; its column is left in dupcol.
+template <typename I,typename T>
+bool FillSparseRow(const std::vector<indextype> &cols,const std::vector<T> &vals,size_t b,size_t e,unsigned char duppolicy,
+                   std::vector<I> &dc,std::vector<T> &dv,indextype &dupcol)
+{
+ dc.reserve(e-b);
+ dv.reserve(e-b);
+ size_t i=b;
+ while (i<e)
+ {
+  indextype c=cols[i];
+  T val=vals[i];
+  i++;
+  while ((i<e) && (cols[i]==c))
+  {
+   if (duppolicy==DUP_SUM)
+    val += vals[i];
+   else
+    if (duppolicy==DUP_LAST)
+     val=vals[i];
+    else
+    {
+     dupcol=c;
+     return false;
+    }
+   i++;
+  }
+  if (val!=T(0))
+  {
+   dc.push_back(I(c));
+   dv.push_back(val);
+  }
+ }
+ return true;
+}
+
+/****************************************
+  TEMPLATED CONSTRUCTORS AND FUNCTIONS
+*****************************************/
+
+template <typename T>
+SparseMatrixBuilder<T>::SparseMatrixBuilder(indextype nrows,indextype ncols,unsigned char duppolicy)
+{
+ if ((duppolicy!=DUP_SUM) && (duppolicy!=DUP_LAST) && (duppolicy!=DUP_ERROR))
+ {
+  std::ostringstream errst;
+  errst << "SparseMatrixBuilder: " << int(duppolicy) << " is not a valid policy for repeated positions. Use DUP_SUM, DUP_LAST or DUP_ERROR.\n";
+  JMatrixStop(errst.str());
+ }
+ nr=nrows;
+ nc=ncols;
+ this->duppolicy=duppolicy;
+ nshards=std::thread::hardware_concurrency();
+ if (nshards==0)
+  nshards=1;
+ if (nshards>BUILDER_MAX_SHARDS)
+  nshards=BUILDER_MAX_SHARDS;
+ shards.reset(new Shard[nshards]);
+}
+
+TEMPLATES_CONST(SparseMatrixBuilder,SINGLE_ARG(indextype nrows,indextype ncols,unsigned char duppolicy))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+typename SparseMatrixBuilder<T>::Shard &SparseMatrixBuilder<T>::MyShard()
+{
+ return shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % nshards];
+}
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void SparseMatrixBuilder<T>::CheckPosition(indextype r,indextype c)
+{
+ if ((r>=nr) || (c>=nc))
+ {
+  std::ostringstream errst;
+  errst << "SparseMatrixBuilder: position (" << r << "," << c << ") out of the bounds of a matrix of (" << nr << "x" << nc << ").\n";
+  JMatrixStop(errst.str());
+ }
+}
+
+TEMPLATES_FUNC(void,SparseMatrixBuilder,CheckPosition,SINGLE_ARG(indextype r,indextype c))
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void SparseMatrixBuilder<T>::Reserve(size_t n)
+{
+ Shard &s=MyShard();
+ std::lock_guard<std::mutex> lock(s.mtx);
+ s.r.reserve(s.r.size()+n);
+ s.c.reserve(s.c.size()+n);
+ s.v.reserve(s.v.size()+n);
+}
+
+TEMPLATES_FUNC(void,SparseMatrixBuilder,Reserve,size_t n)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void SparseMatrixBuilder<T>::Add(indextype r,indextype c,T v)
+{
+ CheckPosition(r,c);
+ Shard &s=MyShard();
+ std::lock_guard<std::mutex> lock(s.mtx);
+ s.r.push_back(r);
+ s.c.push_back(c);
+ s.v.push_back(v);
+}
+
+TEMPLATES_SETFUNC(void,SparseMatrixBuilder,Add,SINGLE_ARG(indextype r,indextype c),v)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void SparseMatrixBuilder<T>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<T> &v)
+{
+ if ((rows.size()!=cols.size()) || (rows.size()!=v.size()))
+  JMatrixStop("SparseMatrixBuilder::AddMany: the vectors of rows, columns and values must have the same length.\n");
+ for (size_t i=0;i<rows.size();i++)
+  CheckPosition(rows[i],cols[i]);
+
+ Shard &s=MyShard();
+ std::lock_guard<std::mutex> lock(s.mtx);
+ s.r.insert(s.r.end(),rows.begin(),rows.end());
+ s.c.insert(s.c.end(),cols.begin(),cols.end());
+ s.v.insert(s.v.end(),v.begin(),v.end());
+}
+
+template void SparseMatrixBuilder<unsigned char>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<unsigned char> &v);
+template void SparseMatrixBuilder<char>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<char> &v);
+template void SparseMatrixBuilder<unsigned short>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<unsigned short> &v);
+template void SparseMatrixBuilder<short>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<short> &v);
+template void SparseMatrixBuilder<unsigned int>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<unsigned int> &v);
+template void SparseMatrixBuilder<int>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<int> &v);
+template void SparseMatrixBuilder<unsigned long>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<unsigned long> &v);
+template void SparseMatrixBuilder<long>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<long> &v);
+template void SparseMatrixBuilder<unsigned long long>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<unsigned long long> &v);
+template void SparseMatrixBuilder<long long>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<long long> &v);
+template void SparseMatrixBuilder<float>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<float> &v);
+template void SparseMatrixBuilder<double>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<double> &v);
+template void SparseMatrixBuilder<long double>::AddMany(const std::vector<indextype> &rows,const std::vector<indextype> &cols,const std::vector<long double> &v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+size_t SparseMatrixBuilder<T>::Size()
+{
+ size_t n=0;
+ for (unsigned int i=0;i<nshards;i++)
+ {
+  std::lock_guard<std::mutex> lock(shards[i].mtx);
+  n += shards[i].r.size();
+ }
+ return n;
+}
+
+TEMPLATES_FUNC(size_t,SparseMatrixBuilder,Size,)
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void SparseMatrixBuilder<T>::Build(SparseMatrix<T> &M,unsigned int nthreads)
+{
+ JMatrixTraceSpan span("SparseMatrixBuilder Build");
+ JMatrixTraceSpan phase("gather");
+
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads==0)
+  nthreads=1;
+
+ // The triplets of all shards are moved to three vectors. Shards are emptied (and their memory released) as we go.
+ size_t n=Size();
+ std::vector<indextype> r0,c0;
+ std::vector<T> v0;
+ r0.reserve(n);
+ c0.reserve(n);
+ v0.reserve(n);
+ for (unsigned int i=0;i<nshards;i++)
+ {
+  r0.insert(r0.end(),shards[i].r.begin(),shards[i].r.end());
+  c0.insert(c0.end(),shards[i].c.begin(),shards[i].c.end());
+  v0.insert(v0.end(),shards[i].v.begin(),shards[i].v.end());
+  std::vector<indextype>().swap(shards[i].r);
+  std::vector<indextype>().swap(shards[i].c);
+  std::vector<T>().swap(shards[i].v);
+ }
+
+ unsigned int nsort=nthreads;
+ if (n/BUILDER_MIN_TRIPLETS_PER_THREAD<nsort)
+  nsort=(n<BUILDER_MIN_TRIPLETS_PER_THREAD) ? 1 : (unsigned int)(n/BUILDER_MIN_TRIPLETS_PER_THREAD);
+
+ if (DEB & DEBJM)
+  std::cout << "Building sparse matrix of (" << nr << "x" << nc << ") from " << n << " triplets with " << nsort << " sorting threads.\n";
+
+ // Triplets which come already sorted by row and column (as those of a generator or a file) need no sort at all
+ bool sorted=true;
+ for (size_t i=1;(i<n) && sorted;i++)
+  sorted = (r0[i-1]<r0[i]) || ((r0[i-1]==r0[i]) && (c0[i-1]<=c0[i]));
+
+ std::vector<size_t> start;
+ if (sorted)
+ {
+  start.assign(size_t(nr)+1,0);
+  for (size_t i=0;i<n;i++)
+   start[r0[i]+1]++;
+  for (indextype r=0;r<nr;r++)
+   start[r+1] += start[r];
+ }
+ else
+ {
+  // LSD radix sort with the column as the less significant digit: after the stable sort by row, each row is sorted by column
+  // and repeated positions keep the order in which they were added.
+  std::vector<indextype> r1,c1;
+  std::vector<T> v1;
+  phase.Next("sort by column");
+  CountingSortPass(false,nc,r0,c0,v0,r1,c1,v1,start,nsort);
+  phase.Next("sort by row");
+  CountingSortPass(true,nr,r1,c1,v1,r0,c0,v0,start,nsort);
+ }
+
+ phase.Next("fill rows");
+ M.pattern=false;          // The built matrix has the added values
+ M.Resize(nr,nc);
+
+ std::atomic<bool> dupfound(false);
+ indextype duprow=0,dupcol=0;
+ std::mutex dupmtx;
+
+ auto fill=[&](indextype first,indextype last)
+ {
+  indextype c;
+  for (indextype r=first;r<last;r++)
+  {
+   bool ok = M.narrow ? FillSparseRow(c0,v0,start[r],start[r+1],duppolicy,M.datacols16[r],M.data[r],c)
+                      : FillSparseRow(c0,v0,start[r],start[r+1],duppolicy,M.datacols[r],M.data[r],c);
+   if (!ok)
+   {
+    if (!dupfound.exchange(true))
+    {
+     std::lock_guard<std::mutex> lock(dupmtx);
+     duprow=r;
+     dupcol=c;
+    }
+    return;
+   }
+  }
+ };
+
+ unsigned int nfill=(nthreads<nr) ? nthreads : ((nr>0) ? (unsigned int)nr : 1);
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nfill;t++)
+  workers.push_back(std::thread(fill,indextype((size_t(nr)*t)/nfill),indextype((size_t(nr)*(t+1))/nfill)));
+ fill(0,indextype(size_t(nr)/nfill));
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+
+ if (dupfound)
+ {
+  std::ostringstream errst;
+  errst << "SparseMatrixBuilder::Build: position (" << duprow << "," << dupcol << ") has been added more than once, and repeated positions were declared as an error.\n";
+  JMatrixStop(errst.str());
+ }
+
+ if (DEB & DEBJM)
+  std::cout << "Sparse matrix built" << (sorted ? " (triplets were already sorted).\n" : ".\n");
+}
+
+template void SparseMatrixBuilder<unsigned char>::Build(SparseMatrix<unsigned char> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<char>::Build(SparseMatrix<char> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<unsigned short>::Build(SparseMatrix<unsigned short> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<short>::Build(SparseMatrix<short> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<unsigned int>::Build(SparseMatrix<unsigned int> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<int>::Build(SparseMatrix<int> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<unsigned long>::Build(SparseMatrix<unsigned long> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<long>::Build(SparseMatrix<long> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<unsigned long long>::Build(SparseMatrix<unsigned long long> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<long long>::Build(SparseMatrix<long long> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<float>::Build(SparseMatrix<float> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<double>::Build(SparseMatrix<double> &M,unsigned int nthreads);
+template void SparseMatrixBuilder<long double>::Build(SparseMatrix<long double> &M,unsigned int nthreads);
@@ -16,7 +16,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <thread>
 #include "../headers/sparsematrix.h"
+#include "../headers/fullmatrix.h"
 #include "../headers/templatemacros.h"
 
 extern unsigned char DEB;
@@ -58,8 +60,8 @@ template void sort_indexes_and_values(const std::vector<long double> &v,std::vec
 template <typename T>
 SparseMatrix<T>::SparseMatrix() : JMatrix<T>(MTYPESPARSE)
 {
- datacols.clear();
- data.clear();
+ pattern=false;
+ AllocateRows();
 }
 
 TEMPLATES_CONST(SparseMatrix,)
@@ -69,76 +71,114 @@ TEMPLATES_CONST(SparseMatrix,)
 template <typename T>
 SparseMatrix<T>::SparseMatrix(indextype nrows,indextype ncols) : JMatrix<T>(MTYPESPARSE,nrows,ncols)
 {
- std::vector<indextype> vc; vc.clear();
- std::vector<T> vt; vt.clear();
- 
- for (indextype r=0;r<this->nr;r++)
- {
-     datacols.push_back(vc);    
-     data.push_back(vt);
- }
+ pattern=false;
+ AllocateRows();
 }
 
 TEMPLATES_CONST(SparseMatrix,SINGLE_ARG(indextype nrows,indextype ncols))
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Leaves nr empty rows, with the column indices in datacols16 if the number of columns allows it or in datacols otherwise.
+template <typename T>
+void SparseMatrix<T>::AllocateRows()
+{
+ narrow=(SparseFormatForColumns(this->nc)==SPARSE_IDX16);
+ datacols.clear();
+ datacols16.clear();
+ data.clear();
+ if (narrow)
+  datacols16.resize(this->nr);
+ else
+  datacols.resize(this->nr);
+ data.resize(this->nr);
+}
+
+TEMPLATES_FUNC(void,SparseMatrix,AllocateRows,)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 template <typename T>
 SparseMatrix<T>::SparseMatrix(const SparseMatrix<T>& other) : JMatrix<T>(other)
 {
- if (this->nr != 0)
+ narrow=other.narrow;
+ pattern=other.pattern;
+ datacols=other.datacols;
+ datacols16=other.datacols16;
+ data=other.data;
+}
+
+TEMPLATES_COPY_CONST(SparseMatrix)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(FullMatrix<T>& other,unsigned int nthreads) : JMatrix<T>(MTYPESPARSE,other.GetNRows(),other.GetNCols())
+{
+ JMatrixTraceSpan span("SparseMatrix from full");
+
+ pattern=false;
+ AllocateRows();
+
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads>this->nr)
+  nthreads=(unsigned int)this->nr;
+ if (nthreads==0)
+  nthreads=1;
+
+ auto scan=[&](indextype first,indextype last)
  {
-  std::vector<indextype> vc; vc.clear();
-  std::vector<T> vt; vt.clear();
- 
-  for (indextype r=0;r<this->nr;r++)
+  auto fill=[&](const T *v,auto &cols,std::vector<T> &vals)
   {
-     datacols.push_back(vc);    
-     data.push_back(vt);
-  }
-  for (indextype r=0;r<this->nr;r++)
-     for ( indextype c=0; c<other.datacols[r].size(); c++)
-     {
-       datacols[r].push_back(other.datacols[r][c]);  
-       data[r].push_back(other.data[r][c]);
-     }
- }
- else
- {
-  datacols.clear();
-  data.clear();   
- }
+   indextype n=0;
+   for (indextype c=0;c<this->nc;c++)
+    n += (v[c]!=T(0));
+   cols.resize(n);
+   vals.resize(n);
+   for (indextype c=0,k=0;k<n;c++)
+    if (v[c]!=T(0))
+    {
+     cols[k]=c;
+     vals[k++]=v[c];
+    }
+  };
+  for (indextype r=first;r<last;r++)
+   if (narrow)
+    fill(other.data[r],datacols16[r],data[r]);
+   else
+    fill(other.data[r],datacols[r],data[r]);
+ };
+
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(scan,indextype((size_t(this->nr)*t)/nthreads),indextype((size_t(this->nr)*(t+1))/nthreads)));
+ scan(0,indextype(size_t(this->nr)/nthreads));
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+
+ std::vector<std::string> names=other.GetRowNames();
+ if (names.size()>0)
+  this->SetRowNames(names);
+ names=other.GetColNames();
+ if (names.size()>0)
+  this->SetColNames(names);
+ this->SetComment(other.GetComment());
 }
 
-TEMPLATES_COPY_CONST(SparseMatrix)
+TEMPLATES_CONVERT_CONST(SparseMatrix,FullMatrix,unsigned int nthreads)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
 void SparseMatrix<T>::Resize(indextype newnr,indextype newnc)
 {
- if (this->nr!=0)
-  for (indextype r=0;r<this->nr;r++)
-  {
-    data[r].clear();
-    datacols[r].clear();
-  }
- data.clear();
- datacols.clear();
-   
  ((JMatrix<T> *)this)->Resize(newnr,newnc);
  
  if (DEB & DEBJM)
     std::cout << "Sparse matrix resized to (" << this->nr << "," << this->nc << ")\n";
  
- std::vector<indextype> vc; vc.clear();
- std::vector<T> vt; vt.clear();
- 
- for (indextype r=0;r<this->nr;r++)
- {
-     datacols.push_back(vc);    
-     data.push_back(vt);
- }
+ AllocateRows();
 }
 
 TEMPLATES_FUNC(void,SparseMatrix,Resize,SINGLE_ARG(indextype newnr,indextype newnc))
@@ -148,14 +188,9 @@ TEMPLATES_FUNC(void,SparseMatrix,Resize,SINGLE_ARG(indextype newnr,indextype new
 template <typename T>
 SparseMatrix<T>::~SparseMatrix()
 {
- if (this->nr!=0)
-  for (indextype r=0;r<this->nr;r++)
-  {
-    data[r].clear();
-    datacols[r].clear();
-  }
  data.clear();
  datacols.clear();
+ datacols16.clear();
 }
 
 TEMPLATES_DEFAULT_DEST(SparseMatrix)
@@ -166,16 +201,15 @@ TEMPLATES_DEFAULT_DEST(SparseMatrix)
 template <typename T>
 SparseMatrix<T>::SparseMatrix(std::string fname) : JMatrix<T>(fname,MTYPESPARSE)
 {   
-    std::vector<indextype> vc; vc.clear();
-    std::vector<T> vt; vt.clear();
- 
-    for (indextype r=0;r<this->nr;r++)
-    {
-     datacols.push_back(vc);    
-     data.push_back(vt);
-    }
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("SparseMatrix load");
+    JMatrixTraceSpan phase("allocate");
+    pattern=((this->sparseformat & SPARSE_PATTERN)!=0);
+    AllocateRows();
     
+    phase.Next("read data");
     indextype ncr;
+    unsigned long long ibytes;
     // These are booked by default to the maximum size of a row. Not all space will be used at each row.
     indextype *cvalues = new indextype [this->nc];
     T *values = new T [this->nc];
@@ -184,22 +218,27 @@ SparseMatrix<T>::SparseMatrix(std::string fname) : JMatrix<T>(fname,MTYPESPARSE)
     for (indextype r=0;r<this->nr;r++)
     {
      // ...first, we read the number of non-zero entries
-     this->ifile.read((char *)(&ncr),sizeof(indextype));
+     ReadSparseRowHead(this->ifile,this->sparseformat,ncr,ibytes);
   
      // Then we read as many vales (column positions and real values) as needed, all at the same time, in arrays.
-     this->ifile.read((char *)cvalues,ncr*sizeof(indextype));
-     this->ifile.read((char *)values,ncr*sizeof(T));
+     ReadSparseIndices(this->ifile,this->sparseformat,ncr,ibytes,cvalues);
+     if (!pattern)
+      ReadValues(this->ifile,this->vcodec,ncr,values);
+     JStatRows(1);
+     JStatElements(ncr);
      
      // and finally the arrays are stored as vectors
-     for (indextype c=0;c<ncr;c++)
-     {
-         datacols[r].push_back(cvalues[c]);
-         data[r].push_back(values[c]);
-     }
+     if (narrow)
+      datacols16[r].assign(cvalues,cvalues+ncr);
+     else
+      datacols[r].assign(cvalues,cvalues+ncr);
+     if (!pattern)
+      data[r].assign(values,values+ncr);
     }
  
     delete[] cvalues;
     delete[] values;
+    phase.End();
     
     this->ReadMetadata();                  // This is exclusively used when reading from a binary file, not from a csv file
     
@@ -216,6 +255,9 @@ TEMPLATES_CONST(SparseMatrix,std::string fname)
 template <typename T>
 SparseMatrix<T>::SparseMatrix(std::string fname,TrMark) : JMatrix<T>(fname,MTYPESPARSE)
 {
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("SparseMatrix load");
+    JMatrixTraceSpan phase("allocate");
     // nr and nc have been read by the superclass contructor.
     // We need it, so we store them in orignr, orignc. But then we swap them
     indextype orignr,orignc;
@@ -225,16 +267,12 @@ SparseMatrix<T>::SparseMatrix(std::string fname,TrMark) : JMatrix<T>(fname,MTYPE
     this->nr=orignc;
     this->nc=orignr;
     
-    std::vector<indextype> vc; vc.clear();
-    std::vector<T> vt; vt.clear();
- 
-    for (indextype r=0;r<this->nr;r++)
-    {
-     datacols.push_back(vc);    
-     data.push_back(vt);
-    }
+    pattern=((this->sparseformat & SPARSE_PATTERN)!=0);
+    AllocateRows();
     
+    phase.Next("read data");
     indextype ncr;
+    unsigned long long ibytes;
     // These are booked by default to the maximum size of a row. Not all space will be used at each row.
     indextype *cvalues = new indextype [orignc];
     T *values = new T [orignc];
@@ -243,46 +281,37 @@ SparseMatrix<T>::SparseMatrix(std::string fname,TrMark) : JMatrix<T>(fname,MTYPE
     for (indextype r=0;r<orignr;r++)
     {
      // ...first, we read the number of non-zero entries
-     this->ifile.read((char *)(&ncr),sizeof(indextype));
+     ReadSparseRowHead(this->ifile,this->sparseformat,ncr,ibytes);
   
      // Then we read as many vales (column positions and real values) as needed, all at the same time, in arrays.
-     this->ifile.read((char *)cvalues,ncr*sizeof(indextype));
-     this->ifile.read((char *)values,ncr*sizeof(T));
+     ReadSparseIndices(this->ifile,this->sparseformat,ncr,ibytes,cvalues);
+     if (!pattern)
+      ReadValues(this->ifile,this->vcodec,ncr,values);
+     JStatRows(1);
+     JStatElements(ncr);
      
      // and the arrays are stored as vectors in this new matrix, but transposed:
      // all are in row r, and in columns cvalues[0], cvalues[1], etc. so they will go to row cvalues[..], column r.
+     // Since the rows of the file are read in increasing order, each row of this matrix receives its columns already sorted.
      for (indextype c=0;c<ncr;c++)
      {
-         datacols[cvalues[c]].push_back(r);
-         data[cvalues[c]].push_back(values[c]);
+         if (narrow)
+          datacols16[cvalues[c]].push_back((unsigned short)r);
+         else
+          datacols[cvalues[c]].push_back(r);
+         if (!pattern)
+          data[cvalues[c]].push_back(values[c]);
      }
     }
     
     delete[] cvalues;
     delete[] values;
+    phase.End();
     
     this->ReadMetadata();    // This is exclusively used when reading from a binary file, not from a csv file        
     
     this->ifile.close();
     
-    // But this is not enough: each datum at (r,c) has been stored in row c, but not ordered, as expected. So we have to order each new row.
-    // This time r runs up to the number of rows of the matrix that is being created, nr, not up to orignr as before
-    for (indextype r=0;r<this->nr;r++)
-    {
-        std::vector<size_t>     idx(datacols[r].size());
-        std::vector<indextype>  idv(datacols[r].size());
-        // idv are the column-values, correctly ordered.
-        // idx are their indexes, which are needed to reorder the array of values...
-        sort_indexes_and_values(datacols[r],idx,idv);
-        datacols[r].clear();
-        datacols[r]=idv;
-        std::vector<T> values;
-        for (indextype c=0;c<idx.size();c++)
-            values.push_back(data[r][idx[c]]);
-        data[r].clear();
-        data[r]=values;
-    }
-
     if (DEB & DEBJM)
      std::cout << "Read transposed sparse matrix with size (" << this->nr << "," << this->nc << ")\n";
 }
@@ -294,35 +323,13 @@ TEMPLATES_CONST(SparseMatrix,SINGLE_ARG(std::string fname,TrMark))
 template <typename T>
 SparseMatrix<T>& SparseMatrix<T>::operator=(const SparseMatrix<T>& other)
 {
- if (this->nr!=0)
- {
-  for (indextype r=0;r<this->nr;r++)
-  {
-   data[r].clear(); 
-   datacols[r].clear();
-  }
-  data.clear();
-  datacols.clear();
- }
- 
  ((JMatrix<T> *)this)->operator=((const JMatrix<T> &)other);
  
- std::vector<indextype> vc; vc.clear();
- std::vector<T> vt; vt.clear();
- 
- for (indextype r=0;r<this->nr;r++)
- {
-     datacols.push_back(vc);    
-     data.push_back(vt);
- }
- 
- 
- for (indextype r=0;r<this->nr;r++)
-     for ( indextype c=0; c<other.datacols[r].size(); c++)
-     {
-       datacols[r].push_back(other.datacols[r][c]);  
-       data[r].push_back(other.data[r][c]);
-     }  
+ narrow=other.narrow;
+ pattern=other.pattern;
+ datacols=other.datacols;
+ datacols16=other.datacols16;
+ data=other.data;
  
  return *this;
 }
@@ -334,18 +341,8 @@ TEMPLATES_OPERATOR(SparseMatrix,=)
 template <typename T>
 SparseMatrix<T>& SparseMatrix<T>::operator!=(const SparseMatrix<T>& other)
 {
- if (this->nr!=0)
- {
-  if (DEB & DEBJM)
-    std::cout << "Cleaning old matrix before assignment...\n";
-  for (indextype r=0;r<this->nr;r++)
-  {
-   data[r].clear(); 
-   datacols[r].clear();
-  }
-  data.clear();
-  datacols.clear();
- }
+ if ((this->nr!=0) && (DEB & DEBJM))
+  std::cout << "Cleaning old matrix before assignment...\n";
  
  ((JMatrix<T> *)this)->operator!=((const JMatrix<T> &)other);
  // Here number of rows and columns has been swapped
@@ -357,14 +354,8 @@ SparseMatrix<T>& SparseMatrix<T>::operator!=(const SparseMatrix<T>& other)
      oldc=((JMatrix<T> *)&other)->GetNCols();
      std::cout << "Transposing matrix of (" << oldr << "x" << oldc << ") to a matrix of (" << this->nr << "x" << this->nc << ")\n";
  }
- std::vector<indextype> vc; vc.clear();
- std::vector<T> vt; vt.clear();
- 
- for (indextype r=0;r<this->nr;r++)
- {
-     datacols.push_back(vc);    
-     data.push_back(vt);
- }
+ pattern=other.pattern;
+ AllocateRows();
   
  T v;
  for (indextype r=0;r<this->nr;r++)
@@ -374,8 +365,12 @@ SparseMatrix<T>& SparseMatrix<T>::operator!=(const SparseMatrix<T>& other)
     v=other.Get(c,r);
     if (v!=T(0))
     {
-     datacols[r].push_back(c);
-     data[r].push_back(v);   
+     if (narrow)
+      datacols16[r].push_back((unsigned short)c);
+     else
+      datacols[r].push_back(c);
+     if (!pattern)
+      data[r].push_back(v);
     }
   }
  }
@@ -389,13 +384,17 @@ TEMPLATES_OPERATOR(SparseMatrix,!=)
 // Constructor to read from a csv file
 template <typename T>
 SparseMatrix<T>::SparseMatrix(std::string fname,unsigned char vtype,char csep) : JMatrix<T>(fname,MTYPESPARSE,vtype,csep)
-{    
+{
+    JMatrixOpScope opscope(STATS_READCSV);
+    JMatrixTraceSpan span("SparseMatrix load from csv");
+    JMatrixTraceSpan phase("count lines");
     std::string line;
     // This is just to know number of rows
     this->nr=0;
     while (!this->ifile.eof())
     {
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
             this->nr++;
     }
@@ -411,22 +410,27 @@ SparseMatrix<T>::SparseMatrix(std::string fname,unsigned char vtype,char csep) :
          default: std::cout << "unknown type values??? (Is this an error?).\n"; break;
         }
     }
+    phase.Next("parse lines");
     // Reposition pointer at the begin and re-read first (header) line
     // and no, seekg does not work (possibly, because we had reached the eof ???)
     this->ifile.close();
     this->ifile.open(fname.c_str());
     size_t p=0;
     getline(this->ifile,line);
+    JStatRead(line.size()+1);
     // No need to process first line here, it was done at the parent's class constructor
     
     T *data_with_zeros = new T [this->nc];
     
+    narrow=(SparseFormatForColumns(this->nc)==SPARSE_IDX16);
+    pattern=false;
     std::vector<indextype> datacolsofrow;
     std::vector<T>dataofrow;
     
     while (!this->ifile.eof())
     {
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
         {
           if (!this->ProcessDataLineCsv(line,csep,data_with_zeros))
@@ -443,8 +447,13 @@ SparseMatrix<T>::SparseMatrix(std::string fname,unsigned char vtype,char csep) :
                   datacolsofrow.push_back(t);
                   dataofrow.push_back(data_with_zeros[t]);
               }
-          datacols.push_back(datacolsofrow);
+          if (narrow)
+           datacols16.push_back(std::vector<unsigned short>(datacolsofrow.begin(),datacolsofrow.end()));
+          else
+           datacols.push_back(datacolsofrow);
           data.push_back(dataofrow);
+          JStatRows(1);
+          JStatElements(this->nc);
           
           p++;
         }
@@ -482,34 +491,15 @@ T SparseMatrix<T>::Get(indextype r,indextype c) const
         JMatrixStop(errst.str());
     }
 #endif
-    // If this row has nothing in it or the first column in which there is something is beyond our request, the content is zero.
-    if ((datacols[r].size()==0) || (datacols[r][0]>c))  // This assumes short-cut evaluation of OR...
-        return T(0);
-
-    // Otherwise, let's look for our column, if it exists.
-    size_t m;
-    size_t mid;
-    size_t low=0;
-    size_t high=datacols[r].size()-1;
-    while (low <= high)
+    // Binary search of the column among the (sorted) columns of this row
+    auto find=[&](const auto &cols) -> T
     {
-     mid = low + (high-low)/2;
-     
-     if (datacols[r][mid] == c)
-     {
-         m = mid;
-         break;
-     }
-     if (datacols[r][mid] < c)
-         low=mid+1;
-     else
-         high=mid-1;
-    }
-    if (low>high)
-        m = mid;
-    
-    return (datacols[r][m]==c) ? data[r][m] : T(0);
-   
+     auto it=std::lower_bound(cols.begin(),cols.end(),c);
+     if ((it==cols.end()) || (*it!=c))
+      return T(0);
+     return pattern ? T(1) : data[r][it-cols.begin()];
+    };
+    return narrow ? find(datacols16[r]) : find(datacols[r]);
 }
 
 TEMPLATES_FUNCRCONST(SparseMatrix,Get,SINGLE_ARG(indextype r,indextype c))
@@ -532,46 +522,27 @@ void SparseMatrix<T>::Set(indextype r,indextype c,T v)
     if (v==T(0))
      return;
      
-    // Particular case 1: If this row has nothing in it, just add column and value
-    if (datacols[r].size()==0)
-    {
-       datacols[r].push_back(c);
-       data[r].push_back(v);
-       return;
-    } 
-    
-    // Particular case 2: It the first column in which there is something is beyond our request, the content must be set at the beginning
-    if (datacols[r][0]>c)
-    {
-     // Yes, insert at head is begin()+1, not begin...
-     datacols[r].insert(datacols[r].begin()+1,c);
-     data[r].insert(data[r].begin()+1,v);
-    }
-    else
+    // The column is replaced if it exists or inserted at its place (the first with a greater column) if it does not.
+    auto set=[&](auto &cols)
     {
-     size_t mid;
-     size_t low=0;
-     size_t high=datacols[r].size()-1;
-     while (low <= high)
+     auto it=std::lower_bound(cols.begin(),cols.end(),c);
+     size_t k=it-cols.begin();
+     if ((it!=cols.end()) && (*it==c))
      {
-      mid = low + (high-low)/2;
-     
-      if (datacols[r][mid] == c)
-      {
-         data[r][mid]=v;
-         return;
-      }
-      if (datacols[r][mid] < c)
-          low=mid+1;
-      else
-          high=mid-1;
+      if (!pattern)
+       data[r][k]=v;
      }
-     
-     // If we are here, the column did not exist. m will contain the place to be inserted. Rememeber that insert after mid is at begin()+mid+1
-     datacols[r].insert(datacols[r].begin()+mid+1,c);
-     data[r].insert(data[r].begin()+mid+1,v);
-    } 
-    return;
+     else
+     {
+      cols.insert(it,c);
+      if (!pattern)
+       data[r].insert(data[r].begin()+k,v);
+     }
+    };
+    if (narrow)
+     set(datacols16[r]);
+    else
+     set(datacols[r]);
 }
 
 TEMPLATES_SETFUNC(void,SparseMatrix,Set,SINGLE_ARG(indextype r,indextype c),v)
@@ -590,10 +561,12 @@ void SparseMatrix<T>::SetRow(indextype r,std::vector<indextype> vc,std::vector<T
         JMatrixStop(errst.str());
     }
 #endif
-    datacols[r].clear();
-    datacols[r]=vc;
-    data[r].clear();
-    data[r]=v;
+    if (narrow)
+     datacols16[r].assign(vc.begin(),vc.end());
+    else
+     datacols[r]=vc;
+    if (!pattern)
+     data[r]=v;
 }
 
 TEMPLATES_SETFUNCVEC(void,SparseMatrix,SetRow,SINGLE_ARG(indextype r,std::vector<indextype> vc),v)
@@ -612,8 +585,19 @@ void SparseMatrix<T>::GetRow(indextype r,T *v)
     }
 #endif
  // Fill the positions in v which are not zero.
- for (indextype c=0;c<data[r].size();c++)
-     v[datacols[r][c]]=data[r][c];
+ auto fill=[&](const auto &cols)
+ {
+  if (pattern)
+   for (indextype c=0;c<cols.size();c++)
+     v[cols[c]]=T(1);
+  else
+   for (indextype c=0;c<cols.size();c++)
+     v[cols[c]]=data[r][c];
+ };
+ if (narrow)
+  fill(datacols16[r]);
+ else
+  fill(datacols[r]);
 }
 
 TEMPLATES_SETFUNC(void,SparseMatrix,GetRow,indextype r,*v)
@@ -633,11 +617,18 @@ void SparseMatrix<T>::GetSparseRow(indextype r,unsigned char *m,unsigned char s,
     }
 #endif
   // Fill the positions in v which are not zero and also sum the value s to those positions in array m
-  for (indextype c=0;c<data[r].size();c++)
+  auto fill=[&](const auto &cols)
   {
-     v[datacols[r][c]]=data[r][c];  
-     m[datacols[r][c]] |= s;
-  }
+   for (indextype c=0;c<cols.size();c++)
+   {
+     v[cols[c]] = pattern ? T(1) : data[r][c];
+     m[cols[c]] |= s;
+   }
+  };
+  if (narrow)
+   fill(datacols16[r]);
+  else
+   fill(datacols[r]);
 }
 
 TEMPLATES_SETFUNC(void,SparseMatrix,GetSparseRow,SINGLE_ARG(indextype r,unsigned char *m,unsigned char s),*v)
@@ -656,24 +647,189 @@ void SparseMatrix<T>::GetMarksOfSparseRow(indextype r,unsigned char *m,unsigned
         JMatrixStop(errst.str());
     }
 #endif
-  for (indextype c=0;c<data[r].size();c++)
-     m[datacols[r][c]] |= s;
+  auto mark=[&](const auto &cols)
+  {
+   for (indextype c=0;c<cols.size();c++)
+     m[cols[c]] |= s;
+  };
+  if (narrow)
+   mark(datacols16[r]);
+  else
+   mark(datacols[r]);
 }
 
 TEMPLATES_FUNC(void,SparseMatrix,GetMarksOfSparseRow,SINGLE_ARG(indextype r,unsigned char *m,unsigned char s))
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+template <typename T>
+void SparseMatrix<T>::SetPatternOnly(bool on)
+{
+ if (on==pattern)
+  return;
+ 
+ if (on)
+ {
+  // Values are simply dropped, and their memory freed
+  data.clear();
+  data.resize(this->nr);
+ }
+ else
+ {
+  for (indextype r=0;r<this->nr;r++)
+   data[r].assign(RowSize(r),T(1));
+ }
+ pattern=on;
+ 
+ if (DEB & DEBJM)
+  std::cout << "Sparse matrix of (" << this->nr << "x" << this->nc << ") is now " << (pattern ? "pattern-only" : "with values") << ".\n";
+}
+
+TEMPLATES_FUNC(void,SparseMatrix,SetPatternOnly,bool on)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Number of common elements of two sorted arrays of column indices. When one of them is much shorter, each of its elements is looked for in the other one
+// with an exponential search from the last place found, which is O(na*log(nb/na)) instead of O(na+nb). Otherwise, a branch-free merge is used.
+template <typename I1,typename I2>
+static indextype SortedIntersectionSize(const I1 *a,size_t na,const I2 *b,size_t nb)
+{
+ if (na>nb)
+  return SortedIntersectionSize(b,nb,a,na);
+ if (na==0)
+  return 0;
+ 
+ indextype n=0;
+ size_t i,j=0;
+ if (nb/na>=32)
+ {
+  for (i=0;(i<na) && (j<nb);i++)
+  {
+   indextype x=indextype(a[i]);
+   size_t lo=j,hi=j,step=1;
+   while ((hi<nb) && (indextype(b[hi])<x))
+   {
+    lo=hi+1;
+    hi+=step;
+    step*=2;
+   }
+   if (hi>nb)
+    hi=nb;
+   j=std::lower_bound(b+lo,b+hi,x,[](I2 y,indextype v) { return indextype(y)<v; })-b;
+   if ((j<nb) && (indextype(b[j])==x))
+   {
+    n++;
+    j++;
+   }
+  }
+  return n;
+ }
+ 
+ i=0;
+ while ((i<na) && (j<nb))
+ {
+  indextype x=indextype(a[i]),y=indextype(b[j]);
+  n += (x==y);
+  i += (x<=y);
+  j += (y<=x);
+ }
+ return n;
+}
+
+template <typename T>
+indextype SparseMatrix<T>::RowIntersection(indextype r1,const SparseMatrix<T> &other,indextype r2) const
+{
+#ifdef WITH_CHECKS_MATRIX
+    if ((r1>=this->nr) || (r2>=other.nr))
+    {
+        std::ostringstream errst;
+        errst << "Runtime error in SparseMatrix<T>::RowIntersection: at least one row index (" << r1 << " or " << r2 << ") out of bounds.\n";
+        errst << "Matrices were of dimension (" << this->nr << " x " << this->nc << ") and (" << other.nr << " x " << other.nc << ")\n";
+        JMatrixStop(errst.str());
+    }
+#endif
+ auto inter=[&](const auto &a) -> indextype
+ {
+  if (other.narrow)
+   return SortedIntersectionSize(a.data(),a.size(),other.datacols16[r2].data(),other.datacols16[r2].size());
+  else
+   return SortedIntersectionSize(a.data(),a.size(),other.datacols[r2].data(),other.datacols[r2].size());
+ };
+ return narrow ? inter(datacols16[r1]) : inter(datacols[r1]);
+}
+
+template indextype SparseMatrix<unsigned char>::RowIntersection(indextype r1,const SparseMatrix<unsigned char> &other,indextype r2) const;
+template indextype SparseMatrix<char>::RowIntersection(indextype r1,const SparseMatrix<char> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned short>::RowIntersection(indextype r1,const SparseMatrix<unsigned short> &other,indextype r2) const;
+template indextype SparseMatrix<short>::RowIntersection(indextype r1,const SparseMatrix<short> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned int>::RowIntersection(indextype r1,const SparseMatrix<unsigned int> &other,indextype r2) const;
+template indextype SparseMatrix<int>::RowIntersection(indextype r1,const SparseMatrix<int> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned long>::RowIntersection(indextype r1,const SparseMatrix<unsigned long> &other,indextype r2) const;
+template indextype SparseMatrix<long>::RowIntersection(indextype r1,const SparseMatrix<long> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned long long>::RowIntersection(indextype r1,const SparseMatrix<unsigned long long> &other,indextype r2) const;
+template indextype SparseMatrix<long long>::RowIntersection(indextype r1,const SparseMatrix<long long> &other,indextype r2) const;
+template indextype SparseMatrix<float>::RowIntersection(indextype r1,const SparseMatrix<float> &other,indextype r2) const;
+template indextype SparseMatrix<double>::RowIntersection(indextype r1,const SparseMatrix<double> &other,indextype r2) const;
+template indextype SparseMatrix<long double>::RowIntersection(indextype r1,const SparseMatrix<long double> &other,indextype r2) const;
+
+template <typename T>
+double SparseMatrix<T>::JaccardDistance(indextype r1,const SparseMatrix<T> &other,indextype r2) const
+{
+ indextype ni=RowIntersection(r1,other,r2);
+ unsigned long long nu=(unsigned long long)RowSize(r1)+(unsigned long long)other.RowSize(r2)-ni;
+ return (nu==0) ? 0.0 : 1.0-double(ni)/double(nu);
+}
+
+template double SparseMatrix<unsigned char>::JaccardDistance(indextype r1,const SparseMatrix<unsigned char> &other,indextype r2) const;
+template double SparseMatrix<char>::JaccardDistance(indextype r1,const SparseMatrix<char> &other,indextype r2) const;
+template double SparseMatrix<unsigned short>::JaccardDistance(indextype r1,const SparseMatrix<unsigned short> &other,indextype r2) const;
+template double SparseMatrix<short>::JaccardDistance(indextype r1,const SparseMatrix<short> &other,indextype r2) const;
+template double SparseMatrix<unsigned int>::JaccardDistance(indextype r1,const SparseMatrix<unsigned int> &other,indextype r2) const;
+template double SparseMatrix<int>::JaccardDistance(indextype r1,const SparseMatrix<int> &other,indextype r2) const;
+template double SparseMatrix<unsigned long>::JaccardDistance(indextype r1,const SparseMatrix<unsigned long> &other,indextype r2) const;
+template double SparseMatrix<long>::JaccardDistance(indextype r1,const SparseMatrix<long> &other,indextype r2) const;
+template double SparseMatrix<unsigned long long>::JaccardDistance(indextype r1,const SparseMatrix<unsigned long long> &other,indextype r2) const;
+template double SparseMatrix<long long>::JaccardDistance(indextype r1,const SparseMatrix<long long> &other,indextype r2) const;
+template double SparseMatrix<float>::JaccardDistance(indextype r1,const SparseMatrix<float> &other,indextype r2) const;
+template double SparseMatrix<double>::JaccardDistance(indextype r1,const SparseMatrix<double> &other,indextype r2) const;
+template double SparseMatrix<long double>::JaccardDistance(indextype r1,const SparseMatrix<long double> &other,indextype r2) const;
+
+template <typename T>
+indextype SparseMatrix<T>::HammingDistance(indextype r1,const SparseMatrix<T> &other,indextype r2) const
+{
+ indextype ni=RowIntersection(r1,other,r2);
+ return RowSize(r1)+other.RowSize(r2)-2*ni;
+}
+
+template indextype SparseMatrix<unsigned char>::HammingDistance(indextype r1,const SparseMatrix<unsigned char> &other,indextype r2) const;
+template indextype SparseMatrix<char>::HammingDistance(indextype r1,const SparseMatrix<char> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned short>::HammingDistance(indextype r1,const SparseMatrix<unsigned short> &other,indextype r2) const;
+template indextype SparseMatrix<short>::HammingDistance(indextype r1,const SparseMatrix<short> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned int>::HammingDistance(indextype r1,const SparseMatrix<unsigned int> &other,indextype r2) const;
+template indextype SparseMatrix<int>::HammingDistance(indextype r1,const SparseMatrix<int> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned long>::HammingDistance(indextype r1,const SparseMatrix<unsigned long> &other,indextype r2) const;
+template indextype SparseMatrix<long>::HammingDistance(indextype r1,const SparseMatrix<long> &other,indextype r2) const;
+template indextype SparseMatrix<unsigned long long>::HammingDistance(indextype r1,const SparseMatrix<unsigned long long> &other,indextype r2) const;
+template indextype SparseMatrix<long long>::HammingDistance(indextype r1,const SparseMatrix<long long> &other,indextype r2) const;
+template indextype SparseMatrix<float>::HammingDistance(indextype r1,const SparseMatrix<float> &other,indextype r2) const;
+template indextype SparseMatrix<double>::HammingDistance(indextype r1,const SparseMatrix<double> &other,indextype r2) const;
+template indextype SparseMatrix<long double>::HammingDistance(indextype r1,const SparseMatrix<long double> &other,indextype r2) const;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 template <typename T>
 void SparseMatrix<T>::SelfRowNorm(std::string ctype)
 { 
+ if (pattern)
+  JMatrixStop("Pattern-only sparse matrices cannot be normalized, since they have no values.\n");
+
  if (DEB & DEBJM)
   std::cout << "Normalizing... ";
 
  if ((ctype=="log1") || (ctype=="log1n"))
  {
   for (indextype r=0;r<this->nr;r++)
-   for (indextype k=0;k<datacols[r].size();k++)
+   for (indextype k=0;k<data[r].size();k++)
     data[r][k] = log2(data[r][k]+1.0);
  }
  
@@ -688,11 +844,11 @@ void SparseMatrix<T>::SelfRowNorm(std::string ctype)
  for (indextype r=0;r<this->nr;r++)
  {
   sum=T(0);
-  for (indextype k=0;k<datacols[r].size();k++)
+  for (indextype k=0;k<data[r].size();k++)
    sum+=data[r][k];
  
  if (sum!=T(0))
-  for (indextype k=0;k<datacols[r].size();k++)
+  for (indextype k=0;k<data[r].size();k++)
     data[r][k] /= sum;
  }
  if (DEB & DEBJM)
@@ -706,13 +862,16 @@ TEMPLATES_FUNC(void,SparseMatrix,SelfRowNorm,std::string ctype)
 template <typename T>
 void SparseMatrix<T>::SelfColNorm(std::string ctype)
 { 
+ if (pattern)
+  JMatrixStop("Pattern-only sparse matrices cannot be normalized, since they have no values.\n");
+
  if (DEB & DEBJM)
   std::cout << "Normalizing... ";
 
  if ((ctype=="log1") || (ctype=="log1n"))
  {
   for (indextype r=0;r<this->nr;r++)
-   for (indextype k=0;k<datacols[r].size();k++)
+   for (indextype k=0;k<data[r].size();k++)
     data[r][k] = log2(data[r][k]+1.0);
  }
  
@@ -727,14 +886,21 @@ void SparseMatrix<T>::SelfColNorm(std::string ctype)
  for (indextype c=0; c<this->nc; c++)
   sums[c]=T(0);
   
- for (indextype r=0; r<this->nr; r++)
-  for (indextype k=0; k<datacols[r].size(); k++)
-   sums[datacols[r][k]] += data[r][k];
+ auto norm=[&](const auto &dc)
+ {
+  for (indextype r=0; r<this->nr; r++)
+   for (indextype k=0; k<data[r].size(); k++)
+    sums[dc[r][k]] += data[r][k];
  
- for (indextype r=0; r<this->nr; r++)
-  for (indextype k=0; k<datacols[r].size(); k++)
-   if (datacols[r][k]!=T(0))
-    data[r][k] /= sums[datacols[r][k]];
+  for (indextype r=0; r<this->nr; r++)
+   for (indextype k=0; k<data[r].size(); k++)
+    if (sums[dc[r][k]]!=T(0))
+     data[r][k] /= sums[dc[r][k]];
+ };
+ if (narrow)
+  norm(datacols16);
+ else
+  norm(datacols);
  
  delete[] sums;
    
@@ -749,6 +915,9 @@ TEMPLATES_FUNC(void,SparseMatrix,SelfColNorm,std::string ctype)
 template <typename T>
 void SparseMatrix<T>::WriteBin(std::string fname)
 {
+    JMatrixOpScope opscope(STATS_WRITEBIN);
+    JMatrixTraceSpan span("SparseMatrix WriteBin");
+    this->sparseformat = pattern ? SPARSE_PATTERN : SPARSE_IDX32;    // WriteHeader adds the format of the indices
     ((JMatrix<T> *)this)->WriteBin(fname,MTYPESPARSE);
     
     if (DEB & DEBJM)
@@ -757,36 +926,123 @@ void SparseMatrix<T>::WriteBin(std::string fname)
      std::cout.flush();
     }
     
-    indextype ncr;
+    WriteBinContents(this->ofile);
+    
+    this->ofile.close();
+}
+
+TEMPLATES_FUNC(void,SparseMatrix,WriteBin,std::string fname)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes all that comes after the header: the binary data, the metadata and the end-of-data offset.
+template <typename T>
+void SparseMatrix<T>::WriteBinContents(std::ostream &os)
+{    
+    JMatrixTraceSpan phase("write data");
+    // Column indices are written either encoded or with the same width they have in memory, as WriteHeader has recorded in the header
+    size_t isize = narrow ? sizeof(unsigned short) : sizeof(indextype);
+    std::vector<unsigned char> enc;
+    indextype ncr,nb;
     for (indextype r=0;r<this->nr;r++)
     {
-        ncr=datacols[r].size();
-        this->ofile.write((const char *)(&ncr),sizeof(indextype));
-        for (unsigned c=0;c<ncr;c++)
-            this->ofile.write((const char *)(&datacols[r][c]),sizeof(indextype));
-        for (unsigned c=0;c<ncr;c++)
-            this->ofile.write((const char *)(&data[r][c]),sizeof(T));
+        ncr=RowSize(r);
+        os.write((const char *)(&ncr),sizeof(indextype));
+        JStatWrite(sizeof(indextype));
+        if ((this->sparseformat & SPARSE_INDEX_MASK)==SPARSE_VARINT)
+        {
+            enc.clear();
+            if (narrow)
+                EncodeSparseIndices(datacols16[r].data(),ncr,enc);
+            else
+                EncodeSparseIndices(datacols[r].data(),ncr,enc);
+            nb=indextype(enc.size());
+            os.write((const char *)(&nb),sizeof(indextype));
+            os.write((const char *)enc.data(),nb);
+            JStatWrite(sizeof(indextype));
+            JStatWrite(nb);
+        }
+        else
+        {
+            if (narrow)
+                os.write((const char *)datacols16[r].data(),ncr*isize);
+            else
+                os.write((const char *)datacols[r].data(),ncr*isize);
+            JStatWrite(ncr*isize);
+        }
+        if (!pattern)
+        {
+            os.write((const char *)data[r].data(),ncr*sizeof(T));
+            JStatWrite(ncr*sizeof(T));
+        }
+        JStatElements(ncr);
     }
+    JStatRows(this->nr);
+    phase.End();
     
-    unsigned long long endofbindata = this->ofile.tellp();
+    unsigned long long endofbindata = (unsigned long long)os.tellp();
     
     if (DEB & DEBJM)
      std::cout << "End of block of binary data at offset " << endofbindata << "\n";
 
-    this->WriteMetadata();              // Here we must write the metadata at the end of the binary contents of the matrix
+    this->WriteMetadata(os);              // Here we must write the metadata at the end of the binary contents of the matrix
+    
+    os.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    JStatWrite(sizeof(unsigned long long));
+}
+
+TEMPLATES_FUNC(void,SparseMatrix,WriteBinContents,std::ostream &os)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::future<int> SparseMatrix<T>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs)
+{
+    if (DEB & DEBJM)
+    {
+     std::cout << "Writing binary matrix " << fname << " of (" << this->nr << "x" << this->nc << ") asynchronously\n";
+     std::cout.flush();
+    }
     
-    this->ofile.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    this->sparseformat = pattern ? SPARSE_PATTERN : SPARSE_IDX32;    // WriteHeader adds the format of the indices
     
-    this->ofile.close();
+    // The serialization runs in its own thread and the disk writes in the writer thread of AsyncWriteBuf, so that the caller is not blocked at all.
+    return std::async(std::launch::async,[this,fname,direct,nbufs]()
+    {
+        JMatrixOpScope opscope(STATS_WRITEBIN);
+        JMatrixTraceSpan span("SparseMatrix WriteBinAsync");
+        AsyncWriteBuf wb(DEFAULT_ASYNC_BUFFER_SIZE,nbufs);
+        int st=wb.Open(fname,direct);
+        if (st!=WRITE_OK)
+            return st;
+        std::ostream os(&wb);
+        this->WriteHeader(os,MTYPESPARSE);
+        WriteBinContents(os);
+        return wb.Close();
+    });
 }
 
-TEMPLATES_FUNC(void,SparseMatrix,WriteBin,std::string fname)
+template std::future<int> SparseMatrix<unsigned char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<unsigned short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<unsigned int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<unsigned long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<unsigned long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<float>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SparseMatrix<long double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
 void SparseMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
 {
+    JMatrixOpScope opscope(STATS_WRITECSV);
+    JMatrixTraceSpan span("SparseMatrix WriteCsv");
     // Remember: this writes the header, even if there were no column names (then, the header will be "","C1","C2",...)
     ((JMatrix<T> *)this)->WriteCsv(fname,csep,withquotes);
 
@@ -799,6 +1055,7 @@ void SparseMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
     }
 
     int p = std::numeric_limits<T>::max_digits10;
+    JMatrixTraceSpan phase("write rows");
 
     // We have rows to write; otherwise we would have returned four lines ago...
     indextype rns=this->rownames.size();
@@ -820,6 +1077,9 @@ void SparseMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
             this->ofile << std::setprecision(p) << Get(r,c) << csep;
         this->ofile << std::setprecision(p) << Get(r,this->nc-1) << std::endl;
     }
+    JStatWrite((unsigned long long)this->ofile.tellp());
+    JStatRows(this->nr);
+    JStatElements((unsigned long long)this->nr*this->nc);
     this->ofile.close();
 }
 
@@ -832,11 +1092,16 @@ float SparseMatrix<T>::GetUsedMemoryMB()
 {
     unsigned long long num_elem=0;
     for (indextype r=0;r<this->nr;r++)
-        num_elem += (unsigned long long)datacols[r].size();
-        
-    std::cout << num_elem << " elements, half of " << sizeof(T) << " bytes and half of " << sizeof(indextype) << " bytes each, with accounts for ";
-    float ret = float(num_elem)*float(sizeof(indextype)+sizeof(T));
-    ret += float(datacols.size()*sizeof(indextype));
+        num_elem += (unsigned long long)RowSize(r);
+    
+    size_t isize = narrow ? sizeof(unsigned short) : sizeof(indextype);
+    size_t vsize = pattern ? 0 : sizeof(T);
+    if (pattern)
+     std::cout << num_elem << " elements with no values, of " << isize << " bytes each, with accounts for ";
+    else
+     std::cout << num_elem << " elements, half of " << sizeof(T) << " bytes and half of " << isize << " bytes each, with accounts for ";
+    float ret = float(num_elem)*float(isize+vsize);
+    ret += float(this->nr*sizeof(indextype));
     ret /= (1024.0*1024.0);
     return ret;
 }
@@ -16,7 +16,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include "../headers/symmetricmatrix.h"
+#include "../headers/fullmatrix.h"
 #include "../headers/templatemacros.h"
 
 extern unsigned char DEB;
@@ -84,6 +88,89 @@ TEMPLATES_COPY_CONST(SymmetricMatrix)
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+template <typename T>
+SymmetricMatrix<T>::SymmetricMatrix(FullMatrix<T>& other,bool check,unsigned int nthreads) : JMatrix<T>(MTYPESYMMETRIC,other.GetNRows(),other.GetNRows())
+{
+ JMatrixTraceSpan span("SymmetricMatrix from full");
+
+ if (other.GetNRows()!=other.GetNCols())
+ {
+  std::ostringstream errst;
+  errst << "SymmetricMatrix: a full matrix of dimension (" << other.GetNRows() << " x " << other.GetNCols() << ") is not square, so it cannot be converted to a symmetric matrix.\n";
+  JMatrixStop(errst.str());
+ }
+
+ data.resize(this->nr);
+
+ indextype nblocks=(this->nr+SYMMETRIC_TILE_SIZE-1)/SYMMETRIC_TILE_SIZE;
+ if (nthreads==0)
+  nthreads=std::thread::hardware_concurrency();
+ if (nthreads>nblocks)
+  nthreads=(unsigned int)nblocks;
+ if (nthreads==0)
+  nthreads=1;
+
+ std::atomic<bool> asymfound(false);
+ indextype asymrow=0,asymcol=0;
+ std::mutex asymmtx;
+
+ auto copy=[&](unsigned int t)
+ {
+  for (indextype b=t;(b<nblocks) && !asymfound;b+=nthreads)
+  {
+   indextype r0=b*SYMMETRIC_TILE_SIZE;
+   indextype r1=std::min(this->nr,r0+SYMMETRIC_TILE_SIZE);
+   for (indextype r=r0;r<r1;r++)
+    data[r].assign(other.data[r],other.data[r]+r+1);
+   if (!check)
+    continue;
+   // The upper triangle of the block is compared with the rows below it as in FullMatrix(SymmetricMatrix<T>&)
+   for (indextype c=r0+1;c<this->nr;c++)
+   {
+    const T *low=other.data[c];
+    indextype rl=std::min(r1,c);
+    for (indextype r=r0;r<rl;r++)
+     if (other.data[r][c]!=low[r])
+     {
+      if (!asymfound.exchange(true))
+      {
+       std::lock_guard<std::mutex> lock(asymmtx);
+       asymrow=r;
+       asymcol=c;
+      }
+      return;
+     }
+   }
+  }
+ };
+
+ std::vector<std::thread> workers;
+ for (unsigned int t=1;t<nthreads;t++)
+  workers.push_back(std::thread(copy,t));
+ copy(0);
+ for (unsigned int t=0;t<workers.size();t++)
+  workers[t].join();
+
+ if (asymfound)
+ {
+  std::ostringstream errst;
+  errst << "SymmetricMatrix: the full matrix is not symmetric. Element (" << asymrow << "," << asymcol << ") differs from element (" << asymcol << "," << asymrow << ").\n";
+  JMatrixStop(errst.str());
+ }
+
+ std::vector<std::string> names=other.GetRowNames();
+ if (names.size()>0)
+  this->SetRowNames(names);
+ names=other.GetColNames();
+ if (names.size()>0)
+  this->SetColNames(names);
+ this->SetComment(other.GetComment());
+}
+
+TEMPLATES_CONVERT_CONST(SymmetricMatrix,FullMatrix,SINGLE_ARG(bool check,unsigned int nthreads))
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
 template <typename T>
 void SymmetricMatrix<T>::Resize(indextype newnr)
 {
@@ -129,6 +216,9 @@ TEMPLATES_DEFAULT_DEST(SymmetricMatrix)
 template <typename T>
 SymmetricMatrix<T>::SymmetricMatrix(std::string fname) : JMatrix<T>(fname,MTYPESYMMETRIC)
 {
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("SymmetricMatrix load");
+    JMatrixTraceSpan phase("allocate");
     try
     {
      data.resize(this->nr);
@@ -151,16 +241,20 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname) : JMatrix<T>(fname,MTYPES
         }
     }
     
+    phase.Next("read data");
     T *ddata = new T [this->nr];
     
     for (indextype r=0;r<this->nr;r++)
     {
-        this->ifile.read((char *)ddata,(r+1)*sizeof(T));
+        ReadValues(this->ifile,this->vcodec,r+1,ddata);
+        JStatElements(r+1);
         for (indextype c=0;c<=r;c++)
             data[r][c]=ddata[c];
     }
     
     delete[] ddata;
+    JStatRows(this->nr);
+    phase.End();
     
     this->ReadMetadata();                  // This is exclusively used when reading from a binary file, not from a csv file
       
@@ -179,6 +273,9 @@ TEMPLATES_CONST(SymmetricMatrix,std::string fname)
 template <typename T>
 SymmetricMatrix<T>::SymmetricMatrix(std::string fname,bool warn) : JMatrix<T>(fname,MTYPESYMMETRIC)
 {
+    JMatrixOpScope opscope(STATS_LOAD);
+    JMatrixTraceSpan span("SymmetricMatrix load");
+    JMatrixTraceSpan phase("allocate");
     if (warn)
      MemoryWarnings(this->nr,sizeof(T));
 
@@ -204,16 +301,20 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname,bool warn) : JMatrix<T>(fn
         }
     }
 
+    phase.Next("read data");
     T *ddata = new T [this->nr];
 
     for (indextype r=0;r<this->nr;r++)
     {
-        this->ifile.read((char *)ddata,(r+1)*sizeof(T));
+        ReadValues(this->ifile,this->vcodec,r+1,ddata);
+        JStatElements(r+1);
         for (indextype c=0;c<=r;c++)
             data[r][c]=ddata[c];
     }
 
     delete[] ddata;
+    JStatRows(this->nr);
+    phase.End();
 
     this->ReadMetadata();                  // This is exclusively used when reading from a binary file, not from a csv file
 
@@ -262,12 +363,16 @@ TEMPLATES_OPERATOR(SymmetricMatrix,=)
 template <typename T>
 SymmetricMatrix<T>::SymmetricMatrix(std::string fname,unsigned char vtype,char csep) : JMatrix<T>(fname,MTYPESYMMETRIC,vtype,csep)
 {
+    JMatrixOpScope opscope(STATS_READCSV);
+    JMatrixTraceSpan span("SymmetricMatrix load from csv");
+    JMatrixTraceSpan phase("count lines");
     std::string line;
     // This is just to know number of rows
     this->nr=0;
     while (!this->ifile.eof())
     {
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
             this->nr++;
     }
@@ -293,6 +398,7 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname,unsigned char vtype,char c
         std::cout << "         upper-triangular matrix will be read just to check the number of them and immediately ignored.\n";
     }
     
+    phase.Next("allocate");
     data.resize(this->nr);
     for (indextype r=0;r<this->nr;r++)
     {
@@ -300,12 +406,14 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname,unsigned char vtype,char c
      data[r].assign(r+1,T(0));
     }
     
+    phase.Next("parse lines");
     // Reposition pointer at the beginnig and re-read first (header) line
     // and no, seekg does not work (possibly, because we had reached the eof ???)
     this->ifile.close();
     this->ifile.open(fname.c_str());
     size_t p=0;
     getline(this->ifile,line);
+    JStatRead(line.size()+1);
     // No need to process first line here, it was done at the parent's class constructor
    
    if (DEB & DEBJM)
@@ -318,6 +426,7 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname,unsigned char vtype,char c
             std::cout.flush();
         }
         getline(this->ifile,line);
+        JStatRead(line.size()+1);
         if (!this->ifile.eof())
         {
           if (!this->ProcessDataLineCsvForSymmetric(line,csep,p,data[p]))
@@ -342,6 +451,9 @@ SymmetricMatrix<T>::SymmetricMatrix(std::string fname,unsigned char vtype,char c
             std::cout << " instead of " << this->nr << ".\n";
     }
     
+    JStatRows(p);
+    JStatElements((unsigned long long)p*this->nc);
+
     // No call to ReadMetadata must be done here, since these data are NOT binary. The column names were read by the parent's class constructor
     // and the row names are stored as they are read by the former call to ProcessDataLine
     
@@ -466,6 +578,9 @@ TEMPLATES_FUNCR(SymmetricMatrix,GetRowSum,indextype r)
 template <typename T>
 void SymmetricMatrix<T>::WriteBin(std::string fname)
 {
+    JMatrixOpScope opscope(STATS_WRITEBIN);
+    JMatrixTraceSpan span("SymmetricMatrix WriteBin");
+    SetValueCodec();
     ((JMatrix<T> *)this)->WriteBin(fname,MTYPESYMMETRIC);
     
     if (DEB & DEBJM)
@@ -474,36 +589,126 @@ void SymmetricMatrix<T>::WriteBin(std::string fname)
      std::cout.flush();
     }
     
+    WriteBinContents(this->ofile);
+    
+    this->ofile.close();
+}
+
+TEMPLATES_FUNC(void,SymmetricMatrix,WriteBin,std::string fname)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes all that comes after the header: the binary data, the metadata and the end-of-data offset.
+template <typename T>
+void SymmetricMatrix<T>::WriteBinContents(std::ostream &os)
+{
+    JMatrixTraceSpan phase("write data");
     T *ddata = new T [this->nr];
     
     for (indextype r=0;r<this->nr;r++)
     {
         for (indextype c=0;c<=r;c++)
             ddata[c]=data[r][c];
-        this->ofile.write((const char *)ddata,(r+1)*sizeof(T));
+        WriteValues(os,this->vcodec,ddata,r+1);
+        JStatElements(r+1);
     }
+    JStatRows(this->nr);
     
     delete[] ddata;
+    phase.End();
     
-    unsigned long long endofbindata = this->ofile.tellp();
+    unsigned long long endofbindata = (unsigned long long)os.tellp();
     
     if (DEB & DEBJM)
      std::cout << "End of block of binary data at offset " << endofbindata << "\n";
      
-    this->WriteMetadata();                // Here we must write the metadata at the end of the binary contents of the matrix
+    this->WriteMetadata(os);                // Here we must write the metadata at the end of the binary contents of the matrix
     
-    this->ofile.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    os.write((const char *)&endofbindata,sizeof(unsigned long long));  // This writes the point where binary data ends at the end of the file
+    JStatWrite(sizeof(unsigned long long));
+}
+
+TEMPLATES_FUNC(void,SymmetricMatrix,WriteBinContents,std::ostream &os)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Chooses the encoding of the values to be written, as set with JMatrixSetValueEncoding. Quantised encodings with no given range take that of the values.
+template <typename T>
+void SymmetricMatrix<T>::SetValueCodec()
+{
+    double minv=1.0,maxv=0.0;
+    if (ValueWriteNeedsRange(this->TypeNameToId()))
+    {
+        minv=std::numeric_limits<double>::max();
+        maxv=std::numeric_limits<double>::lowest();
+        for (indextype r=0;r<this->nr;r++)
+            for (indextype c=0;c<=r;c++)
+            {
+                // NaN fails both comparisons, so it does not change the range
+                if (double(data[r][c])<minv)
+                    minv=double(data[r][c]);
+                if (double(data[r][c])>maxv)
+                    maxv=double(data[r][c]);
+            }
+        if (minv>maxv)
+            minv=maxv=0.0;
+    }
+    this->vcodec=ValueWriteCodec(this->TypeNameToId(),minv,maxv);
+}
+
+TEMPLATES_FUNC(void,SymmetricMatrix,SetValueCodec,)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::future<int> SymmetricMatrix<T>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs)
+{
+    if (DEB & DEBJM)
+    {
+     std::cout << "Writing binary matrix " << fname << " of (" << this->nr << "x" << this->nc << ") asynchronously\n";
+     std::cout.flush();
+    }
     
-    this->ofile.close();
+    // The encoding is chosen now, with the setting of the moment of the call
+    SetValueCodec();
+
+    // The serialization runs in its own thread and the disk writes in the writer thread of AsyncWriteBuf, so that the caller is not blocked at all.
+    return std::async(std::launch::async,[this,fname,direct,nbufs]()
+    {
+        JMatrixOpScope opscope(STATS_WRITEBIN);
+        JMatrixTraceSpan span("SymmetricMatrix WriteBinAsync");
+        AsyncWriteBuf wb(DEFAULT_ASYNC_BUFFER_SIZE,nbufs);
+        int st=wb.Open(fname,direct);
+        if (st!=WRITE_OK)
+            return st;
+        std::ostream os(&wb);
+        this->WriteHeader(os,MTYPESYMMETRIC);
+        WriteBinContents(os);
+        return wb.Close();
+    });
 }
 
-TEMPLATES_FUNC(void,SymmetricMatrix,WriteBin,std::string fname)
+template std::future<int> SymmetricMatrix<unsigned char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<char>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<unsigned short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<short>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<unsigned int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<int>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<unsigned long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<unsigned long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<long long>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<float>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
+template std::future<int> SymmetricMatrix<long double>::WriteBinAsync(std::string fname,bool direct,unsigned int nbufs);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <typename T>
 void SymmetricMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
 {
+    JMatrixOpScope opscope(STATS_WRITECSV);
+    JMatrixTraceSpan span("SymmetricMatrix WriteCsv");
     // Remember: this writes the header, even if there were no column names (then, the header will be "","C1","C2",...)
     ((JMatrix<T> *)this)->WriteCsv(fname,csep,withquotes);
 
@@ -516,6 +721,7 @@ void SymmetricMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
     }
 
     int p = std::numeric_limits<T>::max_digits10;
+    JMatrixTraceSpan phase("write rows");
 
     // We have rows to write; otherwise we would have returned four lines ago...
     indextype rns=this->rownames.size();
@@ -541,6 +747,9 @@ void SymmetricMatrix<T>::WriteCsv(std::string fname,char csep,bool withquotes)
             this->ofile << std::setprecision(p) << data[c][r] << csep;
         this->ofile << std::setprecision(p) << data[this->nr-1][r] << std::endl;
     }
+    JStatWrite((unsigned long long)this->ofile.tellp());
+    JStatRows(this->nr);
+    JStatElements((unsigned long long)this->nr*this->nc);
     this->ofile.close();
 }
 
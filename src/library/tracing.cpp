@@ -0,0 +1,136 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include "../headers/tracing.h"
+#include "../headers/debugpar.h"
+
+extern unsigned char DEB;
+
+std::atomic<bool> JTraceOn(false);
+
+struct JTraceEvent
+{
+ const char *name;
+ long long start;
+ long long end;
+ unsigned int tid;
+};
+
+// Owner of the collected events. Its destructor writes the trace when the program ends with tracing ON.
+struct JTraceLog
+{
+ std::mutex mtx;
+ std::string fname;
+ std::vector<JTraceEvent> events;
+ long long origin;
+ unsigned int nthreads;
+
+ JTraceLog()
+ {
+  nthreads=0;
+  origin=JTraceNow();
+  const char *env=getenv("JMATRIX_TRACE");
+  if ((env!=nullptr) && (env[0]!='\0'))
+  {
+   fname=std::string(env);
+   JTraceOn=true;
+  }
+ }
+
+ ~JTraceLog()
+ {
+  if (JTraceOn)
+  {
+   JTraceOn=false;
+   Write();
+  }
+ }
+
+ // Small consecutive numbers for the threads are easier to read in the trace viewer than the system ones
+ unsigned int ThreadNumber()
+ {
+  static thread_local unsigned int tid=0;
+  if (tid==0)
+  {
+   std::lock_guard<std::mutex> lock(mtx);
+   tid=++nthreads;
+  }
+  return tid;
+ }
+
+ void Write()
+ {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ofstream f(fname.c_str());
+  if (!f.is_open())
+  {
+   JMatrixWarning("Cannot open file "+fname+" to write the trace.\n");
+   return;
+  }
+  f << std::fixed << std::setprecision(3);
+  f << "{\"traceEvents\":[\n";
+  for (size_t i=0;i<events.size();i++)
+  {
+   f << "{\"name\":\"" << events[i].name << "\",\"cat\":\"jmatrix\",\"ph\":\"X\",\"pid\":" << getpid() << ",\"tid\":" << events[i].tid
+     << ",\"ts\":" << double(events[i].start-origin)/1000.0 << ",\"dur\":" << double(events[i].end-events[i].start)/1000.0 << "}";
+   f << ((i+1<events.size()) ? ",\n" : "\n");
+  }
+  f << "],\"displayTimeUnit\":\"ms\"}\n";
+  f.close();
+  if (DEB & DEBJM)
+   std::cout << events.size() << " trace spans written to file " << fname << ".\n";
+  events.clear();
+ }
+};
+
+static JTraceLog JTrace;
+
+//////////////////////////////////////////////////////////////////
+
+void JTraceEmit(const char *name,long long start,long long end)
+{
+ unsigned int tid=JTrace.ThreadNumber();
+ std::lock_guard<std::mutex> lock(JTrace.mtx);
+ JTrace.events.push_back({name,start,end,tid});
+}
+
+//////////////////////////////////////////////////////////////////
+
+void JMatrixSetTrace(std::string fname)
+{
+ if (JTraceOn)
+ {
+  JTraceOn=false;
+  JTrace.Write();
+ }
+ if (fname!="")
+ {
+  {
+   std::lock_guard<std::mutex> lock(JTrace.mtx);
+   JTrace.fname=fname;
+   JTrace.events.clear();
+  }
+  JTraceOn=true;
+ }
+}
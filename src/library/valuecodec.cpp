@@ -0,0 +1,457 @@
+/*
+ *
+ * Copyright (C) 2022 Juan Domingo (Juan.Domingo@uv.es)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <type_traits>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+#include "../headers/jmatrix.h"
+#include "../headers/valuecodec.h"
+
+extern unsigned char DEB;
+
+// Values of matrices of types other than float are converted from/to 16-bit floats through a float array of this size
+const size_t VALUE_BLOCK=1024;
+
+// Encoding set with JMatrixSetValueEncoding, and its fixed range (none if minv>=maxv)
+static std::mutex ValueEncMutex;
+static unsigned char ValueEnc=VALUE_NATIVE;
+static double ValueEncMin=0.0;
+static double ValueEncMax=0.0;
+
+std::string ValueEncodingName(unsigned char enc)
+{
+    switch (enc)
+    {
+        case VALUE_NATIVE:   return "native";
+        case VALUE_HALF:     return "half precision float (16 bits)";
+        case VALUE_BFLOAT16: return "bfloat16 (16 bits)";
+        case VALUE_Q8:       return "quantised in 8 bits";
+        case VALUE_Q16:      return "quantised in 16 bits";
+        default:             return "unknown encoding";
+    }
+}
+
+unsigned char ValueEncodingFromName(std::string name)
+{
+    if (name=="native")
+     return VALUE_NATIVE;
+    if (name=="half")
+     return VALUE_HALF;
+    if (name=="bfloat16")
+     return VALUE_BFLOAT16;
+    if (name=="q8")
+     return VALUE_Q8;
+    if (name=="q16")
+     return VALUE_Q16;
+    return NOTYPE;
+}
+
+size_t ValueSize(const ValueCodec &vc,size_t tsize)
+{
+    switch (vc.enc)
+    {
+        case VALUE_Q8:       return sizeof(unsigned char);
+        case VALUE_HALF:
+        case VALUE_BFLOAT16:
+        case VALUE_Q16:      return sizeof(unsigned short);
+        default:             return (vc.stype==NOTYPE) ? tsize : size_t(SizeOfType(vc.stype));
+    }
+}
+
+void JMatrixSetValueEncoding(unsigned char enc,double minv,double maxv)
+{
+    if (enc>VALUE_Q16)
+    {
+     std::ostringstream errst;
+     errst << int(enc) << " is not a valid value encoding.\n";
+     JMatrixStop(errst.str());
+    }
+    if ((minv<maxv) && !(std::isfinite(minv) && std::isfinite(maxv)))
+     JMatrixStop("JMatrixSetValueEncoding: the range of the quantised values must be finite.\n");
+    std::lock_guard<std::mutex> lock(ValueEncMutex);
+    ValueEnc=enc;
+    ValueEncMin=minv;
+    ValueEncMax=maxv;
+}
+
+// Only values of floating point types are encoded
+static bool IsFloatType(unsigned char ctype)
+{
+    return (ctype==FTYPE) || (ctype==DTYPE) || (ctype==LDTYPE);
+}
+
+bool ValueWriteNeedsRange(unsigned char ctype)
+{
+    std::lock_guard<std::mutex> lock(ValueEncMutex);
+    return IsFloatType(ctype) && ((ValueEnc==VALUE_Q8) || (ValueEnc==VALUE_Q16)) && !(ValueEncMin<ValueEncMax);
+}
+
+ValueCodec ValueWriteCodec(unsigned char ctype,double minv,double maxv)
+{
+    ValueCodec vc;
+    if (!IsFloatType(ctype))
+     return vc;
+
+    std::lock_guard<std::mutex> lock(ValueEncMutex);
+    vc.enc=ValueEnc;
+    if ((vc.enc==VALUE_Q8) || (vc.enc==VALUE_Q16))
+    {
+     if (ValueEncMin<ValueEncMax)
+     {
+      minv=ValueEncMin;
+      maxv=ValueEncMax;
+     }
+     if (minv>maxv)
+      JMatrixStop("The range of the values to be quantised is not known. Give it with JMatrixSetValueEncoding or JMatrixWriter::SetValueRange.\n");
+     if (!(std::isfinite(minv) && std::isfinite(maxv)))
+      JMatrixStop("Values with infinite range cannot be quantised.\n");
+     double qmax = (vc.enc==VALUE_Q8) ? 255.0 : 65535.0;
+     vc.offset=minv;
+     vc.scale = (maxv>minv) ? (maxv-minv)/qmax : 1.0;
+    }
+    if ((DEB & DEBJM) && (vc.enc!=VALUE_NATIVE))
+     std::cout << "Values will be written as " << ValueEncodingName(vc.enc) << " (scale " << vc.scale << ", offset " << vc.offset << ").\n";
+    return vc;
+}
+
+/******************************************************
+  CONVERSION KERNELS
+******************************************************/
+
+// Half precision to float. Normal numbers only need their exponent rebiased; subnormals are normalized by a float subtraction.
+static inline float HalfToFloat1(unsigned short h)
+{
+    const unsigned int EXPMASK=0x7C00u << 13;
+    unsigned int o=((unsigned int)(h & 0x7FFF)) << 13;
+    unsigned int e=o & EXPMASK;
+    float f;
+    o += (unsigned int)(127-15) << 23;
+    if (e==EXPMASK)                         // Inf or NaN
+     o += (unsigned int)(128-16) << 23;
+    else if (e==0)                          // Zero or subnormal
+    {
+     o += 1u << 23;
+     memcpy((void *)&f,(const void *)&o,sizeof(float));
+     f -= 6.103515625e-05f;                 // 2^-14, the smallest normal half
+     memcpy((void *)&o,(const void *)&f,sizeof(float));
+    }
+    o |= ((unsigned int)(h & 0x8000)) << 16;
+    memcpy((void *)&f,(const void *)&o,sizeof(float));
+    return f;
+}
+
+// Float to half precision, rounding to nearest even. Values too big for a half become Inf.
+static inline unsigned short FloatToHalf1(float x)
+{
+    unsigned int f,o;
+    memcpy((void *)&f,(const void *)&x,sizeof(float));
+    unsigned int sign=f & 0x80000000u;
+    f ^= sign;
+    if (f>=(143u << 23))                    // 65536 or more, Inf or NaN
+     o = (f>(255u << 23)) ? 0x7E00 : 0x7C00;
+    else if (f<(113u << 23))                // Subnormal half or zero: adding 0.5 leaves the rounded mantissa in the lowest bits
+    {
+     float t;
+     memcpy((void *)&t,(const void *)&f,sizeof(float));
+     t += 0.5f;
+     memcpy((void *)&o,(const void *)&t,sizeof(float));
+     o -= (126u << 23);
+    }
+    else
+    {
+     unsigned int odd=(f >> 13) & 1;
+     f += ((unsigned int)(15-127) << 23)+0xFFF+odd;
+     o = f >> 13;
+    }
+    return (unsigned short)(o | (sign >> 16));
+}
+
+// bfloat16 is the upper half of a float
+static inline float BFloat16ToFloat1(unsigned short b)
+{
+    unsigned int o=((unsigned int)b) << 16;
+    float f;
+    memcpy((void *)&f,(const void *)&o,sizeof(float));
+    return f;
+}
+
+static inline unsigned short FloatToBFloat161(float x)
+{
+    unsigned int f;
+    memcpy((void *)&f,(const void *)&x,sizeof(float));
+    if ((f & 0x7FFFFFFFu)>0x7F800000u)      // NaN must remain a NaN, whatever its mantissa
+     return (unsigned short)((f >> 16) | 0x40);
+    f += 0x7FFFu+((f >> 16) & 1);           // Round to nearest even
+    return (unsigned short)(f >> 16);
+}
+
+// 16-bit floats at src to floats. With F16C, eight of them at a time.
+static void Decode16(unsigned char enc,const unsigned char *src,size_t n,float *v)
+{
+    unsigned short h;
+    size_t i=0;
+    if (enc==VALUE_HALF)
+    {
+#if defined(__F16C__)
+     for (;i+8<=n;i+=8)
+      _mm256_storeu_ps(v+i,_mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src+i*sizeof(unsigned short)))));
+#endif
+     for (;i<n;i++)
+     {
+      memcpy((void *)&h,(const void *)(src+i*sizeof(unsigned short)),sizeof(unsigned short));
+      v[i]=HalfToFloat1(h);
+     }
+    }
+    else
+     for (;i<n;i++)
+     {
+      memcpy((void *)&h,(const void *)(src+i*sizeof(unsigned short)),sizeof(unsigned short));
+      v[i]=BFloat16ToFloat1(h);
+     }
+}
+
+static void Encode16(unsigned char enc,const float *v,size_t n,unsigned char *dst)
+{
+    unsigned short h;
+    size_t i=0;
+    if (enc==VALUE_HALF)
+    {
+#if defined(__F16C__)
+     for (;i+8<=n;i+=8)
+      _mm_storeu_si128((__m128i *)(dst+i*sizeof(unsigned short)),_mm256_cvtps_ph(_mm256_loadu_ps(v+i),_MM_FROUND_TO_NEAREST_INT));
+#endif
+     for (;i<n;i++)
+     {
+      h=FloatToHalf1(v[i]);
+      memcpy((void *)(dst+i*sizeof(unsigned short)),(const void *)&h,sizeof(unsigned short));
+     }
+    }
+    else
+     for (;i<n;i++)
+     {
+      h=FloatToBFloat161(v[i]);
+      memcpy((void *)(dst+i*sizeof(unsigned short)),(const void *)&h,sizeof(unsigned short));
+     }
+}
+
+// Quantised values are offset+scale*q. Float matrices do the arithmetic in float, so that the loop vectorizes with the widest lanes.
+template <typename T,typename Q>
+static void Dequantise(const ValueCodec &vc,const unsigned char *src,size_t n,T *v)
+{
+    typedef typename std::conditional<std::is_same<T,float>::value,float,double>::type W;
+    const W scale=W(vc.scale);
+    const W offset=W(vc.offset);
+    Q q;
+    for (size_t i=0;i<n;i++)
+    {
+     memcpy((void *)&q,(const void *)(src+i*sizeof(Q)),sizeof(Q));
+     v[i]=T(offset+scale*W(q));
+    }
+}
+
+template <typename T,typename Q>
+static void Quantise(const ValueCodec &vc,const T *v,size_t n,unsigned char *dst)
+{
+    const double qmax=double(Q(~Q(0)));
+    const double inv=1.0/vc.scale;
+    double x;
+    Q q;
+    for (size_t i=0;i<n;i++)
+    {
+     x=(double(v[i])-vc.offset)*inv;
+     // Written so that NaN becomes 0
+     q = (!(x>0.0)) ? Q(0) : ((x>=qmax) ? Q(qmax) : Q(x+0.5));
+     memcpy((void *)(dst+i*sizeof(Q)),(const void *)&q,sizeof(Q));
+    }
+}
+
+template <typename T>
+static unsigned char ValueTypeId()
+{
+    if (std::is_same<T,unsigned char>::value)      return UCTYPE;
+    if (std::is_same<T,char>::value)               return SCTYPE;
+    if (std::is_same<T,unsigned short>::value)     return USTYPE;
+    if (std::is_same<T,short>::value)              return SSTYPE;
+    if (std::is_same<T,unsigned int>::value)       return UITYPE;
+    if (std::is_same<T,int>::value)                return SITYPE;
+    if (std::is_same<T,unsigned long>::value)      return ULTYPE;
+    if (std::is_same<T,long>::value)               return SLTYPE;
+    if (std::is_same<T,unsigned long long>::value) return ULLTYPE;
+    if (std::is_same<T,long long>::value)          return SLLTYPE;
+    if (std::is_same<T,float>::value)              return FTYPE;
+    if (std::is_same<T,double>::value)             return DTYPE;
+    if (std::is_same<T,long double>::value)        return LDTYPE;
+    return NOTYPE;
+}
+
+// Values stored as type S are copied to an aligned block and converted to T with a plain loop, which the compiler vectorizes for the usual pairs of types
+template <typename S,typename T>
+static void ConvertValues(const unsigned char *src,size_t n,T *v)
+{
+    S s[VALUE_BLOCK];
+    for (size_t i=0;i<n;i+=VALUE_BLOCK)
+    {
+     size_t m=std::min(VALUE_BLOCK,n-i);
+     memcpy((void *)s,(const void *)(src+i*sizeof(S)),m*sizeof(S));
+     for (size_t k=0;k<m;k++)
+      v[i+k]=T(s[k]);
+    }
+}
+
+template <typename T>
+static void ConvertStored(unsigned char stype,const unsigned char *src,size_t n,T *v)
+{
+    switch (stype)
+    {
+        case UCTYPE:  ConvertValues<unsigned char>(src,n,v); break;
+        case SCTYPE:  ConvertValues<char>(src,n,v); break;
+        case USTYPE:  ConvertValues<unsigned short>(src,n,v); break;
+        case SSTYPE:  ConvertValues<short>(src,n,v); break;
+        case UITYPE:  ConvertValues<unsigned int>(src,n,v); break;
+        case SITYPE:  ConvertValues<int>(src,n,v); break;
+        case ULTYPE:  ConvertValues<unsigned long>(src,n,v); break;
+        case SLTYPE:  ConvertValues<long>(src,n,v); break;
+        case ULLTYPE: ConvertValues<unsigned long long>(src,n,v); break;
+        case SLLTYPE: ConvertValues<long long>(src,n,v); break;
+        case FTYPE:   ConvertValues<float>(src,n,v); break;
+        case DTYPE:   ConvertValues<double>(src,n,v); break;
+        case LDTYPE:  ConvertValues<long double>(src,n,v); break;
+        default:      JMatrixStop("Values stored in a binary file are of an unknown data type.\n");
+    }
+}
+
+/******************************************************
+  TEMPLATED FUNCTIONS
+******************************************************/
+
+template <typename T>
+bool ValueIsRaw(const ValueCodec &vc)
+{
+    return (vc.enc==VALUE_NATIVE) && ((vc.stype==NOTYPE) || (vc.stype==ValueTypeId<T>()));
+}
+
+template bool ValueIsRaw<unsigned char>(const ValueCodec &vc);
+template bool ValueIsRaw<char>(const ValueCodec &vc);
+template bool ValueIsRaw<unsigned short>(const ValueCodec &vc);
+template bool ValueIsRaw<short>(const ValueCodec &vc);
+template bool ValueIsRaw<unsigned int>(const ValueCodec &vc);
+template bool ValueIsRaw<int>(const ValueCodec &vc);
+template bool ValueIsRaw<unsigned long>(const ValueCodec &vc);
+template bool ValueIsRaw<long>(const ValueCodec &vc);
+template bool ValueIsRaw<unsigned long long>(const ValueCodec &vc);
+template bool ValueIsRaw<long long>(const ValueCodec &vc);
+template bool ValueIsRaw<float>(const ValueCodec &vc);
+template bool ValueIsRaw<double>(const ValueCodec &vc);
+template bool ValueIsRaw<long double>(const ValueCodec &vc);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,T *v)
+{
+    switch (vc.enc)
+    {
+        case VALUE_HALF:
+        case VALUE_BFLOAT16:
+        {
+         if (std::is_same<T,float>::value)
+         {
+          Decode16(vc.enc,src,n,reinterpret_cast<float *>(v));
+          break;
+         }
+         float f[VALUE_BLOCK];
+         for (size_t i=0;i<n;i+=VALUE_BLOCK)
+         {
+          size_t m=std::min(VALUE_BLOCK,n-i);
+          Decode16(vc.enc,src+i*sizeof(unsigned short),m,f);
+          for (size_t k=0;k<m;k++)
+           v[i+k]=T(f[k]);
+         }
+         break;
+        }
+        case VALUE_Q8:  Dequantise<T,unsigned char>(vc,src,n,v); break;
+        case VALUE_Q16: Dequantise<T,unsigned short>(vc,src,n,v); break;
+        default:
+         if (ValueIsRaw<T>(vc))
+          memcpy((void *)v,(const void *)src,n*sizeof(T));
+         else
+          ConvertStored(vc.stype,src,n,v);
+         break;
+    }
+}
+
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,unsigned char *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,char *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,unsigned short *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,short *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,unsigned int *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,int *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,unsigned long *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,long *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,unsigned long long *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,long long *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,float *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,double *v);
+template void DecodeValues(const ValueCodec &vc,const unsigned char *src,size_t n,long double *v);
+
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+void EncodeValues(const ValueCodec &vc,const T *v,size_t n,unsigned char *dst)
+{
+    switch (vc.enc)
+    {
+        case VALUE_HALF:
+        case VALUE_BFLOAT16:
+        {
+         if (std::is_same<T,float>::value)
+         {
+          Encode16(vc.enc,reinterpret_cast<const float *>(v),n,dst);
+          break;
+         }
+         float f[VALUE_BLOCK];
+         for (size_t i=0;i<n;i+=VALUE_BLOCK)
+         {
+          size_t m=std::min(VALUE_BLOCK,n-i);
+          for (size_t k=0;k<m;k++)
+           f[k]=float(v[i+k]);
+          Encode16(vc.enc,f,m,dst+i*sizeof(unsigned short));
+         }
+         break;
+        }
+        case VALUE_Q8:  Quantise<T,unsigned char>(vc,v,n,dst); break;
+        case VALUE_Q16: Quantise<T,unsigned short>(vc,v,n,dst); break;
+        default:        memcpy((void *)dst,(const void *)v,n*sizeof(T)); break;
+    }
+}
+
+template void EncodeValues(const ValueCodec &vc,const unsigned char *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const char *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const unsigned short *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const short *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const unsigned int *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const int *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const unsigned long *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const long *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const unsigned long long *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const long long *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const float *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const double *v,size_t n,unsigned char *dst);
+template void EncodeValues(const ValueCodec &vc,const long double *v,size_t n,unsigned char *dst);